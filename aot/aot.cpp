@@ -0,0 +1,473 @@
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <set>
+#include <string>
+#include <vector>
+#include "core/command_line.h"
+#include "core/file.h"
+#include "core/log.h"
+#include "core/scope_exit.h"
+#include "cpu/x86/aot.h"
+#include "cpu/x86/block_cache.h"
+#include "cpu/x86/decoder.h"
+#include "dos/exe.h"
+#include "fmt/format.h"
+
+using namespace wwiv::core;
+using namespace door86::cpu::x86;
+using namespace door86::dos;
+
+// Translates a COM or EXE into C++ with one function per basic block, which
+// is compiled into a module that door86 loads for that exact image (see
+// cpu/x86/aot.h).
+//
+// Code is found by following branches from the entry point, so anything
+// only reached through a jump table or computed address is left to the
+// interpreter, as is anything that doesn't match the file at run time.
+
+// The program as it is loaded into memory.
+struct image_t {
+  std::vector<uint8_t> data;
+  // Bytes of data that came from the file, the rest is padding.
+  uint32_t size{0};
+  // Bytes of data patched by EXE relocations.
+  std::set<uint32_t> relocated;
+  // offset of the entry point's code segment from the start of the image,
+  // (negative for a COM file since CS is the PSP).
+  int32_t entry_seg_base{0};
+  uint16_t entry_ip{0};
+  uint64_t hash{0};
+};
+
+// A place code was found, CS relative.
+struct target_t {
+  int32_t seg_base;
+  uint16_t ip;
+};
+
+struct block_info_t {
+  std::vector<instruction_t> insts;
+  uint32_t len{0};
+};
+
+static std::optional<image_t> read_image(const std::string& filename) {
+  File f(filename);
+  const auto len = f.length();
+  if (len <= 0 || !f.Open(File::modeBinary | File::modeReadOnly)) {
+    LOG(WARNING) << "Failed to open file: " << filename;
+    return std::nullopt;
+  }
+  std::vector<uint8_t> file(len);
+  if (f.Read(&file[0], len) != len) {
+    LOG(WARNING) << "Failed to read all bytes from file: " << filename;
+    return std::nullopt;
+  }
+
+  image_t image;
+  image.hash = image_hash(file.data(), file.size());
+  uint32_t header_size = 0;
+  if (is_exe(filename)) {
+    const auto exe = read_exe_header(filename);
+    if (!exe) {
+      LOG(WARNING) << "Failed to read exe header: " << filename;
+      return std::nullopt;
+    }
+    header_size = exe->header_size();
+    image.entry_seg_base = exe->hdr.cs * 0x10;
+    image.entry_ip = exe->hdr.ip;
+    for (const auto& r : exe->relos) {
+      const uint32_t off = (r.segment * 0x10) + r.offset;
+      image.relocated.insert(off);
+      image.relocated.insert(off + 1);
+    }
+  } else {
+    // COM files are loaded at offset 100h of the PSP segment.
+    image.entry_seg_base = -0x100;
+    image.entry_ip = 0x100;
+  }
+  if (header_size > file.size()) {
+    return std::nullopt;
+  }
+  image.data.assign(file.begin() + header_size, file.end());
+  image.size = static_cast<uint32_t>(image.data.size());
+  // So the decoder can't read past the end.
+  image.data.resize(image.size + max_instruction_len);
+  return image;
+}
+
+// Returns true if execution can continue with the instruction after inst.
+static bool falls_through(const instruction_t& inst) {
+  if (inst.metadata->mask & op_mask_notimpl) {
+    return false;
+  }
+  switch (inst.op) {
+  // POP CS, MOV CS
+  case 0x0F: return false;
+  case 0x8E: return inst.mdrm.reg != 1;
+  // RET, RETF, IRET, JMP
+  case 0xC2:
+  case 0xC3:
+  case 0xCA:
+  case 0xCB:
+  case 0xCF:
+  case 0xE9:
+  case 0xEA:
+  case 0xEB:
+  // HLT
+  case 0xF4: return false;
+  // JMP r/m16, JMP m16:16
+  case 0xFF: return inst.mdrm.reg != 4 && inst.mdrm.reg != 5;
+  }
+  return true;
+}
+
+// Returns the CS relative target of a near branch, if inst is one.
+static std::optional<uint16_t> branch_target(const instruction_t& inst, uint16_t next_ip) {
+  const auto op = inst.op;
+  if ((op >= 0x70 && op <= 0x7F) || (op >= 0xE0 && op <= 0xE3) || op == 0xEB) {
+    return static_cast<uint16_t>(next_ip + static_cast<int8_t>(inst.imm8));
+  }
+  if (op == 0xE8 || op == 0xE9) {
+    return static_cast<uint16_t>(next_ip + static_cast<int16_t>(inst.imm16));
+  }
+  return std::nullopt;
+}
+
+// Follows every branch from the entry point, returning the blocks found by
+// image offset. The instructions point into decoder, so it has to outlive them.
+static std::map<uint32_t, block_info_t> find_blocks(Decoder& decoder, const image_t& image) {
+  std::map<uint32_t, block_info_t> blocks;
+  std::set<uint32_t> seen;
+  std::deque<target_t> work{{image.entry_seg_base, image.entry_ip}};
+  while (!work.empty()) {
+    const auto t = work.front();
+    work.pop_front();
+    if (t.seg_base + t.ip < 0) {
+      continue;
+    }
+    const auto start = static_cast<uint32_t>(t.seg_base + t.ip);
+    if (!seen.insert(start).second) {
+      continue;
+    }
+
+    block_info_t b;
+    auto ip = t.ip;
+    bool complete = false;
+    while (static_cast<int>(b.insts.size()) < BlockCache::max_block_len) {
+      const auto pos = start + b.len;
+      if (pos >= image.size) {
+        break;
+      }
+      const auto inst = decoder.decode(&image.data[pos]);
+      if (pos + inst.len > image.size) {
+        // Ran off the end of the file.
+        break;
+      }
+      b.insts.push_back(inst);
+      b.len += inst.len;
+      ip = static_cast<uint16_t>(ip + inst.len);
+      if (BlockCache::ends_block(inst)) {
+        if (const auto target = branch_target(inst, ip)) {
+          work.push_back({t.seg_base, target.value()});
+        }
+        complete = !falls_through(inst);
+        break;
+      }
+    }
+    if (!complete) {
+      work.push_back({t.seg_base, ip});
+    }
+    if (b.insts.empty()) {
+      continue;
+    }
+    bool relocated = false;
+    for (auto i = start; i < start + b.len; i++) {
+      relocated |= image.relocated.count(i) > 0;
+    }
+    if (relocated) {
+      // Memory won't match the file once the relocations are applied.
+      VLOG(1) << fmt::format("Skipping relocated block at: {:05x}", start);
+      continue;
+    }
+    blocks.emplace(start, std::move(b));
+  }
+  return blocks;
+}
+
+static const char* reg16[] = {"ax", "cx", "dx", "bx", "sp", "bp", "si", "di"};
+static const char* reg8[] = {"al", "cl", "dl", "bl", "ah", "ch", "dh", "bh"};
+
+// Jcc conditions, in opcode order, the same as CPU::execute_0x7.
+static const char* conditions[] = {
+    "c.flags.oflag()",
+    "!c.flags.oflag()",
+    "c.flags.cflag()",
+    "!c.flags.cflag()",
+    "c.flags.zflag()",
+    "!c.flags.zflag()",
+    "c.flags.cflag() || c.flags.zflag()",
+    "!c.flags.cflag() && !c.flags.zflag()",
+    "c.flags.sflag()",
+    "!c.flags.sflag()",
+    "c.flags.pflag()",
+    "!c.flags.pflag()",
+    "c.flags.sflag() != c.flags.oflag()",
+    "c.flags.sflag() == c.flags.oflag()",
+    "c.flags.zflag() || (c.flags.sflag() != c.flags.oflag())",
+    "!c.flags.zflag() && (c.flags.sflag() == c.flags.oflag())"};
+
+// ALU operation n (bits 3-5 of 00-3F, reg of 80-83) on an Rmm for dst with src.
+static std::string alu(int n, bool wide, int dst, const std::string& src) {
+  const auto rmm = wide ? fmt::format("R16(&c, &r.{})", reg16[dst])
+                        : fmt::format("R8(&c, &h.{})", reg8[dst]);
+  switch (n) {
+  case 0: return fmt::format("{} += {};", rmm, src);
+  case 1: return fmt::format("{} |= {};", rmm, src);
+  case 2: return fmt::format("{}.adc({});", rmm, src);
+  case 3: return fmt::format("{}.sbb({});", rmm, src);
+  case 4: return fmt::format("{} &= {};", rmm, src);
+  case 5: return fmt::format("{} -= {};", rmm, src);
+  case 6: return fmt::format("{} ^= {};", rmm, src);
+  case 7: return fmt::format("{}.cmp({});", rmm, src);
+  }
+  return {};
+}
+
+static std::string reg(bool wide, int n) {
+  return fmt::format("{}.{}", wide ? "r" : "h", wide ? reg16[n] : reg8[n]);
+}
+
+// Returns C++ for instructions that only touch registers and flags, using the
+// same Rmm operations as the interpreter so the results are identical.
+// Returns nothing for anything that should go through the interpreter.
+static std::optional<std::string> translate(const instruction_t& inst) {
+  if (inst.metadata->mask & op_mask_notimpl) {
+    return std::nullopt;
+  }
+  const auto op = inst.op;
+  const bool reg3 = inst.mdrm.mod == 3;
+  const bool wide = op & 0x01;
+  if (op < 0x40 && (op & 0x07) <= 0x05) {
+    const auto n = (op >> 3) & 0x07;
+    switch (op & 0x07) {
+    // op r/m, r
+    case 0x0:
+    case 0x1:
+      if (reg3) {
+        return alu(n, wide, inst.mdrm.rm, reg(wide, inst.mdrm.reg));
+      }
+      return std::nullopt;
+    // op r, r/m
+    case 0x2:
+    case 0x3:
+      if (reg3) {
+        return alu(n, wide, inst.mdrm.reg, reg(wide, inst.mdrm.rm));
+      }
+      return std::nullopt;
+    // op AL, imm8
+    case 0x4: return alu(n, false, 0, fmt::format("0x{:02x}", inst.imm8));
+    // op AX, imm16
+    case 0x5: return alu(n, true, 0, fmt::format("0x{:04x}", inst.imm16));
+    }
+  }
+  if (op >= 0x40 && op <= 0x4F) {
+    return fmt::format("R16(&c, &r.{}).{}();", reg16[op & 0x07], (op & 0x08) ? "dec" : "inc");
+  }
+  if (op >= 0xB0 && op <= 0xB7) {
+    return fmt::format("h.{} = 0x{:02x};", reg8[op & 0x07], inst.imm8);
+  }
+  if (op >= 0xB8 && op <= 0xBF) {
+    return fmt::format("r.{} = 0x{:04x};", reg16[op & 0x07], inst.imm16);
+  }
+  if (!reg3 && op != 0x90) {
+    return std::nullopt;
+  }
+  switch (op) {
+  case 0x80: return alu(inst.mdrm.reg, false, inst.mdrm.rm, fmt::format("0x{:02x}", inst.imm8));
+  case 0x81: return alu(inst.mdrm.reg, true, inst.mdrm.rm, fmt::format("0x{:04x}", inst.imm16));
+  case 0x83:
+    return alu(inst.mdrm.reg, true, inst.mdrm.rm,
+               fmt::format("0x{:04x}",
+                           static_cast<uint16_t>(static_cast<int8_t>(inst.imm8))));
+  case 0x88:
+  case 0x89:
+    return fmt::format("{} = {};", reg(wide, inst.mdrm.rm), reg(wide, inst.mdrm.reg));
+  case 0x8A:
+  case 0x8B:
+    return fmt::format("{} = {};", reg(wide, inst.mdrm.reg), reg(wide, inst.mdrm.rm));
+  case 0x90: return std::string();
+  }
+  return std::nullopt;
+}
+
+// Returns C++ for branches that don't need the interpreter. ip must already
+// point past inst.
+static std::optional<std::string> translate_branch(const instruction_t& inst) {
+  const auto op = inst.op;
+  if (op >= 0x70 && op <= 0x7F) {
+    return fmt::format("if ({}) {{\n    c.ip = static_cast<uint16_t>(c.ip + {});\n  }}",
+                       conditions[op & 0x0F], static_cast<int8_t>(inst.imm8));
+  }
+  if (op == 0xEB) {
+    return fmt::format("c.ip = static_cast<uint16_t>(c.ip + {});", static_cast<int8_t>(inst.imm8));
+  }
+  if (op == 0xE9) {
+    return fmt::format("c.ip = static_cast<uint16_t>(c.ip + {});",
+                       static_cast<int16_t>(inst.imm16));
+  }
+  return std::nullopt;
+}
+
+struct stats_t {
+  int blocks{0};
+  int native{0};
+  int fallback{0};
+};
+
+static std::string generate_block(const image_t& image, uint32_t start, const block_info_t& b,
+                                  stats_t& stats) {
+  std::string s;
+  s += fmt::format("static const uint8_t code_{:05x}[] = {{", start);
+  for (uint32_t i = 0; i < b.len; i++) {
+    const auto* sep = i == 0 ? "\n    " : (i % 12) ? ", " : ",\n    ";
+    s += fmt::format("{}0x{:02x}", sep, image.data[start + i]);
+  }
+  s += "};\n\n";
+
+  s += fmt::format(
+      "static uint32_t block_{:05x}(CPU& cpu, [[maybe_unused]] const block_t& block) {{\n", start);
+  s += "  [[maybe_unused]] auto& c = cpu.core;\n";
+  s += "  [[maybe_unused]] auto& r = c.regs.x;\n";
+  s += "  [[maybe_unused]] auto& h = c.regs.h;\n";
+  // Bytes of instructions run since core.ip was last updated.
+  uint32_t ip_pending = 0;
+  const auto sync_ip = [&] {
+    if (ip_pending) {
+      s += fmt::format("  c.ip += {};\n", ip_pending);
+      ip_pending = 0;
+    }
+  };
+  uint32_t off = 0;
+  for (size_t i = 0; i < b.insts.size(); i++) {
+    const auto& inst = b.insts[i];
+    auto text = inst.DebugString();
+    text.erase(text.find_last_not_of(' ') + 1);
+    s += fmt::format("  // {}\n", text);
+    ip_pending += inst.len;
+    if (const auto code = translate(inst)) {
+      if (!code->empty()) {
+        s += fmt::format("  {}\n", code.value());
+      }
+      ++stats.native;
+    } else if (const auto branch = translate_branch(inst)) {
+      sync_ip();
+      s += fmt::format("  {}\n", branch.value());
+      ++stats.native;
+    } else {
+      sync_ip();
+      s += fmt::format("  static const auto i{} = aot_decode(code_{:05x} + {});\n", i, start, off);
+      if (i + 1 < b.insts.size()) {
+        s += fmt::format("  if (!aot_execute(cpu, block, i{})) {{\n    return {};\n  }}\n", i,
+                         i + 1);
+      } else {
+        s += fmt::format("  aot_execute(cpu, block, i{});\n", i);
+      }
+      ++stats.fallback;
+    }
+    off += inst.len;
+  }
+  sync_ip();
+  s += fmt::format("  return {};\n", b.insts.size());
+  s += "}\n\n";
+  ++stats.blocks;
+  return s;
+}
+
+static std::string generate(const std::string& filename, const image_t& image,
+                            const std::map<uint32_t, block_info_t>& blocks, stats_t& stats) {
+  std::string s;
+  s += fmt::format("// Generated by aot from {}, do not edit.\n", filename);
+  s += "#include \"cpu/x86/aot.h\"\n";
+  s += "#include \"cpu/x86/cpu.h\"\n";
+  s += "#include \"cpu/x86/rmm.h\"\n";
+  s += "#include <cstdint>\n\n";
+  s += "using namespace door86::cpu::x86;\n";
+  s += "using R8 = Rmm<RmmType::REGISTER, uint8_t>;\n";
+  s += "using R16 = Rmm<RmmType::REGISTER, uint16_t>;\n\n";
+  for (const auto& [start, b] : blocks) {
+    s += generate_block(image, start, b, stats);
+  }
+  if (blocks.empty()) {
+    s += "static const aot_block_t* blocks = nullptr;\n\n";
+  } else {
+    s += "static const aot_block_t blocks[] = {\n";
+    for (const auto& [start, b] : blocks) {
+      s += fmt::format("    {{0x{:05x}, {}, code_{:05x}, block_{:05x}}},\n", start, b.len, start,
+                       start);
+    }
+    s += "};\n\n";
+  }
+  s += fmt::format("extern \"C\" DOOR86_AOT_EXPORT const aot_module_t* {}() {{\n",
+                   aot_module_symbol);
+  s += fmt::format("  static const aot_module_t module{{aot_abi_version, 0x{:016x}ull, {}, blocks}};\n",
+                   image.hash, blocks.size());
+  s += "  return &module;\n";
+  s += "}\n";
+  return s;
+}
+
+int main(int argc, char** argv) {
+  LoggerConfig config;
+  Logger::Init(argc, argv, config);
+
+  ScopeExit at_exit(Logger::ExitLogger);
+  CommandLine cmdline(argc, argv, "");
+  cmdline.add_argument(
+      {"output", 'o', "File to write the generated C++ to. (default: <hash>.cpp)", ""});
+  // Ignore this one. used by logger
+  cmdline.add_argument({"v", "verbose log", "0"});
+  cmdline.set_no_args_allowed(true);
+
+  if (!cmdline.Parse()) {
+    std::cout << cmdline.GetHelp() << std::endl;
+    return EXIT_FAILURE;
+  }
+  if (cmdline.help_requested()) {
+    std::cout << cmdline.GetHelp() << std::endl;
+    return EXIT_SUCCESS;
+  }
+
+  if (cmdline.remaining().empty()) {
+    std::cout << "Usage: aot [options] <exename>\r\n" << cmdline.GetHelp() << std::endl;
+    return 1;
+  }
+  const auto& filename = cmdline.remaining().front();
+
+  const auto image = read_image(filename);
+  if (!image) {
+    std::cout << "Failed to read: " << filename << std::endl;
+    return EXIT_FAILURE;
+  }
+  Decoder decoder(false);
+  const auto blocks = find_blocks(decoder, image.value());
+  stats_t stats;
+  const auto code = generate(filename, image.value(), blocks, stats);
+
+  auto output = cmdline.sarg("output");
+  if (output.empty()) {
+    output = fmt::format("{:016x}.cpp", image->hash);
+  }
+  std::ofstream out(output, std::ios::binary);
+  if (!out || !out.write(code.data(), code.size())) {
+    std::cout << "Failed to write: " << output << std::endl;
+    return EXIT_FAILURE;
+  }
+  fmt::print("{}: {} blocks, {} instructions translated, {} interpreted.\r\n", output,
+             stats.blocks, stats.native, stats.fallback);
+  fmt::print("Build it into {} for door86 --aot_dir.\r\n", aot_module_filename(image->hash));
+  return EXIT_SUCCESS;
+}
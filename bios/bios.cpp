@@ -1,31 +1,297 @@
 #include "bios/bios.h"
 
 #include "fmt/format.h"
+#include <algorithm>
 
 namespace door86::bios {
 
-Bios::Bios(door86::cpu::x86::CPU* cpu) : cpu_(cpu) {
+using door86::cpu::x86::CPU;
+
+// BIOS data area video fields (at 0040:xxxx)
+static constexpr uint32_t bda_video_mode = 0x449;
+static constexpr uint32_t bda_columns = 0x44A;
+static constexpr uint32_t bda_page_size = 0x44C;
+static constexpr uint32_t bda_page_offset = 0x44E;
+static constexpr uint32_t bda_cursor = 0x450;
+static constexpr uint32_t bda_cursor_shape = 0x460;
+static constexpr uint32_t bda_active_page = 0x462;
+static constexpr uint32_t bda_crtc_port = 0x463;
+static constexpr uint32_t bda_rows = 0x484;
+
+Bios::Bios(CPU* cpu)
+    : cpu_(cpu), screen(cpu->memory), keyboard(cpu), timer(cpu->memory, cpu->time), pit(cpu) {
   cpu_->int_handlers().try_emplace(
       0x10, std::bind(&Bios::int10, this, std::placeholders::_1, std::placeholders::_2));
+  cpu_->int_handlers().try_emplace(
+      0x1A, std::bind(&Bios::int1a, this, std::placeholders::_1, std::placeholders::_2));
+  // A program waiting for the next tick is parked until then.
+  timer.on_new_tick = [this](TickClock::clock::time_point next) { cpu_->idle.wake_at(next); };
+  // F000:0000 - system ROM.
+  cpu_->memory.map_rom(0xF0000, 0x10000);
+  // Hardware interrupts, with the vectors pointing at ROM stubs for the
+  // services above, which a program's hook can chain to.
+  cpu_->int_handlers().try_emplace(
+      0x08, std::bind(&Bios::int08, this, std::placeholders::_1, std::placeholders::_2));
+  for (int num = 0x09; num <= 0x0F; num++) {
+    cpu_->int_handlers().try_emplace(
+        num, std::bind(&Bios::irq, this, std::placeholders::_1, std::placeholders::_2));
+  }
+  // The user timer hook, which does nothing until the program sets it.
+  cpu_->int_handlers().try_emplace(0x1C, [](int, CPU&) {});
+  for (int num = 0x08; num <= 0x0F; num++) {
+    cpu_->set_rom_vector(num);
+    // Not something the program asked for.
+    cpu_->idle.add_poll(num);
+  }
+  cpu_->set_rom_vector(0x1C);
+  cpu_->idle.add_poll(0x1C);
+  pit.irq0 = [this] { cpu_->pic.raise(0); };
+  // Mode 3, as left by a boot without clearing the screen.
+  init_video(3, 25);
+  fill_cells(0, 0, TextScreen::cols * screen.rows(), ' ', 0x07);
+  // Don't hold back changes when the program waits for input or exits.
+  cpu_->add_slice_handler([this](CPU&, door86::cpu::x86::stop_reason_t reason) {
+    refresh(reason == door86::cpu::x86::stop_reason_t::waiting ||
+            reason == door86::cpu::x86::stop_reason_t::halted);
+  });
+}
+
+void Bios::int08(int, CPU& cpu) {
+  // The tick count is worked out when it's read (see TickClock), which leaves
+  // the program's INT 1Ch hook, if it has one.
+  cpu.pic.end_of_interrupt();
+  if (!cpu.rom_vector(0x1C)) {
+    cpu.chain_interrupt(0x1C);
+  }
+}
+
+void Bios::irq(int, CPU& cpu) { cpu.pic.end_of_interrupt(); }
+
+void Bios::refresh(bool now) {
+  auto& out = cpu_->output;
+  if (out.written() != written_) {
+    // Something else wrote to the terminal, so the cursor and colors could be anywhere.
+    screen.forget_terminal();
+  }
+  out.write(now ? screen.update() : screen.frame(TextScreen::clock::now()));
+  written_ = out.written();
+}
+
+uint32_t Bios::cell(int row, int col) const {
+  return TextScreen::video_memory + (row * TextScreen::cols + col) * 2;
+}
+
+std::pair<int, int> Bios::cursor() const {
+  return {cpu_->memory.abs8(bda_cursor + 1), cpu_->memory.abs8(bda_cursor)};
+}
+
+void Bios::set_cursor(int row, int col) {
+  cpu_->memory.abs8(bda_cursor, static_cast<uint8_t>(col));
+  cpu_->memory.abs8(bda_cursor + 1, static_cast<uint8_t>(row));
+}
+
+void Bios::fill_cells(int row, int col, int count, uint8_t ch, uint8_t attr) {
+  if (count <= 0) {
+    return;
+  }
+  auto* p = cpu_->memory.write_ptr(cell(row, col), count * 2);
+  for (int i = 0; i < count * 2; i += 2) {
+    p[i] = ch;
+    p[i + 1] = attr;
+  }
+}
+
+void Bios::scroll(bool up, int lines, uint8_t attr, int top, int left, int bottom, int right) {
+  constexpr auto cols = TextScreen::cols;
+  bottom = std::min(bottom, screen.rows() - 1);
+  right = std::min(right, cols - 1);
+  if (top > bottom || left > right) {
+    return;
+  }
+  const auto height = bottom - top + 1;
+  if (lines == 0 || lines > height) {
+    // Blanks the whole window.
+    lines = height;
+  }
+  auto& m = cpu_->memory;
+  const auto kept = height - lines;
+  if (left == 0 && right == cols - 1) {
+    // Whole rows are one run of memory.
+    if (up) {
+      m.move(cell(top, 0), cell(top + lines, 0), kept * cols * 2);
+      fill_cells(bottom - lines + 1, 0, lines * cols, ' ', attr);
+    } else {
+      m.move(cell(top + lines, 0), cell(top, 0), kept * cols * 2);
+      fill_cells(top, 0, lines * cols, ' ', attr);
+    }
+    return;
+  }
+  const auto width = right - left + 1;
+  for (int i = 0; i < kept; i++) {
+    const auto dst = up ? top + i : bottom - i;
+    const auto src = up ? dst + lines : dst - lines;
+    m.move(cell(dst, left), cell(src, left), width * 2);
+  }
+  for (int i = 0; i < lines; i++) {
+    fill_cells(up ? bottom - i : top + i, left, width, ' ', attr);
+  }
+}
+
+void Bios::teletype(uint8_t ch, std::optional<uint8_t> attr) {
+  auto [row, col] = cursor();
+  switch (ch) {
+  case 0x07: // Bell, nothing to show.
+    return;
+  case 0x08:
+    if (col > 0) {
+      --col;
+    }
+    break;
+  case '\r': col = 0; break;
+  case '\n': ++row; break;
+  default: {
+    auto& m = cpu_->memory;
+    m.abs8(cell(row, col), ch);
+    if (attr) {
+      m.abs8(cell(row, col) + 1, attr.value());
+    }
+    if (++col == TextScreen::cols) {
+      col = 0;
+      ++row;
+    }
+  } break;
+  }
+  if (row >= screen.rows()) {
+    // Scroll up a line, blanking the new line with the attribute under the cursor.
+    row = screen.rows() - 1;
+    const auto fill = cpu_->memory.abs8(cell(row, col) + 1);
+    scroll(true, 1, fill, 0, 0, row, TextScreen::cols - 1);
+  }
+  set_cursor(row, col);
+}
+
+void Bios::init_video(uint8_t mode, int rows) {
+  auto& m = cpu_->memory;
+  m.abs8(bda_video_mode, mode);
+  m.abs16(bda_columns, TextScreen::cols);
+  m.abs16(bda_page_size, static_cast<uint16_t>(rows == 50 ? 0x2000 : 0x1000));
+  m.abs16(bda_page_offset, 0);
+  m.abs8(bda_active_page, 0);
+  m.abs16(bda_crtc_port, 0x3D4);
+  m.abs8(bda_rows, static_cast<uint8_t>(rows - 1));
+  m.abs16(bda_cursor_shape, 0x0607);
+  set_cursor(0, 0);
+}
+
+void Bios::set_mode(uint8_t al) {
+  const auto mode = static_cast<uint8_t>(al & 0x7f);
+  if (mode != 2 && mode != 3) {
+    LOG(WARNING) << "Unsupported video mode: " << static_cast<int>(mode) << ", using 3";
+  }
+  init_video(mode == 2 ? 2 : 3, 25);
+  if (screen.rows() != 25) {
+    screen.set_rows(25);
+  }
+  if (!(al & 0x80)) {
+    fill_cells(0, 0, TextScreen::cols * 25, ' ', 0x07);
+    screen.invalidate();
+  }
+}
+
+void Bios::set_rows(int rows) {
+  const auto [row, col] = cursor();
+  init_video(cpu_->memory.abs8(bda_video_mode), rows);
+  screen.set_rows(rows);
+  fill_cells(0, 0, TextScreen::cols * rows, ' ', 0x07);
+  set_cursor(std::min(row, rows - 1), col);
 }
 
-void Bios::int10(int, door86::cpu::x86::CPU&) {
+void Bios::int10(int, CPU&) {
   auto& r = cpu_->core.regs;
+  auto& m = cpu_->memory;
   switch (r.h.ah) {
-  // INT 10, 13 - Write String(BIOS versions from 1 / 10 / 86)
-  case 0x13: {
-    if (r.h.al > 1) {
-      LOG(WARNING) << "Colors not yet supported";
+  // INT 10,0 - Set Video Mode
+  case 0x00: set_mode(r.h.al); break;
+  // INT 10,1 - Set Cursor Type
+  case 0x01: m.abs16(bda_cursor_shape, r.x.cx); break;
+  // INT 10,2 - Set Cursor Position (only page 0 is supported)
+  case 0x02:
+    set_cursor(std::min<int>(r.h.dh, screen.rows() - 1),
+               std::min<int>(r.h.dl, TextScreen::cols - 1));
+    break;
+  // INT 10,3 - Read Cursor Position and Size
+  case 0x03: {
+    const auto [row, col] = cursor();
+    r.h.dh = static_cast<uint8_t>(row);
+    r.h.dl = static_cast<uint8_t>(col);
+    r.x.cx = m.abs16(bda_cursor_shape);
+  } break;
+  // INT 10,5 - Select Active Display Page
+  case 0x05:
+    if (r.h.al != 0) {
+      LOG(WARNING) << "Only display page 0 is supported, not: " << static_cast<int>(r.h.al);
     }
-    for (int i = 0; i < r.x.cx; i++) {
-      fputc(cpu_->memory.get<uint8_t>(cpu_->core.sregs.es, r.x.bp + i), stdout);
+    break;
+  // INT 10,6 - Scroll Window Up
+  case 0x06: scroll(true, r.h.al, r.h.bh, r.h.ch, r.h.cl, r.h.dh, r.h.dl); break;
+  // INT 10,7 - Scroll Window Down
+  case 0x07: scroll(false, r.h.al, r.h.bh, r.h.ch, r.h.cl, r.h.dh, r.h.dl); break;
+  // INT 10,8 - Read Character and Attribute at Cursor Position
+  case 0x08: {
+    const auto [row, col] = cursor();
+    r.h.al = m.abs8(cell(row, col));
+    r.h.ah = m.abs8(cell(row, col) + 1);
+  } break;
+  // INT 10,9 - Write Character and Attribute at Cursor Position
+  case 0x09: {
+    const auto [row, col] = cursor();
+    const auto end = screen.rows() * TextScreen::cols;
+    const auto count = std::min<int>(r.x.cx, end - (row * TextScreen::cols + col));
+    fill_cells(row, col, count, r.h.al, r.h.bl);
+  } break;
+  // INT 10,A - Write Character Only at Current Cursor Position
+  case 0x0A: {
+    const auto [row, col] = cursor();
+    const auto end = screen.rows() * TextScreen::cols;
+    const auto count = std::min<int>(r.x.cx, end - (row * TextScreen::cols + col));
+    for (int i = 0; i < count; i++) {
+      m.abs8(cell(row, col + i), r.h.al);
     }
-    fflush(stdout);
   } break;
   // INT 10,E - Write Text in Teletype Mode
-  case 0x0E: {
-    fputc(r.h.al, stdout);
-    fflush(stdout);
+  case 0x0E: teletype(r.h.al, std::nullopt); break;
+  // INT 10,F - Get Video State
+  case 0x0F:
+    r.h.al = m.abs8(bda_video_mode);
+    r.h.ah = static_cast<uint8_t>(TextScreen::cols);
+    r.h.bh = m.abs8(bda_active_page);
+    break;
+  // INT 10,11 - Character Generator, only switching between 25 and 50 rows.
+  case 0x11:
+    switch (r.h.al) {
+    case 0x11:
+    case 0x14: set_rows(25); break;
+    case 0x12: set_rows(50); break;
+    default:
+      LOG(WARNING) << fmt::format("Unhandled BIOS Interrupt AH:{:02X}; AL:{:02X}", r.h.ah, r.h.al);
+      break;
+    }
+    break;
+  // INT 10, 13 - Write String(BIOS versions from 1 / 10 / 86)
+  case 0x13: {
+    const auto saved = cursor();
+    set_cursor(r.h.dh, r.h.dl);
+    const auto with_attrs = (r.h.al & 0x02) != 0;
+    for (int i = 0; i < r.x.cx; i++) {
+      const auto off = static_cast<uint16_t>(r.x.bp + (with_attrs ? i * 2 : i));
+      const auto ch = m.get<uint8_t>(cpu_->core.sregs.es, off);
+      const auto attr =
+          with_attrs ? m.get<uint8_t>(cpu_->core.sregs.es, static_cast<uint16_t>(off + 1)) : r.h.bl;
+      teletype(ch, attr);
+    }
+    if (!(r.h.al & 0x01)) {
+      set_cursor(saved.first, saved.second);
+    }
   } break;
   default:
     // unhandled
@@ -35,4 +301,23 @@ void Bios::int10(int, door86::cpu::x86::CPU&) {
   } // switch
 }
 
+void Bios::int1a(int, CPU&) {
+  auto& r = cpu_->core.regs;
+  switch (r.h.ah) {
+  // INT 1A,0 - Read system clock counter
+  case 0x00: {
+    const auto ticks = timer.ticks();
+    r.x.cx = static_cast<uint16_t>(ticks >> 16);
+    r.x.dx = static_cast<uint16_t>(ticks & 0xffff);
+    r.h.al = timer.midnight() ? 1 : 0;
+  } break;
+  // INT 1A,1 - Set system clock counter
+  case 0x01: timer.set_ticks((static_cast<uint32_t>(r.x.cx) << 16) | r.x.dx); break;
+  default:
+    LOG(WARNING) << fmt::format("Unhandled time of day function AH:{:02X}; AL:{:02X}", r.h.ah,
+                                r.h.al);
+    break;
+  }
+}
+
 } // namespace door86::bios
@@ -1,6 +1,10 @@
 #ifndef INCLUDED_BIOS_BIOS_H
 #define INCLUDED_BIOS_BIOS_H
 
+#include "bios/keyboard.h"
+#include "bios/pit.h"
+#include "bios/text_screen.h"
+#include "bios/tick_clock.h"
 #include "cpu/memory.h"
 #include "cpu/x86/cpu.h"
 #include "dos/psp.h"
@@ -10,6 +14,7 @@
 #include <memory>
 #include <optional>
 #include <string>
+#include <utility>
 #include <vector>
 
 namespace door86::bios {
@@ -20,12 +25,44 @@ public:
   Bios(door86::cpu::x86::CPU* cpu);
   ~Bios() = default;
 
+  // INT 08 - IRQ 0, the system timer
+  void int08(int, door86::cpu::x86::CPU&);
+  // INT 09-0F - IRQs 1-7, with nothing to do but send the EOI
+  void irq(int, door86::cpu::x86::CPU&);
   // INT 10 - Video BIOS Services
   void int10(int, door86::cpu::x86::CPU&);
+  // INT 1A - Time of day services
+  void int1a(int, door86::cpu::x86::CPU&);
+
+  // Sends changes to video memory to the caller, at most screen.frame_rate
+  // times a second unless now is true.
+  void refresh(bool now = false);
 
   door86::cpu::x86::CPU* cpu_;
+  TextScreen screen;
+  Keyboard keyboard;
+  TickClock timer;
+  Pit pit;
 
 private:
+  // cpu_->output.written() after the last refresh.
+  uint64_t written_{0};
+  // Video memory location of a cell.
+  uint32_t cell(int row, int col) const;
+  // Cursor row and column for page 0, from the BIOS data area.
+  std::pair<int, int> cursor() const;
+  void set_cursor(int row, int col);
+  // Sets count cells, starting at row, col and continuing onto the following rows.
+  void fill_cells(int row, int col, int count, uint8_t ch, uint8_t attr);
+  // Scrolls the window by lines (0 blanks it), filling the new lines with attr.
+  void scroll(bool up, int lines, uint8_t attr, int top, int left, int bottom, int right);
+  // Writes ch at the cursor like a terminal, with attr or the attribute already there.
+  void teletype(uint8_t ch, std::optional<uint8_t> attr);
+  // Sets the BIOS data area for a text mode, with the cursor at the top left.
+  void init_video(uint8_t mode, int rows);
+  void set_mode(uint8_t al);
+  void set_rows(int rows);
+
   void display_char();
   void display_string();
   void get_char();
@@ -0,0 +1,199 @@
+#include <gtest/gtest.h>
+
+#include "bios/bios.h"
+#include "cpu/x86/cpu.h"
+#include "cpu/x86/cpu_fixture.h"
+#include <string>
+
+using namespace door86::bios;
+using namespace door86::cpu::x86;
+
+class BiosTest : public ::testing::Test {
+protected:
+  void int10(uint16_t ax, uint16_t bx = 0, uint16_t cx = 0, uint16_t dx = 0) {
+    auto& r = cpu.core.regs.x;
+    r.ax = ax;
+    r.bx = bx;
+    r.cx = cx;
+    r.dx = dx;
+    bios.int10(0x10, cpu);
+  }
+  uint8_t ch(int row, int col) {
+    return cpu.memory.abs8(TextScreen::video_memory + (row * 80 + col) * 2);
+  }
+  uint8_t attr(int row, int col) {
+    return cpu.memory.abs8(TextScreen::video_memory + (row * 80 + col) * 2 + 1);
+  }
+  std::string row_text(int row, int cols) {
+    std::string s;
+    for (int col = 0; col < cols; col++) {
+      s.push_back(static_cast<char>(ch(row, col)));
+    }
+    return s;
+  }
+  void print(const std::string& s) {
+    for (const auto c : s) {
+      int10(0x0e00 | static_cast<uint8_t>(c));
+    }
+  }
+  std::pair<int, int> cursor() {
+    int10(0x0300);
+    return {cpu.core.regs.h.dh, cpu.core.regs.h.dl};
+  }
+
+  CPU cpu;
+  Bios bios{&cpu};
+};
+
+TEST_F(BiosTest, Initial) {
+  EXPECT_EQ(' ', ch(0, 0));
+  EXPECT_EQ(0x07, attr(24, 79));
+  int10(0x0f00);
+  EXPECT_EQ(3, cpu.core.regs.h.al);
+  EXPECT_EQ(80, cpu.core.regs.h.ah);
+}
+
+TEST_F(BiosTest, Cursor) {
+  int10(0x0200, 0, 0, 0x0a05);
+  EXPECT_EQ(std::make_pair(10, 5), cursor());
+  // Off the screen is clamped.
+  int10(0x0200, 0, 0, 0x6464);
+  EXPECT_EQ(std::make_pair(24, 79), cursor());
+}
+
+TEST_F(BiosTest, Teletype) {
+  print("Hello\r\nWorld");
+  EXPECT_EQ("Hello", row_text(0, 5));
+  EXPECT_EQ("World", row_text(1, 5));
+  EXPECT_EQ(std::make_pair(1, 5), cursor());
+  print("\b\bx");
+  EXPECT_EQ("Worxd", row_text(1, 5));
+}
+
+TEST_F(BiosTest, TeletypeScrolls) {
+  int10(0x0200, 0, 0, 0x1800);
+  print("bottom\r\n");
+  EXPECT_EQ("bottom", row_text(23, 6));
+  EXPECT_EQ("      ", row_text(24, 6));
+  EXPECT_EQ(std::make_pair(24, 0), cursor());
+}
+
+TEST_F(BiosTest, WriteCharAndAttribute) {
+  int10(0x0200, 0, 0, 0x0002);
+  int10(0x0941, 0x001e, 3);
+  EXPECT_EQ("  AAA ", row_text(0, 6));
+  EXPECT_EQ(0x1e, attr(0, 4));
+  EXPECT_EQ(0x07, attr(0, 5));
+  // The cursor doesn't move.
+  EXPECT_EQ(std::make_pair(0, 2), cursor());
+
+  int10(0x0a42, 0, 2);
+  EXPECT_EQ("  BBA ", row_text(0, 6));
+  EXPECT_EQ(0x1e, attr(0, 2));
+
+  int10(0x0800);
+  EXPECT_EQ(0x1e42, cpu.core.regs.x.ax);
+}
+
+TEST_F(BiosTest, ScrollWindow) {
+  for (int row = 0; row < 4; row++) {
+    int10(0x0200, 0, 0, static_cast<uint16_t>(row << 8));
+    int10(0x0930 | row, 0x0007, 10);
+  }
+  // Rows 0-3, columns 2-5 up one line.
+  int10(0x0601, 0x1700, 0x0002, 0x0305);
+  EXPECT_EQ("00111100", row_text(0, 8));
+  EXPECT_EQ("11222211", row_text(1, 8));
+  EXPECT_EQ("33    33", row_text(3, 8));
+  EXPECT_EQ(0x17, attr(3, 2));
+  EXPECT_EQ(0x07, attr(3, 6));
+
+  // Whole rows down two lines.
+  int10(0x0702, 0x0700, 0x0000, 0x034f);
+  EXPECT_EQ("        ", row_text(0, 8));
+  EXPECT_EQ("00111100", row_text(2, 8));
+  EXPECT_EQ("11222211", row_text(3, 8));
+
+  // AL=0 clears the window.
+  int10(0x0600, 0x0700, 0x0000, 0x184f);
+  EXPECT_EQ("        ", row_text(3, 8));
+}
+
+TEST_F(BiosTest, WriteString) {
+  const std::string s = "Hi";
+  cpu.memory.load_string(0x2000, s);
+  cpu.core.sregs.es = 0x200;
+  cpu.core.regs.x.bp = 0;
+  // AL=1 moves the cursor.
+  int10(0x1301, 0x004f, 2, 0x0503);
+  EXPECT_EQ('H', ch(5, 3));
+  EXPECT_EQ(0x4f, attr(5, 4));
+  EXPECT_EQ(std::make_pair(5, 5), cursor());
+}
+
+TEST_F(BiosTest, SetMode) {
+  print("x");
+  int10(0x1112);
+  EXPECT_EQ(50, bios.screen.rows());
+  int10(0x0003);
+  EXPECT_EQ(25, bios.screen.rows());
+  EXPECT_EQ(' ', ch(0, 0));
+  EXPECT_EQ(std::make_pair(0, 0), cursor());
+}
+
+TEST_F(BiosTest, OutputIsBatched) {
+  bios.screen.update();
+  print("abc");
+  // All three in one update, leaving the cursor after them.
+  EXPECT_EQ("\x1b[1H\x1b[0;37;40mabc", bios.screen.update());
+}
+
+TEST_F(BiosTest, TimerCallsUserHook) {
+  cpu.time.set_virtual();
+  cpu.idle.enabled = true;
+  // INT 20h halts the CPU.
+  cpu.memory[0x20 * 4] = 0x20;
+  cpu.int_handlers().try_emplace(0x20, [](int, CPU& c) { c.halt(); });
+  // INT 1Ch hook at 0200:0000: INC BYTE [0500]; IRET
+  const auto hook = door86::cpu::x86::parse_opcodes_from_line("FE060005 CF");
+  ASSERT_TRUE(cpu.memory.load_image(0x2000, hook.size(), hook.data()));
+  cpu.memory.set<uint16_t>(0, 0x1C * 4, 0x0000);
+  cpu.memory.set<uint16_t>(0, 0x1C * 4 + 2, 0x0200);
+  // STI; L: CMP BYTE [0500], 3; JB L; INT 20
+  const auto ops = door86::cpu::x86::parse_opcodes_from_line("FB 803E000503 72F9 CD20");
+  ASSERT_TRUE(cpu.memory.load_image(0x1000, ops.size(), ops.data()));
+  cpu.core.sregs.ds = 0;
+  cpu.core.sregs.ss = 0x300;
+  cpu.core.regs.x.sp = 0x100;
+  ASSERT_TRUE(cpu.run(0x100, 0));
+  // Three ticks, each of which sent its EOI.
+  EXPECT_EQ(0, cpu.pic.isr());
+  EXPECT_GE(cpu.cycles, 3 * 0x10000 * Pit::cycles_per_tick);
+  EXPECT_LT(cpu.cycles, 4 * 0x10000 * Pit::cycles_per_tick);
+}
+
+TEST_F(BiosTest, TimerHookChainsToRom) {
+  cpu.time.set_virtual();
+  cpu.idle.enabled = true;
+  // INT 20h halts the CPU.
+  cpu.memory[0x20 * 4] = 0x20;
+  cpu.int_handlers().try_emplace(0x20, [](int, CPU& c) { c.halt(); });
+  // The old vector is a stub in the system ROM.
+  ASSERT_EQ(0x1020, cpu.memory.get<uint16_t>(0, 0x08 * 4));
+  ASSERT_EQ(0xF000, cpu.memory.get<uint16_t>(0, 0x08 * 4 + 2));
+  // INT 08h hook at 0200:0000: INC BYTE [0500]; JMP FAR CS:[0009]; the old vector
+  const auto hook = door86::cpu::x86::parse_opcodes_from_line("FE060005 2EFF2E0900 201000F0");
+  ASSERT_TRUE(cpu.memory.load_image(0x2000, hook.size(), hook.data()));
+  cpu.memory.set<uint16_t>(0, 0x08 * 4, 0x0000);
+  cpu.memory.set<uint16_t>(0, 0x08 * 4 + 2, 0x0200);
+  // STI; L: CMP BYTE [0500], 3; JB L; INT 20
+  const auto ops = door86::cpu::x86::parse_opcodes_from_line("FB 803E000503 72F9 CD20");
+  ASSERT_TRUE(cpu.memory.load_image(0x1000, ops.size(), ops.data()));
+  cpu.core.sregs.ds = 0;
+  cpu.core.sregs.ss = 0x300;
+  cpu.core.regs.x.sp = 0x100;
+  ASSERT_TRUE(cpu.run(0x100, 0));
+  // The ROM's handler sent the EOI for each of the three ticks.
+  EXPECT_EQ(0, cpu.pic.isr());
+  EXPECT_LT(cpu.cycles, 4 * 0x10000 * Pit::cycles_per_tick);
+}
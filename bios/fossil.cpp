@@ -0,0 +1,220 @@
+#include "bios/fossil.h"
+
+#include "core/log.h"
+#include "fmt/format.h"
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+namespace door86::bios {
+
+using door86::cpu::x86::CPU;
+
+// Driver identification string returned by function 1Bh, kept in the system ROM.
+static constexpr uint16_t id_seg = 0xF000;
+static constexpr uint16_t id_off = 0x0100;
+static const std::string id_string = "door86 FOSSIL";
+
+// Status bits, AH
+static constexpr uint16_t status_rda = 0x0100;
+static constexpr uint16_t status_thre = 0x2000;
+static constexpr uint16_t status_tsre = 0x4000;
+// AL
+static constexpr uint16_t status_always = 0x0008;
+static constexpr uint16_t status_dcd = 0x0080;
+
+Fossil::Fossil(CPU* cpu, size_t buffer_size)
+    : cpu_(cpu), link_(buffer_size) {
+  cpu_->int_handlers().try_emplace(
+      0x14, std::bind(&Fossil::int14, this, std::placeholders::_1, std::placeholders::_2));
+  cpu_->memory.load_string((id_seg * 0x10) + id_off, id_string + '\0');
+  on_input = [this] { cpu_->idle.wake(); };
+  link_.on_input = [this] { on_input(); };
+  // Status, peeking and reading a block with nothing there only check for input.
+  cpu_->idle.add_poll(0x14, 0x03);
+  cpu_->idle.add_poll(0x14, 0x0C);
+  cpu_->idle.add_poll(0x14, 0x18);
+}
+
+uint16_t Fossil::status() const {
+  uint16_t s = status_always;
+  if (link_.carrier()) {
+    s |= status_dcd;
+  }
+  if (!link_.rx().empty()) {
+    s |= status_rda;
+  }
+  if (link_.tx().free() > 0) {
+    s |= status_thre;
+  }
+  if (link_.tx().empty()) {
+    s |= status_tsre;
+  }
+  return s;
+}
+
+void Fossil::driver_info() {
+  auto& r = cpu_->core.regs;
+  auto& m = cpu_->memory;
+  const auto es = cpu_->core.sregs.es;
+  const auto clamp = [](size_t n) { return static_cast<uint16_t>(std::min<size_t>(n, 0xffff)); };
+  uint8_t info[19]{};
+  const auto put16 = [&info](int i, uint16_t v) {
+    info[i] = static_cast<uint8_t>(v & 0xff);
+    info[i + 1] = static_cast<uint8_t>(v >> 8);
+  };
+  put16(0, sizeof(info));
+  info[2] = 5;  // FOSSIL spec revision
+  info[3] = 1;  // driver revision
+  put16(4, id_off);
+  put16(6, id_seg);
+  put16(8, clamp(link_.rx().capacity()));
+  put16(10, clamp(link_.rx().free()));
+  put16(12, clamp(link_.tx().capacity()));
+  put16(14, clamp(link_.tx().free()));
+  info[16] = 80;
+  info[17] = 25;
+  info[18] = 0x23; // 38400 baud, 8N1
+  const auto n = std::min<uint16_t>(r.x.cx, sizeof(info));
+  for (int i = 0; i < n; i++) {
+    m.set<uint8_t>(es, static_cast<uint16_t>(r.x.di + i), info[i]);
+  }
+  r.x.ax = n;
+}
+
+void Fossil::int14(int, CPU&) {
+  auto& r = cpu_->core.regs;
+  auto& m = cpu_->memory;
+  switch (r.h.ah) {
+  // INT 14,0 - Set baud rate (there isn't one)
+  case 0x00: r.x.ax = status(); break;
+  // INT 14,1 - Transmit character with wait
+  case 0x01:
+    if (link_.tx().free() == 0 && link_.carrier()) {
+      cpu_->wait_for_input();
+      return;
+    }
+    link_.tx().write(&r.h.al, 1);
+    sent(1);
+    r.x.ax = status();
+    break;
+  // INT 14,2 - Receive character with wait
+  case 0x02:
+    if (link_.rx().empty()) {
+      if (link_.carrier()) {
+        cpu_->wait_for_input();
+      } else {
+        r.x.ax = 0xffff;
+      }
+      return;
+    }
+    link_.rx().read(&r.h.al, 1);
+    r.h.ah = 0;
+    break;
+  // INT 14,3 - Request status
+  case 0x03: r.x.ax = status(); break;
+  // INT 14,4 - Initialize driver
+  case 0x04:
+    r.x.ax = signature;
+    r.h.bl = max_function;
+    r.h.bh = 5;
+    break;
+  // INT 14,5 - Deinitialize driver
+  case 0x05: break;
+  // INT 14,6 - Raise/lower DTR
+  case 0x06: break;
+  // INT 14,8 - Flush output buffer, waits for it to be sent
+  case 0x08:
+    if (!link_.tx().empty() && link_.carrier()) {
+      cpu_->wait_for_input();
+    }
+    break;
+  // INT 14,9 - Purge output buffer
+  case 0x09:
+    link_.purge_tx();
+    break;
+  // INT 14,A - Purge input buffer
+  case 0x0A: link_.rx().clear(); break;
+  // INT 14,B - Transmit no wait
+  case 0x0B:
+    r.x.ax = link_.tx().write(&r.h.al, 1) ? 1 : 0;
+    sent(r.x.ax);
+    break;
+  // INT 14,C - Non-destructive read-ahead
+  case 0x0C: {
+    const auto ch = link_.rx().peek();
+    r.x.ax = ch < 0 ? 0xffff : static_cast<uint16_t>(ch);
+  } break;
+  // INT 14,F - Flow control, INT 14,10 - Ctrl-C/K checks
+  case 0x0F: break;
+  case 0x10: r.x.ax = 0; break;
+  // INT 14,18 - Read block (transfer from FOSSIL to user buffer)
+  case 0x18: {
+    const auto es = cpu_->core.sregs.es;
+    uint16_t done = 0;
+    while (done < r.x.cx) {
+      const auto [p, n] = link_.rx().readable();
+      if (n == 0) {
+        break;
+      }
+      const auto off = static_cast<uint16_t>(r.x.di + done);
+      const auto start = (es * 0x10) + off;
+      auto len = std::min<uint32_t>({static_cast<uint32_t>(n), static_cast<uint32_t>(r.x.cx - done),
+                                     0x10000u - off});
+      len = m.direct_size(start, len);
+      if (len == 0) {
+        // Not plain RAM, a byte at a time.
+        m.set<uint8_t>(es, off, *p);
+        len = 1;
+      } else {
+        memcpy(m.write_ptr(start, len), p, len);
+      }
+      link_.rx().consume(len);
+      done = static_cast<uint16_t>(done + len);
+    }
+    r.x.ax = done;
+  } break;
+  // INT 14,19 - Write block (transfer from user buffer to FOSSIL)
+  case 0x19: {
+    const auto es = cpu_->core.sregs.es;
+    uint16_t done = 0;
+    while (done < r.x.cx) {
+      const auto [p, n] = link_.tx().writable();
+      if (n == 0) {
+        break;
+      }
+      const auto off = static_cast<uint16_t>(r.x.di + done);
+      const auto start = (es * 0x10) + off;
+      auto len = std::min<uint32_t>({static_cast<uint32_t>(n), static_cast<uint32_t>(r.x.cx - done),
+                                     0x10000u - off});
+      len = m.direct_size(start, len);
+      if (len == 0) {
+        *p = m.get<uint8_t>(es, off);
+        len = 1;
+      } else {
+        memcpy(p, m.read_ptr(start), len);
+      }
+      link_.tx().commit(len);
+      done = static_cast<uint16_t>(done + len);
+    }
+    sent(done);
+    r.x.ax = done;
+  } break;
+  // INT 14,1B - Return information about the driver
+  case 0x1B: driver_info(); break;
+  default:
+    LOG(WARNING) << fmt::format("Unhandled FOSSIL function AH:{:02X}; AL:{:02X}", r.h.ah, r.h.al);
+    break;
+  }
+}
+
+void Fossil::sent(size_t n) {
+  // Anything more than what was just added means the IO thread hasn't caught up
+  // yet, and will see the new bytes when it does. Otherwise it may be waiting
+  // for the ring to be written.
+  if (n > 0 && link_.tx().size() <= n) {
+    link_.kick();
+  }
+}
+
+} // namespace door86::bios
@@ -0,0 +1,76 @@
+#ifndef INCLUDED_BIOS_FOSSIL_H
+#define INCLUDED_BIOS_FOSSIL_H
+
+#include "bios/serial_link.h"
+#include "cpu/x86/cpu.h"
+
+#include <cstdint>
+#include <functional>
+
+namespace door86::bios {
+
+/**
+ * FOSSIL (revision 5) serial driver on INT 14h, which is how doors talk to
+ * the caller.
+ *
+ * Received and transmitted bytes go through the rings of a SerialLink, whose
+ * IO thread moves them to and from the connection. Block reads and writes
+ * (18h/19h) copy straight between the rings and guest memory.
+ *
+ * Services that have to wait (receive with wait, transmit with wait when
+ * the transmit ring is full) call CPU::wait_for_input and run again once the
+ * IO thread calls on_input. Status and peek are polls, so a program spinning
+ * on them is parked by the idle detector rather than spinning the host.
+ */
+class Fossil {
+public:
+  static constexpr uint16_t signature = 0x1954;
+  static constexpr uint8_t max_function = 0x1B;
+
+  explicit Fossil(door86::cpu::x86::CPU* cpu, size_t buffer_size = 0x2000);
+  ~Fossil() = default;
+  Fossil(const Fossil&) = delete;
+  Fossil& operator=(const Fossil&) = delete;
+
+  // INT 14 - FOSSIL services
+  void int14(int, door86::cpu::x86::CPU&);
+
+  /**
+   * Starts the IO thread moving received bytes from in_fd and transmitted bytes
+   * to out_fd, which may be the same descriptor (i.e. a socket).
+   * Returns false if that isn't supported on this platform.
+   */
+  bool attach(int in_fd, int out_fd) {
+    // Input typed live, see IdleDetector::live_input.
+    cpu_->idle.live_input = link_.attach(in_fd, out_fd);
+    return cpu_->idle.live_input;
+  }
+  /** Stops the IO thread. */
+  void detach() { link_.detach(); }
+
+  // Called on the IO thread when bytes arrive, transmit space frees up or
+  // carrier is lost. Wakes the CPU's idle detector by default, sessions run
+  // by a scheduler should wake the session.
+  std::function<void()> on_input;
+
+  // true while attached to a connection that hasn't closed.
+  bool carrier() const noexcept { return link_.carrier(); }
+
+  SpscRing& rx() noexcept { return link_.rx(); }
+  SpscRing& tx() noexcept { return link_.tx(); }
+
+private:
+  // FOSSIL status in AX, see function 03h.
+  uint16_t status() const;
+  // Copies the driver information (function 1Bh) to ES:DI.
+  void driver_info();
+  // Called after n bytes were added to the transmit ring.
+  void sent(size_t n);
+
+  door86::cpu::x86::CPU* cpu_;
+  SerialLink link_;
+};
+
+} // namespace door86::bios
+
+#endif // INCLUDED_BIOS_FOSSIL_H
@@ -0,0 +1,159 @@
+#include <gtest/gtest.h>
+
+#include "bios/fossil.h"
+#include "cpu/x86/cpu.h"
+#include <chrono>
+#include <string>
+#include <thread>
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+using namespace door86::bios;
+using namespace door86::cpu::x86;
+
+TEST(SpscRingTest, WrapsAround) {
+  SpscRing ring(6);
+  EXPECT_EQ(8u, ring.capacity());
+  const std::string abc = "abcdef";
+  EXPECT_EQ(6u, ring.write(reinterpret_cast<const uint8_t*>(abc.data()), abc.size()));
+  uint8_t buf[8]{};
+  EXPECT_EQ(4u, ring.read(buf, 4));
+  EXPECT_EQ(6u, ring.write(reinterpret_cast<const uint8_t*>(abc.data()), abc.size()));
+  EXPECT_EQ(0u, ring.free());
+  EXPECT_EQ('e', ring.peek());
+  EXPECT_EQ(8u, ring.read(buf, sizeof(buf)));
+  EXPECT_EQ("efabcdef", std::string(reinterpret_cast<char*>(buf), 8));
+  EXPECT_TRUE(ring.empty());
+  EXPECT_EQ(-1, ring.peek());
+}
+
+#ifndef _WIN32
+
+class FossilTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+    ASSERT_TRUE(fossil.attach(fds[0], fds[0]));
+    cpu.core.sregs.es = 0x200;
+  }
+  void TearDown() override {
+    fossil.detach();
+    close(fds[0]);
+    if (fds[1] >= 0) {
+      close(fds[1]);
+    }
+  }
+
+  void int14(uint16_t ax, uint16_t cx = 0, uint16_t di = 0) {
+    auto& r = cpu.core.regs.x;
+    r.ax = ax;
+    r.cx = cx;
+    r.di = di;
+    fossil.int14(0x14, cpu);
+  }
+
+  // Waits for the IO thread to receive n bytes.
+  bool wait_for_rx(size_t n) {
+    for (int i = 0; i < 500 && fossil.rx().size() < n; i++) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+    return fossil.rx().size() >= n;
+  }
+
+  std::string remote_read(size_t n) {
+    std::string s;
+    char buf[256];
+    while (s.size() < n) {
+      const auto got = read(fds[1], buf, std::min(sizeof(buf), n - s.size()));
+      if (got <= 0) {
+        break;
+      }
+      s.append(buf, got);
+    }
+    return s;
+  }
+
+  void remote_write(const std::string& s) {
+    ASSERT_EQ(static_cast<ssize_t>(s.size()), write(fds[1], s.data(), s.size()));
+  }
+
+  CPU cpu;
+  Fossil fossil{&cpu};
+  int fds[2]{-1, -1};
+};
+
+TEST_F(FossilTest, Init) {
+  int14(0x0400);
+  EXPECT_EQ(Fossil::signature, cpu.core.regs.x.ax);
+  EXPECT_EQ(Fossil::max_function, cpu.core.regs.h.bl);
+}
+
+TEST_F(FossilTest, Transmit) {
+  int14(0x0141);
+  int14(0x0B42);
+  EXPECT_EQ(1, cpu.core.regs.x.ax);
+  EXPECT_EQ("AB", remote_read(2));
+}
+
+TEST_F(FossilTest, WriteBlock) {
+  cpu.memory.load_string(0x2010, "Hello, World");
+  int14(0x1900, 12, 0x10);
+  EXPECT_EQ(12, cpu.core.regs.x.ax);
+  EXPECT_EQ("Hello, World", remote_read(12));
+}
+
+TEST_F(FossilTest, ReadBlock) {
+  remote_write("Hello");
+  ASSERT_TRUE(wait_for_rx(5));
+  int14(0x0300);
+  EXPECT_TRUE(cpu.core.regs.x.ax & 0x0100);
+  EXPECT_TRUE(cpu.core.regs.x.ax & 0x0080);
+  int14(0x0C00);
+  EXPECT_EQ('H', cpu.core.regs.x.ax);
+  int14(0x1800, 3, 0x20);
+  EXPECT_EQ(3, cpu.core.regs.x.ax);
+  EXPECT_EQ('H', cpu.memory.abs8(0x2020));
+  EXPECT_EQ('l', cpu.memory.abs8(0x2022));
+  int14(0x0200);
+  EXPECT_EQ('l', cpu.core.regs.x.ax);
+  int14(0x0A00);
+  int14(0x0C00);
+  EXPECT_EQ(0xffff, cpu.core.regs.x.ax);
+}
+
+TEST_F(FossilTest, ReceiveWaits) {
+  // MOV AH, 2; INT 14; INT 20
+  cpu.memory.load_string(0x1000, "\xB4\x02\xCD\x14\xCD\x20");
+  cpu.memory[0x14 * 4] = 0x14;
+  cpu.memory[0x20 * 4] = 0x20;
+  cpu.int_handlers().try_emplace(0x20, [](int, CPU& c) { c.halt(); });
+  cpu.core.sregs.cs = 0x100;
+  cpu.core.sregs.ss = 0x300;
+  cpu.core.regs.x.sp = 0x100;
+  cpu.core.ip = 0;
+  EXPECT_EQ(stop_reason_t::waiting, cpu.run_for({}));
+  EXPECT_EQ(2, cpu.core.ip);
+  remote_write("x");
+  ASSERT_TRUE(wait_for_rx(1));
+  EXPECT_EQ(stop_reason_t::halted, cpu.run_for({}));
+  EXPECT_EQ('x', cpu.core.regs.x.ax);
+}
+
+TEST_F(FossilTest, CarrierLost) {
+  close(fds[1]);
+  fds[1] = -1;
+  for (int i = 0; i < 500 && fossil.carrier(); i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  }
+  EXPECT_FALSE(fossil.carrier());
+  int14(0x0300);
+  EXPECT_FALSE(cpu.core.regs.x.ax & 0x0080);
+  // Doesn't wait for input that will never come.
+  int14(0x0200);
+  EXPECT_EQ(0xffff, cpu.core.regs.x.ax);
+}
+
+#endif
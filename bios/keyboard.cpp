@@ -0,0 +1,412 @@
+#include "bios/keyboard.h"
+
+#include "core/log.h"
+#include "fmt/format.h"
+#include <array>
+#include <cerrno>
+#include <cstring>
+
+#ifdef _WIN32
+#include <chrono>
+#include <io.h>
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+namespace door86::bios {
+
+using door86::cpu::x86::CPU;
+
+// BIOS data area keyboard fields (at 0040:xxxx)
+static constexpr uint32_t bda_shift_flags = 0x417;
+static constexpr uint32_t bda_shift_flags2 = 0x418;
+static constexpr uint32_t bda_head = 0x41A;
+static constexpr uint32_t bda_tail = 0x41C;
+static constexpr uint32_t bda_buffer_start = 0x480;
+static constexpr uint32_t bda_buffer_end = 0x482;
+
+// Only take more from the IO thread once fewer typed bytes than this are waiting,
+// so a large paste waits in the ring (and the connection) rather than here.
+static constexpr size_t typed_low_water = 0x100;
+
+// Scan codes for the printable ASCII characters and control characters on a US keyboard.
+static const std::array<uint8_t, 0x80> scan_codes = [] {
+  std::array<uint8_t, 0x80> s{};
+  const auto row = [&s](const char* keys, uint8_t first) {
+    for (auto* p = keys; *p; p++) {
+      s[static_cast<uint8_t>(*p)] = static_cast<uint8_t>(first + (p - keys));
+    }
+  };
+  row("1234567890-=", 0x02);
+  row("!@#$%^&*()_+", 0x02);
+  row("qwertyuiop[]", 0x10);
+  row("QWERTYUIOP{}", 0x10);
+  row("asdfghjkl;'`", 0x1E);
+  row("ASDFGHJKL:\"~", 0x1E);
+  row("\\zxcvbnm,./", 0x2B);
+  row("|ZXCVBNM<>?", 0x2B);
+  s[' '] = 0x39;
+  // Ctrl+letter
+  for (int c = 1; c <= 26; c++) {
+    s[c] = s['a' + c - 1];
+  }
+  s[0x08] = 0x0E;
+  s[0x09] = 0x0F;
+  s[0x0D] = 0x1C;
+  s[0x1B] = 0x01;
+  return s;
+}();
+
+// What terminals send for the keys that don't have a character.
+struct key_sequence_t {
+  std::string_view seq;
+  uint16_t key;
+};
+static constexpr key_sequence_t key_sequences[] = {
+    {"\x1b[A", 0x4800},   {"\x1b[B", 0x5000},   {"\x1b[C", 0x4D00},   {"\x1b[D", 0x4B00},
+    {"\x1bOA", 0x4800},   {"\x1bOB", 0x5000},   {"\x1bOC", 0x4D00},   {"\x1bOD", 0x4B00},
+    {"\x1b[H", 0x4700},   {"\x1b[F", 0x4F00},   {"\x1bOH", 0x4700},   {"\x1bOF", 0x4F00},
+    {"\x1b[1~", 0x4700},  {"\x1b[2~", 0x5200},  {"\x1b[3~", 0x5300},  {"\x1b[4~", 0x4F00},
+    {"\x1b[5~", 0x4900},  {"\x1b[6~", 0x5100},  {"\x1bOP", 0x3B00},   {"\x1bOQ", 0x3C00},
+    {"\x1bOR", 0x3D00},   {"\x1bOS", 0x3E00},   {"\x1b[11~", 0x3B00}, {"\x1b[12~", 0x3C00},
+    {"\x1b[13~", 0x3D00}, {"\x1b[14~", 0x3E00}, {"\x1b[15~", 0x3F00}, {"\x1b[17~", 0x4000},
+    {"\x1b[18~", 0x4100}, {"\x1b[19~", 0x4200}, {"\x1b[20~", 0x4300}, {"\x1b[21~", 0x4400},
+};
+
+Keyboard::Keyboard(CPU* cpu, size_t buffer_size) : cpu_(cpu), rx_(buffer_size) {
+  cpu_->int_handlers().try_emplace(
+      0x16, std::bind(&Keyboard::int16, this, std::placeholders::_1, std::placeholders::_2));
+  auto& m = cpu_->memory;
+  m.abs16(bda_head, buffer_start);
+  m.abs16(bda_tail, buffer_start);
+  m.abs16(bda_buffer_start, buffer_start);
+  m.abs16(bda_buffer_end, buffer_end);
+  m.abs8(bda_shift_flags, 0);
+  m.abs8(bda_shift_flags2, 0);
+  on_input = [this] { cpu_->idle.wake(); };
+  cpu_->add_slice_handler([this](CPU&, door86::cpu::x86::stop_reason_t reason) {
+    if (reason == door86::cpu::x86::stop_reason_t::waiting && reading_ &&
+        typed_pos_ == typed_.size() && !script_.empty()) {
+      // The program can't get any further without the next keys.
+      typed_.append(script_.front().second);
+      script_.pop_front();
+      cpu_->idle.wake();
+    }
+    // Programs that read the type-ahead buffer themselves see typed keys too.
+    fill();
+  });
+}
+
+Keyboard::~Keyboard() { detach(); }
+
+std::pair<uint16_t, size_t> Keyboard::translate(std::string_view s) {
+  if (s.empty()) {
+    return {0, 0};
+  }
+  const auto ch = static_cast<uint8_t>(s.front());
+  if (ch == 0x1B) {
+    bool partial = false;
+    for (const auto& k : key_sequences) {
+      if (s.substr(0, k.seq.size()) == k.seq) {
+        return {k.key, k.seq.size()};
+      }
+      if (s.size() < k.seq.size() && k.seq.substr(0, s.size()) == s) {
+        partial = true;
+      }
+    }
+    if (partial) {
+      return {0, 0};
+    }
+  }
+  switch (ch) {
+  // Enter from a terminal that sends LF.
+  case '\n': return {0x1C0D, 1};
+  // Backspace from a terminal that sends DEL.
+  case 0x7F: return {0x0E08, 1};
+  }
+  const uint8_t scan = ch < scan_codes.size() ? scan_codes[ch] : 0;
+  return {static_cast<uint16_t>((scan << 8) | ch), 1};
+}
+
+bool Keyboard::push(uint16_t key) {
+  auto& m = cpu_->memory;
+  const auto tail = m.abs16(bda_tail);
+  auto next = static_cast<uint16_t>(tail + 2);
+  if (next >= m.abs16(bda_buffer_end)) {
+    next = m.abs16(bda_buffer_start);
+  }
+  if (next == m.abs16(bda_head)) {
+    // Full, the real BIOS would beep.
+    return false;
+  }
+  m.abs16(0x400 + tail, key);
+  m.abs16(bda_tail, next);
+  return true;
+}
+
+std::optional<uint16_t> Keyboard::peek() const {
+  const auto& m = cpu_->memory;
+  const auto head = m.abs16(bda_head);
+  if (head == m.abs16(bda_tail)) {
+    return std::nullopt;
+  }
+  return m.abs16(0x400 + head);
+}
+
+std::optional<uint16_t> Keyboard::pop() {
+  const auto key = peek();
+  if (key) {
+    auto& m = cpu_->memory;
+    auto next = static_cast<uint16_t>(m.abs16(bda_head) + 2);
+    if (next >= m.abs16(bda_buffer_end)) {
+      next = m.abs16(bda_buffer_start);
+    }
+    m.abs16(bda_head, next);
+  }
+  return key;
+}
+
+void Keyboard::type(std::string_view s) { typed_.append(s); }
+
+void Keyboard::type_at(uint64_t instructions, std::string s) {
+  script_.emplace_back(instructions, std::move(s));
+}
+
+void Keyboard::fill() {
+  bool arrived = false;
+  while (!script_.empty() && script_.front().first <= cpu_->instructions) {
+    typed_.append(script_.front().second);
+    script_.pop_front();
+    arrived = true;
+  }
+  while (typed_.size() - typed_pos_ < typed_low_water) {
+    const auto [p, n] = rx_.readable();
+    if (n == 0) {
+      break;
+    }
+    const std::string_view bytes(reinterpret_cast<const char*>(p), n);
+    if (on_typed) {
+      on_typed(cpu_->instructions, bytes);
+    }
+    typed_.append(bytes);
+    rx_.consume(n);
+    arrived = true;
+  }
+  bool partial = false;
+  const std::string_view typed(typed_);
+  while (typed_pos_ < typed.size()) {
+    auto [key, len] = translate(typed.substr(typed_pos_));
+    if (len == 0) {
+      if (partial_ && !arrived) {
+        // Nothing came to finish it since last time, so it's just Esc.
+        key = 0x011B;
+        len = 1;
+      } else {
+        partial = true;
+        break;
+      }
+    }
+    if (!push(key)) {
+      break;
+    }
+    typed_pos_ += len;
+  }
+  partial_ = partial;
+  if (typed_pos_ == typed_.size()) {
+    typed_.clear();
+    typed_pos_ = 0;
+  } else if (typed_pos_ > typed_.size() / 2) {
+    typed_.erase(0, typed_pos_);
+    typed_pos_ = 0;
+  }
+}
+
+void Keyboard::int16(int, CPU&) {
+  auto& r = cpu_->core.regs;
+  auto& m = cpu_->memory;
+  switch (r.h.ah) {
+  // INT 16,0 - Wait for keystroke and read, INT 16,10 - extended
+  case 0x00:
+  case 0x10: {
+    fill();
+    const auto key = pop();
+    reading_ = !key;
+    if (!key) {
+      cpu_->wait_for_input();
+      return;
+    }
+    r.x.ax = *key;
+    // Keep the type-ahead buffer topped up for programs that look at it.
+    fill();
+  } break;
+  // INT 16,1 - Get keystroke status, INT 16,11 - extended
+  case 0x01:
+  case 0x11: {
+    fill();
+    const auto key = peek();
+    cpu_->core.flags.zflag(!key);
+    if (key) {
+      r.x.ax = *key;
+    }
+  } break;
+  // INT 16,2 - Get shift status
+  case 0x02: r.h.al = m.abs8(bda_shift_flags); break;
+  // INT 16,3 - Set keyboard typematic rate
+  case 0x03: break;
+  // INT 16,5 - Store keystroke in keyboard type-ahead buffer
+  case 0x05: r.h.al = push(r.x.cx) ? 0 : 1; break;
+  // INT 16,12 - Get extended shift status
+  case 0x12:
+    r.h.al = m.abs8(bda_shift_flags);
+    r.h.ah = m.abs8(bda_shift_flags2);
+    break;
+  default:
+    LOG(WARNING) << fmt::format("Unhandled keyboard function AH:{:02X}; AL:{:02X}", r.h.ah, r.h.al);
+    break;
+  }
+}
+
+#ifdef _WIN32
+
+bool Keyboard::attach(int fd) {
+  detach();
+  if (_get_osfhandle(fd) == -1) {
+    LOG(ERROR) << "Unable to read keyboard input from fd " << fd;
+    return false;
+  }
+  fd_ = fd;
+  stopping_ = false;
+  io_done_ = false;
+  io_ = std::thread(&Keyboard::run_io, this);
+  cpu_->idle.live_input = true;
+  return true;
+}
+
+void Keyboard::detach() {
+  if (!io_.joinable()) {
+    return;
+  }
+  stopping_ = true;
+  // The thread may not have started its read yet when it's cancelled.
+  while (!io_done_) {
+    kick();
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  io_.join();
+}
+
+void Keyboard::kick() {
+  // There's no pipe to poll with, so cancel the blocking read instead.
+  if (io_.joinable()) {
+    CancelSynchronousIo(static_cast<HANDLE>(io_.native_handle()));
+  }
+}
+
+void Keyboard::run_io() {
+  const auto handle = reinterpret_cast<HANDLE>(_get_osfhandle(fd_));
+  while (!stopping_) {
+    if (rx_.free() == 0) {
+      // Waits for the program to make room in the ring.
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      continue;
+    }
+    const auto [p, n] = rx_.writable();
+    DWORD got = 0;
+    if (!ReadFile(handle, p, static_cast<DWORD>(n), &got, nullptr)) {
+      if (GetLastError() == ERROR_OPERATION_ABORTED) {
+        continue;
+      }
+      VLOG(1) << "Keyboard input closed.";
+      break;
+    }
+    if (got == 0) {
+      VLOG(1) << "Keyboard input closed.";
+      break;
+    }
+    rx_.commit(got);
+    on_input();
+  }
+  io_done_ = true;
+}
+
+#else
+
+bool Keyboard::attach(int fd) {
+  detach();
+  if (pipe(wake_fds_) != 0) {
+    LOG(ERROR) << "Unable to create keyboard wake pipe: " << strerror(errno);
+    return false;
+  }
+  for (const auto f : wake_fds_) {
+    fcntl(f, F_SETFL, fcntl(f, F_GETFL) | O_NONBLOCK);
+  }
+  fd_ = fd;
+  stopping_ = false;
+  io_ = std::thread(&Keyboard::run_io, this);
+  cpu_->idle.live_input = true;
+  return true;
+}
+
+void Keyboard::detach() {
+  if (!io_.joinable()) {
+    return;
+  }
+  stopping_ = true;
+  kick();
+  io_.join();
+  close(wake_fds_[0]);
+  close(wake_fds_[1]);
+  wake_fds_[0] = wake_fds_[1] = -1;
+}
+
+void Keyboard::kick() {
+  if (wake_fds_[1] >= 0) {
+    const char c = 0;
+    [[maybe_unused]] auto n = write(wake_fds_[1], &c, 1);
+  }
+}
+
+void Keyboard::run_io() {
+  bool open = true;
+  while (!stopping_) {
+    pollfd fds[2]{};
+    int nfds = 0;
+    fds[nfds++] = {wake_fds_[0], POLLIN, 0};
+    const auto in = open && rx_.free() > 0 ? nfds++ : -1;
+    if (in >= 0) {
+      fds[in] = {fd_, POLLIN, 0};
+    }
+    // Waits for the program to make room in the ring.
+    const auto timeout = open && rx_.free() == 0 ? 10 : -1;
+    if (poll(fds, nfds, timeout) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      LOG(ERROR) << "Keyboard poll failed: " << strerror(errno);
+      break;
+    }
+    if (fds[0].revents & POLLIN) {
+      char buf[64];
+      while (read(wake_fds_[0], buf, sizeof(buf)) > 0) {
+      }
+    }
+    if (in >= 0 && fds[in].revents) {
+      const auto [p, n] = rx_.writable();
+      const auto got = read(fd_, p, n);
+      if (got > 0) {
+        rx_.commit(got);
+        on_input();
+      } else if (got == 0 || (errno != EAGAIN && errno != EINTR)) {
+        VLOG(1) << "Keyboard input closed.";
+        open = false;
+      }
+    }
+  }
+}
+
+#endif
+
+} // namespace door86::bios
@@ -0,0 +1,116 @@
+#ifndef INCLUDED_BIOS_KEYBOARD_H
+#define INCLUDED_BIOS_KEYBOARD_H
+
+#include "bios/spsc_ring.h"
+#include "cpu/x86/cpu.h"
+
+#include <atomic>
+#include <deque>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+
+namespace door86::bios {
+
+/**
+ * Keyboard services on INT 16h, using the type-ahead buffer in the BIOS data
+ * area (0040:001A - 0040:003D) like the real BIOS, so programs that look at
+ * the buffer themselves see the same keys.
+ *
+ * Bytes typed by the caller are read from a file descriptor (stdin or a
+ * socket) by an IO thread, with poll(2) or blocking reads on Windows, and
+ * kept in a ring until the program wants keys. They are turned into scan code
+ * and character pairs (including the ANSI sequences terminals send for cursor
+ * and function keys) and moved into the type-ahead buffer as it has room, so
+ * pasting more than the 15 keys it holds doesn't lose anything.
+ *
+ * Reading a key with none waiting calls CPU::wait_for_input, and runs again
+ * once the IO thread calls on_input.
+ */
+class Keyboard {
+public:
+  // Offsets (from 0040:0000) of the default type-ahead buffer.
+  static constexpr uint16_t buffer_start = 0x1E;
+  static constexpr uint16_t buffer_end = 0x3E;
+
+  explicit Keyboard(door86::cpu::x86::CPU* cpu, size_t buffer_size = 0x4000);
+  ~Keyboard();
+  Keyboard(const Keyboard&) = delete;
+  Keyboard& operator=(const Keyboard&) = delete;
+
+  // INT 16 - Keyboard services
+  void int16(int, door86::cpu::x86::CPU&);
+
+  /**
+   * Starts the IO thread reading typed bytes from fd.
+   * Returns false if the thread couldn't be started.
+   */
+  bool attach(int fd);
+  /** Stops the IO thread. */
+  void detach();
+
+  /**
+   * Types s, i.e. text pasted by the caller. Only call this from the thread
+   * running the CPU.
+   */
+  void type(std::string_view s);
+
+  /**
+   * Types s once the program has executed instructions instructions, or as
+   * soon as it waits for a key with nothing else typed. With virtual time
+   * (see GuestClock) that's the same point in every run, so recorded input
+   * replays exactly. Call in order of instructions.
+   */
+  void type_at(uint64_t instructions, std::string s);
+
+  /** Moves typed keys into the type-ahead buffer while it has room. */
+  void fill();
+
+  // Called on the IO thread when bytes arrive. Wakes the CPU's idle detector
+  // by default, sessions run by a scheduler should wake the session.
+  std::function<void()> on_input;
+  // Called with the instruction count as bytes from the IO thread are typed,
+  // i.e. to record them for type_at.
+  std::function<void(uint64_t instructions, std::string_view bytes)> on_typed;
+
+  // Scan code (high byte) and character (low byte) for the keys at the start of
+  // s, and how many bytes of s they used. Returns a length of 0 if s is the
+  // start of an escape sequence that could still be completed by more input.
+  static std::pair<uint16_t, size_t> translate(std::string_view s);
+
+private:
+  // Type-ahead buffer in the BIOS data area.
+  bool push(uint16_t key);
+  std::optional<uint16_t> peek() const;
+  std::optional<uint16_t> pop();
+  void run_io();
+  void kick();
+
+  door86::cpu::x86::CPU* cpu_;
+  // Bytes from the IO thread.
+  SpscRing rx_;
+  // Bytes not yet in the type-ahead buffer, on the CPU thread.
+  std::string typed_;
+  // Bytes of typed_ already in the type-ahead buffer.
+  size_t typed_pos_{0};
+  // typed_ ended in an incomplete escape sequence as of the last fill.
+  bool partial_{false};
+  // From type_at, in order.
+  std::deque<std::pair<uint64_t, std::string>> script_;
+  // The program is waiting in a read for a key.
+  bool reading_{false};
+  std::atomic<bool> stopping_{false};
+  // The IO thread has finished (only used on Windows, where it's cancelled).
+  std::atomic<bool> io_done_{false};
+  int fd_{-1};
+  // Self pipe used to wake the IO thread out of poll (not used on Windows).
+  int wake_fds_[2]{-1, -1};
+  std::thread io_;
+};
+
+} // namespace door86::bios
+
+#endif // INCLUDED_BIOS_KEYBOARD_H
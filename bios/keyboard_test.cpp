@@ -0,0 +1,143 @@
+#include <gtest/gtest.h>
+
+#include "bios/keyboard.h"
+#include "cpu/x86/cpu.h"
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+using namespace door86::bios;
+using namespace door86::cpu::x86;
+
+class KeyboardTest : public ::testing::Test {
+protected:
+  void int16(uint16_t ax, uint16_t cx = 0) {
+    cpu.core.regs.x.ax = ax;
+    cpu.core.regs.x.cx = cx;
+    keyboard.int16(0x16, cpu);
+  }
+  // Key waiting, without reading it.
+  std::optional<uint16_t> ready() {
+    int16(0x0100);
+    if (cpu.core.flags.zflag()) {
+      return std::nullopt;
+    }
+    return cpu.core.regs.x.ax;
+  }
+
+  CPU cpu;
+  Keyboard keyboard{&cpu};
+};
+
+static std::pair<uint16_t, size_t> key(uint16_t k, size_t len) { return {k, len}; }
+
+TEST_F(KeyboardTest, Translate) {
+  EXPECT_EQ(key(0x1E61, 1), Keyboard::translate("a"));
+  EXPECT_EQ(key(0x1E41, 1), Keyboard::translate("A"));
+  EXPECT_EQ(key(0x1C0D, 1), Keyboard::translate("\r"));
+  EXPECT_EQ(key(0x1C0D, 1), Keyboard::translate("\n"));
+  EXPECT_EQ(key(0x2E03, 1), Keyboard::translate("\x03"));
+  EXPECT_EQ(key(0x4800, 3), Keyboard::translate("\x1b[Ax"));
+  EXPECT_EQ(key(0x5300, 4), Keyboard::translate("\x1b[3~"));
+  EXPECT_EQ(key(0x3B00, 3), Keyboard::translate("\x1bOP"));
+  EXPECT_EQ(key(0x011B, 1), Keyboard::translate("\x1bx"));
+  // Could still be a cursor key.
+  EXPECT_EQ(0u, Keyboard::translate("\x1b[").second);
+}
+
+TEST_F(KeyboardTest, ReadAndStatus) {
+  EXPECT_FALSE(ready());
+  keyboard.type("ab");
+  EXPECT_EQ(0x1E61, ready());
+  int16(0x0000);
+  EXPECT_EQ(0x1E61, cpu.core.regs.x.ax);
+  int16(0x1000);
+  EXPECT_EQ(0x3062, cpu.core.regs.x.ax);
+  EXPECT_FALSE(ready());
+  EXPECT_FALSE(cpu.waiting_for_input());
+}
+
+TEST_F(KeyboardTest, ReadWaits) {
+  int16(0x0000);
+  EXPECT_TRUE(cpu.waiting_for_input());
+}
+
+TEST_F(KeyboardTest, TypeAheadBuffer) {
+  keyboard.type("xy");
+  keyboard.fill();
+  // Where the real BIOS keeps them.
+  EXPECT_EQ(Keyboard::buffer_start, cpu.memory.abs16(0x41A));
+  EXPECT_EQ(Keyboard::buffer_start + 4, cpu.memory.abs16(0x41C));
+  EXPECT_EQ(0x2D78, cpu.memory.abs16(0x400 + Keyboard::buffer_start));
+}
+
+TEST_F(KeyboardTest, StoreKeystroke) {
+  int16(0x0500, 0x3920);
+  EXPECT_EQ(0, cpu.core.regs.h.al);
+  EXPECT_EQ(0x3920, ready());
+}
+
+TEST_F(KeyboardTest, Paste) {
+  std::string pasted;
+  for (int i = 0; i < 1000; i++) {
+    pasted.push_back(static_cast<char>('a' + i % 26));
+  }
+  keyboard.type(pasted);
+  std::string got;
+  for (size_t i = 0; i < pasted.size(); i++) {
+    int16(0x0000);
+    ASSERT_FALSE(cpu.waiting_for_input());
+    got.push_back(static_cast<char>(cpu.core.regs.h.al));
+  }
+  EXPECT_EQ(pasted, got);
+  EXPECT_FALSE(ready());
+}
+
+TEST_F(KeyboardTest, LoneEscape) {
+  keyboard.type("\x1b");
+  // Held back in case the rest of a sequence is coming.
+  EXPECT_FALSE(ready());
+  EXPECT_EQ(0x011B, ready());
+}
+
+TEST_F(KeyboardTest, TypeAt) {
+  keyboard.type_at(100, "a");
+  keyboard.type_at(200, "b");
+  cpu.instructions = 99;
+  EXPECT_FALSE(ready());
+  cpu.instructions = 150;
+  EXPECT_EQ(0x1E61, ready());
+  int16(0x0000);
+  // Waiting for a key, so the next one is typed early.
+  int16(0x0000);
+  EXPECT_TRUE(cpu.waiting_for_input());
+  cpu.end_slice(stop_reason_t::waiting);
+  EXPECT_EQ(0x3062, ready());
+}
+
+#ifndef _WIN32
+
+TEST_F(KeyboardTest, Attach) {
+  int fds[2];
+  ASSERT_EQ(0, pipe(fds));
+  std::atomic<int> inputs{0};
+  keyboard.on_input = [&inputs] { ++inputs; };
+  ASSERT_TRUE(keyboard.attach(fds[0]));
+  ASSERT_EQ(3, write(fds[1], "\x1b[D", 3));
+  for (int i = 0; i < 500 && inputs == 0; i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  }
+  EXPECT_GT(inputs, 0);
+  int16(0x0000);
+  EXPECT_EQ(0x4B00, cpu.core.regs.x.ax);
+  keyboard.detach();
+  close(fds[0]);
+  close(fds[1]);
+}
+
+#endif
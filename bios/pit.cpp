@@ -0,0 +1,268 @@
+#include "bios/pit.h"
+
+#include "core/log.h"
+#include <utility>
+
+namespace door86::bios {
+
+using door86::cpu::x86::CPU;
+
+Pit::Pit(CPU* cpu) : cpu_(cpu) {
+  cpu_->io.add_ports(
+      port_count0, 4, [this](uint16_t port) { return read(port); },
+      [this](uint16_t port, uint8_t value) { write(port, value); });
+  cpu_->io.add_ports(
+      port_system, 1, [this](uint16_t port) { return read(port); },
+      [this](uint16_t port, uint8_t value) { write(port, value); });
+  // As the BIOS leaves them: channel 0 at 18.2 Hz for the system timer,
+  // channel 1 for DRAM refresh every 15 us, and channel 2 (the speaker) off.
+  write(port_system, 0);
+  write(port_control, 0x36);
+  write(port_count0, 0);
+  write(port_count0, 0);
+  write(port_control, 0x54);
+  write(port_count0 + 1, 18);
+  write(port_control, 0xB6);
+  write(port_count0 + 2, 0x33);
+  write(port_count0 + 2, 0x05);
+}
+
+Pit::~Pit() {
+  if (channels_[0].event) {
+    cpu_->events.cancel(channels_[0].event);
+  }
+}
+
+uint64_t Pit::now() const { return cpu_->time.elapsed_cycles() / cycles_per_tick; }
+
+uint64_t Pit::elapsed(const channel_t& c) const {
+  if (!c.counting) {
+    return 0;
+  }
+  return c.gate ? now() - c.loaded : c.gated;
+}
+
+uint16_t Pit::count(const channel_t& c) const {
+  if (!c.counting) {
+    return static_cast<uint16_t>(c.reload);
+  }
+  const auto e = elapsed(c);
+  switch (c.mode) {
+  case 2: return static_cast<uint16_t>(c.reload - e % c.reload);
+  case 3: {
+    // Counts down by two, through each half of the square wave.
+    const auto half = (c.reload + 1) / 2;
+    const auto p = e % c.reload;
+    const auto q = p < half ? p : p - half;
+    return static_cast<uint16_t>((c.reload & ~1u) - 2 * q);
+  }
+  // Keeps counting, wrapping around, after reaching 0.
+  default: return static_cast<uint16_t>(c.reload - e);
+  }
+}
+
+bool Pit::out(const channel_t& c) const {
+  if (!c.counting) {
+    return c.mode != 0;
+  }
+  const auto e = elapsed(c);
+  switch (c.mode) {
+  case 0:
+  case 1: return e >= c.reload;
+  // Low for the clock the count is 1.
+  case 2: return !c.gate || e % c.reload != c.reload - 1;
+  // High for the first half (the longer one, for an odd count).
+  case 3: return !c.gate || e % c.reload < (c.reload + 1) / 2;
+  // Low for the clock after reaching 0.
+  default: return e != c.reload;
+  }
+}
+
+uint16_t Pit::count(int channel) const { return count(channels_.at(channel)); }
+
+bool Pit::out(int channel) const { return out(channels_.at(channel)); }
+
+uint8_t Pit::status(int channel) const {
+  const auto& c = channels_[channel];
+  return static_cast<uint8_t>((out(c) ? 0x80 : 0) | (c.counting ? 0 : 0x40) | (c.access << 4) |
+                              (c.mode << 1) | (c.bcd ? 1 : 0));
+}
+
+uint8_t Pit::read(uint16_t port) {
+  switch (port) {
+  case port_count0:
+  case port_count0 + 1:
+  case port_count0 + 2: return read_count(port - port_count0);
+  case port_system: {
+    // Bit 4 toggles with each DRAM refresh, and programs time short delays by it.
+    const auto& refresh = channels_[1];
+    const bool toggle = refresh.counting && (elapsed(refresh) / refresh.reload) & 1;
+    return static_cast<uint8_t>(system_ | (toggle ? 0x10 : 0) | (out(channels_[2]) ? 0x20 : 0));
+  }
+  // The control word can't be read.
+  default: return 0xFF;
+  }
+}
+
+void Pit::write(uint16_t port, uint8_t value) {
+  switch (port) {
+  case port_count0:
+  case port_count0 + 1:
+  case port_count0 + 2: write_count(port - port_count0, value); break;
+  case port_control: control(value); break;
+  case port_system:
+    system_ = value & 0x0F;
+    set_gate(2, value & 0x01);
+    break;
+  }
+}
+
+void Pit::control(uint8_t value) {
+  const int channel = value >> 6;
+  if (channel == 3) {
+    // 8254 read-back: latches the count (bit 5 clear) and status (bit 4
+    // clear) of the channels in bits 1-3.
+    for (int i = 0; i < 3; i++) {
+      auto& c = channels_[i];
+      if (!(value & (2 << i))) {
+        continue;
+      }
+      if (!(value & 0x20) && !c.latch) {
+        c.latch = count(c);
+        c.read_msb = false;
+      }
+      if (!(value & 0x10) && !c.status) {
+        c.status = status(i);
+      }
+    }
+    return;
+  }
+  auto& c = channels_[channel];
+  const auto access = static_cast<uint8_t>((value >> 4) & 3);
+  if (access == 0) {
+    // Counter latch command, the first one holds until it's read.
+    if (!c.latch) {
+      c.latch = count(c);
+      c.read_msb = false;
+    }
+    return;
+  }
+  c.access = access;
+  c.mode = (value >> 1) & 7;
+  if (c.mode > 5) {
+    // 6 and 7 are 2 and 3.
+    c.mode -= 4;
+  }
+  c.bcd = value & 1;
+  if (c.bcd) {
+    VLOG(1) << "PIT channel " << channel << " set to BCD, counting in binary.";
+  }
+  c.counting = false;
+  c.write_msb = false;
+  c.read_msb = false;
+  c.latch.reset();
+  c.status.reset();
+  if (channel == 0) {
+    schedule();
+  }
+}
+
+void Pit::write_count(int channel, uint8_t value) {
+  auto& c = channels_[channel];
+  uint32_t reload = value;
+  switch (c.access) {
+  case 2: reload = value << 8; break;
+  case 3:
+    if (!c.write_msb) {
+      c.lsb = value;
+      c.write_msb = true;
+      if (c.mode == 0) {
+        // Writing the first byte stops the count.
+        c.counting = false;
+        if (channel == 0) {
+          schedule();
+        }
+      }
+      return;
+    }
+    c.write_msb = false;
+    reload = c.lsb | (value << 8);
+    break;
+  }
+  c.reload = reload ? reload : 0x10000;
+  c.loaded = now();
+  c.gated = 0;
+  c.counting = true;
+  if (channel == 0) {
+    schedule();
+  }
+}
+
+uint8_t Pit::read_count(int channel) {
+  auto& c = channels_[channel];
+  if (c.status) {
+    const auto status = *c.status;
+    c.status.reset();
+    return status;
+  }
+  const auto value = c.latch ? *c.latch : count(c);
+  bool msb = c.access == 2;
+  if (c.access == 3) {
+    msb = std::exchange(c.read_msb, !c.read_msb);
+  }
+  if (c.access != 3 || msb) {
+    c.latch.reset();
+  }
+  return static_cast<uint8_t>(msb ? value >> 8 : value);
+}
+
+void Pit::set_gate(int channel, bool gate) {
+  auto& c = channels_[channel];
+  if (c.gate == gate) {
+    return;
+  }
+  if (!gate) {
+    c.gated = elapsed(c);
+    c.gate = false;
+    return;
+  }
+  c.gate = true;
+  // The gate going high starts modes 1, 2, 3 and 5 over, the rest carry on.
+  c.loaded = now() - (c.mode == 0 || c.mode == 4 ? c.gated : 0);
+}
+
+void Pit::schedule() {
+  auto& c = channels_[0];
+  if (c.event) {
+    cpu_->events.cancel(c.event);
+    c.event = 0;
+  }
+  if (!c.counting) {
+    return;
+  }
+  const auto e = now() - c.loaded;
+  uint64_t rising = 0;
+  switch (c.mode) {
+  case 0:
+  case 1: rising = c.reload; break;
+  case 2:
+  case 3: rising = (e / c.reload + 1) * c.reload; break;
+  default: rising = c.reload + 1; break;
+  }
+  if (rising <= e) {
+    // A one shot that's already gone off.
+    return;
+  }
+  c.event = cpu_->events.schedule((c.loaded + rising) * cycles_per_tick,
+                                  [this](uint64_t at) { on_rising(at); });
+}
+
+void Pit::on_rising(uint64_t) {
+  channels_[0].event = 0;
+  if (irq0) {
+    irq0();
+  }
+  schedule();
+}
+
+} // namespace door86::bios
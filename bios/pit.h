@@ -0,0 +1,97 @@
+#ifndef INCLUDED_BIOS_PIT_H
+#define INCLUDED_BIOS_PIT_H
+
+#include "cpu/x86/cpu.h"
+#include "cpu/x86/event_queue.h"
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <optional>
+
+namespace door86::bios {
+
+/**
+ * The 8253/8254 programmable interval timer on ports 40h-43h, and the timer
+ * bits of port 61h (the channel 2 gate, and the channel 1 and 2 outputs).
+ *
+ * The counters aren't clocked. The PIT runs at a quarter of the 8088's clock
+ * (1.19 MHz), so a count or output is worked out from the guest clock (see
+ * GuestClock::elapsed_cycles) when it's read. The only events scheduled on
+ * the CPU's EventQueue are for channel 0's output going high, which is IRQ 0
+ * on a PC.
+ *
+ * Modes 1 and 5 (hardware triggered) count like 0 and 4, since only channel 2
+ * has a gate the program can change. BCD counting isn't supported.
+ */
+class Pit {
+public:
+  static constexpr uint16_t port_count0 = 0x40;
+  static constexpr uint16_t port_control = 0x43;
+  static constexpr uint16_t port_system = 0x61;
+  // 8088 clock cycles per PIT clock.
+  static constexpr uint64_t cycles_per_tick = 4;
+
+  explicit Pit(door86::cpu::x86::CPU* cpu);
+  ~Pit();
+  Pit(const Pit&) = delete;
+  Pit& operator=(const Pit&) = delete;
+
+  // Called when channel 0's output goes high, to raise IRQ 0.
+  std::function<void()> irq0;
+
+  uint8_t read(uint16_t port);
+  void write(uint16_t port, uint8_t value);
+
+  // The count and output of a channel now.
+  uint16_t count(int channel) const;
+  bool out(int channel) const;
+
+private:
+  struct channel_t {
+    uint8_t mode{0};
+    // 1: LSB only, 2: MSB only, 3: LSB then MSB.
+    uint8_t access{3};
+    bool bcd{false};
+    // 1 to 0x10000 (written as 0).
+    uint32_t reload{0x10000};
+    // PIT clock the count was loaded at.
+    uint64_t loaded{0};
+    // A count has been written since the mode was set.
+    bool counting{false};
+    bool gate{true};
+    // Clocks counted before the gate went low.
+    uint64_t gated{0};
+    // The next count write or read is the MSB of a 16 bit access.
+    bool write_msb{false};
+    uint8_t lsb{0};
+    bool read_msb{false};
+    std::optional<uint16_t> latch;
+    std::optional<uint8_t> status;
+    door86::cpu::x86::EventQueue::event_id event{0};
+  };
+
+  // PIT clocks since the CPU started.
+  uint64_t now() const;
+  // PIT clocks counted by c so far.
+  uint64_t elapsed(const channel_t& c) const;
+  uint16_t count(const channel_t& c) const;
+  bool out(const channel_t& c) const;
+  uint8_t status(int channel) const;
+  void control(uint8_t value);
+  void write_count(int channel, uint8_t value);
+  uint8_t read_count(int channel);
+  void set_gate(int channel, bool gate);
+  // Schedules an event for channel 0's output going high next.
+  void schedule();
+  void on_rising(uint64_t at);
+
+  door86::cpu::x86::CPU* cpu_;
+  std::array<channel_t, 3> channels_;
+  // Bits 0-3 last written to port 61h.
+  uint8_t system_{0};
+};
+
+} // namespace door86::bios
+
+#endif // INCLUDED_BIOS_PIT_H
@@ -0,0 +1,177 @@
+#include <gtest/gtest.h>
+
+#include "bios/pit.h"
+#include "cpu/x86/cpu.h"
+#include "cpu/x86/cpu_fixture.h"
+#include <chrono>
+#include <string>
+#include <thread>
+
+using namespace door86::bios;
+using namespace door86::cpu::x86;
+using namespace std::chrono_literals;
+
+class PitTest : public ::testing::Test {
+protected:
+  PitTest() {
+    pit.irq0 = [this] { ++irqs; };
+  }
+  // So the PIT's clock is the cycle count, from before it starts counting.
+  static CPU* virtual_time(CPU* cpu) {
+    cpu->time.set_virtual();
+    return cpu;
+  }
+  // Moves the clock on by ticks PIT clocks, running events as they're due.
+  void run_ticks(uint64_t ticks) {
+    for (uint64_t i = 0; i < ticks; i++) {
+      cpu.cycles += Pit::cycles_per_tick;
+      cpu.events.run_due(cpu.cycles);
+    }
+  }
+  uint16_t latched(int channel) {
+    cpu.io.outb(Pit::port_control, static_cast<uint8_t>(channel << 6));
+    const auto lo = cpu.io.inb(Pit::port_count0 + channel);
+    return static_cast<uint16_t>(lo | (cpu.io.inb(Pit::port_count0 + channel) << 8));
+  }
+  void program(int channel, uint8_t mode, uint16_t count) {
+    cpu.io.outb(Pit::port_control, static_cast<uint8_t>((channel << 6) | 0x30 | (mode << 1)));
+    cpu.io.outb(Pit::port_count0 + channel, static_cast<uint8_t>(count));
+    cpu.io.outb(Pit::port_count0 + channel, static_cast<uint8_t>(count >> 8));
+  }
+
+  CPU cpu;
+  Pit pit{virtual_time(&cpu)};
+  int irqs{0};
+};
+
+TEST_F(PitTest, SystemTimer) {
+  // Mode 3 with a count of 65536, which counts down by two.
+  EXPECT_EQ(0, latched(0));
+  run_ticks(100);
+  EXPECT_EQ(0x10000 - 200, latched(0));
+  EXPECT_TRUE(pit.out(0));
+  run_ticks(0x8000 - 100);
+  EXPECT_FALSE(pit.out(0));
+  EXPECT_EQ(0, irqs);
+  // 18.2 a second.
+  run_ticks(0x8000);
+  EXPECT_EQ(1, irqs);
+  EXPECT_EQ(0x10000 * Pit::cycles_per_tick * 2, cpu.events.next());
+}
+
+TEST_F(PitTest, RateGenerator) {
+  program(0, 2, 1000);
+  run_ticks(999);
+  EXPECT_EQ(1, pit.count(0));
+  EXPECT_FALSE(pit.out(0));
+  EXPECT_EQ(0, irqs);
+  run_ticks(1);
+  EXPECT_EQ(1000, pit.count(0));
+  EXPECT_EQ(1, irqs);
+  run_ticks(2000);
+  EXPECT_EQ(3, irqs);
+}
+
+TEST_F(PitTest, OneShot) {
+  program(0, 0, 50);
+  EXPECT_FALSE(pit.out(0));
+  run_ticks(10);
+  EXPECT_EQ(40, latched(0));
+  run_ticks(40);
+  EXPECT_TRUE(pit.out(0));
+  EXPECT_EQ(1, irqs);
+  // Wraps around without going off again.
+  run_ticks(100);
+  EXPECT_EQ(0x10000 - 100, pit.count(0));
+  EXPECT_EQ(1, irqs);
+  EXPECT_TRUE(cpu.events.empty());
+}
+
+TEST_F(PitTest, LatchHoldsUntilRead) {
+  program(0, 2, 1000);
+  run_ticks(10);
+  cpu.io.outb(Pit::port_control, 0x00);
+  run_ticks(10);
+  EXPECT_EQ(0xDE, cpu.io.inb(Pit::port_count0));
+  run_ticks(10);
+  EXPECT_EQ(0x03, cpu.io.inb(Pit::port_count0));
+  // Live again.
+  EXPECT_EQ(970, latched(0));
+}
+
+TEST_F(PitTest, ReadBack) {
+  program(2, 3, 0x1234);
+  // Status and count of channel 2.
+  cpu.io.outb(Pit::port_control, 0xC8);
+  // Output high, count loaded, LSB then MSB, mode 3.
+  EXPECT_EQ(0xB6, cpu.io.inb(Pit::port_count0 + 2));
+  EXPECT_EQ(0x34, cpu.io.inb(Pit::port_count0 + 2));
+  EXPECT_EQ(0x12, cpu.io.inb(Pit::port_count0 + 2));
+}
+
+TEST_F(PitTest, SpeakerGate) {
+  program(2, 0, 100);
+  // The BIOS leaves the gate low.
+  run_ticks(10);
+  EXPECT_EQ(100, pit.count(2));
+  EXPECT_EQ(0, cpu.io.inb(Pit::port_system) & 0x20);
+  cpu.io.outb(Pit::port_system, 0x01);
+  run_ticks(100);
+  EXPECT_EQ(0x21, cpu.io.inb(Pit::port_system) & 0x21);
+}
+
+TEST_F(PitTest, RefreshToggles) {
+  const auto before = cpu.io.inb(Pit::port_system) & 0x10;
+  run_ticks(18);
+  EXPECT_NE(before, cpu.io.inb(Pit::port_system) & 0x10);
+}
+
+TEST_F(PitTest, RunLoopRunsEvents) {
+  program(0, 2, 100);
+  // L: JMP L
+  const auto ops = parse_opcodes_from_line("EBFE");
+  ASSERT_TRUE(cpu.memory.load_image(0x1000, ops.size(), ops.data()));
+  cpu.core.sregs.cs = 0x100;
+  cpu.core.ip = 0;
+  budget_t budget;
+  budget.cycles = 100 * Pit::cycles_per_tick * 5 + 10;
+  EXPECT_EQ(stop_reason_t::budget, cpu.run_for(budget));
+  EXPECT_EQ(5, irqs);
+}
+
+TEST_F(PitTest, WaitingSkipsToEvent) {
+  pit.irq0 = [this] { cpu.memory.abs8(0x500, 1); };
+  // INT 20h halts the CPU.
+  cpu.memory[0x20 * 4] = 0x20;
+  cpu.int_handlers().try_emplace(0x20, [](int, CPU& c) { c.halt(); });
+  // L: CMP BYTE [0500], 0; JE L; INT 20
+  const auto ops = parse_opcodes_from_line("803E000500 74F9 CD20");
+  ASSERT_TRUE(cpu.memory.load_image(0x1000, ops.size(), ops.data()));
+  cpu.core.sregs.ds = 0;
+  cpu.idle.enabled = true;
+  ASSERT_TRUE(cpu.run(0x100, 0));
+  // Straight to the first timer tick, rather than spinning until it.
+  EXPECT_GE(cpu.cycles, 0x10000 * Pit::cycles_per_tick);
+  EXPECT_LT(cpu.cycles, 0x10000 * Pit::cycles_per_tick + 1000);
+}
+
+TEST(PitHostTimeTest, FollowsHostClock) {
+  CPU cpu;
+  Pit pit{&cpu};
+  int irqs = 0;
+  pit.irq0 = [&irqs] { ++irqs; };
+  // L: JMP L
+  const auto ops = parse_opcodes_from_line("EBFE");
+  ASSERT_TRUE(cpu.memory.load_image(0x1000, ops.size(), ops.data()));
+  cpu.core.sregs.cs = 0x100;
+  cpu.core.ip = 0;
+  budget_t budget;
+  budget.deadline = std::chrono::steady_clock::now() + 20ms;
+  EXPECT_EQ(stop_reason_t::deadline, cpu.run_for(budget));
+  // However many cycles that ran, it's less than a 55ms tick.
+  EXPECT_EQ(0, irqs);
+  std::this_thread::sleep_for(60ms);
+  budget.deadline = std::chrono::steady_clock::now() + 1ms;
+  cpu.run_for(budget);
+  EXPECT_EQ(1, irqs);
+}
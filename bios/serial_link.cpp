@@ -0,0 +1,138 @@
+#include "bios/serial_link.h"
+
+#include "core/log.h"
+#include <cerrno>
+#include <cstring>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+namespace door86::bios {
+
+SerialLink::SerialLink(size_t buffer_size) : rx_(buffer_size), tx_(buffer_size) {}
+
+SerialLink::~SerialLink() { detach(); }
+
+void SerialLink::purge_tx() {
+  purge_tx_ = true;
+  kick();
+}
+
+#ifdef _WIN32
+
+bool SerialLink::attach(int, int) {
+  LOG(ERROR) << "The serial IO thread isn't supported on Windows yet.";
+  return false;
+}
+
+void SerialLink::detach() {}
+
+void SerialLink::kick() {}
+
+void SerialLink::run_io() {}
+
+#else
+
+bool SerialLink::attach(int in_fd, int out_fd) {
+  detach();
+  if (pipe(wake_fds_) != 0) {
+    LOG(ERROR) << "Unable to create serial wake pipe: " << strerror(errno);
+    return false;
+  }
+  for (const auto fd : wake_fds_) {
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+  }
+  in_fd_ = in_fd;
+  out_fd_ = out_fd;
+  carrier_ = true;
+  stopping_ = false;
+  io_ = std::thread(&SerialLink::run_io, this);
+  return true;
+}
+
+void SerialLink::detach() {
+  if (!io_.joinable()) {
+    return;
+  }
+  stopping_ = true;
+  kick();
+  io_.join();
+  close(wake_fds_[0]);
+  close(wake_fds_[1]);
+  wake_fds_[0] = wake_fds_[1] = -1;
+}
+
+void SerialLink::kick() {
+  if (wake_fds_[1] >= 0) {
+    const char c = 0;
+    // If the pipe is full the IO thread has wakeups waiting already.
+    [[maybe_unused]] auto n = write(wake_fds_[1], &c, 1);
+  }
+}
+
+void SerialLink::run_io() {
+  while (!stopping_) {
+    if (purge_tx_.exchange(false)) {
+      tx_.clear();
+      on_input();
+    }
+    pollfd fds[3]{};
+    int nfds = 0;
+    fds[nfds++] = {wake_fds_[0], POLLIN, 0};
+    const auto in = carrier_ && rx_.free() > 0 ? nfds++ : -1;
+    if (in >= 0) {
+      fds[in] = {in_fd_, POLLIN, 0};
+    }
+    const auto out = carrier_ && !tx_.empty() ? nfds++ : -1;
+    if (out >= 0) {
+      fds[out] = {out_fd_, POLLOUT, 0};
+    }
+    // The receive ring filling up is the only thing that isn't woken up for.
+    const auto timeout = carrier_ && rx_.free() == 0 ? 10 : -1;
+    if (poll(fds, nfds, timeout) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      LOG(ERROR) << "Serial poll failed: " << strerror(errno);
+      break;
+    }
+    if (fds[0].revents & POLLIN) {
+      char buf[64];
+      while (read(wake_fds_[0], buf, sizeof(buf)) > 0) {
+      }
+    }
+    bool woke = false;
+    if (in >= 0 && fds[in].revents) {
+      const auto [p, n] = rx_.writable();
+      const auto got = read(in_fd_, p, n);
+      if (got > 0) {
+        rx_.commit(got);
+      } else if (got == 0 || (errno != EAGAIN && errno != EINTR)) {
+        VLOG(1) << "Serial connection closed.";
+        carrier_ = false;
+      }
+      woke = true;
+    }
+    if (out >= 0 && fds[out].revents) {
+      const auto [p, n] = tx_.readable();
+      const auto sent = write(out_fd_, p, n);
+      if (sent > 0) {
+        tx_.consume(sent);
+      } else if (sent < 0 && errno != EAGAIN && errno != EINTR) {
+        VLOG(1) << "Serial connection closed.";
+        carrier_ = false;
+      }
+      woke = true;
+    }
+    if (woke) {
+      on_input();
+    }
+  }
+}
+
+#endif
+
+} // namespace door86::bios
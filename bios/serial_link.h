@@ -0,0 +1,74 @@
+#ifndef INCLUDED_BIOS_SERIAL_LINK_H
+#define INCLUDED_BIOS_SERIAL_LINK_H
+
+#include "bios/spsc_ring.h"
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <thread>
+
+namespace door86::bios {
+
+/**
+ * The connection to the caller behind a serial port (the FOSSIL driver or
+ * the UART): a receive and a transmit ring, and an IO thread that moves
+ * bytes between them and a file descriptor (a socket, a pty, or stdin and
+ * stdout) with poll(2), so nothing the program does blocks on the
+ * connection.
+ *
+ * The emulated side only touches the rings. Received bytes are read from the
+ * descriptor as many at a time as there's room for, and everything waiting
+ * in the transmit ring goes out in one write once the IO thread is kicked.
+ */
+class SerialLink {
+public:
+  explicit SerialLink(size_t buffer_size);
+  ~SerialLink();
+  SerialLink(const SerialLink&) = delete;
+  SerialLink& operator=(const SerialLink&) = delete;
+
+  /**
+   * Starts the IO thread moving received bytes from in_fd and transmitted bytes
+   * to out_fd, which may be the same descriptor (i.e. a socket).
+   * Returns false if that isn't supported on this platform.
+   */
+  bool attach(int in_fd, int out_fd);
+  /** Stops the IO thread. */
+  void detach();
+
+  /** Tells the IO thread there's something to transmit. */
+  void kick();
+  /** Throws away everything waiting to be transmitted. */
+  void purge_tx();
+
+  // Called on the IO thread when bytes arrive, transmit space frees up or
+  // carrier is lost.
+  std::function<void()> on_input;
+
+  // true while attached to a connection that hasn't closed.
+  bool carrier() const noexcept { return carrier_; }
+
+  SpscRing& rx() noexcept { return rx_; }
+  SpscRing& tx() noexcept { return tx_; }
+  const SpscRing& rx() const noexcept { return rx_; }
+  const SpscRing& tx() const noexcept { return tx_; }
+
+private:
+  void run_io();
+
+  SpscRing rx_;
+  SpscRing tx_;
+  std::atomic<bool> carrier_{false};
+  std::atomic<bool> stopping_{false};
+  std::atomic<bool> purge_tx_{false};
+  int in_fd_{-1};
+  int out_fd_{-1};
+  // Self pipe used to wake the IO thread out of poll.
+  int wake_fds_[2]{-1, -1};
+  std::thread io_;
+};
+
+} // namespace door86::bios
+
+#endif // INCLUDED_BIOS_SERIAL_LINK_H
@@ -0,0 +1,115 @@
+#ifndef INCLUDED_BIOS_SPSC_RING_H
+#define INCLUDED_BIOS_SPSC_RING_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+namespace door86::bios {
+
+/**
+ * A byte ring buffer shared by one producer thread and one consumer thread
+ * without locks.
+ *
+ * Both sides can work on the buffer in place: the producer fills the span
+ * returned by writable() (i.e. by passing it to read(2)) and commits it, and
+ * the consumer drains the span returned by readable() (i.e. by passing it to
+ * write(2), or copying it into guest memory) and consumes it.
+ */
+class SpscRing {
+public:
+  // capacity is rounded up to a power of 2.
+  explicit SpscRing(size_t capacity) {
+    size_t n = 1;
+    while (n < capacity) {
+      n <<= 1;
+    }
+    buf_.resize(n);
+  }
+
+  size_t capacity() const noexcept { return buf_.size(); }
+  size_t size() const noexcept {
+    // head first, so it's never past the tail that's read.
+    const auto head = head_.load(std::memory_order_acquire);
+    return tail_.load(std::memory_order_acquire) - head;
+  }
+  size_t free() const noexcept { return capacity() - size(); }
+  bool empty() const noexcept { return size() == 0; }
+
+  // Producer side.
+
+  // The contiguous free space, which may be less than free().
+  std::pair<uint8_t*, size_t> writable() noexcept {
+    const auto tail = tail_.load(std::memory_order_relaxed);
+    const auto head = head_.load(std::memory_order_acquire);
+    const auto start = tail & (capacity() - 1);
+    return {buf_.data() + start, std::min(capacity() - (tail - head), capacity() - start)};
+  }
+  // Makes n bytes written into writable() available to the consumer.
+  void commit(size_t n) noexcept { tail_.fetch_add(n, std::memory_order_release); }
+  // Copies in up to size bytes, returns how many were.
+  size_t write(const uint8_t* data, size_t size) noexcept {
+    size_t done = 0;
+    while (done < size) {
+      const auto [p, n] = writable();
+      if (n == 0) {
+        break;
+      }
+      const auto len = std::min(n, size - done);
+      memcpy(p, data + done, len);
+      commit(len);
+      done += len;
+    }
+    return done;
+  }
+
+  // Consumer side.
+
+  // The contiguous waiting bytes, which may be less than size().
+  std::pair<const uint8_t*, size_t> readable() const noexcept {
+    const auto head = head_.load(std::memory_order_relaxed);
+    const auto tail = tail_.load(std::memory_order_acquire);
+    const auto start = head & (capacity() - 1);
+    return {buf_.data() + start, std::min(tail - head, capacity() - start)};
+  }
+  // Releases n bytes of readable() back to the producer.
+  void consume(size_t n) noexcept { head_.fetch_add(n, std::memory_order_release); }
+  // Copies out up to size bytes, returns how many were.
+  size_t read(uint8_t* data, size_t size) noexcept {
+    size_t done = 0;
+    while (done < size) {
+      const auto [p, n] = readable();
+      if (n == 0) {
+        break;
+      }
+      const auto len = std::min(n, size - done);
+      memcpy(data + done, p, len);
+      consume(len);
+      done += len;
+    }
+    return done;
+  }
+  // Returns the next byte without consuming it, or -1 if there isn't one.
+  int peek() const noexcept {
+    const auto [p, n] = readable();
+    return n ? *p : -1;
+  }
+  // Throws away everything waiting.
+  void clear() noexcept {
+    head_.store(tail_.load(std::memory_order_acquire), std::memory_order_release);
+  }
+
+private:
+  std::vector<uint8_t> buf_;
+  // Free running counts of bytes consumed and committed.
+  alignas(64) std::atomic<size_t> head_{0};
+  alignas(64) std::atomic<size_t> tail_{0};
+};
+
+} // namespace door86::bios
+
+#endif // INCLUDED_BIOS_SPSC_RING_H
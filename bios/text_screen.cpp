@@ -0,0 +1,196 @@
+#include "bios/text_screen.h"
+
+#include "core/log.h"
+#include "fmt/format.h"
+#include <algorithm>
+
+namespace door86::bios {
+
+using door86::cpu::Memory;
+
+// ANSI color for each of the 3 bit CGA colors (CGA is BGR, ANSI is RGB)
+static constexpr int ansi_color[] = {0, 4, 2, 6, 1, 5, 3, 7};
+
+static bool is_blank(uint8_t ch) { return ch == 0 || ch == ' ' || ch == 0xff; }
+
+// Returns true if the two cells look the same, blanks only need the same background.
+static bool looks_same(uint8_t c1, uint8_t a1, uint8_t c2, uint8_t a2) {
+  if (c1 == c2 && a1 == a2) {
+    return true;
+  }
+  return is_blank(c1) && is_blank(c2) && (a1 & 0x70) == (a2 & 0x70);
+}
+
+// Pages needed for the largest screen.
+static constexpr int video_pages = (TextScreen::cols * 50 * 2 + Memory::page_mask) >> Memory::page_shift;
+
+TextScreen::TextScreen(Memory& memory) : memory_(memory) {
+  shown_.resize(cols * rows_ * 2);
+  for (int i = 0; i < video_pages; i++) {
+    gens_.push_back(memory_.generation(video_memory + (i << Memory::page_shift)));
+  }
+  cursor_ = {memory_.abs8(0x451), memory_.abs8(0x450)};
+}
+
+void TextScreen::set_rows(int rows) {
+  if (rows != 25 && rows != 50) {
+    LOG(WARNING) << "Unsupported number of text rows: " << rows;
+    return;
+  }
+  rows_ = rows;
+  shown_.assign(cols * rows_ * 2, 0);
+  invalidate();
+}
+
+void TextScreen::invalidate() {
+  redraw_ = true;
+  forget_terminal();
+}
+
+uint8_t TextScreen::char_at(int row, int col) const {
+  return memory_.abs8(video_memory + (row * cols + col) * 2);
+}
+
+uint8_t TextScreen::attr_at(int row, int col) const {
+  return memory_.abs8(video_memory + (row * cols + col) * 2 + 1);
+}
+
+void TextScreen::move_to(std::string& out, int row, int col) {
+  if (row == row_ && col == col_) {
+    return;
+  }
+  if (row == row_ && col_ >= 0 && col > col_) {
+    const auto gap = col - col_;
+    // Resending a few unchanged cells is shorter than moving the cursor over them.
+    bool resend = gap <= 3;
+    for (int c = col_; resend && c < col; c++) {
+      resend = shown_[(row * cols + c) * 2 + 1] == attr_;
+    }
+    if (resend) {
+      for (int c = col_; c < col; c++) {
+        const auto ch = shown_[(row * cols + c) * 2];
+        out.push_back(static_cast<char>(is_blank(ch) ? ' ' : ch));
+      }
+    } else if (gap == 1) {
+      out.append("\x1b[C");
+    } else {
+      out.append(fmt::format("\x1b[{}C", gap));
+    }
+  } else if (col == 0) {
+    out.append(fmt::format("\x1b[{}H", row + 1));
+  } else {
+    out.append(fmt::format("\x1b[{};{}H", row + 1, col + 1));
+  }
+  row_ = row;
+  col_ = col;
+}
+
+void TextScreen::set_attr(std::string& out, uint8_t attr) {
+  if (attr == attr_) {
+    return;
+  }
+  std::string sgr;
+  const auto add = [&sgr](int code) {
+    if (!sgr.empty()) {
+      sgr.push_back(';');
+    }
+    sgr.append(std::to_string(code));
+  };
+  // Bold (bright) and blink can only be turned off by a reset.
+  const auto reset = attr_ < 0 || ((attr_ & 0x08) && !(attr & 0x08)) ||
+                     ((attr_ & 0x80) && !(attr & 0x80));
+  const auto prev = reset ? -1 : attr_;
+  if (reset) {
+    add(0);
+  }
+  if ((attr & 0x08) && (prev < 0 || !(prev & 0x08))) {
+    add(1);
+  }
+  if ((attr & 0x80) && (prev < 0 || !(prev & 0x80))) {
+    add(5);
+  }
+  if (prev < 0 || (prev & 0x07) != (attr & 0x07)) {
+    add(30 + ansi_color[attr & 0x07]);
+  }
+  if (prev < 0 || (prev & 0x70) != (attr & 0x70)) {
+    add(40 + ansi_color[(attr >> 4) & 0x07]);
+  }
+  out.append("\x1b[").append(sgr).push_back('m');
+  attr_ = attr;
+}
+
+void TextScreen::put(std::string& out, int row, int col) {
+  const auto ch = char_at(row, col);
+  const auto attr = attr_at(row, col);
+  move_to(out, row, col);
+  set_attr(out, attr);
+  out.push_back(static_cast<char>(is_blank(ch) ? ' ' : ch));
+  const auto i = (row * cols + col) * 2;
+  shown_[i] = ch;
+  shown_[i + 1] = attr;
+  if (++col_ == cols) {
+    // Terminals differ on where the cursor is after writing the last column.
+    row_ = col_ = -1;
+  }
+}
+
+std::string TextScreen::update() {
+  std::string out;
+  const auto row_bytes = cols * 2;
+  std::vector<bool> dirty(rows_, redraw_);
+  for (int i = 0; i < video_pages; i++) {
+    const auto start = static_cast<int>(i << Memory::page_shift);
+    const auto gen = memory_.generation(video_memory + start);
+    if (gen == gens_[i]) {
+      continue;
+    }
+    gens_[i] = gen;
+    const auto end = std::min<int>(start + Memory::page_size, rows_ * row_bytes);
+    for (int row = start / row_bytes; row * row_bytes < end; row++) {
+      dirty[row] = true;
+    }
+  }
+  if (redraw_) {
+    redraw_ = false;
+    // Start from a blank screen, so only cells with something in them are sent.
+    out.append("\x1b[0m\x1b[2J");
+    attr_ = 0x07;
+    row_ = col_ = -1;
+    for (size_t i = 0; i < shown_.size(); i += 2) {
+      shown_[i] = ' ';
+      shown_[i + 1] = 0x07;
+    }
+  }
+  bool sent = !out.empty();
+  for (int row = 0; row < rows_; row++) {
+    if (!dirty[row]) {
+      continue;
+    }
+    for (int col = 0; col < cols; col++) {
+      const auto i = (row * cols + col) * 2;
+      if (!looks_same(char_at(row, col), attr_at(row, col), shown_[i], shown_[i + 1])) {
+        put(out, row, col);
+        sent = true;
+      }
+    }
+  }
+  // 0040:0050 - cursor column and row for page 0
+  const auto cursor_col = memory_.abs8(0x450);
+  const auto cursor_row = memory_.abs8(0x451);
+  if (cursor_row < rows_ && cursor_col < cols &&
+      (sent || cursor_row != cursor_.first || cursor_col != cursor_.second)) {
+    move_to(out, cursor_row, cursor_col);
+  }
+  cursor_ = {cursor_row, cursor_col};
+  return out;
+}
+
+std::string TextScreen::frame(clock::time_point now) {
+  if (frame_rate > 0 && now - last_frame_ < std::chrono::microseconds(1000000) / frame_rate) {
+    return {};
+  }
+  last_frame_ = now;
+  return update();
+}
+
+} // namespace door86::bios
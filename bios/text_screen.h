@@ -0,0 +1,87 @@
+#ifndef INCLUDED_BIOS_TEXT_SCREEN_H
+#define INCLUDED_BIOS_TEXT_SCREEN_H
+
+#include "cpu/memory.h"
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace door86::bios {
+
+/**
+ * Color text mode video memory at B800:0000 and the ANSI needed to show it
+ * to a caller.
+ *
+ * Programs write straight into video memory, so this keeps a copy of what
+ * the caller's terminal is showing and, for each frame, sends only the cells
+ * that differ from it: a cursor move when the next changed cell isn't where
+ * the cursor already is, an SGR when the attribute changes, then the
+ * characters.  Pages of video memory whose generation hasn't changed since
+ * the last frame aren't looked at.
+ */
+class TextScreen {
+public:
+  using clock = std::chrono::steady_clock;
+
+  static constexpr uint32_t video_memory = 0xB8000;
+  static constexpr int cols = 80;
+
+  explicit TextScreen(door86::cpu::Memory& memory);
+  ~TextScreen() = default;
+
+  // Frames per second sent by frame(), changes in between are coalesced.
+  int frame_rate{30};
+
+  // Text rows, 25 or 50.
+  int rows() const noexcept { return rows_; }
+  // Sets the number of rows, the next update redraws the whole screen.
+  void set_rows(int rows);
+
+  /**
+   * Returns the ANSI that brings the caller's terminal from what was last
+   * sent to what's in video memory now, ending with the cursor at the BIOS
+   * cursor position. Empty if nothing changed.
+   */
+  std::string update();
+
+  /** Returns update() if a frame is due at now, otherwise an empty string. */
+  std::string frame(clock::time_point now);
+
+  /** Forgets what the terminal shows, the next update redraws the whole screen. */
+  void invalidate();
+
+  /** Forgets where the terminal's cursor is and its colors, after other output. */
+  void forget_terminal() { row_ = col_ = attr_ = -1; }
+
+private:
+  // Moves the terminal cursor to row, col.
+  void move_to(std::string& out, int row, int col);
+  // Sets the terminal's attribute to the CGA attribute attr.
+  void set_attr(std::string& out, uint8_t attr);
+  // Sends the cell at row, col.
+  void put(std::string& out, int row, int col);
+  uint8_t char_at(int row, int col) const;
+  uint8_t attr_at(int row, int col) const;
+
+  door86::cpu::Memory& memory_;
+  int rows_{25};
+  // Character and attribute pairs as last sent.
+  std::vector<uint8_t> shown_;
+  // Generation of each page of video memory when it was last compared.
+  std::vector<uint32_t> gens_;
+  bool redraw_{false};
+  // Terminal cursor and attribute, -1 when unknown.
+  int row_{-1};
+  int col_{-1};
+  int attr_{-1};
+  // BIOS cursor row and column as of the last update.
+  std::pair<int, int> cursor_;
+  clock::time_point last_frame_{};
+};
+
+} // namespace door86::bios
+
+#endif // INCLUDED_BIOS_TEXT_SCREEN_H
@@ -0,0 +1,93 @@
+#include <gtest/gtest.h>
+
+#include "bios/text_screen.h"
+#include "cpu/memory.h"
+#include <string>
+
+using namespace door86::bios;
+using namespace door86::cpu;
+
+class TextScreenTest : public ::testing::Test {
+protected:
+  void put(int row, int col, const std::string& s, uint8_t attr = 0x07) {
+    for (const auto ch : s) {
+      const auto loc = TextScreen::video_memory + (row * TextScreen::cols + col++) * 2;
+      memory.abs8(loc, static_cast<uint8_t>(ch));
+      memory.abs8(loc + 1, attr);
+    }
+  }
+  void cursor(int row, int col) {
+    memory.abs8(0x450, static_cast<uint8_t>(col));
+    memory.abs8(0x451, static_cast<uint8_t>(row));
+  }
+
+  Memory memory{Memory::max_size};
+  TextScreen screen{memory};
+};
+
+TEST_F(TextScreenTest, NothingChanged) {
+  EXPECT_EQ("", screen.update());
+  memory.abs8(0x1000, 1);
+  EXPECT_EQ("", screen.update());
+}
+
+TEST_F(TextScreenTest, Cells) {
+  put(0, 0, "Hi");
+  EXPECT_EQ("\x1b[1H\x1b[0;37;40mHi\x1b[1H", screen.update());
+  EXPECT_EQ("", screen.update());
+
+  // Only the changed cell, and the same attribute isn't sent again.
+  put(0, 10, "!");
+  EXPECT_EQ("\x1b[10C!\x1b[1H", screen.update());
+}
+
+TEST_F(TextScreenTest, Attributes) {
+  put(2, 10, "A", 0x1e);
+  put(2, 11, "B", 0x1c);
+  put(2, 12, "C", 0x07);
+  // Yellow on blue, red keeps bold, then a reset to turn bold off.
+  EXPECT_EQ("\x1b[3;11H\x1b[0;1;33;44mA\x1b[31mB\x1b[0;37;40mC\x1b[1H", screen.update());
+}
+
+TEST_F(TextScreenTest, ShortGapsAreResent) {
+  put(5, 0, "abcdef");
+  screen.update();
+  put(5, 0, "X");
+  put(5, 3, "Y");
+  put(5, 20, "Z");
+  // bc is shorter than a cursor move.
+  EXPECT_EQ("\x1b[6HXbcY\x1b[16CZ\x1b[1H", screen.update());
+}
+
+TEST_F(TextScreenTest, Cursor) {
+  cursor(3, 4);
+  EXPECT_EQ("\x1b[4;5H", screen.update());
+  EXPECT_EQ("", screen.update());
+}
+
+TEST_F(TextScreenTest, Redraw) {
+  put(1, 0, "x");
+  screen.update();
+  screen.invalidate();
+  // Blank cells aren't sent after clearing the screen.
+  EXPECT_EQ("\x1b[0m\x1b[2J\x1b[2Hx\x1b[1H", screen.update());
+}
+
+TEST_F(TextScreenTest, FiftyRows) {
+  screen.set_rows(50);
+  screen.update();
+  put(49, 79, "!");
+  EXPECT_EQ("\x1b[50;80H!\x1b[1H", screen.update());
+}
+
+TEST_F(TextScreenTest, FrameRate) {
+  screen.frame_rate = 10;
+  const auto now = TextScreen::clock::now();
+  put(0, 0, "1");
+  EXPECT_NE("", screen.frame(now));
+  put(0, 0, "2");
+  put(0, 0, "3");
+  EXPECT_EQ("", screen.frame(now + std::chrono::milliseconds(50)));
+  // Both changes are sent as one.
+  EXPECT_EQ("3\x1b[1H", screen.frame(now + std::chrono::milliseconds(100)));
+}
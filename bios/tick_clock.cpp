@@ -0,0 +1,83 @@
+#include "bios/tick_clock.h"
+
+namespace door86::bios {
+
+using door86::cpu::x86::GuestClock;
+using std::chrono::microseconds;
+
+TickClock::TickClock(door86::cpu::Memory& memory, const GuestClock& time)
+    : mem_(memory), time_(time) {
+  for (int i = 0; i < 4; i++) {
+    mem_[bda_ticks + i] = 0;
+  }
+  update();
+  days_ = day_;
+  mem_.add_counter(bda_ticks, 5);
+  mem_.add_read_hook(bda_ticks, 5, [this](uint32_t loc) { return read(loc); });
+}
+
+void TickClock::update() {
+  const auto stored = static_cast<uint32_t>(mem_[bda_ticks] | (mem_[bda_ticks + 1] << 8) |
+                                            (mem_[bda_ticks + 2] << 16) | (mem_[bda_ticks + 3] << 24));
+  if (stored != shown_) {
+    // The program set the count.
+    set_ticks(stored);
+  }
+  updated_ = time_.now();
+  const auto local = time_.local_us();
+  day_ = local / GuestClock::us_per_day;
+  const auto us = local % GuestClock::us_per_day;
+  tick_ = static_cast<uint32_t>(us * ticks_per_day / GuestClock::us_per_day);
+  // Rounded up, so the count has changed by then.
+  const auto next_us =
+      ((tick_ + 1) * GuestClock::us_per_day + ticks_per_day - 1) / ticks_per_day;
+  next_ = updated_ + microseconds(next_us - us);
+  shown_ = (tick_ + offset_) % ticks_per_day;
+  for (int i = 0; i < 4; i++) {
+    mem_[bda_ticks + i] = static_cast<uint8_t>(shown_ >> (i * 8));
+  }
+  if (on_new_tick && reported_ != std::make_pair(day_, tick_)) {
+    reported_ = {day_, tick_};
+    on_new_tick(next_);
+  }
+}
+
+uint8_t TickClock::read(uint32_t loc) {
+  update();
+  if (loc == bda_midnight) {
+    return day_ > days_ ? 1 : 0;
+  }
+  return mem_[loc];
+}
+
+uint32_t TickClock::ticks() {
+  update();
+  return shown_;
+}
+
+void TickClock::set_ticks(uint32_t ticks) {
+  const auto local = time_.local_us();
+  days_ = local / GuestClock::us_per_day;
+  const auto tick = static_cast<uint32_t>((local % GuestClock::us_per_day) * ticks_per_day /
+                                          GuestClock::us_per_day);
+  ticks %= ticks_per_day;
+  offset_ = (ticks + ticks_per_day - tick) % ticks_per_day;
+  shown_ = ticks;
+  for (int i = 0; i < 4; i++) {
+    mem_[bda_ticks + i] = static_cast<uint8_t>(shown_ >> (i * 8));
+  }
+}
+
+bool TickClock::midnight() {
+  update();
+  const auto passed = day_ > days_;
+  days_ = day_;
+  return passed;
+}
+
+TickClock::clock::time_point TickClock::next_tick() {
+  update();
+  return next_;
+}
+
+} // namespace door86::bios
@@ -0,0 +1,71 @@
+#ifndef INCLUDED_BIOS_TICK_CLOCK_H
+#define INCLUDED_BIOS_TICK_CLOCK_H
+
+#include "bios/time_of_day.h"
+#include "cpu/memory.h"
+#include "cpu/x86/guest_clock.h"
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+
+namespace door86::bios {
+
+/**
+ * The BIOS timer tick count at 0040:006C, and the midnight flag at 0040:0070.
+ *
+ * Rather than running INT 08h 18.2 times a second to count ticks, the count
+ * is worked out from the time of day on the guest clock whenever it's read:
+ * by the program reading the BIOS data area (through a Memory read hook), or
+ * by INT 1Ah and the DOS time services. A program that writes its own value
+ * into the count keeps counting from there, same as with the real timer.
+ */
+class TickClock {
+public:
+  using clock = door86::cpu::x86::GuestClock::clock;
+
+  static constexpr uint32_t ticks_per_day = door86::bios::ticks_per_day;
+  static constexpr uint32_t bda_ticks = 0x46C;
+  static constexpr uint32_t bda_midnight = 0x470;
+
+  TickClock(door86::cpu::Memory& memory, const door86::cpu::x86::GuestClock& time);
+  ~TickClock() = default;
+  // Called when a new count is read, with when the next one starts (i.e. to
+  // wake a program spinning until it does).
+  std::function<void(clock::time_point next)> on_new_tick;
+
+  // Ticks since midnight.
+  uint32_t ticks();
+  // Sets the ticks since midnight, and clears the midnight flag.
+  void set_ticks(uint32_t ticks);
+  // Returns true if midnight has passed since the last call.
+  bool midnight();
+  // When the tick count next changes.
+  clock::time_point next_tick();
+
+private:
+  // Picks up the count if the program wrote one, then stores the current one.
+  void update();
+  uint8_t read(uint32_t loc);
+
+  door86::cpu::Memory& mem_;
+  const door86::cpu::x86::GuestClock& time_;
+  // Ticks added to the time of day, by the program setting the count.
+  uint32_t offset_{0};
+  // Time of day in ticks, and days since 1970, as of the last update.
+  uint32_t tick_{0};
+  int64_t day_{0};
+  // Guest time of the last update, and when the tick after it starts.
+  clock::time_point updated_{};
+  clock::time_point next_{};
+  // Count left in the BIOS data area by the last update.
+  uint32_t shown_{0};
+  // day_ as of the last call to midnight.
+  int64_t days_{0};
+  // tick_ and day_ when on_new_tick was last called.
+  std::pair<int64_t, uint32_t> reported_{-1, 0};
+};
+
+} // namespace door86::bios
+
+#endif // INCLUDED_BIOS_TICK_CLOCK_H
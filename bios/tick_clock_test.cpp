@@ -0,0 +1,90 @@
+#include <gtest/gtest.h>
+
+#include "bios/tick_clock.h"
+#include "cpu/memory.h"
+#include "cpu/x86/guest_clock.h"
+#include <chrono>
+
+using namespace door86::bios;
+using namespace door86::cpu;
+using namespace door86::cpu::x86;
+using namespace std::chrono_literals;
+
+class TickClockTest : public ::testing::Test {
+protected:
+  void run_for(std::chrono::microseconds us) {
+    cycles += static_cast<uint64_t>(us.count()) * GuestClock::cpu_hz / 1000000;
+  }
+
+  static GuestClock& virtual_time(GuestClock& time) {
+    // Starts at midnight.
+    time.set_virtual();
+    return time;
+  }
+
+  uint64_t cycles{0};
+  GuestClock time{cycles};
+  Memory mem{0x10000};
+  TickClock clock{mem, virtual_time(time)};
+};
+
+TEST_F(TickClockTest, CountsWhenRead) {
+  EXPECT_EQ(0u, clock.ticks());
+  run_for(1s);
+  EXPECT_EQ(18u, clock.ticks());
+  run_for(9s);
+  // 18.2 a second.
+  EXPECT_EQ(182u, mem.abs16(TickClock::bda_ticks));
+  EXPECT_EQ(0, mem.abs16(TickClock::bda_ticks + 2));
+}
+
+TEST_F(TickClockTest, ProgramSetsCount) {
+  mem.abs16(TickClock::bda_ticks, 1000);
+  // Counts on from when it's next read.
+  EXPECT_EQ(1000u, clock.ticks());
+  run_for(1s);
+  EXPECT_EQ(1018u, clock.ticks());
+}
+
+TEST_F(TickClockTest, Midnight) {
+  time.advance_to(time.now() + 24h - 100ms);
+  EXPECT_EQ(TickClock::ticks_per_day - 2, clock.ticks());
+  EXPECT_EQ(0, mem.abs8(TickClock::bda_midnight));
+  run_for(1s);
+  EXPECT_EQ(16u, clock.ticks());
+  EXPECT_EQ(1, mem.abs8(TickClock::bda_midnight));
+  EXPECT_TRUE(clock.midnight());
+  EXPECT_FALSE(clock.midnight());
+  EXPECT_EQ(0, mem.abs8(TickClock::bda_midnight));
+}
+
+TEST_F(TickClockTest, NextTick) {
+  run_for(10ms);
+  const auto next = clock.next_tick();
+  EXPECT_GT(next, time.now());
+  time.advance_to(next - 1us);
+  EXPECT_EQ(0u, clock.ticks());
+  time.advance_to(next);
+  EXPECT_EQ(1u, clock.ticks());
+}
+
+TEST_F(TickClockTest, NewTick) {
+  int calls = 0;
+  clock.on_new_tick = [&calls](TickClock::clock::time_point) { ++calls; };
+  clock.ticks();
+  mem.abs8(TickClock::bda_ticks);
+  EXPECT_EQ(1, calls);
+  run_for(100ms);
+  clock.ticks();
+  EXPECT_EQ(2, calls);
+}
+
+TEST(TickClockTimeTest, TimeOfDay) {
+  const auto t = time_of_day(ticks_per_day - 1);
+  EXPECT_EQ(23, t.hour);
+  EXPECT_EQ(59, t.minute);
+  EXPECT_EQ(59, t.second);
+  const auto noon = time_of_day(ticks_per_day / 2);
+  EXPECT_EQ(12, noon.hour);
+  EXPECT_EQ(0, noon.minute);
+}
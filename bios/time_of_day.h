@@ -0,0 +1,29 @@
+#ifndef INCLUDED_BIOS_TIME_OF_DAY_H
+#define INCLUDED_BIOS_TIME_OF_DAY_H
+
+#include <cstdint>
+
+namespace door86::bios {
+
+// 18.2 a second, the 8253 input clock over 65536, which the BIOS counts as
+// exactly a day.
+static constexpr uint32_t ticks_per_day = 0x1800B0;
+
+struct time_of_day_t {
+  uint8_t hour;
+  uint8_t minute;
+  uint8_t second;
+  uint8_t hundredths;
+};
+
+// Time of day for a BIOS tick count, as DOS works it out from the CLOCK$ device.
+inline time_of_day_t time_of_day(uint32_t ticks) {
+  // Like DOS, a day of ticks is exactly 24 hours (it's really a few hundredths short).
+  const auto hundredths = static_cast<uint64_t>(ticks % ticks_per_day) * 8640000 / ticks_per_day;
+  return {static_cast<uint8_t>(hundredths / 360000), static_cast<uint8_t>(hundredths / 6000 % 60),
+          static_cast<uint8_t>(hundredths / 100 % 60), static_cast<uint8_t>(hundredths % 100)};
+}
+
+} // namespace door86::bios
+
+#endif // INCLUDED_BIOS_TIME_OF_DAY_H
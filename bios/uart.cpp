@@ -0,0 +1,260 @@
+#include "bios/uart.h"
+
+#include "core/log.h"
+#include "fmt/format.h"
+
+namespace door86::bios {
+
+using door86::cpu::x86::CPU;
+using door86::cpu::x86::stop_reason_t;
+
+// IIR interrupt identification, highest priority first.
+static constexpr uint8_t iir_rda = 0x04;
+static constexpr uint8_t iir_timeout = 0x0C;
+static constexpr uint8_t iir_thre = 0x02;
+static constexpr uint8_t iir_msr = 0x00;
+static constexpr uint8_t iir_none = 0x01;
+
+// LSR
+static constexpr uint8_t lsr_dr = 0x01;
+static constexpr uint8_t lsr_thre = 0x20;
+static constexpr uint8_t lsr_temt = 0x40;
+
+// MCR
+static constexpr uint8_t mcr_out2 = 0x08;
+
+// Size of the 16550's FIFOs, which is all loopback mode holds.
+static constexpr size_t fifo_size = 16;
+
+// COM1-4 base ports, in the order of their BIOS data area entries.
+static constexpr uint16_t com_bases[]{0x3F8, 0x2F8, 0x3E8, 0x2E8};
+static constexpr uint32_t bda_com_ports = 0x400;
+static constexpr uint32_t bda_equipment = 0x410;
+
+Uart::Uart(CPU* cpu, uint16_t base, int irq, size_t buffer_size)
+    : cpu_(cpu), base_(base), irq_(irq), link_(buffer_size) {
+  kick_at_ = link_.tx().capacity() / 4;
+  cpu_->io.add_ports(
+      base_, 8, [this](uint16_t port) { return read(port); },
+      [this](uint16_t port, uint8_t value) { write(port, value); });
+  on_input = [this] { cpu_->idle.wake(); };
+  link_.on_input = [this] { on_input(); };
+  cpu_->add_slice_handler([this](CPU& cpu, stop_reason_t reason) {
+    // Otherwise the program stays parked until something else wakes it.
+    if (update() && reason == stop_reason_t::waiting) {
+      cpu.idle.wake();
+    }
+  });
+  msr_ = modem_lines();
+  // Programs find the port through its BIOS data area entry, and the count of
+  // serial ports in the equipment word.
+  auto& m = cpu_->memory;
+  int ports = 0;
+  for (int i = 0; i < 4; i++) {
+    const auto entry = bda_com_ports + i * 2;
+    if (com_bases[i] == base_) {
+      m.abs16(entry, base_);
+    }
+    if (m.abs16(entry) != 0) {
+      ++ports;
+    }
+  }
+  m.abs16(bda_equipment, static_cast<uint16_t>((m.abs16(bda_equipment) & ~0x0E00) | (ports << 9)));
+}
+
+size_t Uart::rx_size() const { return loopback() ? loopback_.size() : link_.rx().size(); }
+
+bool Uart::tx_ready() const {
+  return loopback() || !link_.carrier() || link_.tx().free() > 0;
+}
+
+uint8_t Uart::receive() {
+  uint8_t value = 0;
+  if (loopback()) {
+    if (!loopback_.empty()) {
+      value = loopback_.front();
+      loopback_.pop_front();
+    }
+    return value;
+  }
+  link_.rx().read(&value, 1);
+  return value;
+}
+
+void Uart::transmit(uint8_t value) {
+  if (loopback()) {
+    if (loopback_.size() < fifo_size) {
+      loopback_.push_back(value);
+    }
+    return;
+  }
+  if (!link_.carrier()) {
+    // Nothing's connected, so it goes out onto the line and is gone.
+    return;
+  }
+  auto& tx = link_.tx();
+  if (tx.write(&value, 1) == 0) {
+    // Overrun, the program didn't wait for THRE.
+    VLOG(1) << fmt::format("UART {:03X} transmit overrun.", base_);
+  }
+  if (tx.free() == 0) {
+    tx_full_ = true;
+  }
+  // Only once as it goes past, or it'd be a system call a byte.
+  if (tx.size() == kick_at_) {
+    link_.kick();
+  }
+}
+
+uint8_t Uart::modem_lines() const {
+  if (loopback()) {
+    // RTS to CTS, DTR to DSR, OUT1 to RI and OUT2 to DCD.
+    return static_cast<uint8_t>(((mcr_ & 0x02) << 3) | ((mcr_ & 0x01) << 5) | ((mcr_ & 0x0C) << 4));
+  }
+  // CTS, DSR and DCD while connected.
+  return link_.carrier() ? 0xB0 : 0x00;
+}
+
+void Uart::update_msr() {
+  const auto lines = modem_lines();
+  const auto changed = static_cast<uint8_t>((lines ^ msr_) & 0xF0);
+  // DCTS, DDSR and DDCD on any change, TERI only at the end of a ring.
+  auto deltas = static_cast<uint8_t>(((changed & 0x30) >> 4) | ((changed & 0x80) >> 4));
+  if ((msr_ & 0x40) && !(lines & 0x40)) {
+    deltas |= 0x04;
+  }
+  msr_ = static_cast<uint8_t>(lines | (msr_ & 0x0F) | deltas);
+}
+
+uint8_t Uart::lsr() const {
+  uint8_t value = 0;
+  if (rx_size() > 0) {
+    value |= lsr_dr;
+  }
+  if (tx_ready()) {
+    value |= lsr_thre;
+  }
+  if (loopback() || !link_.carrier() || link_.tx().empty()) {
+    value |= lsr_temt;
+  }
+  return value;
+}
+
+uint8_t Uart::pending() const {
+  // Receiver line status (errors and break) never happens.
+  if ((ier_ & ier_rda) && rx_size() > 0) {
+    static constexpr size_t trigger[4]{1, 4, 8, 14};
+    return fifo() && rx_size() < trigger[fcr_ >> 6] ? iir_timeout : iir_rda;
+  }
+  if ((ier_ & ier_thre) && thre_ && tx_ready()) {
+    return iir_thre;
+  }
+  if ((ier_ & ier_msr) && (msr_ & 0x0F)) {
+    return iir_msr;
+  }
+  return iir_none;
+}
+
+bool Uart::update_irq() {
+  // OUT2 enables the IRQ line on a PC, and loopback disconnects it.
+  const auto line = pending() != iir_none && (mcr_ & mcr_out2) && !loopback();
+  const auto raised = line && !irq_line_;
+  irq_line_ = line;
+  if (raised) {
+    cpu_->pic.raise(irq_);
+  }
+  return raised;
+}
+
+bool Uart::update() {
+  if (!link_.tx().empty()) {
+    link_.kick();
+  }
+  if (tx_full_ && tx_ready()) {
+    // THR emptied.
+    tx_full_ = false;
+    thre_ = true;
+  }
+  update_msr();
+  return update_irq();
+}
+
+uint8_t Uart::read(uint16_t port) {
+  uint8_t value = 0;
+  switch (port - base_) {
+  case reg_data: value = dlab() ? static_cast<uint8_t>(divisor_ & 0xff) : receive(); break;
+  case reg_ier: value = dlab() ? static_cast<uint8_t>(divisor_ >> 8) : ier_; break;
+  case reg_iir:
+    update_msr();
+    value = pending();
+    // Reading IIR is what acknowledges THRE.
+    if (value == iir_thre) {
+      thre_ = false;
+    }
+    if (fifo()) {
+      value |= 0xC0;
+    }
+    break;
+  case reg_lcr: value = lcr_; break;
+  case reg_mcr: value = mcr_; break;
+  case reg_lsr: value = lsr(); break;
+  case reg_msr:
+    update_msr();
+    value = msr_;
+    msr_ &= 0xF0;
+    break;
+  case reg_scr: value = scr_; break;
+  }
+  update_irq();
+  return value;
+}
+
+void Uart::write(uint16_t port, uint8_t value) {
+  switch (port - base_) {
+  case reg_data:
+    if (dlab()) {
+      divisor_ = static_cast<uint16_t>((divisor_ & 0xff00) | value);
+      break;
+    }
+    transmit(value);
+    // Writing THR clears THRE, and it's sent straight away so THR is empty
+    // again unless the ring filled up. Dropping the line in between is the
+    // edge for the next interrupt.
+    thre_ = false;
+    update_irq();
+    thre_ = tx_ready();
+    break;
+  case reg_ier:
+    if (dlab()) {
+      divisor_ = static_cast<uint16_t>((divisor_ & 0x00ff) | (value << 8));
+      break;
+    }
+    // Enabling THRE with THR empty interrupts right away.
+    if (!(ier_ & ier_thre) && (value & ier_thre) && tx_ready()) {
+      thre_ = true;
+    }
+    ier_ = value & 0x0F;
+    break;
+  case reg_iir:
+    if (value & 0x02) {
+      link_.rx().clear();
+      loopback_.clear();
+    }
+    if (value & 0x04) {
+      link_.purge_tx();
+    }
+    fcr_ = value & 0xC1;
+    break;
+  case reg_lcr: lcr_ = value; break;
+  case reg_mcr:
+    mcr_ = value & 0x1F;
+    update_msr();
+    break;
+  case reg_scr: scr_ = value; break;
+  // LSR and MSR are read only.
+  default: break;
+  }
+  update_irq();
+}
+
+} // namespace door86::bios
@@ -0,0 +1,139 @@
+#ifndef INCLUDED_BIOS_UART_H
+#define INCLUDED_BIOS_UART_H
+
+#include "bios/serial_link.h"
+#include "cpu/x86/cpu.h"
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+
+namespace door86::bios {
+
+/**
+ * A 16550A UART, for programs that drive the COM port directly through its
+ * registers (COM1 at 3F8h-3FFh on IRQ 4 by default) rather than through
+ * FOSSIL.
+ *
+ * The UART's FIFOs are the rings of a SerialLink, so reading RBR or LSR and
+ * writing THR only touch memory shared with the IO thread and never make a
+ * system call. A program sending a byte at a time after polling LSR for THRE
+ * just fills the transmit ring, which is handed to the IO thread in one go
+ * at the end of the slice, or as soon as a quarter of it is waiting. The
+ * line runs as fast as the connection does; the divisor latch is kept but
+ * doesn't slow anything down.
+ * With nothing connected (or once carrier drops), transmitted bytes are
+ * thrown away as a real UART sends them onto a dead line, so THR keeps
+ * emptying for a program that polls for it.
+ *
+ * Interrupts are raised on the PIC when enabled in IER and OUT2 is set in
+ * MCR, as on a PC. Bytes arriving from the IO thread are noticed between
+ * slices. With the FIFOs enabled, a receive FIFO holding less than the
+ * trigger level reports a character timeout straight away rather than after
+ * four character times. Loopback mode is supported (the diagnostic programs
+ * use to find a UART); line errors and break never happen.
+ */
+class Uart {
+public:
+  static constexpr uint16_t com1_base = 0x3F8;
+  static constexpr int com1_irq = 4;
+
+  // Register offsets from the base port.
+  static constexpr uint16_t reg_data = 0;  // RBR, THR (DLL with DLAB)
+  static constexpr uint16_t reg_ier = 1;   // (DLM with DLAB)
+  static constexpr uint16_t reg_iir = 2;   // IIR, FCR
+  static constexpr uint16_t reg_lcr = 3;
+  static constexpr uint16_t reg_mcr = 4;
+  static constexpr uint16_t reg_lsr = 5;
+  static constexpr uint16_t reg_msr = 6;
+  static constexpr uint16_t reg_scr = 7;
+
+  explicit Uart(door86::cpu::x86::CPU* cpu, uint16_t base = com1_base, int irq = com1_irq,
+                size_t buffer_size = 0x2000);
+  ~Uart() = default;
+  Uart(const Uart&) = delete;
+  Uart& operator=(const Uart&) = delete;
+
+  /**
+   * Starts the IO thread moving received bytes from in_fd and transmitted bytes
+   * to out_fd, which may be the same descriptor (i.e. a socket).
+   * Returns false if that isn't supported on this platform.
+   */
+  bool attach(int in_fd, int out_fd) {
+    // Input typed live, see IdleDetector::live_input.
+    cpu_->idle.live_input = link_.attach(in_fd, out_fd);
+    return cpu_->idle.live_input;
+  }
+  /** Stops the IO thread. */
+  void detach() { link_.detach(); }
+
+  // Called on the IO thread when bytes arrive, transmit space frees up or
+  // carrier is lost. Wakes the CPU's idle detector by default, sessions run
+  // by a scheduler should wake the session.
+  std::function<void()> on_input;
+
+  uint8_t read(uint16_t port);
+  void write(uint16_t port, uint8_t value);
+
+  /**
+   * Hands waiting transmit bytes to the IO thread, and picks up what it did
+   * (bytes received, transmit space, carrier). Called at the end of every
+   * slice, returns true if that raised the IRQ.
+   */
+  bool update();
+
+  SerialLink& link() noexcept { return link_; }
+
+private:
+  // Bits of IER, and the interrupt identification in IIR.
+  static constexpr uint8_t ier_rda = 0x01;
+  static constexpr uint8_t ier_thre = 0x02;
+  static constexpr uint8_t ier_rls = 0x04;
+  static constexpr uint8_t ier_msr = 0x08;
+
+  bool dlab() const noexcept { return lcr_ & 0x80; }
+  bool loopback() const noexcept { return mcr_ & 0x10; }
+  bool fifo() const noexcept { return fcr_ & 0x01; }
+  // Bytes waiting to be read.
+  size_t rx_size() const;
+  // Space to transmit into.
+  bool tx_ready() const;
+  uint8_t receive();
+  void transmit(uint8_t value);
+  // Modem status bits 4-7 as things are now.
+  uint8_t modem_lines() const;
+  // Sets the modem status delta bits for lines that changed.
+  void update_msr();
+  uint8_t lsr() const;
+  // The highest priority pending interrupt as IIR bits 0-3 (1 for none).
+  uint8_t pending() const;
+  // Raises the IRQ when the interrupt output goes high, returns true if it did.
+  bool update_irq();
+
+  door86::cpu::x86::CPU* cpu_;
+  uint16_t base_;
+  int irq_;
+  SerialLink link_;
+  // Bytes written in loopback mode, waiting to be read back.
+  std::deque<uint8_t> loopback_;
+  uint16_t divisor_{12};  // 9600 baud
+  uint8_t ier_{0};
+  uint8_t fcr_{0};
+  uint8_t lcr_{0x03};  // 8N1
+  uint8_t mcr_{0};
+  uint8_t msr_{0};
+  uint8_t scr_{0};
+  // THR went empty since IIR last reported it, or THR was written.
+  bool thre_{true};
+  // Transmit ring was full at the last update.
+  bool tx_full_{false};
+  // Interrupt output as of the last update_irq.
+  bool irq_line_{false};
+  // Transmit ring size at which the IO thread is kicked without waiting for
+  // the end of the slice.
+  size_t kick_at_;
+};
+
+} // namespace door86::bios
+
+#endif // INCLUDED_BIOS_UART_H
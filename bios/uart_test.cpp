@@ -0,0 +1,178 @@
+#include <gtest/gtest.h>
+
+#include "bios/uart.h"
+#include "cpu/x86/cpu.h"
+#include <chrono>
+#include <string>
+#include <thread>
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+using namespace door86::bios;
+using namespace door86::cpu::x86;
+
+class UartTest : public ::testing::Test {
+protected:
+  uint8_t in(uint16_t reg) { return cpu.io.inb(Uart::com1_base + reg); }
+  void out(uint16_t reg, uint8_t value) { cpu.io.outb(Uart::com1_base + reg, value); }
+  // Unmasks IRQ 4 on the PIC.
+  void unmask() { cpu.io.outb(0x21, cpu.pic.imr() & ~0x10); }
+  bool irq4() const { return cpu.pic.irr() & 0x10; }
+
+  CPU cpu;
+  Uart uart{&cpu};
+};
+
+TEST_F(UartTest, Registers) {
+  // Transmitter empty, nothing received.
+  EXPECT_EQ(0x60, in(Uart::reg_lsr));
+  EXPECT_EQ(0x01, in(Uart::reg_iir));
+  out(Uart::reg_scr, 0x5A);
+  EXPECT_EQ(0x5A, in(Uart::reg_scr));
+  // 2400 baud through the divisor latch.
+  out(Uart::reg_lcr, 0x83);
+  out(Uart::reg_data, 0x30);
+  out(Uart::reg_ier, 0x00);
+  EXPECT_EQ(0x30, in(Uart::reg_data));
+  out(Uart::reg_lcr, 0x03);
+  EXPECT_EQ(0x00, in(Uart::reg_ier));
+  // A 16550A with working FIFOs.
+  out(Uart::reg_iir, 0xC7);
+  EXPECT_EQ(0xC1, in(Uart::reg_iir));
+}
+
+TEST_F(UartTest, Loopback) {
+  out(Uart::reg_mcr, 0x10);
+  in(Uart::reg_msr);
+  // RTS and OUT1 show up as CTS and RI.
+  out(Uart::reg_mcr, 0x16);
+  EXPECT_EQ(0x51, in(Uart::reg_msr));
+  EXPECT_EQ(0x50, in(Uart::reg_msr));
+  out(Uart::reg_data, 'A');
+  EXPECT_EQ(0x61, in(Uart::reg_lsr));
+  EXPECT_EQ('A', in(Uart::reg_data));
+  EXPECT_EQ(0x60, in(Uart::reg_lsr));
+}
+
+TEST_F(UartTest, ThreInterrupt) {
+  unmask();
+  out(Uart::reg_mcr, 0x08);
+  out(Uart::reg_ier, 0x02);
+  EXPECT_TRUE(irq4());
+  EXPECT_EQ(0x0C, cpu.pic.acknowledge());
+  EXPECT_EQ(0x02, in(Uart::reg_iir));
+  EXPECT_EQ(0x01, in(Uart::reg_iir));
+  cpu.pic.end_of_interrupt();
+  // THR empties again once the byte's sent.
+  out(Uart::reg_data, 'x');
+  EXPECT_TRUE(irq4());
+}
+
+TEST_F(UartTest, NoInterruptWithoutOut2) {
+  unmask();
+  out(Uart::reg_ier, 0x02);
+  EXPECT_EQ(0x02, in(Uart::reg_iir));
+  EXPECT_FALSE(irq4());
+}
+
+TEST_F(UartTest, BiosDataArea) {
+  EXPECT_EQ(Uart::com1_base, cpu.memory.abs16(0x400));
+  // One serial port in the equipment word.
+  EXPECT_EQ(0x0200, cpu.memory.abs16(0x410) & 0x0E00);
+}
+
+TEST_F(UartTest, TransmitWithoutCarrier) {
+  // Far more than the transmit ring holds, and THR keeps emptying.
+  for (int i = 0; i < 0x4000; i++) {
+    ASSERT_TRUE(in(Uart::reg_lsr) & 0x20);
+    out(Uart::reg_data, static_cast<uint8_t>(i));
+  }
+  EXPECT_EQ(0x60, in(Uart::reg_lsr));
+  EXPECT_TRUE(uart.link().tx().empty());
+}
+
+#ifndef _WIN32
+
+class UartLinkTest : public UartTest {
+protected:
+  void SetUp() override {
+    ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+    ASSERT_TRUE(uart.attach(fds[0], fds[0]));
+  }
+  void TearDown() override {
+    uart.detach();
+    close(fds[0]);
+    close(fds[1]);
+  }
+
+  // Waits for the IO thread to receive n bytes.
+  bool wait_for_rx(size_t n) {
+    for (int i = 0; i < 500 && uart.link().rx().size() < n; i++) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+    return uart.link().rx().size() >= n;
+  }
+
+  std::string remote_read(size_t n) {
+    std::string s;
+    char buf[256];
+    while (s.size() < n) {
+      const auto got = read(fds[1], buf, std::min(sizeof(buf), n - s.size()));
+      if (got <= 0) {
+        break;
+      }
+      s.append(buf, got);
+    }
+    return s;
+  }
+
+  int fds[2]{-1, -1};
+};
+
+TEST_F(UartLinkTest, TransmitIsBatched) {
+  // Once the IO thread has received something it's back waiting in poll.
+  ASSERT_EQ(1, write(fds[1], "x", 1));
+  ASSERT_TRUE(wait_for_rx(1));
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  uart.update();
+  // Carrier, DSR and CTS.
+  EXPECT_EQ(0xBB, in(Uart::reg_msr));
+  for (const char c : std::string("Hello")) {
+    ASSERT_TRUE(in(Uart::reg_lsr) & 0x20);
+    out(Uart::reg_data, static_cast<uint8_t>(c));
+  }
+  EXPECT_FALSE(in(Uart::reg_lsr) & 0x40);
+  // Nothing goes out until the end of the slice.
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  char buf[8];
+  EXPECT_EQ(-1, recv(fds[1], buf, sizeof(buf), MSG_DONTWAIT));
+  cpu.end_slice(stop_reason_t::budget);
+  EXPECT_EQ("Hello", remote_read(5));
+}
+
+TEST_F(UartLinkTest, ReceiveInterrupt) {
+  unmask();
+  out(Uart::reg_iir, 0xC1);
+  out(Uart::reg_mcr, 0x0B);
+  out(Uart::reg_ier, 0x01);
+  EXPECT_FALSE(irq4());
+  ASSERT_EQ(3, write(fds[1], "abc", 3));
+  ASSERT_TRUE(wait_for_rx(3));
+  // Noticed at the end of the slice.
+  EXPECT_TRUE(uart.update());
+  EXPECT_TRUE(irq4());
+  EXPECT_TRUE(in(Uart::reg_lsr) & 0x01);
+  // Under the trigger level of 14, so a character timeout.
+  EXPECT_EQ(0xCC, in(Uart::reg_iir));
+  std::string got;
+  while (in(Uart::reg_lsr) & 0x01) {
+    got.push_back(static_cast<char>(in(Uart::reg_data)));
+  }
+  EXPECT_EQ("abc", got);
+  EXPECT_EQ(0xC1, in(Uart::reg_iir));
+}
+
+#endif
@@ -1,22 +1,66 @@
 #include "cpu/io.h"
 
 #include "core/log.h"
-#include <cstring>
+#include "fmt/format.h"
 
 namespace door86::cpu {
 
+void IO::add_ports(uint16_t first, uint16_t count, in_fn in, out_fn out, in16_fn in16,
+                   out16_fn out16) {
+  CHECK(devices_.size() < 256) << "Too many IO devices";
+  const auto index = static_cast<uint8_t>(devices_.size());
+  devices_.push_back({std::move(in), std::move(out), std::move(in16), std::move(out16)});
+  for (uint32_t port = first; port < static_cast<uint32_t>(first) + count; port++) {
+    auto& page = pages_[port >> 8];
+    if (!page) {
+      page = std::make_unique<page_t>();
+      page->fill(0);
+    }
+    (*page)[port & 0xff] = index;
+  }
+}
+
+IO::port_stats_t& IO::unclaimed(uint16_t port) {
+  auto [it, inserted] = unclaimed_.try_emplace(port);
+  if (inserted) {
+    VLOG(1) << fmt::format("Unclaimed IO port: {:04X}", port);
+  }
+  return it->second;
+}
+
 uint8_t IO::inb(uint16_t port) {
-  LOG(INFO) << "Called inb(" << std::hex << port << ")";
-  return 0;
+  if (const auto d = device(port)) {
+    return devices_[d].in(port);
+  }
+  ++unclaimed(port).reads;
+  return 0xFF;
 }
 
 uint16_t IO::inw(uint16_t port) {
-  LOG(INFO) << "Called inw(" << std::hex << port << ")";
-  return 0;
+  const auto next = static_cast<uint16_t>(port + 1);
+  if (const auto d = device(port); d && devices_[d].in16) {
+    return devices_[d].in16(port);
+  }
+  return static_cast<uint16_t>(inb(port) | (inb(next) << 8));
 }
 
-void IO::outb(uint16_t port, uint8_t value) { LOG(INFO) << "Called outb(" << port << ", " << value << ")"; }
+void IO::outb(uint16_t port, uint8_t value) {
+  ++outputs_;
+  if (const auto d = device(port)) {
+    devices_[d].out(port, value);
+    return;
+  }
+  ++unclaimed(port).writes;
+}
 
-void IO::outw(uint16_t port, uint16_t value) { LOG(INFO) << "Called outw(" << port << ", " << value << ")"; }
+void IO::outw(uint16_t port, uint16_t value) {
+  if (const auto d = device(port); d && devices_[d].out16) {
+    ++outputs_;
+    devices_[d].out16(port, value);
+    return;
+  }
+  outb(port, static_cast<uint8_t>(value));
+  outb(static_cast<uint16_t>(port + 1), static_cast<uint8_t>(value >> 8));
+}
 
-} // namespace door86::cpu
\ No newline at end of file
+} // namespace door86::cpu
@@ -1,25 +1,86 @@
 #ifndef INCLUDED_CPU_IO_H
 #define INCLUDED_CPU_IO_H
 
+#include <array>
 #include <cstdint>
+#include <functional>
+#include <memory>
 #include <type_traits>
+#include <unordered_map>
+#include <vector>
 
 namespace door86::cpu {
 
 /**
  * IO Subsystem.
+ *
+ * Devices register handlers for the ports they decode, and IN and OUT look
+ * the port up in a two level table (256 pages of 256 ports, only allocated
+ * once a device claims a port in them) and call the device's handler. Ports
+ * no device claimed read as FFh, like an empty bus, and accesses to them are
+ * only counted (see unclaimed) since programs probe for hardware in loops.
  */
 class IO {
   public: 
+    // Handlers a device registers for its ports, called with the port accessed.
+    using in_fn = std::function<uint8_t(uint16_t port)>;
+    using out_fn = std::function<void(uint16_t port, uint8_t value)>;
+    using in16_fn = std::function<uint16_t(uint16_t port)>;
+    using out16_fn = std::function<void(uint16_t port, uint16_t value)>;
+
+    struct port_stats_t {
+      uint64_t reads{0};
+      uint64_t writes{0};
+    };
+
     IO() = default;
     ~IO() = default;
+    IO(const IO&) = delete;
+    IO& operator=(const IO&) = delete;
 
     uint8_t inb(uint16_t port);
     uint16_t inw(uint16_t port);
 
     void outb(uint16_t port, uint8_t value);
     void outw(uint16_t port, uint16_t value);
+
+    // Sends reads and writes of the count ports starting at first to a device.
+    // Word accesses are two byte accesses, low byte first, unless in16 and
+    // out16 are given.
+    void add_ports(uint16_t first, uint16_t count, in_fn in, out_fn out, in16_fn in16 = nullptr,
+                   out16_fn out16 = nullptr);
+    // true if a device has claimed port.
+    bool claimed(uint16_t port) const { return device(port) != 0; }
+
+    // Number of outb and outw calls. Reads are only polling and don't count.
+    uint64_t outputs() const noexcept { return outputs_; }
+    // Accesses to ports no device claimed, by port.
+    const std::unordered_map<uint16_t, port_stats_t>& unclaimed() const noexcept {
+      return unclaimed_;
+    }
+
+  private:
+    struct device_t {
+      in_fn in;
+      out_fn out;
+      in16_fn in16;
+      out16_fn out16;
+    };
+    using page_t = std::array<uint8_t, 256>;
+
+    // Index into devices_ for port, 0 if it isn't claimed.
+    uint8_t device(uint16_t port) const {
+      const auto& page = pages_[port >> 8];
+      return page ? (*page)[port & 0xff] : 0;
+    }
+    port_stats_t& unclaimed(uint16_t port);
+
+    // devices_[0] is no device.
+    std::vector<device_t> devices_{1};
+    std::array<std::unique_ptr<page_t>, 256> pages_;
+    std::unordered_map<uint16_t, port_stats_t> unclaimed_;
+    uint64_t outputs_{0};
 };
 }
 
-#endif
\ No newline at end of file
+#endif
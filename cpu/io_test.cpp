@@ -0,0 +1,68 @@
+#include <gtest/gtest.h>
+
+#include "cpu/io.h"
+#include <string>
+#include <vector>
+
+using namespace door86::cpu;
+
+class IOTest : public ::testing::Test {
+protected:
+  IOTest() {
+    io.add_ports(
+        0x3F8, 8, [](uint16_t port) { return static_cast<uint8_t>(port - 0x3F8 + 0x10); },
+        [this](uint16_t port, uint8_t value) { written.emplace_back(port, value); });
+  }
+
+  IO io;
+  std::vector<std::pair<uint16_t, uint8_t>> written;
+};
+
+TEST_F(IOTest, Dispatch) {
+  EXPECT_TRUE(io.claimed(0x3F8));
+  EXPECT_TRUE(io.claimed(0x3FF));
+  EXPECT_FALSE(io.claimed(0x400));
+  EXPECT_EQ(0x15, io.inb(0x3FD));
+  io.outb(0x3F9, 0x42);
+  ASSERT_EQ(1u, written.size());
+  EXPECT_EQ(0x3F9, written.front().first);
+  EXPECT_EQ(0x42, written.front().second);
+  EXPECT_EQ(1u, io.outputs());
+  EXPECT_TRUE(io.unclaimed().empty());
+}
+
+TEST_F(IOTest, Words) {
+  // Two byte accesses, low first.
+  EXPECT_EQ(0x1110, io.inw(0x3F8));
+  io.outw(0x3FA, 0x1234);
+  ASSERT_EQ(2u, written.size());
+  EXPECT_EQ(0x3FA, written[0].first);
+  EXPECT_EQ(0x34, written[0].second);
+  EXPECT_EQ(0x3FB, written[1].first);
+  EXPECT_EQ(0x12, written[1].second);
+}
+
+TEST_F(IOTest, WordHandlers) {
+  uint16_t got = 0;
+  io.add_ports(
+      0x1F0, 1, [](uint16_t) { return static_cast<uint8_t>(0xAA); }, [](uint16_t, uint8_t) {},
+      [](uint16_t) { return static_cast<uint16_t>(0xBEEF); },
+      [&got](uint16_t, uint16_t value) { got = value; });
+  EXPECT_EQ(0xBEEF, io.inw(0x1F0));
+  io.outw(0x1F0, 0x1234);
+  EXPECT_EQ(0x1234, got);
+}
+
+TEST_F(IOTest, Unclaimed) {
+  // An empty bus.
+  EXPECT_EQ(0xFF, io.inb(0x2F8));
+  EXPECT_EQ(0xFF, io.inb(0x2F8));
+  io.outb(0x2F8, 1);
+  io.outb(0x378, 1);
+  ASSERT_EQ(2u, io.unclaimed().size());
+  EXPECT_EQ(2u, io.unclaimed().at(0x2F8).reads);
+  EXPECT_EQ(1u, io.unclaimed().at(0x2F8).writes);
+  EXPECT_EQ(1u, io.unclaimed().at(0x378).writes);
+  // Still counted as output, it could be to hardware we don't have.
+  EXPECT_EQ(2u, io.outputs());
+}
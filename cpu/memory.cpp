@@ -1,5 +1,6 @@
 #include "cpu/memory.h"
 
+#include <algorithm>
 #include <cstring>
 
 namespace door86::cpu {
@@ -14,21 +15,58 @@ static inline uint32_t abs_memory(uint16_t seg, uint16_t off) {
 }
 
 Memory::Memory(int size) : size_(size) { 
-  mem_ = new uint8_t[size];
-  memset(mem_, 0, size);
+  // Whole pages, so the last one can be accessed through its host pointer.
+  const auto alloc = (size + page_mask) & ~page_mask;
+  mem_ = new uint8_t[alloc];
+  memset(mem_, 0, alloc);
+  map_pages();
+}
+
+Memory::Memory(std::shared_ptr<const MemoryImage> base)
+    : size_(base->size()), base_(std::move(base)) {
+  mem_ = base_->map();
+  CHECK(mem_ != nullptr) << "Unable to map memory image";
+  map_pages();
+}
+
+void Memory::map_pages() {
+  CHECK_LE(size_, static_cast<int>(max_size));
+  pages_.resize(page_count);
+  const auto ram_pages = (size_ + page_mask) >> page_shift;
+  for (uint32_t page = 0; page < ram_pages; ++page) {
+    pages_[page].read = pages_[page].write = mem_ + (page << page_shift);
+  }
 }
 
 Memory::~Memory() {
-  delete mem_;
+  if (base_) {
+    MemoryImage::unmap(mem_, size_);
+  } else {
+    delete[] mem_;
+  }
   mem_ = nullptr;
 }
 
+void Memory::copy_in(size_t start, const uint8_t* src, size_t size) {
+  while (size > 0) {
+    // Up to the end of this page.
+    const auto n = std::min<size_t>(size, page_size - (start & (page_size - 1)));
+    if (memcmp(mem_ + start, src, n) != 0) {
+      touch(start, n);
+      memmove(mem_ + start, src, n);
+    }
+    start += n;
+    src += n;
+    size -= n;
+  }
+}
+
 bool Memory::load_image(size_t start, size_t size, const uint8_t* image) {
   if (size_ - start < size) {
     // We can't load the image, too big to fit.
     return false;
   }
-  memmove(mem_ + start, image, size);
+  copy_in(start, image, size);
   return true;
 }
 
@@ -51,21 +89,239 @@ bool Memory::clear(size_t start, size_t size) {
     // We can't load the image, too big to fit.
     return false;
   }
-  memset(mem_ + start, 0, size);
+  static const uint8_t zeros[page_size]{};
+  for (size_t n = 0; n < size; n += page_size) {
+    const auto len = std::min<size_t>(page_size, size - n);
+    copy_in(start + n, zeros, len);
+  }
   return true;
 }
 
+void Memory::move(uint32_t dst, uint32_t src, size_t size) {
+  touch(dst, size);
+  memmove(mem_ + dst, mem_ + src, size);
+}
+
+void Memory::fill(uint32_t start, size_t size, uint8_t value) {
+  touch(start, size);
+  memset(mem_ + start, value, size);
+}
+
 // returns value from an absolute memory location
 uint16_t Memory::abs16(uint32_t loc) const {
-  const auto* p = reinterpret_cast<uint16_t*>(mem_ + loc);
-  return *p;
+  loc &= address_mask_;
+  const auto* host = pages_[loc >> page_shift].read;
+  if (host && (loc & page_mask) != page_mask) {
+    return *reinterpret_cast<const uint16_t*>(host + (loc & page_mask));
+  }
+  // Straddles two pages, or the end of the address space.
+  return static_cast<uint16_t>(abs8(loc) | (abs8(loc + 1) << 8));
 }
 
 // sets a value from an absolute memory location
 void Memory::abs16(uint32_t loc, uint16_t value) {
-  auto* p = reinterpret_cast<uint16_t*>(mem_ + loc);
-  *p = value;
+  loc &= address_mask_;
+  auto& page = pages_[loc >> page_shift];
+  if (!page.write || (loc & page_mask) == page_mask) {
+    abs8(loc, static_cast<uint8_t>(value & 0xff));
+    abs8(loc + 1, static_cast<uint8_t>(value >> 8));
+    return;
+  }
+  auto* p = reinterpret_cast<uint16_t*>(page.write + (loc & page_mask));
+  if (*p != value) {
+    ++page.gen;
+    if (page.code >= 0 && is_code(page, loc & page_mask, 2)) {
+      code_written(page);
+    }
+    changed(loc);
+    *p = value;
+  }
+}
+
+uint8_t Memory::read_region(uint32_t loc) const {
+  const auto& page = pages_[loc >> page_shift];
+  if (page.read_hooks) {
+    for (const auto& hook : read_hooks_) {
+      if (loc >= hook.start && loc < hook.end) {
+        return hook.read(loc);
+      }
+    }
+    return page.write[loc & page_mask];
+  }
+  if (page.region >= 0) {
+    return regions_[page.region].read(loc);
+  }
+  // Nothing's there.
+  return 0xff;
+}
+
+void Memory::write_region(uint32_t loc, uint8_t value) {
+  auto& page = pages_[loc >> page_shift];
+  if (page.region < 0) {
+    // ROM, or nothing's there.
+    VLOG(4) << "Ignoring write to unwritable memory at: " << loc;
+    return;
+  }
+  ++page.gen;
+  changed(loc);
+  regions_[page.region].write(loc, value);
+}
+
+const uint8_t* Memory::fetch(uint32_t loc, uint8_t* buf, uint32_t size) const {
+  const auto* p = pages_[loc >> page_shift].read;
+  if (p && (loc & page_mask) + size <= page_size) {
+    return p + (loc & page_mask);
+  }
+  for (uint32_t i = 0; i < size; i++) {
+    buf[i] = abs8(loc + i);
+  }
+  return buf;
+}
+
+uint32_t Memory::direct_size(uint32_t start, uint32_t size) const {
+  const uint64_t limit = std::min<uint64_t>(static_cast<uint64_t>(start) + size,
+                                            static_cast<uint64_t>(address_mask_) + 1);
+  uint64_t pos = start;
+  while (pos < limit && is_ram(static_cast<uint32_t>(pos >> page_shift))) {
+    pos = (pos | page_mask) + 1;
+  }
+  return static_cast<uint32_t>(std::min(pos, limit) - std::min<uint64_t>(start, limit));
+}
+
+uint32_t Memory::direct_size_before(uint32_t end, uint32_t size) const {
+  if (end > address_mask_ + 1) {
+    return 0;
+  }
+  const uint32_t limit = end - std::min(end, size);
+  auto pos = end;
+  while (pos > limit && is_ram((pos - 1) >> page_shift)) {
+    pos = (pos - 1) & ~page_mask;
+  }
+  return end - std::max(pos, limit);
+}
+
+void Memory::map_region(uint32_t start, uint32_t size, memory_region_t region) {
+  CHECK_EQ(start & page_mask, 0u);
+  const auto index = static_cast<int>(regions_.size());
+  regions_.emplace_back(std::move(region));
+  for (auto page = start >> page_shift; page < (start + size) >> page_shift; ++page) {
+    pages_[page].read = pages_[page].write = nullptr;
+    pages_[page].region = index;
+    code_written(pages_[page]);
+  }
+}
+
+void Memory::add_read_hook(uint32_t start, uint32_t size,
+                           std::function<uint8_t(uint32_t loc)> read) {
+  if (size == 0) {
+    return;
+  }
+  read_hooks_.push_back({start, start + size, std::move(read)});
+  for (auto page = start >> page_shift; page <= (start + size - 1) >> page_shift; ++page) {
+    CHECK(is_ram(page) || pages_[page].read_hooks) << "Read hooks need RAM at: " << start;
+    // Reads go through read_region, writes still go straight to RAM.
+    pages_[page].read = nullptr;
+    pages_[page].read_hooks = true;
+    code_written(pages_[page]);
+  }
+}
+
+void Memory::map_rom(uint32_t start, uint32_t size) {
+  CHECK_EQ(start & page_mask, 0u);
+  CHECK_LE(start + size, static_cast<uint32_t>(size_));
+  for (auto page = start >> page_shift; page < (start + size) >> page_shift; ++page) {
+    pages_[page].read = mem_ + (page << page_shift);
+    pages_[page].write = nullptr;
+    pages_[page].region = -1;
+    code_written(pages_[page]);
+  }
+}
+
+void Memory::map_ram(uint32_t start, uint32_t size) {
+  CHECK_EQ(start & page_mask, 0u);
+  CHECK_LE(start + size, static_cast<uint32_t>(size_));
+  for (auto page = start >> page_shift; page < (start + size) >> page_shift; ++page) {
+    pages_[page].read = pages_[page].write = mem_ + (page << page_shift);
+    pages_[page].region = -1;
+    code_written(pages_[page]);
+  }
+}
+
+// Records a write to all pages within [start, start + size).
+void Memory::touch(size_t start, size_t size) {
+  if (size == 0) {
+    return;
+  }
+  changed(static_cast<uint32_t>(start));
+  const auto end = start + size;
+  const auto last = (end - 1) >> page_shift;
+  for (auto page = start >> page_shift; page <= last; ++page) {
+    auto& p = pages_[page];
+    ++p.gen;
+    if (p.code >= 0) {
+      const auto page_start = page << page_shift;
+      const auto from = std::max(start, page_start);
+      const auto to = std::min(end, page_start + page_size);
+      if (is_code(p, static_cast<uint32_t>(from - page_start), static_cast<uint32_t>(to - from))) {
+        code_written(p);
+      }
+    }
+  }
+}
+
+void Memory::mark_code(uint32_t loc, uint32_t size) {
+  auto& page = pages_[loc >> page_shift];
+  if (page.code < 0) {
+    page.code = static_cast<int>(code_.size());
+    code_.emplace_back();
+  }
+  auto& bits = code_[page.code];
+  const auto end = std::min((loc & page_mask) + size, page_size);
+  for (auto off = loc & page_mask; off < end; ++off) {
+    bits[off >> 6] |= uint64_t{1} << (off & 63);
+  }
 }
 
+bool Memory::is_code(const page_t& page, uint32_t off, uint32_t size) const {
+  const auto& bits = code_[page.code];
+  const auto end = off + size;
+  while (off < end) {
+    // The rest of this word of the map, or up to end.
+    const auto bit = off & 63;
+    const auto n = std::min<uint32_t>(64 - bit, end - off);
+    const auto mask = (n == 64 ? ~uint64_t{0} : (uint64_t{1} << n) - 1) << bit;
+    if (bits[off >> 6] & mask) {
+      return true;
+    }
+    off += n;
+  }
+  return false;
+}
+
+void Memory::code_written(page_t& page) {
+  ++page.code_gen;
+  if (page.code >= 0) {
+    code_[page.code].fill(0);
+  }
+}
+
+void Memory::add_counter(uint32_t start, uint32_t size) {
+  if (size == 0) {
+    return;
+  }
+  counters_.emplace_back(start, start + size);
+  for (auto page = start >> page_shift; page <= (start + size - 1) >> page_shift; ++page) {
+    pages_[page].counters = true;
+  }
+}
+
+bool Memory::is_counter(uint32_t loc) const {
+  for (const auto& [start, end] : counters_) {
+    if (loc >= start && loc < end) {
+      return true;
+    }
+  }
+  return false;
+}
 
 } // namespace door86::cpu
\ No newline at end of file
@@ -3,12 +3,38 @@
 
 #include "core/log.h"
 #include "cpu/memory_bits.h"
+#include "cpu/memory_image.h"
+#include <array>
 #include <cstdint>
+#include <functional>
+#include <memory>
 #include <string>
+#include <utility>
+#include <vector>
 
 namespace door86::cpu {
 
+/**
+ * Handlers for a region of the address space that isn't plain RAM, such as
+ * a device's memory. Both are given the absolute address being accessed.
+ */
+struct memory_region_t {
+  std::function<uint8_t(uint32_t loc)> read;
+  std::function<void(uint32_t loc, uint8_t value)> write;
+};
 
+/**
+ * Guest memory.
+ *
+ * The address space is split into pages, each of which is either plain RAM
+ * (accessed directly through a host pointer), read only ROM, or a region
+ * whose accesses go to a memory_region_t. Pages past the end of RAM that
+ * aren't mapped read as FF and ignore writes.
+ *
+ * Like an 8088, addresses past 1 MiB wrap around to 0 (i.e. FFFF:0010 is
+ * 0000:0000) unless the A20 line is enabled, which makes the HMA (1 MiB up to
+ * FFFF:FFFF) addressable.
+ */
 class Memory final {
 private:
   // returns the absolute memory location for a segmented address
@@ -17,16 +43,48 @@ private:
   static inline uint32_t abs_memory(uint16_t seg, uint16_t off) { return (seg * 0x10) + off; }
 
 public:
+  // Size of a page of the memory map.
+  static constexpr int page_shift = 12;
+  static constexpr uint32_t page_size = 1 << page_shift;
+  static constexpr uint32_t page_mask = page_size - 1;
+  // 1 MiB of conventional and upper memory plus the HMA.
+  static constexpr uint32_t max_size = 0x110000;
+
   Memory(int size);
+  // Memory starting out as a copy of base, sharing pages with it until they're written.
+  explicit Memory(std::shared_ptr<const MemoryImage> base);
   ~Memory();
+  Memory(const Memory&) = delete;
+  Memory& operator=(const Memory&) = delete;
 
   const uint8_t& operator[](int loc) const { return mem_[loc]; }
   uint8_t& operator[](int loc) { return mem_[loc]; }
 
   // returns value from an absolute memory location
-  uint8_t abs8(uint32_t loc) const { return mem_[loc]; }
+  uint8_t abs8(uint32_t loc) const {
+    loc &= address_mask_;
+    const auto* p = pages_[loc >> page_shift].read;
+    return p ? p[loc & page_mask] : read_region(loc);
+  }
   // sets a value from an absolute memory location
-  void abs8(uint32_t loc, uint8_t value) { mem_[loc] = value; }
+  void abs8(uint32_t loc, uint8_t value) {
+    loc &= address_mask_;
+    auto& page = pages_[loc >> page_shift];
+    if (!page.write) {
+      write_region(loc, value);
+      return;
+    }
+    auto& m = page.write[loc & page_mask];
+    // Don't write the same value, the page may still be shared with a MemoryImage.
+    if (m != value) {
+      ++page.gen;
+      if (page.code >= 0 && is_code(page, loc & page_mask, 1)) {
+        code_written(page);
+      }
+      changed(loc);
+      m = value;
+    }
+  }
 
   // returns value from an absolute memory location
   uint16_t abs16(uint32_t loc) const;
@@ -53,7 +111,8 @@ public:
     }
   }
 
-  // loads an image of size (size) into memory starting at absolute location start
+  // loads an image of size (size) into memory starting at absolute location start.
+  // Pages that already hold the same bytes aren't written.
   bool load_image(size_t start, size_t size, const uint8_t* image);
   // loads an image of size (size) into memory starting at segmented location start
   bool load_image(const seg_address_t& start, size_t size, const uint8_t* image);
@@ -76,17 +135,172 @@ public:
     return p;
   }
 
+  // Bulk access, used by the string instructions. These take absolute
+  // locations within plain RAM (see direct_size) and track writes the same as abs8.
+
+  // Copies size bytes from src to dst, same as memmove.
+  void move(uint32_t dst, uint32_t src, size_t size);
+  // Sets size bytes starting at start to value.
+  void fill(uint32_t start, size_t size, uint8_t value);
+  // Returns a pointer to size bytes starting at start that the caller will write to.
+  uint8_t* write_ptr(uint32_t start, size_t size) {
+    touch(start, size);
+    return mem_ + start;
+  }
+  // Returns a pointer to the memory starting at start.
+  const uint8_t* read_ptr(uint32_t start) const { return mem_ + start; }
+  // Total size of memory in bytes.
+  int size() const { return size_; }
+  // Returns how many of the size bytes starting at start are plain RAM below
+  // the end of the address space, so can be used with the bulk functions.
+  uint32_t direct_size(uint32_t start, uint32_t size) const;
+  // Same as direct_size, for the size bytes ending at (not including) end.
+  uint32_t direct_size_before(uint32_t end, uint32_t size) const;
+
+  // Memory map. These take page aligned locations and sizes.
+
+  // Sends accesses to [start, start + size) to region.
+  void map_region(uint32_t start, uint32_t size, memory_region_t region);
+  // Makes [start, start + size) read only, writes by the program are ignored.
+  // load_image still works, for loading the ROM's contents.
+  void map_rom(uint32_t start, uint32_t size);
+  // Makes [start, start + size) plain RAM again.
+  void map_ram(uint32_t start, uint32_t size);
+  // Reads of [start, start + size), which needn't be page aligned, return what
+  // read returns instead of the RAM there (i.e. a value computed when it's
+  // read, like the BIOS tick count). Writes still go to RAM, so read can see
+  // what the program wrote with operator[]. Other reads of the pages holding
+  // the range are slower, and the pages aren't plain RAM for direct_size.
+  void add_read_hook(uint32_t start, uint32_t size, std::function<uint8_t(uint32_t loc)> read);
+
+  // Enables or disables the A20 line, off (wrapping at 1 MiB) by default.
+  void set_a20(bool enabled) { address_mask_ = enabled ? 0x1fffff : 0xfffff; }
+  bool a20() const noexcept { return address_mask_ != 0xfffff; }
+  // Returns the linear address loc with the A20 line applied, as every access sees it.
+  uint32_t mask(uint32_t loc) const noexcept { return loc & address_mask_; }
+
+  // Code fetch, for the decoder. These take locations already passed through mask.
+
+  // Returns a pointer to the size bytes at loc: into the page when it's RAM
+  // or ROM, otherwise (a region, read hooks, nothing mapped, or crossing into
+  // the next page) they're read with abs8 into buf.
+  const uint8_t* fetch(uint32_t loc, uint8_t* buf, uint32_t size) const;
+  // Returns true if the page holding loc is RAM or ROM, so code decoded from it
+  // only goes stale when the page's code generation changes.
+  bool host_backed(uint32_t loc) const { return pages_[loc >> page_shift].read != nullptr; }
+
+  // Write tracking.
+  //
+  // Each page has a generation that changes whenever a write changes the
+  // page, which lets devices find what's changed since they last looked.
+  // Caches of decoded instructions use the page's code generation instead,
+  // which only changes when a write changes a byte they've marked as
+  // decoded, so a program updating a variable next to its code (as .COM
+  // files do) doesn't throw away the code with it.
+  // Note: writes made through operator[] are not tracked.
+
+  // Returns the write generation for the page holding loc.
+  uint32_t generation(uint32_t loc) const {
+    return pages_[(loc & address_mask_) >> page_shift].gen;
+  }
+  // Returns the code generation for the page holding loc. It also changes
+  // when the page is mapped differently.
+  uint32_t code_generation(uint32_t loc) const {
+    return pages_[(loc & address_mask_) >> page_shift].code_gen;
+  }
+  // Marks the size bytes at loc, which is after Memory::mask and doesn't
+  // cross a page, as decoded by a cache. A write changing any of them changes
+  // the code generation and clears every mark in the page, since everything
+  // decoded from it is dropped and marked again when it's decoded again.
+  void mark_code(uint32_t loc, uint32_t size);
+
+  // Progress tracking, used to tell when a program is only waiting.
+
+  // Returns the number of writes that changed memory, other than writes to counters.
+  // Bulk writes (move, fill, write_ptr) always count.
+  uint64_t writes() const noexcept { return writes_; }
+  // Marks [start, start + size) as a counter (i.e. the BIOS tick count) that
+  // changes without the program doing anything, so writes to it aren't counted.
+  void add_counter(uint32_t start, uint32_t size);
+
   // Helpers for testing
 
   // loads an image of size (size) into memory starting at absolute location start
   bool load_string(size_t start, const std::string& s);
-  // clears (zeros) a block of memory
+  // clears (zeros) a block of memory, pages that are already zero aren't written.
   bool clear(size_t start, size_t size);
 
 private:
+  // Enough pages for every address with A20 enabled.
+  static constexpr uint32_t page_count = 0x200000 >> page_shift;
+
+  struct page_t {
+    // Host memory holding the page, or nullptr when reads go to the region.
+    uint8_t* read{nullptr};
+    // nullptr when the page is read only or writes go to the region.
+    uint8_t* write{nullptr};
+    // Index into regions_, or -1.
+    int region{-1};
+    // Incremented on every write that changes this page.
+    uint32_t gen{0};
+    // true if any counters are in this page.
+    bool counters{false};
+    // true if any read hooks are in this page.
+    bool read_hooks{false};
+    // Index into code_ of the bytes marked as decoded code, or -1 if none have been.
+    int code{-1};
+    // Incremented on every write that changes a byte marked as code.
+    uint32_t code_gen{0};
+  };
+  // A bit for each byte of a page.
+  using code_map_t = std::array<uint64_t, page_size / 64>;
+
+  struct read_hook_t {
+    uint32_t start;
+    uint32_t end;
+    std::function<uint8_t(uint32_t loc)> read;
+  };
+
+  // Reads and writes of pages without a host pointer.
+  uint8_t read_region(uint32_t loc) const;
+  void write_region(uint32_t loc, uint8_t value);
+  // Maps the pages of RAM in [0, size_) and leaves the rest unmapped.
+  void map_pages();
+  // Returns true if page is plain RAM.
+  bool is_ram(uint32_t page) const {
+    const auto loc = page << page_shift;
+    return loc < static_cast<uint32_t>(size_) && pages_[page].read == mem_ + loc &&
+           pages_[page].write == mem_ + loc;
+  }
+  // Records a write to all pages within [start, start + size).
+  void touch(size_t start, size_t size);
+  // Returns true if any of the size bytes at offset off in page are marked as code.
+  bool is_code(const page_t& page, uint32_t off, uint32_t size) const;
+  // Code in page was written (or what's read from it changed), so it's stale.
+  void code_written(page_t& page);
+  // Records a write that changed the value at loc.
+  inline void changed(uint32_t loc) {
+    if (!pages_[loc >> page_shift].counters || !is_counter(loc)) {
+      ++writes_;
+    }
+  }
+  bool is_counter(uint32_t loc) const;
+  // Copies [src, src + size) to start, skipping pages that wouldn't change.
+  void copy_in(size_t start, const uint8_t* src, size_t size);
+
   const int size_;
   bool debug_{false};
   uint8_t* mem_;
+  // mem_ is a private mapping of this image, when set.
+  std::shared_ptr<const MemoryImage> base_;
+  uint32_t address_mask_{0xfffff};
+  std::vector<page_t> pages_;
+  std::vector<memory_region_t> regions_;
+  std::vector<read_hook_t> read_hooks_;
+  std::vector<code_map_t> code_;
+  uint64_t writes_{0};
+  // [start, end) of each counter.
+  std::vector<std::pair<uint32_t, uint32_t>> counters_;
 };
 
 } // namespace door86::cpu
@@ -1,6 +1,7 @@
 #ifndef INCLUDED_CPU_MEMORY_BITS_H
 #define INCLUDED_CPU_MEMORY_BITS_H
 
+#include <array>
 #include <cstdint>
 #include <string>
 #include <vector>
@@ -48,6 +49,22 @@ static inline int kern_popcount(int n) {
   return c;
 }
 
+// Returns a table where each entry is true if the byte has even parity.
+static constexpr std::array<bool, 256> make_parity_table() {
+  std::array<bool, 256> t{};
+  for (int i = 0; i < 256; i++) {
+    int c = 0;
+    for (int n = i; n; n &= (n - 1)) {
+      ++c;
+    }
+    t[i] = (c % 2) == 0;
+  }
+  return t;
+}
+
+// PF lookup: true when the low byte of a result has an even number of bits set.
+static constexpr std::array<bool, 256> parity_table = make_parity_table();
+
 }
 
 #endif // INCLUDED_CPU_MEMORY_BITS_H
\ No newline at end of file
@@ -0,0 +1,96 @@
+#include "cpu/memory_image.h"
+
+#include "core/log.h"
+#include "cpu/memory.h"
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace door86::cpu {
+
+MemoryImage::MemoryImage(handle_t handle, int size) : handle_(handle), size_(size) {}
+
+#ifdef _WIN32
+
+MemoryImage::~MemoryImage() { CloseHandle(handle_); }
+
+std::shared_ptr<const MemoryImage> MemoryImage::create(const Memory& m) {
+  const auto size = static_cast<DWORD>(m.size());
+  auto* h = CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, 0, size, nullptr);
+  if (!h) {
+    LOG(WARNING) << "CreateFileMapping failed: " << GetLastError();
+    return nullptr;
+  }
+  auto* p = MapViewOfFile(h, FILE_MAP_WRITE, 0, 0, size);
+  if (!p) {
+    LOG(WARNING) << "MapViewOfFile failed: " << GetLastError();
+    CloseHandle(h);
+    return nullptr;
+  }
+  memcpy(p, m.read_ptr(0), size);
+  UnmapViewOfFile(p);
+  return std::shared_ptr<const MemoryImage>(new MemoryImage(h, m.size()));
+}
+
+uint8_t* MemoryImage::map() const {
+  return static_cast<uint8_t*>(MapViewOfFile(handle_, FILE_MAP_COPY, 0, 0, size_));
+}
+
+void MemoryImage::unmap(uint8_t* p, int) { UnmapViewOfFile(p); }
+
+#else
+
+MemoryImage::~MemoryImage() { close(handle_); }
+
+static int create_anonymous_file() {
+#ifdef __linux__
+  return memfd_create("door86", MFD_CLOEXEC);
+#else
+  char name[] = "/tmp/door86XXXXXX";
+  const auto fd = mkstemp(name);
+  if (fd >= 0) {
+    // Only the descriptor is needed.
+    unlink(name);
+  }
+  return fd;
+#endif
+}
+
+std::shared_ptr<const MemoryImage> MemoryImage::create(const Memory& m) {
+  const auto fd = create_anonymous_file();
+  if (fd < 0) {
+    LOG(WARNING) << "Unable to create memory image: " << strerror(errno);
+    return nullptr;
+  }
+  const auto size = static_cast<size_t>(m.size());
+  void* p = MAP_FAILED;
+  if (ftruncate(fd, size) == 0) {
+    p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  }
+  if (p == MAP_FAILED) {
+    LOG(WARNING) << "Unable to create memory image: " << strerror(errno);
+    close(fd);
+    return nullptr;
+  }
+  memcpy(p, m.read_ptr(0), size);
+  munmap(p, size);
+  return std::shared_ptr<const MemoryImage>(new MemoryImage(fd, m.size()));
+}
+
+uint8_t* MemoryImage::map() const {
+  auto* p = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_PRIVATE, handle_, 0);
+  return p == MAP_FAILED ? nullptr : static_cast<uint8_t*>(p);
+}
+
+void MemoryImage::unmap(uint8_t* p, int size) { munmap(p, size); }
+
+#endif
+
+} // namespace door86::cpu
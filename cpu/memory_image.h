@@ -0,0 +1,55 @@
+#ifndef INCLUDED_CPU_MEMORY_IMAGE_H
+#define INCLUDED_CPU_MEMORY_IMAGE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace door86::cpu {
+
+class Memory;
+
+/**
+ * A read only snapshot of guest memory that many Memory instances can be
+ * mapped over (see Memory::Memory(std::shared_ptr<const MemoryImage>)).
+ *
+ * Each Memory gets a private copy-on-write mapping of the image, so pages
+ * are shared between all of them until one writes to the page. Pages holding
+ * the same door program, its PSP and environment in many sessions are only
+ * in host memory once.
+ */
+class MemoryImage {
+public:
+  ~MemoryImage();
+  MemoryImage(const MemoryImage&) = delete;
+  MemoryImage& operator=(const MemoryImage&) = delete;
+
+  /** Creates an image holding the current contents of m. Returns nullptr on failure. */
+  static std::shared_ptr<const MemoryImage> create(const Memory& m);
+
+  /** Size in bytes of the memory the image was created from */
+  int size() const noexcept { return size_; }
+
+  /**
+   * Returns a new private copy-on-write mapping of the image, which must be
+   * released with unmap. Returns nullptr on failure.
+   */
+  uint8_t* map() const;
+  static void unmap(uint8_t* p, int size);
+
+private:
+#ifdef _WIN32
+  using handle_t = void*;
+#else
+  using handle_t = int;
+#endif
+  MemoryImage(handle_t handle, int size);
+
+  // file mapping handle on Windows, file descriptor everywhere else.
+  handle_t handle_;
+  int size_;
+};
+
+} // namespace door86::cpu
+
+#endif // INCLUDED_CPU_MEMORY_IMAGE_H
@@ -64,3 +64,170 @@ TEST(MemoryTest, MutateWord) {
   ASSERT_EQ(m[0], 0xcd);
   ASSERT_EQ(m[1], 0xab);
 }
+
+TEST(MemoryTest, Writes) {
+  Memory m(100);
+  m.add_counter(10, 4);
+  const auto start = m.writes();
+
+  m.set<uint8_t>(0, 20, 1);
+  EXPECT_EQ(start + 1, m.writes());
+  // Writing the same value again doesn't change anything.
+  m.set<uint8_t>(0, 20, 1);
+  m.set<uint16_t>(0, 20, 1);
+  EXPECT_EQ(start + 1, m.writes());
+  // Counters change on their own.
+  m.set<uint16_t>(0, 10, 0x1234);
+  m.set<uint8_t>(0, 13, 1);
+  EXPECT_EQ(start + 1, m.writes());
+  m.set<uint8_t>(0, 14, 1);
+  EXPECT_EQ(start + 2, m.writes());
+}
+
+TEST(MemoryTest, Image) {
+  Memory m(0x4000);
+  m.abs8(0x10, 0x42);
+  m.abs8(0x2010, 0x43);
+  auto image = MemoryImage::create(m);
+  ASSERT_NE(nullptr, image);
+  EXPECT_EQ(0x4000, image->size());
+
+  Memory a(image);
+  Memory b(image);
+  EXPECT_EQ(0x42, a.abs8(0x10));
+  EXPECT_EQ(0x43, b.abs8(0x2010));
+  // Each gets its own copy when writing.
+  a.abs8(0x10, 0x01);
+  EXPECT_EQ(0x01, a.abs8(0x10));
+  EXPECT_EQ(0x42, b.abs8(0x10));
+  EXPECT_EQ(0x42, Memory(image).abs8(0x10));
+}
+
+TEST(MemoryTest, LoadSameImageDoesNotWrite) {
+  Memory m(0x4000);
+  uint8_t img[] = {0xad, 0xde, 0xef, 0xbe};
+  ASSERT_TRUE(m.load_image(0x1ffe, 4, img));
+  const auto start = m.writes();
+  ASSERT_TRUE(m.load_image(0x1ffe, 4, img));
+  EXPECT_EQ(start, m.writes());
+  ASSERT_TRUE(m.clear(0x3000, 0x1000));
+  EXPECT_EQ(start, m.writes());
+
+  img[3] = 0;
+  ASSERT_TRUE(m.load_image(0x1ffe, 4, img));
+  EXPECT_EQ(0, m.abs8(0x2001));
+  EXPECT_NE(start, m.writes());
+}
+
+TEST(MemoryTest, A20) {
+  Memory m(Memory::max_size);
+  m.set<uint8_t>(0, 0, 0x12);
+  // FFFF:0010 wraps to 0000:0000
+  EXPECT_EQ(0x12, m.get<uint8_t>(0xffff, 0x10));
+  m.set<uint16_t>(0xffff, 0x0f, 0x3456);
+  EXPECT_EQ(0x34, m.abs8(0));
+  EXPECT_EQ(0x56, m.abs8(0xfffff));
+
+  m.set_a20(true);
+  EXPECT_TRUE(m.a20());
+  EXPECT_EQ(0, m.get<uint8_t>(0xffff, 0x10));
+  m.set<uint8_t>(0xffff, 0xffff, 0x78);
+  EXPECT_EQ(0x78, m.abs8(0x10ffef));
+  EXPECT_EQ(0x34, m.abs8(0));
+}
+
+TEST(MemoryTest, Unmapped) {
+  Memory m(Memory::page_size);
+  m.set_a20(true);
+  EXPECT_EQ(0xff, m.abs8(Memory::page_size));
+  EXPECT_EQ(0xffff, m.abs16(0x1ffffe));
+  m.abs8(Memory::page_size, 1);
+  EXPECT_EQ(0xff, m.abs8(Memory::page_size));
+}
+
+TEST(MemoryTest, Rom) {
+  Memory m(0x4000);
+  uint8_t img[] = {0xad, 0xde};
+  m.map_rom(0x1000, 0x1000);
+  ASSERT_TRUE(m.load_image(0x1ffe, 2, img));
+  m.abs8(0x1ffe, 1);
+  m.abs16(0x1fff, 0x1234);
+  EXPECT_EQ(0xad, m.abs8(0x1ffe));
+  EXPECT_EQ(0xde, m.abs8(0x1fff));
+  // The half in RAM was written.
+  EXPECT_EQ(0x12, m.abs8(0x2000));
+
+  m.map_ram(0x1000, 0x1000);
+  m.abs8(0x1ffe, 1);
+  EXPECT_EQ(1, m.abs8(0x1ffe));
+}
+
+TEST(MemoryTest, Region) {
+  Memory m(0x4000);
+  uint8_t device[Memory::page_size]{};
+  int writes = 0;
+  m.map_region(0x2000, Memory::page_size,
+               {[&](uint32_t loc) { return device[loc - 0x2000]; },
+                [&](uint32_t loc, uint8_t value) {
+                  device[loc - 0x2000] = value;
+                  ++writes;
+                }});
+  const auto gen = m.generation(0x2000);
+  m.set<uint16_t>(0x200, 0x10, 0xbeef);
+  EXPECT_EQ(2, writes);
+  EXPECT_EQ(0xef, device[0x10]);
+  EXPECT_EQ(0xbe, device[0x11]);
+  EXPECT_EQ(0xbeef, m.get<uint16_t>(0x200, 0x10));
+  EXPECT_NE(gen, m.generation(0x2000));
+  // Not plain RAM, so it can't be used in bulk.
+  EXPECT_EQ(0x1000u, m.direct_size(0x1000, 0x2000));
+  EXPECT_EQ(0x800u, m.direct_size_before(0x3800, 0x2000));
+}
+
+TEST(MemoryTest, ReadHook) {
+  Memory m(0x4000);
+  int reads = 0;
+  m.add_read_hook(0x46c, 2, [&](uint32_t loc) {
+    ++reads;
+    return static_cast<uint8_t>(loc & 0xff);
+  });
+  m.abs8(0x46b, 0x11);
+  m.abs16(0x46c, 0x2222);
+  EXPECT_EQ(0x11, m.abs8(0x46b));
+  EXPECT_EQ(0x6d6c, m.abs16(0x46c));
+  EXPECT_EQ(2, reads);
+  // Writes still went to RAM.
+  EXPECT_EQ(0x22, m[0x46c]);
+  EXPECT_EQ(0u, m.direct_size(0x400, 0x100));
+}
+
+TEST(MemoryTest, Generation) {
+  Memory m(0x4000);
+  const auto gen = m.generation(0x1000);
+  const auto other = m.generation(0x2000);
+  m.abs8(0x1000, 0);
+  EXPECT_EQ(gen, m.generation(0x1000));
+  m.abs16(0x1fff, 0x0101);
+  EXPECT_NE(gen, m.generation(0x1000));
+  EXPECT_NE(other, m.generation(0x2000));
+}
+
+TEST(MemoryTest, CodeGeneration) {
+  Memory m(0x4000);
+  const auto gen = m.code_generation(0x1000);
+  m.mark_code(0x1100, 3);
+  // Data in the same page.
+  m.abs8(0x10ff, 1);
+  m.abs16(0x1103, 0x0202);
+  m.fill(0x1200, 0x100, 3);
+  EXPECT_EQ(gen, m.code_generation(0x1000));
+  m.abs16(0x10ff, 0x0404);
+  EXPECT_NE(gen, m.code_generation(0x1000));
+  // Nothing's marked again until it's decoded again.
+  const auto next = m.code_generation(0x1000);
+  m.abs8(0x1101, 5);
+  EXPECT_EQ(next, m.code_generation(0x1000));
+  m.mark_code(0x1100, 3);
+  m.move(0x1102, 0x1200, 1);
+  EXPECT_NE(next, m.code_generation(0x1000));
+}
@@ -0,0 +1,72 @@
+#include "cpu/output_buffer.h"
+
+#include "core/log.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+namespace door86::cpu {
+
+static size_t write_stdout(const char* data, size_t size) {
+  const auto n = fwrite(data, 1, size, stdout);
+  fflush(stdout);
+  return n;
+}
+
+OutputBuffer::OutputBuffer(size_t capacity) : buf_(capacity), sink_(write_stdout) {}
+
+void OutputBuffer::write(const char* data, size_t size) {
+  written_ += size;
+  if (size_ == 0) {
+    since_ = clock::now();
+  }
+  while (size > 0) {
+    if (size_ == buf_.size()) {
+      // Full, the sink has to make room.
+      if (!send_some()) {
+        LOG(WARNING) << "Output sink isn't taking any output, dropping " << size << " bytes.";
+        return;
+      }
+      continue;
+    }
+    const auto tail = (head_ + size_) % buf_.size();
+    const auto n = std::min(size, (tail >= head_ ? buf_.size() : head_) - tail);
+    memcpy(buf_.data() + tail, data, n);
+    size_ += n;
+    data += n;
+    size -= n;
+  }
+  if (size_ >= threshold) {
+    flush();
+  }
+}
+
+bool OutputBuffer::send_some() {
+  const auto n = std::min(size_, buf_.size() - head_);
+  ++sends_;
+  const auto sent = std::min(n, sink_(buf_.data() + head_, n));
+  head_ = (head_ + sent) % buf_.size();
+  size_ -= sent;
+  if (size_ == 0) {
+    head_ = 0;
+  }
+  return sent > 0;
+}
+
+void OutputBuffer::flush() {
+  while (size_ > 0) {
+    if (!send_some()) {
+      // Try again on the next flush.
+      return;
+    }
+  }
+}
+
+void OutputBuffer::flush_if_due(clock::time_point now) {
+  if (size_ > 0 && now - since_ >= latency) {
+    flush();
+    since_ = now;
+  }
+}
+
+} // namespace door86::cpu
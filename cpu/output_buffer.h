@@ -0,0 +1,76 @@
+#ifndef INCLUDED_CPU_OUTPUT_BUFFER_H
+#define INCLUDED_CPU_OUTPUT_BUFFER_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace door86::cpu {
+
+/**
+ * Console output of a machine on its way to the caller.
+ *
+ * Everything written to the console (DOS character and string output, handle
+ * writes to the standard devices, screen updates from the BIOS) goes into
+ * this ring buffer, and is sent to the sink in large writes: when the
+ * threshold is reached, when the program waits for input, or once output has
+ * waited for latency (see flush_if_due, called between slices of execution).
+ *
+ * The sink may take less than it's given (i.e. a non-blocking socket), the
+ * rest is kept for the next flush.
+ */
+class OutputBuffer {
+public:
+  using clock = std::chrono::steady_clock;
+  // Sends up to size bytes, returns how many were sent.
+  using sink_t = std::function<size_t(const char* data, size_t size)>;
+
+  // Writes to stdout until set_sink is called.
+  explicit OutputBuffer(size_t capacity = 0x4000);
+  ~OutputBuffer() = default;
+
+  // Bytes waiting before writes flush.
+  size_t threshold{0x1000};
+  // Longest time output waits before flush_if_due sends it.
+  std::chrono::milliseconds latency{10};
+
+  void set_sink(sink_t sink) { sink_ = std::move(sink); }
+
+  void write(const char* data, size_t size);
+  void write(std::string_view s) { write(s.data(), s.size()); }
+  void write(char ch) { write(&ch, 1); }
+
+  // Sends as much of the waiting output as the sink takes.
+  void flush();
+  // Flushes if output has waited for latency as of now.
+  void flush_if_due(clock::time_point now);
+
+  // Bytes waiting to be sent.
+  size_t size() const noexcept { return size_; }
+  // Total bytes written, sent or not.
+  uint64_t written() const noexcept { return written_; }
+  // Number of calls made to the sink.
+  uint64_t sends() const noexcept { return sends_; }
+
+private:
+  // Sends the waiting bytes up to the end of the buffer, returns false if the sink took none.
+  bool send_some();
+
+  std::vector<char> buf_;
+  // Index of the oldest waiting byte.
+  size_t head_{0};
+  size_t size_{0};
+  sink_t sink_;
+  // When the oldest waiting byte was written.
+  clock::time_point since_{};
+  uint64_t written_{0};
+  uint64_t sends_{0};
+};
+
+} // namespace door86::cpu
+
+#endif // INCLUDED_CPU_OUTPUT_BUFFER_H
@@ -0,0 +1,83 @@
+#include <gtest/gtest.h>
+
+#include "cpu/output_buffer.h"
+#include <string>
+
+using namespace door86::cpu;
+using namespace std::chrono_literals;
+
+class OutputBufferTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    out.set_sink([this](const char* data, size_t size) {
+      const auto n = std::min(size, accept);
+      sent.append(data, n);
+      ++sends;
+      return n;
+    });
+  }
+
+  OutputBuffer out{16};
+  std::string sent;
+  size_t accept{1000};
+  int sends{0};
+};
+
+TEST_F(OutputBufferTest, HeldUntilFlushed) {
+  out.write("Hello");
+  out.write(',');
+  EXPECT_EQ("", sent);
+  EXPECT_EQ(6u, out.size());
+  out.flush();
+  EXPECT_EQ("Hello,", sent);
+  EXPECT_EQ(1, sends);
+  EXPECT_EQ(0u, out.size());
+  EXPECT_EQ(6u, out.written());
+}
+
+TEST_F(OutputBufferTest, Threshold) {
+  out.threshold = 8;
+  out.write("1234567");
+  EXPECT_EQ("", sent);
+  out.write("8");
+  EXPECT_EQ("12345678", sent);
+}
+
+TEST_F(OutputBufferTest, Latency) {
+  out.latency = 10ms;
+  out.write("abc");
+  const auto now = OutputBuffer::clock::now();
+  out.flush_if_due(now - 20ms);
+  EXPECT_EQ("", sent);
+  out.flush_if_due(now + 20ms);
+  EXPECT_EQ("abc", sent);
+}
+
+TEST_F(OutputBufferTest, FullBufferMakesRoom) {
+  out.write("0123456789abcdefXYZ");
+  EXPECT_EQ("0123456789abcdef", sent);
+  out.flush();
+  EXPECT_EQ("0123456789abcdefXYZ", sent);
+}
+
+TEST_F(OutputBufferTest, PartialSendsWrap) {
+  accept = 5;
+  out.write("0123456789");
+  out.flush();
+  // The sink takes 5 at a time.
+  EXPECT_EQ("0123456789", sent);
+  accept = 0;
+  out.write("abcdefghijkl");
+  out.flush();
+  EXPECT_EQ(12u, out.size());
+  accept = 3;
+  out.write("mnop");
+  out.flush();
+  EXPECT_EQ("0123456789abcdefghijklmnop", sent);
+}
+
+TEST_F(OutputBufferTest, SinkNotTaking) {
+  accept = 0;
+  out.write("0123456789abcdefXYZ");
+  EXPECT_EQ(16u, out.size());
+}
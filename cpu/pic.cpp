@@ -0,0 +1,129 @@
+#include "cpu/pic.h"
+
+#include "core/log.h"
+
+namespace door86::cpu {
+
+Pic::Pic(IO& io) {
+  io.add_ports(
+      port_command, 2, [this](uint16_t port) { return read(port); },
+      [this](uint16_t port, uint8_t value) { write(port, value); });
+}
+
+int Pic::next() const {
+  const auto requested = static_cast<uint8_t>(irr_ & ~imr_);
+  if (!requested) {
+    return -1;
+  }
+  for (int irq = 0; irq < 8; irq++) {
+    const auto bit = 1 << irq;
+    if (isr_ & bit) {
+      // Lower priorities wait for this one's EOI.
+      return -1;
+    }
+    if (requested & bit) {
+      return irq;
+    }
+  }
+  return -1;
+}
+
+void Pic::raise(int irq) {
+  irr_ |= static_cast<uint8_t>(1 << irq);
+  update();
+}
+
+uint8_t Pic::acknowledge() {
+  const auto irq = next();
+  if (irq < 0) {
+    // The request went away, the 8259 answers with IRQ 7.
+    return static_cast<uint8_t>(base_ + 7);
+  }
+  const auto bit = static_cast<uint8_t>(1 << irq);
+  irr_ &= ~bit;
+  if (!auto_eoi_) {
+    isr_ |= bit;
+  }
+  update();
+  return static_cast<uint8_t>(base_ + irq);
+}
+
+void Pic::end_of_interrupt() {
+  // The highest priority one in service.
+  isr_ &= static_cast<uint8_t>(isr_ - 1);
+  update();
+}
+
+uint8_t Pic::read(uint16_t port) {
+  if (port == port_data) {
+    return imr_;
+  }
+  if (poll_) {
+    // Poll command: acknowledges the highest priority request, if there is one.
+    poll_ = false;
+    if (!ready_) {
+      return 0;
+    }
+    return static_cast<uint8_t>(0x80 | (acknowledge() - base_));
+  }
+  return read_isr_ ? isr_ : irr_;
+}
+
+void Pic::write(uint16_t port, uint8_t value) {
+  if (port == port_data) {
+    switch (icw_) {
+    case 2:
+      base_ = value & 0xF8;
+      icw_ = !single_ ? 3 : need_icw4_ ? 4 : 0;
+      break;
+    case 3:
+      // Cascade wiring, nothing's connected.
+      icw_ = need_icw4_ ? 4 : 0;
+      break;
+    case 4:
+      auto_eoi_ = value & 0x02;
+      icw_ = 0;
+      break;
+    default:
+      imr_ = value;
+      update();
+      break;
+    }
+    return;
+  }
+  if (value & 0x10) {
+    // ICW1 starts initialization over.
+    need_icw4_ = value & 0x01;
+    single_ = value & 0x02;
+    icw_ = 2;
+    imr_ = 0;
+    isr_ = 0;
+    auto_eoi_ = false;
+    read_isr_ = false;
+    update();
+    return;
+  }
+  if (value & 0x08) {
+    // OCW3
+    if (value & 0x02) {
+      read_isr_ = value & 0x01;
+    }
+    poll_ = value & 0x04;
+    return;
+  }
+  // OCW2
+  switch (value >> 5) {
+  // Non-specific EOI, and with rotation.
+  case 1:
+  case 5: end_of_interrupt(); break;
+  // Specific EOI, and with rotation.
+  case 3:
+  case 7:
+    isr_ &= static_cast<uint8_t>(~(1 << (value & 7)));
+    update();
+    break;
+  default: VLOG(1) << "Unsupported 8259 OCW2: " << static_cast<int>(value); break;
+  }
+}
+
+} // namespace door86::cpu
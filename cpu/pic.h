@@ -0,0 +1,78 @@
+#ifndef INCLUDED_CPU_PIC_H
+#define INCLUDED_CPU_PIC_H
+
+#include "cpu/io.h"
+
+#include <cstdint>
+
+namespace door86::cpu {
+
+/**
+ * The 8259A programmable interrupt controller on ports 20h and 21h.
+ *
+ * Devices call raise() for an IRQ (they're all edge triggered), which sets
+ * its bit in the request register. The CPU looks at ready() once per block,
+ * and when interrupts are enabled takes the vector from acknowledge(), which
+ * moves the IRQ to in service until the program's handler sends an EOI.
+ *
+ * Fixed priority in fully nested mode (IRQ 0 highest), masking, specific and
+ * non-specific EOI, automatic EOI, reading IRR or ISR, and poll mode are
+ * supported. There's only the one controller, like the PC/XT, so IRQs 8-15
+ * don't exist. Special mask mode and rotating priorities aren't supported.
+ */
+class Pic {
+public:
+  static constexpr uint16_t port_command = 0x20;
+  static constexpr uint16_t port_data = 0x21;
+
+  explicit Pic(IO& io);
+  ~Pic() = default;
+  Pic(const Pic&) = delete;
+  Pic& operator=(const Pic&) = delete;
+
+  /** Requests IRQ irq (0-7). */
+  void raise(int irq);
+  /**
+   * True if an IRQ is requested that isn't masked, or held off by one of the
+   * same or higher priority in service.
+   */
+  bool ready() const noexcept { return ready_; }
+  /** Acknowledges the IRQ ready() is true for, returns its interrupt vector */
+  uint8_t acknowledge();
+  /** Non-specific EOI, the same as writing 20h to port 20h */
+  void end_of_interrupt();
+
+  uint8_t read(uint16_t port);
+  void write(uint16_t port, uint8_t value);
+
+  // Registers.
+  uint8_t irr() const noexcept { return irr_; }
+  uint8_t isr() const noexcept { return isr_; }
+  uint8_t imr() const noexcept { return imr_; }
+  // Vector for IRQ 0, from ICW2.
+  uint8_t base() const noexcept { return base_; }
+
+private:
+  // The IRQ to acknowledge next, or -1.
+  int next() const;
+  void update() { ready_ = next() >= 0; }
+
+  uint8_t irr_{0};
+  uint8_t isr_{0};
+  // As the BIOS leaves it, with only the timer and keyboard enabled.
+  uint8_t imr_{0xFC};
+  uint8_t base_{0x08};
+  bool ready_{false};
+  // Initialization command word expected next on port 21h (2-4), or 0.
+  int icw_{0};
+  bool single_{true};
+  bool need_icw4_{false};
+  bool auto_eoi_{false};
+  // OCW3 read register select, and poll command.
+  bool read_isr_{false};
+  bool poll_{false};
+};
+
+} // namespace door86::cpu
+
+#endif // INCLUDED_CPU_PIC_H
@@ -0,0 +1,143 @@
+#include <gtest/gtest.h>
+
+#include "cpu/io.h"
+#include "cpu/pic.h"
+#include "cpu/x86/cpu.h"
+#include "cpu/x86/cpu_fixture.h"
+#include <string>
+
+using namespace door86::cpu;
+using namespace door86::cpu::x86;
+
+class PicTest : public ::testing::Test {
+protected:
+  PicTest() {
+    // Everything unmasked.
+    io.outb(Pic::port_data, 0x00);
+  }
+
+  IO io;
+  Pic pic{io};
+};
+
+TEST_F(PicTest, Masked) {
+  io.outb(Pic::port_data, 0xFC);
+  pic.raise(4);
+  EXPECT_FALSE(pic.ready());
+  EXPECT_EQ(0x10, pic.irr());
+  io.outb(Pic::port_data, 0xEC);
+  EXPECT_TRUE(pic.ready());
+  EXPECT_EQ(0xEC, io.inb(Pic::port_data));
+}
+
+TEST_F(PicTest, Priority) {
+  pic.raise(3);
+  pic.raise(1);
+  EXPECT_EQ(0x09, pic.acknowledge());
+  EXPECT_EQ(0x02, pic.isr());
+  // Held off until IRQ 1's EOI.
+  EXPECT_FALSE(pic.ready());
+  // Higher priority still gets in.
+  pic.raise(0);
+  EXPECT_EQ(0x08, pic.acknowledge());
+  io.outb(Pic::port_command, 0x20);
+  EXPECT_EQ(0x02, pic.isr());
+  EXPECT_FALSE(pic.ready());
+  io.outb(Pic::port_command, 0x20);
+  EXPECT_TRUE(pic.ready());
+  EXPECT_EQ(0x0B, pic.acknowledge());
+  EXPECT_FALSE(pic.ready());
+}
+
+TEST_F(PicTest, SpecificEoi) {
+  pic.raise(5);
+  pic.acknowledge();
+  pic.raise(2);
+  pic.acknowledge();
+  io.outb(Pic::port_command, 0x65);
+  EXPECT_EQ(0x04, pic.isr());
+}
+
+TEST_F(PicTest, ReadRegisters) {
+  pic.raise(6);
+  pic.raise(7);
+  pic.acknowledge();
+  // IRR by default.
+  EXPECT_EQ(0x80, io.inb(Pic::port_command));
+  io.outb(Pic::port_command, 0x0B);
+  EXPECT_EQ(0x40, io.inb(Pic::port_command));
+  io.outb(Pic::port_command, 0x0A);
+  EXPECT_EQ(0x80, io.inb(Pic::port_command));
+}
+
+TEST_F(PicTest, Poll) {
+  pic.raise(2);
+  io.outb(Pic::port_command, 0x0C);
+  EXPECT_EQ(0x82, io.inb(Pic::port_command));
+  EXPECT_EQ(0x04, pic.isr());
+}
+
+TEST_F(PicTest, Initialize) {
+  // ICW1 (single, ICW4 needed), ICW2 (vectors 50h-57h), ICW4 (8086, automatic EOI).
+  io.outb(Pic::port_command, 0x13);
+  io.outb(Pic::port_data, 0x50);
+  io.outb(Pic::port_data, 0x03);
+  EXPECT_EQ(0x00, pic.imr());
+  pic.raise(2);
+  EXPECT_EQ(0x52, pic.acknowledge());
+  EXPECT_EQ(0x00, pic.isr());
+}
+
+class PicCpuTest : public ::testing::Test {
+protected:
+  PicCpuTest() {
+    // INT 20h halts the CPU.
+    cpu.memory[0x20 * 4] = 0x20;
+    cpu.int_handlers().try_emplace(0x20, [](int, CPU& c) { c.halt(); });
+    cpu.io.outb(Pic::port_data, 0x00);
+    // IRQ 0 handler at 0200:0000: INC BYTE [0500]; MOV AL, 20; OUT 20, AL; IRET
+    load(0x2000, "FE060005 B020 E620 CF");
+    cpu.memory.set<uint16_t>(0, 0x08 * 4, 0x0000);
+    cpu.memory.set<uint16_t>(0, 0x08 * 4 + 2, 0x0200);
+    cpu.core.sregs.ds = 0;
+    cpu.core.sregs.ss = 0x300;
+    cpu.core.regs.x.sp = 0x100;
+  }
+  void load(uint32_t at, const std::string& s) {
+    const auto ops = parse_opcodes_from_line(s);
+    ASSERT_TRUE(cpu.memory.load_image(at, ops.size(), ops.data()));
+  }
+
+  CPU cpu;
+};
+
+TEST_F(PicCpuTest, HltWaitsForIrq) {
+  // STI; HLT; INT 20
+  load(0x1000, "FB F4 CD20");
+  cpu.core.sregs.cs = 0x100;
+  cpu.core.ip = 0;
+  EXPECT_EQ(stop_reason_t::waiting, cpu.run_for({}));
+  EXPECT_EQ(stop_reason_t::waiting, cpu.run_for({}));
+  cpu.pic.raise(0);
+  EXPECT_EQ(stop_reason_t::halted, cpu.run_for({}));
+  EXPECT_EQ(1, cpu.memory.abs8(0x500));
+  EXPECT_EQ(0, cpu.pic.isr());
+  // IRET restored IF.
+  EXPECT_TRUE(cpu.core.flags.iflag());
+}
+
+TEST_F(PicCpuTest, NotWhileInterruptsDisabled) {
+  // CLI; NOP; NOP; STI; NOP; INT 20
+  load(0x1000, "FA 90 90 FB 90 CD20");
+  cpu.core.sregs.cs = 0x100;
+  cpu.core.ip = 0;
+  cpu.execution_mode = execution_mode_t::interpreted;
+  budget_t budget;
+  budget.instructions = 2;
+  cpu.run_for(budget);
+  cpu.pic.raise(0);
+  cpu.run_for(budget);
+  EXPECT_EQ(0, cpu.memory.abs8(0x500));
+  EXPECT_EQ(stop_reason_t::halted, cpu.run_for({}));
+  EXPECT_EQ(1, cpu.memory.abs8(0x500));
+}
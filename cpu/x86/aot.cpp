@@ -0,0 +1,132 @@
+#include "cpu/x86/aot.h"
+
+#include "core/log.h"
+#include "core/scope_exit.h"
+#include "cpu/x86/cpu.h"
+#include "fmt/format.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <dlfcn.h>
+#endif
+
+namespace door86::cpu::x86 {
+
+using namespace wwiv::core;
+
+uint64_t image_hash(const uint8_t* data, size_t len) {
+  uint64_t h = 0xcbf29ce484222325ull;
+  for (size_t i = 0; i < len; i++) {
+    h ^= data[i];
+    h *= 0x100000001b3ull;
+  }
+  return h;
+}
+
+std::optional<uint64_t> image_hash(const std::filesystem::path& filepath) {
+  FILE* fp = nullptr;
+  if (fp = fopen(filepath.string().c_str(), "rb"); !fp) {
+    VLOG(1) << "Unable to open file: " << filepath;
+    return std::nullopt;
+  }
+  // Close fp at exit, no matter how
+  ScopeExit at_exit([=] { fclose(fp); });
+
+  std::vector<uint8_t> data;
+  uint8_t buf[4096];
+  while (const auto num_read = fread(buf, 1, sizeof(buf), fp)) {
+    data.insert(data.end(), buf, buf + num_read);
+  }
+  return image_hash(data.data(), data.size());
+}
+
+std::string aot_module_filename(uint64_t hash) {
+#ifdef _WIN32
+  return fmt::format("{:016x}.dll", hash);
+#else
+  return fmt::format("{:016x}.so", hash);
+#endif
+}
+
+instruction_t aot_decode(const uint8_t* code) {
+  static Decoder decoder(false);
+  return decoder.decode(code);
+}
+
+bool aot_execute(CPU& cpu, const block_t& block, const instruction_t& inst) {
+  (cpu.*cpu.handler(inst))(inst);
+  return cpu.memory.code_generation(block.start) == block.gen;
+}
+
+AotModule::AotModule(const aot_module_t* module, uint32_t base, void* handle)
+    : module_(module), base_(base), handle_(handle) {}
+
+AotModule::~AotModule() {
+  if (!handle_) {
+    return;
+  }
+#ifdef _WIN32
+  FreeLibrary(static_cast<HMODULE>(handle_));
+#else
+  dlclose(handle_);
+#endif
+}
+
+std::unique_ptr<AotModule> AotModule::load(const std::filesystem::path& path, uint64_t hash,
+                                           uint32_t base) {
+#ifdef _WIN32
+  void* handle = LoadLibraryW(path.wstring().c_str());
+  if (!handle) {
+    LOG(WARNING) << "Unable to load AOT module: " << path.string();
+    return nullptr;
+  }
+  auto fn = reinterpret_cast<aot_module_fn_t>(
+      GetProcAddress(static_cast<HMODULE>(handle), aot_module_symbol));
+#else
+  void* handle = dlopen(path.string().c_str(), RTLD_NOW | RTLD_LOCAL);
+  if (!handle) {
+    LOG(WARNING) << "Unable to load AOT module: " << path.string() << ": " << dlerror();
+    return nullptr;
+  }
+  auto fn = reinterpret_cast<aot_module_fn_t>(dlsym(handle, aot_module_symbol));
+#endif
+  // Owns handle from here on, so it's closed if anything below fails.
+  const aot_module_t* module = fn ? fn() : nullptr;
+  auto m = std::make_unique<AotModule>(module, base, handle);
+  if (!module) {
+    LOG(WARNING) << "Not an AOT module: " << path.string();
+    return nullptr;
+  }
+  if (module->abi_version != aot_abi_version) {
+    LOG(WARNING) << fmt::format("AOT module {} was built for ABI version {}, expected {}",
+                                path.string(), module->abi_version, aot_abi_version);
+    return nullptr;
+  }
+  if (module->hash != hash) {
+    LOG(WARNING) << fmt::format("AOT module {} was generated for {:016x}, not {:016x}",
+                                path.string(), module->hash, hash);
+    return nullptr;
+  }
+  return m;
+}
+
+aot_block_fn_t AotModule::find(uint32_t loc, uint32_t len, const uint8_t* code) const {
+  if (!module_ || loc < base_) {
+    return nullptr;
+  }
+  const auto offset = loc - base_;
+  const auto* begin = module_->blocks;
+  const auto* end = begin + module_->num_blocks;
+  const auto* it = std::lower_bound(
+      begin, end, offset, [](const aot_block_t& b, uint32_t o) { return b.offset < o; });
+  if (it == end || it->offset != offset || it->len != len || memcmp(it->code, code, len) != 0) {
+    return nullptr;
+  }
+  return it->fn;
+}
+
+} // namespace door86::cpu::x86
@@ -0,0 +1,115 @@
+#ifndef INCLUDED_CPU_X86_AOT_H
+#define INCLUDED_CPU_X86_AOT_H
+
+#include "cpu/x86/block_cache.h"
+#include "cpu/x86/decoder.h"
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string>
+
+// Marks the entry point of a generated module as exported.
+#ifdef _WIN32
+#define DOOR86_AOT_EXPORT __declspec(dllexport)
+#else
+#define DOOR86_AOT_EXPORT __attribute__((visibility("default")))
+#endif
+
+namespace door86::cpu::x86 {
+
+// Generated modules are compiled against cpu_core and block_t, bump this
+// whenever either of them (or aot_module_t, or aot_block_fn_t) changes.
+constexpr uint32_t aot_abi_version = 3;
+
+// Name of the function every generated module exports, which returns its
+// aot_module_t.
+constexpr const char* aot_module_symbol = "door86_aot_module";
+
+/** A basic block translated ahead of time by the aot tool. */
+struct aot_block_t {
+  // offset of the block from the start of the program image.
+  uint32_t offset;
+  // length in bytes of the guest code it was translated from.
+  uint32_t len;
+  // the guest code, the translation is only used while memory still matches it.
+  const uint8_t* code;
+  aot_block_fn_t fn;
+};
+
+/** Everything a generated module exports. */
+struct aot_module_t {
+  uint32_t abi_version;
+  // image_hash() of the program file the module was generated from.
+  uint64_t hash;
+  size_t num_blocks;
+  // sorted by offset.
+  const aot_block_t* blocks;
+};
+
+using aot_module_fn_t = const aot_module_t* (*)();
+
+/** FNV-1a hash of a program file, used to find the module generated for it */
+uint64_t image_hash(const uint8_t* data, size_t len);
+std::optional<uint64_t> image_hash(const std::filesystem::path& filepath);
+
+/** Filename of the module generated for the program file with hash */
+std::string aot_module_filename(uint64_t hash);
+
+// Called by generated code for the instructions it doesn't translate.
+
+/** Decodes the instruction at code */
+instruction_t aot_decode(const uint8_t* code);
+
+/**
+ * Executes inst using the interpreter's handler, core.ip must already point
+ * past inst. Returns false if memory holding block was written, in which case
+ * the rest of the block is stale and must not run.
+ */
+bool aot_execute(CPU& cpu, const block_t& block, const instruction_t& inst);
+
+/**
+ * Code generated ahead of time by the aot tool for one program image.
+ *
+ * The BlockCache asks the module for a translation whenever it builds a
+ * block. A translation is only handed out if it covers exactly the same
+ * guest code as the block, so anything the tool didn't find, code that has
+ * been patched or relocated, and blocks that are split differently at run
+ * time are all left to the interpreter.
+ */
+class AotModule {
+public:
+  /** Wraps module, for an image loaded at linear address base. */
+  AotModule(const aot_module_t* module, uint32_t base, void* handle = nullptr);
+  ~AotModule();
+  AotModule(const AotModule&) = delete;
+  AotModule& operator=(const AotModule&) = delete;
+
+  /**
+   * Loads the module at path for the program image with hash, loaded at
+   * linear address base. Returns nullptr if the module can't be loaded or
+   * was generated for something else.
+   */
+  static std::unique_ptr<AotModule> load(const std::filesystem::path& path, uint64_t hash,
+                                         uint32_t base);
+
+  /**
+   * Returns the translation of the len bytes of code at linear address loc,
+   * or nullptr if there isn't one.
+   */
+  aot_block_fn_t find(uint32_t loc, uint32_t len, const uint8_t* code) const;
+
+  /** Number of translated blocks */
+  size_t size() const noexcept { return module_->num_blocks; }
+
+private:
+  const aot_module_t* module_;
+  uint32_t base_;
+  // from dlopen or LoadLibrary, or nullptr.
+  void* handle_;
+};
+
+} // namespace door86::cpu::x86
+
+#endif // INCLUDED_CPU_X86_AOT_H
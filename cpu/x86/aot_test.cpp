@@ -0,0 +1,104 @@
+#include <gtest/gtest.h>
+
+#include "cpu/x86/aot.h"
+#include "cpu/x86/cpu.h"
+#include "cpu/x86/cpu_fixture.h"
+#include "cpu/x86/rmm.h"
+#include <string>
+
+using namespace door86::cpu;
+using namespace door86::cpu::x86;
+
+using R16 = Rmm<RmmType::REGISTER, uint16_t>;
+
+// MOV CX, 10; XOR AX, AX; L: ADD AX, CX; DEC CX; JNZ L; INT 20
+static const std::string sum_loop = "B90A00 31C0 01C8 49 75FB CD20";
+
+// What aot generates for the loop body at offset 5 of sum_loop.
+static int loop_calls = 0;
+static const uint8_t loop_code[] = {0x01, 0xc8, 0x49, 0x75, 0xfb};
+
+static uint32_t loop_block(CPU& cpu, const block_t& block) {
+  ++loop_calls;
+  auto& c = cpu.core;
+  auto& r = c.regs.x;
+  // ADD AX, CX
+  static const auto i0 = aot_decode(loop_code + 0);
+  c.ip += 2;
+  if (!aot_execute(cpu, block, i0)) {
+    return 1;
+  }
+  // DEC CX
+  R16(&c, &r.cx).dec();
+  // JNZ L
+  c.ip += 3;
+  if (!c.flags.zflag()) {
+    c.ip = static_cast<uint16_t>(c.ip + -5);
+  }
+  return 3;
+}
+
+static const aot_block_t loop_blocks[] = {{0x00005, 5, loop_code, loop_block}};
+static const aot_module_t loop_module{aot_abi_version, 0, 1, loop_blocks};
+
+class AotTest : public testing::Test {
+public:
+  AotTest() {
+    // INT 20h halts the CPU.
+    c.memory[0x20 * 4] = 0x20;
+    c.int_handlers().try_emplace(0x20, [](int, CPU& cpu) { cpu.halt(); });
+    c.core.regs.x.ax = c.core.regs.x.cx = 0;
+    c.execution_mode = execution_mode_t::threaded;
+    loop_calls = 0;
+  }
+
+  bool load(uint32_t loc, const std::string& s) {
+    const auto ops = parse_opcodes_from_line(s);
+    return c.memory.load_image(loc, ops.size(), ops.data());
+  }
+
+  CPU c;
+};
+
+TEST_F(AotTest, ImageHash) {
+  EXPECT_EQ(0xcbf29ce484222325ull, image_hash(nullptr, 0));
+  const uint8_t a = 'a';
+  EXPECT_EQ(0xaf63dc4c8601ec8cull, image_hash(&a, 1));
+  EXPECT_EQ("00000000000000ff", aot_module_filename(0xff).substr(0, 16));
+}
+
+TEST_F(AotTest, Find) {
+  AotModule m(&loop_module, 0x1000);
+  EXPECT_EQ(1u, m.size());
+  EXPECT_EQ(&loop_block, m.find(0x1005, 5, loop_code));
+  // Wrong place, wrong length.
+  EXPECT_EQ(nullptr, m.find(0x1004, 5, loop_code));
+  EXPECT_EQ(nullptr, m.find(0x1005, 4, loop_code));
+  EXPECT_EQ(nullptr, m.find(0x0005, 5, loop_code));
+  // Different code.
+  const uint8_t patched[] = {0x29, 0xc8, 0x49, 0x75, 0xfb};
+  EXPECT_EQ(nullptr, m.find(0x1005, 5, patched));
+}
+
+TEST_F(AotTest, Run) {
+  ASSERT_TRUE(load(0x1000, sum_loop));
+  c.aot = std::make_unique<AotModule>(&loop_module, 0x1000);
+  EXPECT_TRUE(c.run(0x100, 0));
+  EXPECT_EQ(55, c.core.regs.x.ax);
+  EXPECT_EQ(0, c.core.regs.x.cx);
+  // The first time around is part of the block at the entry point.
+  EXPECT_EQ(9, loop_calls);
+}
+
+TEST_F(AotTest, PatchedCodeIsInterpreted) {
+  // SUB AX, CX instead of ADD.
+  ASSERT_TRUE(load(0x1000, "B90A00 31C0 29C8 49 75FB CD20"));
+  c.aot = std::make_unique<AotModule>(&loop_module, 0x1000);
+  EXPECT_TRUE(c.run(0x100, 0));
+  EXPECT_EQ(static_cast<uint16_t>(-55), c.core.regs.x.ax);
+  EXPECT_EQ(0, loop_calls);
+}
+
+TEST_F(AotTest, LoadMissing) {
+  EXPECT_EQ(nullptr, AotModule::load("does_not_exist.so", 0, 0x1000));
+}
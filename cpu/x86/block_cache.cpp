@@ -0,0 +1,115 @@
+#include "cpu/x86/block_cache.h"
+
+#include "core/log.h"
+#include "cpu/x86/cpu.h"
+#include "cpu/x86/timing.h"
+
+namespace door86::cpu::x86 {
+
+BlockCache::BlockCache(CPU& cpu) : cpu_(cpu) {}
+
+bool BlockCache::ends_block(const instruction_t& inst) {
+  if (inst.metadata->mask & op_mask_notimpl) {
+    return true;
+  }
+  const auto op = inst.op;
+  switch (op >> 4) {
+  // POP CS
+  case 0x0: return op == 0x0F;
+  // Jcc rel8
+  case 0x7: return true;
+  // MOV CS, r/m16
+  case 0x8: return op == 0x8E && inst.mdrm.reg == 1;
+  // CALL far, POPF (may set TF)
+  case 0x9: return op == 0x9A || op == 0x9D;
+  // RET, RETF, INT3, INT, INTO, IRET
+  case 0xC: return op == 0xC2 || op == 0xC3 || op >= 0xCA;
+  // LOOPNE, LOOPE, LOOP, JCXZ, CALL, JMP
+  case 0xE: return op <= 0xE3 || (op >= 0xE8 && op <= 0xEB);
+  // HLT, CALL/JMP r/m16 and m16:16
+  case 0xF: return op == 0xF4 || (op == 0xFF && inst.mdrm.reg >= 2 && inst.mdrm.reg <= 5);
+  }
+  return false;
+}
+
+bool BlockCache::valid(const block_t& block) const {
+  return block.gen == cpu_.memory.code_generation(block.start);
+}
+
+bool BlockCache::build(block_t& block, uint32_t loc) {
+  block.start = loc;
+  block.len = 0;
+  block.entries.clear();
+  block.cycles = 0;
+  block.taken = 0;
+  block.next[0] = block.next[1] = nullptr;
+  block.runs = 0;
+  block.native = nullptr;
+  block.aot = nullptr;
+
+  if (!cpu_.memory.host_backed(loc)) {
+    // What's read from there can change without a write, so run it a step at a time.
+    return false;
+  }
+  // Read the generation before decoding so that the block is thrown away
+  // if anything writes to the page while we're decoding it.
+  block.gen = cpu_.memory.code_generation(loc);
+  const auto page_end = (loc | (Memory::page_size - 1)) + 1;
+  for (auto pos = loc; static_cast<int>(block.entries.size()) < max_block_len;) {
+    if (pos + max_instruction_len > page_end) {
+      // Don't let any instruction cross into the next page, writes there wouldn't
+      // invalidate this block.
+      break;
+    }
+    uint8_t buf[max_instruction_len];
+    const auto inst = cpu_.decoder.decode(cpu_.memory.fetch(pos, buf, max_instruction_len));
+    const auto cycles = instruction_cycles(inst);
+    block.entries.push_back({cpu_.handler(inst), inst, cycles});
+    pos += inst.len;
+    block.len += inst.len;
+    block.cycles += cycles;
+    if (ends_block(inst)) {
+      block.taken = taken_cycles(inst);
+      break;
+    }
+  }
+  if (block.entries.empty()) {
+    return false;
+  }
+  cpu_.memory.mark_code(loc, block.len);
+  if (cpu_.aot) {
+    block.aot = cpu_.aot->find(loc, block.len, cpu_.memory.read_ptr(loc));
+  }
+  ++built_;
+  return true;
+}
+
+block_t* BlockCache::get(uint32_t loc) {
+  auto& block = blocks_[loc];
+  if (!block) {
+    block = std::make_unique<block_t>();
+  } else if (valid(*block) && !block->entries.empty()) {
+    return block.get();
+  }
+  return build(*block, loc) ? block.get() : nullptr;
+}
+
+block_t* BlockCache::next(block_t* from, uint32_t loc) {
+  for (auto* n : from->next) {
+    if (n && n->start == loc && valid(*n)) {
+      ++chained_;
+      return n;
+    }
+  }
+  auto* n = get(loc);
+  if (n) {
+    // keep the most recent successor in the first slot.
+    from->next[1] = from->next[0];
+    from->next[0] = n;
+  }
+  return n;
+}
+
+void BlockCache::clear() { blocks_.clear(); }
+
+} // namespace door86::cpu::x86
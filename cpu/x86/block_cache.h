@@ -0,0 +1,106 @@
+#ifndef INCLUDED_CPU_X86_BLOCK_CACHE_H
+#define INCLUDED_CPU_X86_BLOCK_CACHE_H
+
+#include "cpu/memory.h"
+#include "cpu/x86/decoder.h"
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace door86::cpu::x86 {
+
+class CPU;
+
+// Handler used to execute a single decoded instruction.
+using handler_t = void (CPU::*)(const instruction_t&);
+
+/** A decoded instruction bound to the handler that executes it. */
+struct block_entry_t {
+  handler_t fn;
+  instruction_t inst;
+  // 8088 cycles for inst, see timing.h.
+  uint32_t cycles{0};
+};
+
+struct block_t;
+
+// Ahead of time translated code for a block, see aot.h. Returns how many of
+// the block's entries ran, fewer than all of them when one wrote to the
+// block's code.
+using aot_block_fn_t = uint32_t (*)(CPU& cpu, const block_t& block);
+
+/**
+ * A basic block: a straight run of instructions that ends at the first
+ * instruction that may transfer control (branches, CALL, RET, LOOP, INT,
+ * IRET, ...), at the end of a memory page, or when the block is full.
+ */
+struct block_t {
+  // linear address of the first instruction.
+  uint32_t start{0};
+  // memory code generation of the page holding this block when it was built.
+  uint32_t gen{0};
+  // total length in bytes of all instructions.
+  uint32_t len{0};
+  std::vector<block_entry_t> entries;
+  // total 8088 cycles for all instructions.
+  uint32_t cycles{0};
+  // extra cycles if the block ends in a conditional branch that's taken.
+  uint32_t taken{0};
+  // Blocks that have followed this one, used to chain directly to the next
+  // block without looking it up again.
+  block_t* next[2]{nullptr, nullptr};
+  // Times this block has been executed, used by the Jit to find hot blocks.
+  uint32_t runs{0};
+  // Native code generated by the Jit for this block, or nullptr.
+  const uint8_t* native{nullptr};
+  // Code translated ahead of time for this block, or nullptr.
+  aot_block_fn_t aot{nullptr};
+};
+
+/**
+ * Translates guest code into blocks of pre-bound handlers, indexed by linear
+ * address. Blocks are rebuilt when the memory page holding them is written.
+ */
+class BlockCache {
+public:
+  // Most instructions to put into a single block.
+  static constexpr int max_block_len = 64;
+
+  explicit BlockCache(CPU& cpu);
+  ~BlockCache() = default;
+
+  /**
+   * Returns the block starting at linear address loc (after the A20 line, see
+   * Memory::mask), building it if needed. Returns nullptr if no block can be
+   * built at loc (i.e. the instruction crosses a page boundary, or the page
+   * isn't RAM or ROM), in which case the caller should single step.
+   */
+  block_t* get(uint32_t loc);
+
+  /** Returns the block at loc that follows from, using from's chained successors */
+  block_t* next(block_t* from, uint32_t loc);
+
+  /** Drops all blocks */
+  void clear();
+
+  /** Returns true if inst ends a basic block */
+  static bool ends_block(const instruction_t& inst);
+
+  // Statistics
+  uint64_t built() const noexcept { return built_; }
+  uint64_t chained() const noexcept { return chained_; }
+
+private:
+  bool build(block_t& block, uint32_t loc);
+  bool valid(const block_t& block) const;
+
+  CPU& cpu_;
+  std::unordered_map<uint32_t, std::unique_ptr<block_t>> blocks_;
+  uint64_t built_{0};
+  uint64_t chained_{0};
+};
+
+} // namespace door86::cpu::x86
+
+#endif // INCLUDED_CPU_X86_BLOCK_CACHE_H
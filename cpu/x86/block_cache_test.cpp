@@ -0,0 +1,132 @@
+#include <gtest/gtest.h>
+
+#include "cpu/x86/block_cache.h"
+#include "cpu/x86/cpu.h"
+#include "cpu/x86/cpu_fixture.h"
+#include <iostream>
+
+using namespace door86::cpu;
+using namespace door86::cpu::x86;
+
+class BlockCacheTest : public testing::Test {
+public:
+  BlockCacheTest() {
+    // INT 20h halts the CPU.
+    c.memory[0x20 * 4] = 0x20;
+    c.int_handlers().try_emplace(0x20, [](int, CPU& cpu) { cpu.halt(); });
+  }
+
+  bool load(uint32_t loc, const std::string& s) {
+    const auto ops = parse_opcodes_from_line(s);
+    return c.memory.load_image(loc, ops.size(), ops.data());
+  }
+
+  CPU c;
+};
+
+// MOV CX, 10; XOR AX, AX; L: ADD AX, CX; DEC CX; JNZ L; INT 20
+static const std::string sum_loop = "B90A00 31C0 01C8 49 75FB CD20";
+
+TEST_F(BlockCacheTest, EndsBlock) {
+  const auto ops = parse_opcodes_from_line("75FB");
+  EXPECT_TRUE(BlockCache::ends_block(c.decoder.decode(ops)));
+  EXPECT_FALSE(BlockCache::ends_block(c.decoder.decode(parse_opcodes_from_line("01C8"))));
+  EXPECT_TRUE(BlockCache::ends_block(c.decoder.decode(parse_opcodes_from_line("CD21"))));
+  // FF /2 CALL r/m16 ends a block, FF /0 INC doesn't.
+  EXPECT_TRUE(BlockCache::ends_block(c.decoder.decode(parse_opcodes_from_line("FFD0"))));
+  EXPECT_FALSE(BlockCache::ends_block(c.decoder.decode(parse_opcodes_from_line("FFC0"))));
+}
+
+TEST_F(BlockCacheTest, Build) {
+  ASSERT_TRUE(load(0x1000, sum_loop));
+  auto* b = c.blocks.get(0x1000);
+  ASSERT_NE(nullptr, b);
+  EXPECT_EQ(5u, b->entries.size());
+  EXPECT_EQ(10u, b->len);
+  EXPECT_EQ(b, c.blocks.get(0x1000));
+  EXPECT_EQ(1u, c.blocks.built());
+}
+
+TEST_F(BlockCacheTest, Threaded) {
+  ASSERT_TRUE(load(0x1000, sum_loop));
+  c.execution_mode = execution_mode_t::threaded;
+  EXPECT_TRUE(c.run(0x100, 0));
+  EXPECT_EQ(55, c.core.regs.x.ax);
+  EXPECT_EQ(0, c.core.regs.x.cx);
+  // The loop body should have chained back to itself.
+  EXPECT_GT(c.blocks.chained(), 0u);
+}
+
+TEST_F(BlockCacheTest, Interpreted) {
+  ASSERT_TRUE(load(0x1000, sum_loop));
+  c.execution_mode = execution_mode_t::interpreted;
+  EXPECT_TRUE(c.run(0x100, 0));
+  EXPECT_EQ(55, c.core.regs.x.ax);
+  EXPECT_EQ(0, c.core.regs.x.cx);
+  EXPECT_EQ(0u, c.blocks.built());
+}
+
+TEST_F(BlockCacheTest, Invalidate) {
+  ASSERT_TRUE(load(0x1000, sum_loop));
+  auto* b = c.blocks.get(0x1000);
+  ASSERT_NE(nullptr, b);
+  // Change MOV CX, 10 to MOV CX, 4
+  c.memory.set<uint16_t>(0x100, 1, 4);
+  b = c.blocks.get(0x1000);
+  EXPECT_EQ(4, b->entries.front().inst.imm16);
+  EXPECT_EQ(2u, c.blocks.built());
+}
+
+TEST_F(BlockCacheTest, DataWriteToCodePage) {
+  // MOV CX, 10; L: INC WORD [1020]; DEC CX; JNZ L; INT 20, with the counter
+  // in the same page as the loop.
+  ASSERT_TRUE(load(0x1000, "B90A00 FF062010 49 75F9 CD20"));
+  c.execution_mode = execution_mode_t::threaded;
+  EXPECT_TRUE(c.run(0x100, 0));
+  EXPECT_EQ(10, c.memory.get<uint16_t>(0x100, 0x20));
+  // The loop body was built once and chained to itself every trip.
+  EXPECT_EQ(3u, c.blocks.built());
+  EXPECT_GT(c.blocks.chained(), 0u);
+}
+
+// MOV AX, imm16; L: JMP L, runs the MOV and one trip around the loop.
+static uint16_t run_mov(CPU& c, uint16_t cs, uint16_t ip) {
+  c.core.sregs.cs = cs;
+  c.core.ip = ip;
+  c.core.regs.x.ax = 0;
+  budget_t budget;
+  budget.instructions = 2;
+  c.run_for(budget);
+  return c.core.regs.x.ax;
+}
+
+TEST_F(BlockCacheTest, FetchWrapsWithoutA20) {
+  ASSERT_TRUE(load(0x1000, "B83412 EBFE"));
+  ASSERT_TRUE(load(0x101000, "B87856 EBFE"));
+  for (const auto mode : {execution_mode_t::interpreted, execution_mode_t::threaded}) {
+    c.execution_mode = mode;
+    c.memory.set_a20(false);
+    // FFFF:1010 is 0000:1000 with A20 off, like data accesses.
+    EXPECT_EQ(0x1234, run_mov(c, 0xFFFF, 0x1010));
+    c.memory.set_a20(true);
+    EXPECT_EQ(0x5678, run_mov(c, 0xFFFF, 0x1010));
+  }
+}
+
+TEST_F(BlockCacheTest, FetchFromRegion) {
+  auto code = parse_opcodes_from_line("B83412 EBFE");
+  c.memory.map_region(0x20000, Memory::page_size,
+                      {[&code](uint32_t loc) {
+                         const auto off = loc - 0x20000;
+                         return off < code.size() ? code[off] : uint8_t{0x90};
+                       },
+                       [](uint32_t, uint8_t) {}});
+  for (const auto mode : {execution_mode_t::interpreted, execution_mode_t::threaded}) {
+    c.execution_mode = mode;
+    code[1] = 0x34;
+    EXPECT_EQ(0x1234, run_mov(c, 0x2000, 0));
+    // The region changes what it reads without a write, so nothing's cached.
+    code[1] = 0x78;
+    EXPECT_EQ(0x1278, run_mov(c, 0x2000, 0));
+  }
+}
@@ -0,0 +1,69 @@
+#include "cpu/x86/code_buffer.h"
+
+#include "core/log.h"
+#include <cstring>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+namespace door86::cpu::x86 {
+
+CodeBuffer::CodeBuffer(size_t size) : size_(size) {
+#ifdef _WIN32
+  base_ = static_cast<uint8_t*>(VirtualAlloc(nullptr, size, MEM_COMMIT | MEM_RESERVE, PAGE_READONLY));
+#else
+  void* p = mmap(nullptr, size, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  base_ = p == MAP_FAILED ? nullptr : static_cast<uint8_t*>(p);
+#endif
+  if (!base_) {
+    LOG(WARNING) << "Unable to allocate " << size << " bytes for generated code.";
+    size_ = 0;
+  }
+}
+
+CodeBuffer::~CodeBuffer() {
+  if (!base_) {
+    return;
+  }
+#ifdef _WIN32
+  VirtualFree(base_, 0, MEM_RELEASE);
+#else
+  munmap(base_, size_);
+#endif
+}
+
+bool CodeBuffer::protect(bool writable) {
+#ifdef _WIN32
+  DWORD old;
+  return VirtualProtect(base_, size_, writable ? PAGE_READWRITE : PAGE_EXECUTE_READ, &old) != 0;
+#else
+  return mprotect(base_, size_, writable ? (PROT_READ | PROT_WRITE) : (PROT_READ | PROT_EXEC)) == 0;
+#endif
+}
+
+const uint8_t* CodeBuffer::add(const std::vector<uint8_t>& code) {
+  if (!base_ || used_ + code.size() > size_) {
+    return nullptr;
+  }
+  if (!protect(true)) {
+    LOG(WARNING) << "Unable to make the code buffer writable.";
+    return nullptr;
+  }
+  auto* p = base_ + used_;
+  memcpy(p, code.data(), code.size());
+  // Keep each block 16 byte aligned.
+  used_ = (used_ + code.size() + 15) & ~static_cast<size_t>(15);
+  if (!protect(false)) {
+    LOG(WARNING) << "Unable to make the code buffer executable.";
+    return nullptr;
+  }
+#ifdef _WIN32
+  FlushInstructionCache(GetCurrentProcess(), p, code.size());
+#endif
+  return p;
+}
+
+} // namespace door86::cpu::x86
@@ -0,0 +1,49 @@
+#ifndef INCLUDED_CPU_X86_CODE_BUFFER_H
+#define INCLUDED_CPU_X86_CODE_BUFFER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace door86::cpu::x86 {
+
+/**
+ * Executable memory for generated host code.
+ *
+ * The buffer is never writable and executable at the same time (W^X): it is
+ * executable except while add() copies new code into it. Code is allocated
+ * by bumping a pointer and is only ever freed all at once by clear().
+ */
+class CodeBuffer {
+public:
+  explicit CodeBuffer(size_t size);
+  ~CodeBuffer();
+  CodeBuffer(const CodeBuffer&) = delete;
+  CodeBuffer& operator=(const CodeBuffer&) = delete;
+
+  /** true if the executable memory was allocated */
+  bool ok() const noexcept { return base_ != nullptr; }
+
+  /**
+   * Copies code into the buffer and returns a pointer to it, or nullptr if
+   * the buffer is full.
+   */
+  const uint8_t* add(const std::vector<uint8_t>& code);
+
+  /** Throws away all code in the buffer */
+  void clear() noexcept { used_ = 0; }
+
+  size_t size() const noexcept { return size_; }
+  size_t used() const noexcept { return used_; }
+
+private:
+  bool protect(bool writable);
+
+  uint8_t* base_{nullptr};
+  size_t size_{0};
+  size_t used_{0};
+};
+
+} // namespace door86::cpu::x86
+
+#endif // INCLUDED_CPU_X86_CODE_BUFFER_H
@@ -1,10 +1,15 @@
 #include "cpu/x86/cpu.h"
 #include "cpu/x86/rmm.h"
+#include "cpu/x86/string_ops.h"
+#include "cpu/x86/timing.h"
 
 #include "core/log.h"
 #include "fmt/format.h"
+#include <algorithm>
+#include <array>
 #include <iostream>
 #include <iomanip>
+#include <utility>
 
 #ifdef _MSC_VER
 #include <intrin.h>
@@ -13,12 +18,18 @@
 
 namespace door86::cpu::x86 {
 
-CPU::CPU() : core(), decoder(), memory(1 << 20) {}
+CPU::CPU()
+    : core(), decoder(false), memory(Memory::max_size), icache(decoder, memory), blocks(*this), jit(*this),
+      idle(*this) {}
+
+CPU::CPU(std::shared_ptr<const MemoryImage> base)
+    : core(), decoder(false), memory(std::move(base)), icache(decoder, memory), blocks(*this),
+      jit(*this), idle(*this) {}
 
 // TODO(rushfan): Make generic way to set flags after operations
 // mostly add
-void CPU::execute_0x0(const instruction_t& inst) {
-  switch (inst.op & 0x0f) {
+template <uint8_t OP> void CPU::execute_0x0(const instruction_t& inst) {
+  switch (OP & 0x0f) {
   // "0x00":"add r/m8, r8",
   case 0x0: {
     auto rm = rmm8(inst);
@@ -99,59 +110,40 @@ void CPU::execute_0x0(const instruction_t& inst) {
   }
 }
 
-void CPU::execute_0x1(const instruction_t& inst) {
-  const bool cf = core.flags.cflag();
+template <uint8_t OP> void CPU::execute_0x1(const instruction_t& inst) {
   // 0x10-0x15: ADC
-  switch (inst.op & 0x0f) {
+  switch (OP & 0x0f) {
   // "0x10":"ADC r/m8, r8",
   case 0x0: {
     auto rm = rmm8(inst);
-    rm += r8(inst);
-    if (cf) {
-      rm += 1;
-    }
+    rm.adc(r8(inst).get());
   } break;
   // "0x01" : "add r/m16/32, r16/32",
   case 0x1: {
     auto rm = rmm16(inst);
-    rm += r16(inst);
-    if (cf) {
-      rm += 1;
-    }
+    rm.adc(r16(inst).get());
   } break;
   // 02/r":"add r8, r/m8
   case 0x2: {
     auto r = r8(inst);
     const auto rm = rmm8(inst);
-    r += rm;
-    if (cf) {
-      r += 1;
-    }
+    r.adc(rm.get());
   } break;
   // 03":"adc r16/32, r/m16/32
   case 0x3: {
     auto r = r16(inst);
     auto rm = rmm16(inst);
-    r += rm;
-    if (cf) {
-      r += 1;
-    }
+    r.adc(rm.get());
   } break;
   // 14":"ADC al, imm8
   case 0x4: {
     auto r = r8(&core.regs.h.al);
-    r += inst.imm8;
-    if (cf) {
-      r += 1;
-    }
+    r.adc(inst.imm8);
   } break;
   // 15":"ADC ax, imm16/32
   case 0x5: {
     auto r = r16(&core.regs.x.ax);
-    r += inst.imm16;
-    if (cf) {
-      r += 1;
-    }
+    r.adc(inst.imm16);
   } break;
   // 0x16: PUSH SS
   case 0x6: push(core.sregs.ss); break;
@@ -165,58 +157,40 @@ void CPU::execute_0x1(const instruction_t& inst) {
   // 0x18: SBB r/m8	r8
   case 0x8: {
     auto rm = rmm8(inst);
-    rm -= r8(inst);
-    if (cf) {
-      rm -= 1;
-    }
+    rm.sbb(r8(inst).get());
   } break;
   // "0x19" : "SBB r/m16/32, r16/32",
   case 0x9: {
     auto rm = rmm16(inst);
-    rm -= r16(inst);
-    if (cf) {
-      rm -= 1;
-    }
+    rm.sbb(r16(inst).get());
   } break;
   // 0x1A":"SBB r8, r/m8
   case 0xa: {
     auto r = r8(inst);
     const auto rm = rmm8(inst);
-    r -= rm;
-    if (cf) {
-      r -= 1;
-    }
+    r.sbb(rm.get());
   } break;
   // 1B":"SBB r16/32, r/m16/32
   case 0xb: {
     auto r = r16(inst);
     auto rm = rmm16(inst);
-    r -= rm;
-    if (cf) {
-      r -= 1;
-    }
+    r.sbb(rm.get());
   } break;
   // 1C":"SBB al, imm8
   case 0xc: {
     auto r = r8(&core.regs.h.al);
-    r -= inst.imm8;
-    if (cf) {
-      r -= 1;
-    }
+    r.sbb(inst.imm8);
   } break;
   // 1D":"SBB ax, imm16/32
   case 0xd: {
     auto r = r16(&core.regs.x.ax);
-    r -= inst.imm16;
-    if (cf) {
-      r -= 1;
-    }
+    r.sbb(inst.imm16);
   } break;
   default: LOG(WARNING) << fmt::format("Skipped OPCODE: 0x{:02x}", static_cast<int>(inst.op)); break;
   }
 }
-void CPU::execute_0x2(const instruction_t& inst) {
-  switch (inst.op & 0x0f) {
+template <uint8_t OP> void CPU::execute_0x2(const instruction_t& inst) {
+  switch (OP & 0x0f) {
     // 0x22: AND r/m8, r8
   case 0x0: {
     auto rm = rmm8(inst);
@@ -290,8 +264,8 @@ void CPU::execute_0x2(const instruction_t& inst) {
   }
 }
 
-void CPU::execute_0x3(const instruction_t& inst) {
-  switch (inst.op & 0x0f) {
+template <uint8_t OP> void CPU::execute_0x3(const instruction_t& inst) {
+  switch (OP & 0x0f) {
   case 0x0: {
     const auto r = core.regs.h.get(inst.mdrm.reg);
     auto rm = rmm8(inst);
@@ -362,21 +336,21 @@ void CPU::execute_0x3(const instruction_t& inst) {
 }
 
 // INC and DEC
-void CPU::execute_0x4(const instruction_t& inst) {
-  const auto dec = inst.op & 0x08;
-  const auto regnum = inst.op & 0x07;
+template <uint8_t OP> void CPU::execute_0x4(const instruction_t& inst) {
+  constexpr auto dec = OP & 0x08;
+  constexpr auto regnum = OP & 0x07;
   auto r = r16(core.regs.x.regptr(regnum));
   if (dec) {
-    r -= 1;
+    r.dec();
   } else {
-    r += 1;  
+    r.inc();
   }
 }
 
 // PUSH and POP
-void CPU::execute_0x5(const instruction_t& inst) {
-  const auto popd = inst.op & 0x08;
-  const auto regnum = inst.op & 0x07;
+template <uint8_t OP> void CPU::execute_0x5(const instruction_t& inst) {
+  constexpr auto popd = OP & 0x08;
+  constexpr auto regnum = OP & 0x07;
   auto r = r16(core.regs.x.regptr(regnum));
   if (popd) {
     r.set(pop());
@@ -385,8 +359,8 @@ void CPU::execute_0x5(const instruction_t& inst) {
   }
 }
 
-void CPU::execute_0x6(const instruction_t& inst) {
-  switch (inst.op & 0x0f) {
+template <uint8_t OP> void CPU::execute_0x6(const instruction_t& inst) {
+  switch (OP & 0x0f) {
   // PUSHA
   case 0x0: {
     const auto temp = core.regs.x.sp;
@@ -421,9 +395,9 @@ void CPU::execute_0x6(const instruction_t& inst) {
   }
 }
 
-void CPU::execute_0x7(const instruction_t& inst) {
+template <uint8_t OP> void CPU::execute_0x7(const instruction_t& inst) {
   bool cond = false;
-  switch (inst.op & 0x0f) {
+  switch (OP & 0x0f) {
   case 0x0: cond = core.flags.oflag(); break;
   case 0x1: cond = !core.flags.oflag(); break;
   case 0x2: cond = core.flags.cflag(); break;
@@ -450,8 +424,8 @@ void CPU::execute_0x7(const instruction_t& inst) {
   }
 }
 
-void CPU::execute_0x80(const instruction_t& inst, int subop) {
-  switch (inst.mdrm.reg) {
+template <int REG> void CPU::execute_0x80(const instruction_t& inst) {
+  switch (REG) {
   // 80 /0 ib: ADD r/m8, imm8
   case 0x0: {
     auto rm = rmm8(inst);
@@ -464,37 +438,26 @@ void CPU::execute_0x80(const instruction_t& inst, int subop) {
   } break;
   // 80 /2 ib: ADS r/m8, imm8
   case 0x2: {
-    const auto cf = core.flags.cflag();
     auto rm = rmm8(inst);
-    rm += inst.imm8;
-    if (cf) {
-      rm += 1;
-    }
+    rm.adc(inst.imm8);
   } break;
   // 80 /3 ib: SBB r/m8, imm8
   case 0x3: {
-    const auto cf = core.flags.cflag();
     auto rm = rmm8(inst);
-    rm -= inst.imm8;
-    if (cf) {
-      rm -= 1;
-    }
+    rm.sbb(inst.imm8);
   } break;
   // 80 /4 ib: AND r/m8, imm8
   case 0x4: {
-    const auto cf = core.flags.cflag();
     auto rm = rmm8(inst);
     rm &= inst.imm8;
   } break;
   // 80 /5 ib: SUB r/m8, imm8
   case 0x5: {
-    const auto cf = core.flags.cflag();
     auto rm = rmm8(inst);
     rm -= inst.imm8;
   } break;
   // 80 /6 ib: XOR r/m8, imm8
   case 0x6: {
-    const auto cf = core.flags.cflag();
     auto rm = rmm8(inst);
     rm ^= inst.imm8;
   } break;
@@ -509,8 +472,8 @@ void CPU::execute_0x80(const instruction_t& inst, int subop) {
   }
 }
 
-void CPU::execute_0x81(const instruction_t& inst, int subop) {
-  switch (inst.mdrm.reg) {
+template <int REG> void CPU::execute_0x81(const instruction_t& inst) {
+  switch (REG) {
   // 81 /0 iw: ADD r/m16, imm16
   case 0x0: {
     auto rm = rmm16(inst);
@@ -523,37 +486,26 @@ void CPU::execute_0x81(const instruction_t& inst, int subop) {
   } break;
   // 81 /2 iw: ADS r/m16, imm16
   case 0x2: {
-    const auto cf = core.flags.cflag();
     auto rm = rmm16(inst);
-    rm += inst.imm16;
-    if (cf) {
-      rm += 1;
-    }
+    rm.adc(inst.imm16);
   } break;
   // 81 /3 iw: SBB r/m16, imm16
   case 0x3: {
-    const auto cf = core.flags.cflag();
     auto rm = rmm16(inst);
-    rm -= inst.imm16;
-    if (cf) {
-      rm -= 1;
-    }
+    rm.sbb(inst.imm16);
   } break;
   // 81 /4 iw: AND r/m16, imm16
   case 0x4: {
-    const auto cf = core.flags.cflag();
     auto rm = rmm16(inst);
     rm &= inst.imm16;
   } break;
   // 81 /5 iw: SUB r/m16, imm16
   case 0x5: {
-    const auto cf = core.flags.cflag();
     auto rm = rmm16(inst);
     rm -= inst.imm16;
   } break;
   // 81 /6 iw: XOR r/m16, imm16
   case 0x6: {
-    const auto cf = core.flags.cflag();
     auto rm = rmm16(inst);
     rm ^= inst.imm16;
   } break;
@@ -568,61 +520,48 @@ void CPU::execute_0x81(const instruction_t& inst, int subop) {
   }
 }
 
-void CPU::execute_0x82(const instruction_t& inst, int subop) { LOG(FATAL) << "Implement me"; }
-
-void CPU::execute_0x83(const instruction_t& inst, int subop) {
+template <int REG> void CPU::execute_0x83(const instruction_t& inst) {
   // only add if reg == 0
-  switch (inst.mdrm.reg) {
+  switch (REG) {
   // 83/0":"add r/m16/32, imm8
   case 0x0: {
     auto regmem16 = rmm16(inst);
-    regmem16 += static_cast<uint16_t>(inst.imm8);
+    regmem16 += static_cast<uint16_t>(static_cast<int8_t>(inst.imm8));
   } break;
   // 83 /1 i2: OR r/m16, imm8
   case 0x1: {
     auto rm = rmm16(inst);
-    rm |= static_cast<uint16_t>(inst.imm8);
+    rm |= static_cast<uint16_t>(static_cast<int8_t>(inst.imm8));
   } break;
   // 83 /2 iw: ADS r/m16, imm8
   case 0x2: {
-    const auto cf = core.flags.cflag();
     auto rm = rmm16(inst);
-    rm += static_cast<uint16_t>(inst.imm8);
-    if (cf) {
-      rm += 1;
-    }
+    rm.adc(static_cast<uint16_t>(static_cast<int8_t>(inst.imm8)));
   } break;
   // 83 /3 iw: SBB r/m16, imm8
   case 0x3: {
-    const auto cf = core.flags.cflag();
     auto rm = rmm16(inst);
-    rm -= static_cast<uint16_t>(inst.imm8);
-    if (cf) {
-      rm -= 1;
-    }
+    rm.sbb(static_cast<uint16_t>(static_cast<int8_t>(inst.imm8)));
   } break;
   // 83 /4 iw: AND r/m16, imm8
   case 0x4: {
-    const auto cf = core.flags.cflag();
     auto rm = rmm16(inst);
-    rm &= static_cast<uint16_t>(inst.imm8);
+    rm &= static_cast<uint16_t>(static_cast<int8_t>(inst.imm8));
   } break;
   // 83 /5 iw: SUB r/m16, imm8
   case 0x5: {
-    const auto cf = core.flags.cflag();
     auto rm = rmm16(inst);
-    rm -= static_cast<uint16_t>(inst.imm8);
+    rm -= static_cast<uint16_t>(static_cast<int8_t>(inst.imm8));
   } break;
   // 83 /6 iw: XOR r/m16, imm8
   case 0x6: {
-    const auto cf = core.flags.cflag();
     auto rm = rmm16(inst);
-    rm ^= static_cast<uint16_t>(inst.imm8);
+    rm ^= static_cast<uint16_t>(static_cast<int8_t>(inst.imm8));
   } break;
   // 83 /7 iw: CMP r/m16, imm8
   case 0x7: {
     auto rm = rmm16(inst);
-    rm.cmp(static_cast<uint16_t>(inst.imm8));
+    rm.cmp(static_cast<uint16_t>(static_cast<int8_t>(inst.imm8)));
   } break;
   default: {
     VLOG(1) << "Unhandled submode of 0x83: " << inst.mdrm.reg;
@@ -630,29 +569,17 @@ void CPU::execute_0x83(const instruction_t& inst, int subop) {
   }
 }
 
-void CPU::execute_0x8(const instruction_t& inst) {
-  switch (inst.op & 0x0f) {
-  // 0x80/M
-  case 0x0: execute_0x80(inst, inst.mdrm.reg); break;
-  // 0x81/M
-  case 0x1: execute_0x81(inst, inst.mdrm.reg); break; 
-  // 0x83/M
-  case 0x3: execute_0x83(inst, inst.mdrm.reg); break;
+template <uint8_t OP> void CPU::execute_0x8(const instruction_t& inst) {
+  switch (OP & 0x0f) {
   // 0x84 /r: TEST r/m8, r8
   case 0x4: {
     auto rmm = rmm8(inst);
-    const auto saved_rmm = rmm.get();
-    auto r = r8(inst);
-    rmm &= r;
-    rmm.set(saved_rmm);
+    rmm.test(r8(inst).get());
   } break;
   // 0x85 /r: TEST r/m16, r16
   case 0x5: {
     auto rmm = rmm16(inst);
-    const auto saved_rmm = rmm.get();
-    auto r = r16(inst);
-    rmm &= r;
-    rmm.set(saved_rmm);
+    rmm.test(r16(inst).get());
   } break;
   // XCHG r8, r/m8
   case 0x6: {
@@ -719,8 +646,8 @@ void CPU::execute_0x8(const instruction_t& inst) {
   }
 }
 
-void CPU::execute_0x9(const instruction_t& inst) {
-  const auto last = inst.op & 0x0f;
+template <uint8_t OP> void CPU::execute_0x9(const instruction_t& inst) {
+  constexpr auto last = OP & 0x0f;
   if (last == 0) {
     // NOP
     return;
@@ -732,15 +659,15 @@ void CPU::execute_0x9(const instruction_t& inst) {
     swap(left, right);
     return;
   } 
-  switch (inst.op & 0x0f) {
+  switch (OP & 0x0f) {
   // 98: CBW: AX = sign-extend of AL.
   case 0x8: core.regs.h.ah = (core.regs.h.al & 0x80) ? 0xff : 0x00; break;
   // 99: CWD: DX:AX = sign-extend of AX.
   case 0x9: core.regs.x.dx = (core.regs.x.ax & 0x8000) ? 0xffff : 0x0000; break;
   // 9C: Push lower 16 bits of EFLAGS.
-  case 0xC: push(core.flags.value_); break;
+  case 0xC: push(core.flags.value()); break;
   // 9D: Pop top of stack into lower 16 bits of EFLAGS.
-  case 0xD: core.flags.value_ = pop(); break;
+  case 0xD: core.flags.value(pop()); break;
   default:
     LOG(WARNING) << fmt::format("Skipped OPCODE: 0x{:02x}", static_cast<int>(inst.op));
     break;
@@ -771,8 +698,8 @@ void CPU::scas_m16(const instruction_t& inst) {
   core.regs.x.di += step;
 }
 
-void CPU::execute_0xA(const instruction_t& inst) {
-  switch (inst.op & 0x0f) {
+template <uint8_t OP> void CPU::execute_0xA(const instruction_t& inst) {
+  switch (OP & 0x0f) {
   case 0x0: {
     const auto seg = core.sregs.get(inst.seg_index());
     core.regs.h.al = memory.get<uint8_t>(seg, inst.imm16);
@@ -809,9 +736,10 @@ void CPU::execute_0xA(const instruction_t& inst) {
   // CMPS m8, m8
   case 0x6: {
     const int16_t step = core.flags.dflag() ? -1 : 1;
-    auto left = mem16(core.sregs.ds, core.regs.x.si);
-    const auto right = mem16(core.sregs.es, core.regs.x.di);
+    auto left = mem8(core.sregs.ds, core.regs.x.si);
+    const auto right = mem8(core.sregs.es, core.regs.x.di);
     left.cmp(right);
+    core.regs.x.si += step;
     core.regs.x.di += step;
   } break;
   // CMPS m16, m16
@@ -820,6 +748,7 @@ void CPU::execute_0xA(const instruction_t& inst) {
     auto left = mem16(core.sregs.ds, core.regs.x.si);
     const auto right = mem16(core.sregs.es, core.regs.x.di);
     left.cmp(right);
+    core.regs.x.si += step;
     core.regs.x.di += step;
   } break;
   // A8 ib: TEST AL, imm8
@@ -870,9 +799,9 @@ void CPU::execute_0xA(const instruction_t& inst) {
   }
 }
 
-void CPU::execute_0xB(const instruction_t& inst) {
-  const auto wide = inst.op & 0x08;
-  const auto regnum = inst.op & 0x07;
+template <uint8_t OP> void CPU::execute_0xB(const instruction_t& inst) {
+  constexpr auto wide = OP & 0x08;
+  constexpr auto regnum = OP & 0x07;
   if (wide) {
     core.regs.x.set(regnum, inst.imm16);
   } else {
@@ -880,10 +809,8 @@ void CPU::execute_0xB(const instruction_t& inst) {
   }
 }
 
-void CPU::execute_0xC(const instruction_t& inst) {
-  switch (inst.op & 0x0f) {
-  case 0x0: return execute_0xC0(inst, inst.mdrm.reg);
-  case 0x1: return execute_0xC1(inst, inst.mdrm.reg);
+template <uint8_t OP> void CPU::execute_0xC(const instruction_t& inst) {
+  switch (OP & 0x0f) {
   // RET (near call and clear some bytes of stack)
   case 0x2: {
     core.ip = pop();
@@ -947,12 +874,18 @@ void CPU::execute_0xC(const instruction_t& inst) {
   } break;
   // "CD":"int imm8",
   case 0xC: call_interrupt(0x03); break;
-  case 0xD: call_interrupt(inst.imm8); break;
+  case 0xD:
+    call_interrupt(inst.imm8);
+    if (stop_ == stop_reason_t::waiting) {
+      // The service is waiting for input, run it again when we resume.
+      core.ip -= inst.len;
+    }
+    break;
   // CF: IRET: Interrupt return (16-bit operand size).
   case 0xF: {
     core.ip = pop();
     core.sregs.cs = pop();
-    core.flags.value_ = pop();
+    core.flags.value(pop());
     if (VLOG_IS_ON(1)) {
       VLOG(1) << fmt::format("IRET num: SP: {:02x}", core.regs.x.sp);
     }
@@ -961,9 +894,9 @@ void CPU::execute_0xC(const instruction_t& inst) {
   }
 }
 
-void CPU::execute_0xC0(const instruction_t& inst, int subop) {
+template <int REG> void CPU::execute_0xC0(const instruction_t& inst) {
   auto r = rmm8(inst);
-  switch (subop) {
+  switch (REG) {
   case 0: r.rol(inst.disp8); break;
   case 1: r.ror(inst.disp8); break;
   case 2: r.rcl(inst.disp8); break;
@@ -975,9 +908,9 @@ void CPU::execute_0xC0(const instruction_t& inst, int subop) {
   }
 }
 
-void CPU::execute_0xC1(const instruction_t& inst, int subop) {
+template <int REG> void CPU::execute_0xC1(const instruction_t& inst) {
   auto r = rmm16(inst);
-  switch (subop) {
+  switch (REG) {
   case 0: r.rol(inst.disp8); break;
   case 1: r.ror(inst.disp8); break;
   case 2: r.rcl(inst.disp8); break;
@@ -989,9 +922,9 @@ void CPU::execute_0xC1(const instruction_t& inst, int subop) {
   }
 }
 
-void CPU::execute_0xD0(const instruction_t& inst, int subop) {
+template <int REG> void CPU::execute_0xD0(const instruction_t& inst) {
   auto r = rmm8(inst);
-  switch (subop) {
+  switch (REG) {
   case 0: r.rol(1); break;
   case 1: r.ror(1); break;
   case 2: r.rcl(1); break;
@@ -1004,9 +937,9 @@ void CPU::execute_0xD0(const instruction_t& inst, int subop) {
   }
 }
 
-void CPU::execute_0xD1(const instruction_t& inst, int subop) {
+template <int REG> void CPU::execute_0xD1(const instruction_t& inst) {
   auto r = rmm16(inst);
-  switch (subop) {
+  switch (REG) {
   case 0: r.rol(1); break;
   case 1: r.ror(1); break;
   case 2: r.rcl(1); break;
@@ -1019,9 +952,9 @@ void CPU::execute_0xD1(const instruction_t& inst, int subop) {
   }
 }
 
-void CPU::execute_0xD2(const instruction_t& inst, int subop) {
+template <int REG> void CPU::execute_0xD2(const instruction_t& inst) {
   auto r = rmm8(inst);
-  switch (subop) {
+  switch (REG) {
   case 0: r.rol(core.regs.h.cl); break;
   case 1: r.ror(core.regs.h.cl); break;
   case 2: r.rcl(core.regs.h.cl); break;
@@ -1034,9 +967,9 @@ void CPU::execute_0xD2(const instruction_t& inst, int subop) {
   }
 }
 
-void CPU::execute_0xD3(const instruction_t& inst, int subop) {
+template <int REG> void CPU::execute_0xD3(const instruction_t& inst) {
   auto r = rmm16(inst);
-  switch (subop) {
+  switch (REG) {
   case 0: r.rol(core.regs.h.cl); break;
   case 1: r.ror(core.regs.h.cl); break;
   case 2: r.rcl(core.regs.h.cl); break;
@@ -1049,17 +982,8 @@ void CPU::execute_0xD3(const instruction_t& inst, int subop) {
   }
 }
 
-void CPU::execute_0xD(const instruction_t& inst) {
-  switch (inst.op & 0x0f) {
-  case 0x0: execute_0xD0(inst, inst.mdrm.reg); break;
-  case 0x1: execute_0xD1(inst, inst.mdrm.reg); break;
-  case 0x2: execute_0xD2(inst, inst.mdrm.reg); break;
-  case 0x3: execute_0xD3(inst, inst.mdrm.reg); break;
-  }
-}
-
-void CPU::execute_0xE(const instruction_t& inst) {
-  switch (inst.op & 0x0f) {
+template <uint8_t OP> void CPU::execute_0xE(const instruction_t& inst) {
+  switch (OP & 0x0f) {
   // LOOPNE rel8
   case 0x0: {
     if (core.regs.x.cx-- != 0 && !core.flags.zflag()) {
@@ -1114,8 +1038,8 @@ void CPU::execute_0xE(const instruction_t& inst) {
   }
 }
 
-void CPU::execute_0xF6(const instruction_t& inst, int subop) {
-  switch (inst.mdrm.reg) {
+template <int REG> void CPU::execute_0xF6(const instruction_t& inst) {
+  switch (REG) {
   case 0: {
     LOG(WARNING) << "Need SOME WAY TO ENCODE THIS! F6/0 with imm8";
     uint8_t imm{inst.imm8};
@@ -1149,8 +1073,8 @@ void CPU::execute_0xF6(const instruction_t& inst, int subop) {
   }
 }
 
-void CPU::execute_0xF7(const instruction_t& inst, int subop) {
-  switch (inst.mdrm.reg) {
+template <int REG> void CPU::execute_0xF7(const instruction_t& inst) {
+  switch (REG) {
   case 0: {
     LOG(WARNING) << "Need SOME WAY TO ENCODE THIS! F7/0 with imm16";
     uint16_t operand{inst.disp16};
@@ -1186,15 +1110,15 @@ void CPU::execute_0xF7(const instruction_t& inst, int subop) {
   }
 }
 
-void CPU::execute_0xFE(const instruction_t& inst, int subop) {
-  switch (inst.mdrm.reg) {
+template <int REG> void CPU::execute_0xFE(const instruction_t& inst) {
+  switch (REG) {
   case 0: { // INC
     auto r = rmm8(inst);
-    r += 1;
+    r.inc();
   } break;
   case 1: { // DEC
     auto r = rmm8(inst);
-    r -= 1;
+    r.dec();
   } break;
   default: {
     LOG(WARNING) << "Unhandled subcode of opcode: 0xFE; subcode: "
@@ -1203,15 +1127,15 @@ void CPU::execute_0xFE(const instruction_t& inst, int subop) {
   }
 }
 
-void CPU::execute_0xFF(const instruction_t& inst, int subop) {
-  switch (inst.mdrm.reg) {
+template <int REG> void CPU::execute_0xFF(const instruction_t& inst) {
+  switch (REG) {
   case 0: { // INC
     auto r = rmm16(inst);
-    r += 1;
+    r.inc();
   } break;
   case 1: { // DEC
     auto r = rmm16(inst);
-    r -= 1;
+    r.dec();
   } break;
   case 2: { // CALL
     // push the next IP onto the stack then jump ahead by the specified offset.
@@ -1243,14 +1167,15 @@ void CPU::execute_0xFF(const instruction_t& inst, int subop) {
 }
 
 
-void CPU::execute_0xF(const instruction_t& inst) {
-  switch (inst.op & 0x0f) {
+template <uint8_t OP> void CPU::execute_0xF(const instruction_t& inst) {
+  switch (OP & 0x0f) {
+  // HLT: wait for an interrupt.
+  case 0x4:
+    hlt_ = true;
+    stop_ = stop_reason_t::waiting;
+    break;
   // 0xF5: CMC
   case 0x5: core.flags.cflag(!core.flags.cflag()); break;
-  // 0xF6/M
-  case 0x6: execute_0xF6(inst, inst.mdrm.reg); break;
-  // 0xF7/M
-  case 0x7: execute_0xF7(inst, inst.mdrm.reg); break;
   // CLC: Clear carry flag
   case 0x8: core.flags.cflag(false); break;
   // STC: Set carry flag
@@ -1263,10 +1188,6 @@ void CPU::execute_0xF(const instruction_t& inst) {
   case 0xC: core.flags.dflag(false); break;
   // STDSet Direction Flag
   case 0xD: core.flags.dflag(true); break;
-  // INC or DEC r/m8
-  case 0xE: execute_0xFE(inst, inst.mdrm.reg); break;
-  // INC r/m16
-  case 0xF: execute_0xFF(inst, inst.mdrm.reg); break;
   default: LOG(WARNING) << fmt::format("Skipped OPCODE: 0x{:02x}", static_cast<int>(inst.op));
   }
 }
@@ -1276,24 +1197,37 @@ void CPU::call_interrupt(int num) {
   auto off = memory.get<uint16_t>(0, num * 4);
   auto seg = memory.get<uint16_t>(0, (num * 4) + 2);
 
-  push(core.flags.value_);
+  // The INT in num's ROM stub, which a program chained to.
+  const bool stub = core.sregs.cs == rom_seg && core.ip == rom_stubs + num * 4 + 2;
+
+  push(core.flags.value());
   push(core.sregs.cs);
   push(core.ip);
 
-  if (seg != 0x0000 || off != num) {
+  if (!stub && !rom_vector(num) && (seg != 0x0000 || off != num)) {
     // We have a handler.
     // It should do a IRET??
     core.sregs.cs = seg;
     core.ip = off;
+    core.flags.iflag(false);
+    core.flags.tflag(false);
     return;
   }
 
   if (auto fn = int_handlers_.find(num); fn != std::end(int_handlers_)) {
+    const auto ax = core.regs.x.ax;
     fn->second(num, *this);
+    idle.on_interrupt(num, static_cast<uint8_t>(ax >> 8), static_cast<uint8_t>(ax));
     // restore stack after our implicit handler
     core.ip = pop();
     core.sregs.cs = pop();
-    core.flags.value_ = pop();
+    // Services return results in the flags (i.e. CF, ZF), like a BIOS that
+    // returns with RETF 2, so only the interrupt and trap flags are restored.
+    const auto flags = pop();
+    core.flags.value(static_cast<uint16_t>((flags & (IF | TF)) | (core.flags.value() & ~(IF | TF))));
+    if (const auto chained = std::exchange(chain_, std::nullopt)) {
+      call_interrupt(*chained);
+    }
     return;
   }
   // static default fail safe handlers.
@@ -1308,7 +1242,20 @@ void CPU::call_interrupt(int num) {
   // Since we were unhandled, return to previous state
   core.ip = pop();
   core.sregs.cs = pop();
-  core.flags.value_ = pop();
+  core.flags.value(pop());
+}
+
+void CPU::set_rom_vector(int num) {
+  const auto off = static_cast<uint16_t>(rom_stubs + num * 4);
+  const uint8_t code[]{0xCD, static_cast<uint8_t>(num), 0xCF};
+  memory.load_image(rom_seg * 0x10 + off, sizeof(code), code);
+  memory.set<uint16_t>(0, static_cast<uint16_t>(num * 4), off);
+  memory.set<uint16_t>(0, static_cast<uint16_t>(num * 4 + 2), rom_seg);
+}
+
+bool CPU::rom_vector(int num) const {
+  return memory.get<uint16_t>(0, static_cast<uint16_t>(num * 4)) == rom_stubs + num * 4 &&
+         memory.get<uint16_t>(0, static_cast<uint16_t>(num * 4 + 2)) == rom_seg;
 }
 
 bool CPU::run(uint16_t start_cs, uint16_t start_ip) {
@@ -1324,75 +1271,395 @@ bool CPU::run() {
       wwiv::os::sleep_for(std::chrono::milliseconds(500));
     }
   }
-  while (running_) {
-    const int pos = (core.sregs.cs * 0x10) + core.ip;
-    const auto inst = decoder.decode(&memory[pos]);
-    if (VLOG_IS_ON(3)) {
-      const auto line =
-          fmt::format("[{:04x}:{:04x}] inst: {}", core.sregs.cs, core.ip, inst.DebugString());
-      VLOG(3) << line;
+  // Slices of about 10ms.
+  static constexpr uint64_t slice_cycles = GuestClock::cpu_hz / 100;
+  budget_t budget;
+  for (;;) {
+    if (time.is_virtual()) {
+      // Slices end at the same place every run.
+      budget.cycles = slice_cycles;
+    } else {
+      budget.deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(10);
     }
-    core.ip += inst.len;
-    execute(inst);
-    if (VLOG_IS_ON(4)) {
-      VLOG(4) << core.DebugString();
-      std::cerr << std::endl;
+    const auto reason = run_for(budget);
+    end_slice(reason);
+    switch (reason) {
+    case stop_reason_t::halted: return true;
+    case stop_reason_t::waiting:
+      if (const auto until = begin_wait()) {
+        idle.park_for(*until - std::chrono::steady_clock::now());
+        end_wait();
+      }
+      break;
+    // Keep going, like a real CPU would.
+    default: break;
     }
   }
-  return true;
 }
 
-bool CPU::execute(const instruction_t& inst) {
-  if (debugger_attached.load()) {
-    // Use int1 as the step interrupt if we have a debugger attached for now.
-    call_interrupt(0x01);
+std::optional<std::chrono::steady_clock::time_point> CPU::begin_wait() {
+  const auto now = time.now();
+  if (events.next() != EventQueue::never) {
+    const auto due = events.next() - std::min(events.next(), time.elapsed_cycles());
+    idle.wake_at(now + GuestClock::to_duration(due));
+  }
+  const auto until = idle.wait_until(now);
+  if (!until) {
+    return std::nullopt;
   }
-  if (inst.metadata.mask & op_mask_notimpl) {
-    LOG(WARNING) << fmt::format("Unimplemented Opcode Encountered: {:02X} at IP: {:02X}",
-      static_cast<uint16_t>(inst.op), core.ip - 1);
-    return false;
-  }
-  bool done = true;
-  do {
-    switch (inst.op >> 4) {
-    case 0x0: execute_0x0(inst); break;
-    case 0x1: execute_0x1(inst); break;
-    case 0x2: execute_0x2(inst); break;
-    case 0x3: execute_0x3(inst); break;
-    case 0x4: execute_0x4(inst); break;
-    case 0x5: execute_0x5(inst); break;
-    case 0x6: execute_0x6(inst); break;
-    case 0x7: execute_0x7(inst); break;
-    case 0x8: execute_0x8(inst); break;
-    case 0x9: execute_0x9(inst); break;
-    case 0xA: execute_0xA(inst); break;
-    case 0xB: execute_0xB(inst); break;
-    case 0xC: execute_0xC(inst); break;
-    case 0xD: execute_0xD(inst); break;
-    case 0xE: execute_0xE(inst); break;
-    case 0xF: execute_0xF(inst); break;
+  park_cycles_ = std::numeric_limits<uint64_t>::max();
+  if (time.is_virtual()) {
+    // Nothing to wait for, skip ahead to when there might be.
+    const auto before = cycles;
+    time.advance_to(*until);
+    // Or to the next device event, if that's sooner.
+    cycles = std::clamp(events.next(), before, cycles);
+    if (!idle.live_input) {
+      return std::nullopt;
     }
-    if (inst.rep) {
-      done = false;
-      if (--core.regs.x.cx == 0) {
-        done = true;
-        break;
-      }
-      if (inst.metadata.mask & uses_rep_zf) {
-        done = core.flags.zflag();    
-      }
-    } else if (inst.repne) {
-      if (--core.regs.x.cx == 0) {
-        done = true;
-        break;
+    // Someone's typing in real time, so wait for them for as long as was
+    // skipped, and only skip as much as that took.
+    park_cycles_ = cycles - before;
+    cycles = before;
+    parked_ = std::chrono::steady_clock::now();
+    return *parked_ + GuestClock::to_duration(park_cycles_);
+  }
+  parked_ = std::chrono::steady_clock::now();
+  return until;
+}
+
+void CPU::end_wait() {
+  if (!parked_) {
+    return;
+  }
+  const auto parked = std::chrono::steady_clock::now() - *std::exchange(parked_, std::nullopt);
+  // The cycles it would have run for.
+  cycles += std::min(GuestClock::to_cycles(parked), park_cycles_);
+}
+
+void CPU::end_slice(stop_reason_t reason) {
+  for (auto& h : slice_handlers_) {
+    h(*this, reason);
+  }
+  if (reason == stop_reason_t::waiting || reason == stop_reason_t::halted) {
+    output.flush();
+  } else {
+    output.flush_if_due(OutputBuffer::clock::now());
+  }
+}
+
+stop_reason_t CPU::run_for(const budget_t& budget) {
+  const auto add = [](uint64_t a, uint64_t b) {
+    return b > std::numeric_limits<uint64_t>::max() - a ? std::numeric_limits<uint64_t>::max()
+                                                        : a + b;
+  };
+  const limits_t limits{add(instructions, budget.instructions), add(cycles, budget.cycles),
+                        budget.deadline};
+  stop_.reset();
+  next_clock_check_ = instructions;
+  next_event_check_ = instructions;
+  switch (execution_mode) {
+  case execution_mode_t::interpreted: return run_interpreted(limits);
+  case execution_mode_t::threaded:
+  case execution_mode_t::jit: return run_threaded(limits);
+  }
+  return stop_reason_t::halted;
+}
+
+std::optional<stop_reason_t> CPU::should_stop(const limits_t& limits, bool first) {
+  // Instructions between looking at the clock.
+  static constexpr uint64_t clock_check_interval = 1024;
+
+  if (!running_) {
+    return stop_reason_t::halted;
+  }
+  if (time.is_virtual()) {
+    if (cycles >= events.next()) {
+      events.run_due(cycles);
+    }
+  } else if (events.next() != EventQueue::never && instructions >= next_event_check_) {
+    // Reading the host's clock every block would cost more than the blocks.
+    next_event_check_ = instructions + clock_check_interval;
+    if (const auto now = time.elapsed_cycles(); now >= events.next()) {
+      events.run_due(now);
+    }
+  }
+  if (stop_) {
+    return std::exchange(stop_, std::nullopt);
+  }
+  // Hardware interrupts, looked for once a block rather than every instruction.
+  if (pic.ready() && core.flags.iflag()) {
+    hlt_ = false;
+    call_interrupt(pic.acknowledge());
+  }
+  if (hlt_) {
+    return stop_reason_t::waiting;
+  }
+  if (instructions >= limits.instructions || cycles >= limits.cycles) {
+    return stop_reason_t::budget;
+  }
+  if (limits.deadline != std::chrono::steady_clock::time_point::max() &&
+      instructions >= next_clock_check_) {
+    next_clock_check_ = instructions + clock_check_interval;
+    if (std::chrono::steady_clock::now() >= limits.deadline) {
+      return stop_reason_t::deadline;
+    }
+  }
+  // Don't stop at the breakpoint we're resuming from.
+  if (!first && !breakpoints.empty() &&
+      breakpoints.count((core.sregs.cs * 0x10) + core.ip)) {
+    return stop_reason_t::breakpoint;
+  }
+  return std::nullopt;
+}
+
+void CPU::step() {
+  const auto pos = memory.mask((core.sregs.cs * 0x10) + core.ip);
+  const auto& inst = icache.get(pos);
+  if (VLOG_IS_ON(3)) {
+    const auto line =
+        fmt::format("[{:04x}:{:04x}] inst: {}", core.sregs.cs, core.ip, inst.DebugString());
+    VLOG(3) << line;
+  }
+  core.ip += inst.len;
+  const auto next = core.ip;
+  execute(inst);
+  ++instructions;
+  cycles += instruction_cycles(inst);
+  if (const auto taken = taken_cycles(inst); taken && core.ip != next) {
+    cycles += taken;
+  }
+  if (VLOG_IS_ON(4)) {
+    VLOG(4) << core.DebugString();
+    std::cerr << std::endl;
+  }
+}
+
+stop_reason_t CPU::run_interpreted(const limits_t& limits) {
+  for (bool first = true;; first = false) {
+    if (const auto reason = should_stop(limits, first)) {
+      return reason.value();
+    }
+    step();
+  }
+}
+
+stop_reason_t CPU::run_threaded(const limits_t& limits) {
+  const bool use_jit = execution_mode == execution_mode_t::jit && Jit::supported();
+  block_t* block = nullptr;
+  for (bool first = true;; first = false) {
+    if (const auto reason = should_stop(limits, first)) {
+      return reason.value();
+    }
+    if (debugger_attached.load() || VLOG_IS_ON(3) || !breakpoints.empty()) {
+      // The debugger, tracing and breakpoints want to see every instruction.
+      block = nullptr;
+      step();
+      continue;
+    }
+    const auto pos = memory.mask((core.sregs.cs * 0x10) + core.ip);
+    block = block ? blocks.next(block, pos) : blocks.get(pos);
+    if (!block || instructions + block->entries.size() > limits.instructions ||
+        cycles + block->cycles > limits.cycles) {
+      // No block here, or not enough budget left to run all of it.
+      block = nullptr;
+      step();
+      continue;
+    }
+    if (idle.enabled && idle.on_block(block->start)) {
+      return stop_reason_t::waiting;
+    }
+    const uint16_t fallthrough = core.ip + block->len;
+    if (block->aot) {
+      count_block(*block, block->aot(*this, *block), fallthrough);
+      continue;
+    }
+    if (use_jit) {
+      if (block->native) {
+        count_block(*block, reinterpret_cast<native_block_t>(block->native)(), fallthrough);
+        continue;
       }
-      if (inst.metadata.mask & uses_rep_zf) {
-        done = !core.flags.zflag();
+      if (++block->runs == Jit::hot_threshold && !jit.compile(*block) && jit.full()) {
+        // Out of room for generated code, start over with empty caches.
+        blocks.clear();
+        jit.clear();
+        block = nullptr;
+        continue;
       }
     }
-  } while (!done);
+    execute_block(*block);
+  }
+}
+
+void CPU::count_block(const block_t& block, uint32_t ran, uint16_t fallthrough) {
+  instructions += ran;
+  if (ran < block.entries.size()) {
+    // It rewrote itself part way through, like execute_block.
+    for (uint32_t i = 0; i < ran; i++) {
+      cycles += block.entries[i].cycles;
+    }
+    return;
+  }
+  cycles += block.cycles;
+  if (block.taken && core.ip != fallthrough) {
+    cycles += block.taken;
+  }
+}
+
+void CPU::execute_block(const block_t& block) {
+  const uint16_t fallthrough = core.ip + block.len;
+  for (const auto& e : block.entries) {
+    core.ip += e.inst.len;
+    (this->*e.fn)(e.inst);
+    ++instructions;
+    cycles += e.cycles;
+    if (memory.code_generation(block.start) != block.gen || stop_) {
+      // This block just rewrote itself (the rest of it is stale), or needs to stop.
+      return;
+    }
+  }
+  if (block.taken && core.ip != fallthrough) {
+    cycles += block.taken;
+  }
+}
+
+// DISPATCH TABLE
+
+// Handler for a single opcode. Group opcodes are dispatched by their ModRM
+// reg field instead, see group_handler.
+template <uint8_t OP> static constexpr handler_t opcode_handler() {
+  constexpr auto hi = OP >> 4;
+  if constexpr (group_index(OP) >= 0) {
+    return &CPU::execute_notimpl;
+  } else if constexpr (hi == 0x0) {
+    return &CPU::execute_0x0<OP>;
+  } else if constexpr (hi == 0x1) {
+    return &CPU::execute_0x1<OP>;
+  } else if constexpr (hi == 0x2) {
+    return &CPU::execute_0x2<OP>;
+  } else if constexpr (hi == 0x3) {
+    return &CPU::execute_0x3<OP>;
+  } else if constexpr (hi == 0x4) {
+    return &CPU::execute_0x4<OP>;
+  } else if constexpr (hi == 0x5) {
+    return &CPU::execute_0x5<OP>;
+  } else if constexpr (hi == 0x6) {
+    return &CPU::execute_0x6<OP>;
+  } else if constexpr (hi == 0x7) {
+    return &CPU::execute_0x7<OP>;
+  } else if constexpr (hi == 0x8) {
+    return &CPU::execute_0x8<OP>;
+  } else if constexpr (hi == 0x9) {
+    return &CPU::execute_0x9<OP>;
+  } else if constexpr (hi == 0xA) {
+    return &CPU::execute_0xA<OP>;
+  } else if constexpr (hi == 0xB) {
+    return &CPU::execute_0xB<OP>;
+  } else if constexpr (hi == 0xC) {
+    return &CPU::execute_0xC<OP>;
+  } else if constexpr (hi == 0xE) {
+    return &CPU::execute_0xE<OP>;
+  } else if constexpr (hi == 0xF) {
+    return &CPU::execute_0xF<OP>;
+  } else {
+    // 0xD4-0xDF are all unimplemented.
+    return &CPU::execute_notimpl;
+  }
+}
+
+// Handler for sub-opcode REG of the group opcode OP.
+template <uint8_t OP, int REG> static constexpr handler_t group_handler() {
+  if constexpr (OP == 0x80) {
+    return &CPU::execute_0x80<REG>;
+  } else if constexpr (OP == 0x81) {
+    return &CPU::execute_0x81<REG>;
+  } else if constexpr (OP == 0x83) {
+    return &CPU::execute_0x83<REG>;
+  } else if constexpr (OP == 0xC0) {
+    return &CPU::execute_0xC0<REG>;
+  } else if constexpr (OP == 0xC1) {
+    return &CPU::execute_0xC1<REG>;
+  } else if constexpr (OP == 0xD0) {
+    return &CPU::execute_0xD0<REG>;
+  } else if constexpr (OP == 0xD1) {
+    return &CPU::execute_0xD1<REG>;
+  } else if constexpr (OP == 0xD2) {
+    return &CPU::execute_0xD2<REG>;
+  } else if constexpr (OP == 0xD3) {
+    return &CPU::execute_0xD3<REG>;
+  } else if constexpr (OP == 0xF6) {
+    return &CPU::execute_0xF6<REG>;
+  } else if constexpr (OP == 0xF7) {
+    return &CPU::execute_0xF7<REG>;
+  } else if constexpr (OP == 0xFE) {
+    return &CPU::execute_0xFE<REG>;
+  } else if constexpr (OP == 0xFF) {
+    return &CPU::execute_0xFF<REG>;
+  } else {
+    // 0x82 is not implemented.
+    return &CPU::execute_notimpl;
+  }
+}
+
+// Handler for entry I of the dispatch table, see dispatch_group_base.
+template <std::size_t I> static constexpr handler_t dispatch_handler() {
+  if constexpr (I < dispatch_group_base) {
+    return opcode_handler<static_cast<uint8_t>(I)>();
+  } else if constexpr (I < dispatch_rep_base) {
+    constexpr auto g = I - dispatch_group_base;
+    return group_handler<group_opcodes[g / 8], g % 8>();
+  } else if constexpr (I < dispatch_notimpl) {
+    return &CPU::execute_rep<static_cast<uint8_t>(first_rep_opcode + I - dispatch_rep_base)>;
+  } else {
+    return &CPU::execute_notimpl;
+  }
+}
+
+template <std::size_t... I>
+static constexpr std::array<handler_t, dispatch_size>
+make_dispatch_table(std::index_sequence<I...>) {
+  return {{dispatch_handler<I>()...}};
+}
+
+// Every handler, indexed by instruction_t::dispatch.
+static constexpr auto dispatch_table = make_dispatch_table(std::make_index_sequence<dispatch_size>{});
+
+handler_t CPU::handler(const instruction_t& inst) const { return dispatch_table[inst.dispatch]; }
+
+bool CPU::execute(const instruction_t& inst) {
+  if (debugger_attached.load()) {
+    // Use int1 as the step interrupt if we have a debugger attached for now.
+    call_interrupt(0x01);
+  }
+  (this->*dispatch_table[inst.dispatch])(inst);
+  return inst.dispatch != dispatch_notimpl;
+}
 
-  return true;
+void CPU::execute_notimpl(const instruction_t& inst) {
+  LOG(WARNING) << fmt::format("Unimplemented Opcode Encountered: {:02X} at IP: {:02X}",
+                              static_cast<uint16_t>(inst.op), core.ip - 1);
+  stop_ = stop_reason_t::unimplemented;
+}
+
+template <uint8_t OP> void CPU::execute_rep(const instruction_t& inst) {
+  // SI is relative to DS unless overridden, DI is always relative to ES.
+  const auto src_seg = inst.has_seg_override ? core.sregs.get(inst.seg_override) : core.sregs.ds;
+  const uint16_t count = core.regs.x.cx;
+  switch (OP) {
+  case 0xA4: rep_movs<uint8_t>(core, memory, src_seg); break;
+  case 0xA5: rep_movs<uint16_t>(core, memory, src_seg); break;
+  case 0xA6: rep_cmps<uint8_t>(core, memory, src_seg, inst.repne); break;
+  case 0xA7: rep_cmps<uint16_t>(core, memory, src_seg, inst.repne); break;
+  case 0xAA: rep_stos<uint8_t>(core, memory); break;
+  case 0xAB: rep_stos<uint16_t>(core, memory); break;
+  case 0xAC: rep_lods<uint8_t>(core, memory, src_seg); break;
+  case 0xAD: rep_lods<uint16_t>(core, memory, src_seg); break;
+  case 0xAE: rep_scas<uint8_t>(core, memory, inst.repne); break;
+  case 0xAF: rep_scas<uint16_t>(core, memory, inst.repne); break;
+  // TEST AL/AX, imm: the prefix doesn't apply.
+  default: execute_0xA<OP>(inst); break;
+  }
+  cycles += rep_cycles(OP) * static_cast<uint16_t>(count - core.regs.x.cx);
 }
 
 
@@ -1461,7 +1728,7 @@ Rmm<RmmType::REGISTER, uint16_t> CPU::r16(int regnum) {
 }
 
 Rmm<RmmType::REGISTER, uint16_t> CPU::r16(const instruction_t& inst) {
-  if (inst.metadata.mask & op_mask_reg_is_sreg) {
+  if (inst.metadata->mask & op_mask_reg_is_sreg) {
     return Rmm<RmmType::REGISTER, uint16_t>(&core, core.sregs.regptr(inst.mdrm.reg));
   }
   return Rmm<RmmType::REGISTER, uint16_t>(&core, core.regs.x.regptr(inst.mdrm.reg));
@@ -1483,37 +1750,5 @@ Rmm<RmmType::MEMORY, uint16_t> CPU::mem16(uint16_t seg, uint16_t offset) {
   return Rmm<RmmType::MEMORY, uint16_t>(&core, &memory, seg, offset);
 }
 
-
-// REPEAT SUPPORT
-
-void CPU::rep(const instruction_t& inst) {
-  if (!inst.rep && !inst.repne) {
-    LOG(WARNING) << "Called CPU::rep without a REP or REPNE prefix";
-    return;
-  }
-  if (inst.rep && inst.repne) {
-    LOG(WARNING) << "Called CPU::rep with *BOTH* a REP or REPNE prefix";
-    return;
-  }
-
-  switch (inst.op) {
-  // SCASB
-  case 0xAE: {
-    for (; core.flags.zflag() == inst.repne && core.regs.x.cx; --core.regs.x.cx) {
-      scas_m8(inst);
-    }
-  } break;
-  case 0xAF: {
-    for (; core.flags.zflag() == inst.repne && core.regs.x.cx; --core.regs.x.cx) {
-      scas_m16(inst);
-    }
-  } break;
-  default: {
-    LOG(WARNING) << "Unhandled REP opcode: " << std::hex << inst.op;
-  } break;
-  }
-}
-
-
 } // namespace door86::cpu::x86
 
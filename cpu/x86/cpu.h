@@ -3,15 +3,30 @@
 
 #include "cpu/io.h"
 #include "cpu/memory.h"
+#include "cpu/output_buffer.h"
+#include "cpu/pic.h"
+#include "cpu/x86/aot.h"
+#include "cpu/x86/block_cache.h"
 #include "cpu/x86/cpu_core.h"
 #include "cpu/x86/decoder.h"
+#include "cpu/x86/event_queue.h"
+#include "cpu/x86/guest_clock.h"
+#include "cpu/x86/idle.h"
+#include "cpu/x86/instruction_cache.h"
+#include "cpu/x86/jit.h"
 #include "cpu/x86/regs.h"
 #include "cpu/x86/rmm.h"
 
 #include <atomic>
+#include <chrono>
 #include <cstdint>
 #include <functional>
+#include <limits>
 #include <map>
+#include <memory>
+#include <optional>
+#include <unordered_set>
+#include <vector>
 
 // Start with instructons needed for hello world in asm, then expand
 // to these, then on to others as needed.
@@ -19,9 +34,46 @@
 
 namespace door86::cpu::x86 {
 
+enum class execution_mode_t {
+  // decode (from the instruction cache) and execute one instruction at a time.
+  interpreted,
+  // execute basic blocks of pre-bound handlers, chained to their successors.
+  threaded,
+  // threaded, but hot blocks are compiled to native code (x86-64 only, see jit.h).
+  jit
+};
+
+// Why CPU::run_for returned.
+enum class stop_reason_t {
+  // ran the number of instructions or cycles it was given.
+  budget,
+  // the deadline passed.
+  deadline,
+  // the program exited, or halt() was called.
+  halted,
+  // the program is waiting for input, either in a service that called
+  // CPU::wait_for_input or spinning in a loop (see idle.h), or for an
+  // interrupt after HLT.
+  waiting,
+  // about to execute an instruction in CPU::breakpoints.
+  breakpoint,
+  // executed an opcode that isn't implemented.
+  unimplemented
+};
+
+/** Limits for CPU::run_for, it stops at whichever is reached first. */
+struct budget_t {
+  uint64_t instructions{std::numeric_limits<uint64_t>::max()};
+  // 8088 clock cycles, see timing.h
+  uint64_t cycles{std::numeric_limits<uint64_t>::max()};
+  std::chrono::steady_clock::time_point deadline{std::chrono::steady_clock::time_point::max()};
+};
+
 class CPU {
 public:
   CPU();
+  // A CPU whose memory starts out as a copy-on-write mapping of base.
+  explicit CPU(std::shared_ptr<const MemoryImage> base);
 
   // opcode executing
   // TODO(rushfan): Rebucket these into the following
@@ -38,40 +90,66 @@ public:
   bool run(uint16_t cs, uint16_t ip);
   // execute using existing cs:ip
   bool run();
+  // Executes from cs:ip until the budget runs out or something else stops
+  // execution. Calling it again picks up where it left off.
+  stop_reason_t run_for(const budget_t& budget);
+  // Called by a host interrupt handler that can't finish until input arrives.
+  // run_for returns stop_reason_t::waiting once the handler returns, and the
+  // INT instruction runs again when execution resumes.
+  void wait_for_input() { stop_ = stop_reason_t::waiting; }
+  // true once wait_for_input has been called, until run_for returns.
+  bool waiting_for_input() const noexcept { return stop_ == stop_reason_t::waiting; }
+  // When run_for returns stop_reason_t::waiting, for run() and the host
+  // scheduler: returns the host time to park the program until if nothing
+  // wakes it first (see IdleDetector::wake), which is when the next device
+  // event is due, at most idle.max_park away. Returns nullopt if it can run
+  // again right away, which with virtual time is after moving the clock on,
+  // unless input is live. end_wait is called when it runs again, to count the
+  // time parked in cycles.
+  std::optional<std::chrono::steady_clock::time_point> begin_wait();
+  void end_wait();
+  // execute the single instruction at cs:ip
+  void step();
   bool execute(const instruction_t& inst);
-  void execute_0x0(const instruction_t& inst);
-  void execute_0x1(const instruction_t& inst);
-  void execute_0x2(const instruction_t& inst);
-  void execute_0x3(const instruction_t& inst);
-  void execute_0x4(const instruction_t& inst);
-  void execute_0x5(const instruction_t& inst);
-  void execute_0x6(const instruction_t& inst);
-  void execute_0x7(const instruction_t& inst);
-  void execute_0x8(const instruction_t& inst);
-  void execute_0x80(const instruction_t& inst, int subop);
-  void execute_0x81(const instruction_t& inst, int subop);
-  void execute_0x82(const instruction_t& inst, int subop);
-  void execute_0x83(const instruction_t& inst, int subop);
-  void execute_0x9(const instruction_t& inst);
-  void execute_0xA(const instruction_t& inst);
-  void execute_0xB(const instruction_t& inst);
-  void execute_0xC(const instruction_t& inst);
-  void execute_0xC0(const instruction_t& inst, int subop);
-  void execute_0xC1(const instruction_t& inst, int subop);
-  void execute_0xD0(const instruction_t& inst, int subop);
-  void execute_0xD1(const instruction_t& inst, int subop);
-  void execute_0xD2(const instruction_t& inst, int subop);
-  void execute_0xD3(const instruction_t& inst, int subop);
-  void execute_0xD(const instruction_t& inst);
-  void execute_0xE(const instruction_t& inst);
-  void execute_0xF6(const instruction_t& inst, int subop);
-  void execute_0xF7(const instruction_t& inst, int subop);
-  void execute_0xFE(const instruction_t& inst, int subop);
-  void execute_0xFF(const instruction_t& inst, int subop);
-  void execute_0xF(const instruction_t& inst);
-
-  // handle rep and repne
-  void rep(const instruction_t& inst);
+  // Returns the handler that will execute inst.
+  handler_t handler(const instruction_t& inst) const;
+  // Executes a REP or REPNE prefixed string instruction in bulk, see string_ops.h
+  template <uint8_t OP> void execute_rep(const instruction_t& inst);
+  // Handles opcodes that are not yet implemented.
+  void execute_notimpl(const instruction_t& inst);
+
+  // One handler per opcode (OP), built into the dispatch table at compile
+  // time. Each is named for the high nibble of the opcodes it handles.
+  template <uint8_t OP> void execute_0x0(const instruction_t& inst);
+  template <uint8_t OP> void execute_0x1(const instruction_t& inst);
+  template <uint8_t OP> void execute_0x2(const instruction_t& inst);
+  template <uint8_t OP> void execute_0x3(const instruction_t& inst);
+  template <uint8_t OP> void execute_0x4(const instruction_t& inst);
+  template <uint8_t OP> void execute_0x5(const instruction_t& inst);
+  template <uint8_t OP> void execute_0x6(const instruction_t& inst);
+  template <uint8_t OP> void execute_0x7(const instruction_t& inst);
+  template <uint8_t OP> void execute_0x8(const instruction_t& inst);
+  template <uint8_t OP> void execute_0x9(const instruction_t& inst);
+  template <uint8_t OP> void execute_0xA(const instruction_t& inst);
+  template <uint8_t OP> void execute_0xB(const instruction_t& inst);
+  template <uint8_t OP> void execute_0xC(const instruction_t& inst);
+  template <uint8_t OP> void execute_0xE(const instruction_t& inst);
+  template <uint8_t OP> void execute_0xF(const instruction_t& inst);
+
+  // Group opcodes, one handler per ModRM reg (REG) sub-opcode.
+  template <int REG> void execute_0x80(const instruction_t& inst);
+  template <int REG> void execute_0x81(const instruction_t& inst);
+  template <int REG> void execute_0x83(const instruction_t& inst);
+  template <int REG> void execute_0xC0(const instruction_t& inst);
+  template <int REG> void execute_0xC1(const instruction_t& inst);
+  template <int REG> void execute_0xD0(const instruction_t& inst);
+  template <int REG> void execute_0xD1(const instruction_t& inst);
+  template <int REG> void execute_0xD2(const instruction_t& inst);
+  template <int REG> void execute_0xD3(const instruction_t& inst);
+  template <int REG> void execute_0xF6(const instruction_t& inst);
+  template <int REG> void execute_0xF7(const instruction_t& inst);
+  template <int REG> void execute_0xFE(const instruction_t& inst);
+  template <int REG> void execute_0xFF(const instruction_t& inst);
 
   // These are useful when handling rep and repne
   // individual instructuctions not handled in execute_0xX loop.
@@ -86,26 +164,75 @@ public:
   // interrupt handling
 
   void call_interrupt(int num);
+  // From a host interrupt service: calls interrupt num once the service
+  // returns, as if from the interrupted code (i.e. INT 08h calling a program's
+  // INT 1Ch handler).
+  void chain_interrupt(int num) { chain_ = num; }
+  // Points interrupt num's vector at a stub in the system ROM (INT num; IRET,
+  // at rom_seg:rom_stubs + num * 4) that calls num's host service. A program
+  // that hooks the interrupt can then pass it on to the old vector with a far
+  // JMP or CALL, like on a real BIOS. The ROM must be mapped (see Bios).
+  void set_rom_vector(int num);
+  // true if interrupt num's vector is still its ROM stub.
+  bool rom_vector(int num) const;
+  static constexpr uint16_t rom_seg = 0xF000;
+  static constexpr uint16_t rom_stubs = 0x1000;
 
   // Processor State
 
   // TODO: add in pause and resume separately to handlle HLT instruction
   void halt() { running_ = false; }
   void resume() { running_ = true; }
+  bool halted() const noexcept { return !running_; }
 
   // flags
 
   // Interrupts
   std::map<int, std::function<void(int num, CPU& cpu)>>& int_handlers() { return int_handlers_; }
 
+  // Host side work, such as sending screen updates, done between slices of
+  // execution. run() ends a slice at least every few milliseconds, and the
+  // host scheduler after every slice it runs. reason is why the slice ended.
+  void add_slice_handler(std::function<void(CPU& cpu, stop_reason_t reason)> handler) {
+    slice_handlers_.emplace_back(std::move(handler));
+  }
+  // Runs the slice handlers, then sends output now if the program is waiting
+  // for input or has exited, otherwise once it's waited long enough.
+  void end_slice(stop_reason_t reason);
+
   // Public structures
 
   cpu_core core;
   Decoder decoder;
   Memory memory;
+  // decoded instructions, indexed by linear address.
+  InstructionCache icache;
+  // basic blocks used when running in execution_mode_t::threaded
+  BlockCache blocks;
+  // native code for hot blocks when running in execution_mode_t::jit
+  Jit jit;
+  // code translated ahead of time for the running program, used by the
+  // threaded and jit modes (see aot.h). May be empty.
+  std::unique_ptr<AotModule> aot;
+  execution_mode_t execution_mode{execution_mode_t::threaded};
   IO io;
+  // Hardware interrupts, taken between blocks while IF is set.
+  Pic pic{io};
+  // Console output to the caller.
+  OutputBuffer output;
+  // finds loops spinning while waiting for input, when enabled.
+  IdleDetector idle;
+  // Instructions and 8088 clock cycles executed so far.
+  uint64_t instructions{0};
+  uint64_t cycles{0};
+  // Time as the program sees it.
+  GuestClock time{cycles};
+  // Device events, run as guest time reaches them.
+  EventQueue events;
+  // Linear addresses run_for stops at before executing.
+  std::unordered_set<uint32_t> breakpoints;
   // If true, we have an active debugger attached.
-  std::atomic<bool> debugger_attached;
+  std::atomic<bool> debugger_attached{false};
   // If true, THE CPU should wait for a debugger to be attached
   // before executing instructions
   bool wait_for_debugger{false};
@@ -125,10 +252,39 @@ private:
   Rmm<RmmType::MEMORY, uint8_t> mem8(uint16_t seg, uint16_t offset);
   Rmm<RmmType::MEMORY, uint16_t> mem16(uint16_t seg, uint16_t offset);
 
+  // budget_t as the values of instructions and cycles to stop at.
+  struct limits_t {
+    uint64_t instructions;
+    uint64_t cycles;
+    std::chrono::steady_clock::time_point deadline;
+  };
+  // Returns why execution should stop before the next instruction, if it should.
+  std::optional<stop_reason_t> should_stop(const limits_t& limits, bool first);
+  stop_reason_t run_interpreted(const limits_t& limits);
+  stop_reason_t run_threaded(const limits_t& limits);
+  void execute_block(const block_t& block);
+  // Counts the first ran entries of a block run by the jit or aot code,
+  // fallthrough is the IP following the block.
+  void count_block(const block_t& block, uint32_t ran, uint16_t fallthrough);
+
   bool running_{true};
+  // Set while executing an instruction to stop before the next one.
+  std::optional<stop_reason_t> stop_;
+  // Executed HLT, waiting for an interrupt.
+  bool hlt_{false};
+  // Host time begin_wait parked the program at, and the most cycles that counts for.
+  std::optional<std::chrono::steady_clock::time_point> parked_;
+  uint64_t park_cycles_{0};
+  // Interrupt for call_interrupt to call after the host service it's running.
+  std::optional<int> chain_;
+  // instructions count at which to next check the deadline.
+  uint64_t next_clock_check_{0};
+  // instructions count at which to next check for due events, with host time.
+  uint64_t next_event_check_{0};
   // default interrupt handlers.  default means it's not been overridden
   // by DOS code.
   std::map<int, std::function<void(int num, CPU& cpu)>> int_handlers_;
+  std::vector<std::function<void(CPU& cpu, stop_reason_t reason)>> slice_handlers_;
 };
 
 
@@ -85,7 +85,7 @@ TEST_F(CPUTest, REPNE_SCAS) {
   regs.x.di = 0;
   mem.clear(0x20000, 100);
   mem.load_string(0x20000, "Hello World");
-  const auto ops = parse_opcodes_from_line("F3 AE");
+  const auto ops = parse_opcodes_from_line("F2 AE");
   const auto inst = c.decoder.decode(ops);
   regs.x.ax = 0x0000;
   regs.x.cx = 0xffff;
@@ -93,3 +93,110 @@ TEST_F(CPUTest, REPNE_SCAS) {
   regs.x.cx = ~regs.x.cx;
   EXPECT_EQ(12, regs.x.cx);
 }
+
+class RunForTest : public CPUTest {
+public:
+  RunForTest() {
+    // INT 20h halts the CPU.
+    mem[0x20 * 4] = 0x20;
+    c.int_handlers().try_emplace(0x20, [](int, CPU& cpu) { cpu.halt(); });
+    regs.x.ax = regs.x.bx = regs.x.cx = regs.x.dx = 0;
+    regs.x.si = regs.x.di = regs.x.bp = regs.x.sp = 0;
+    sregs.cs = 0x100;
+    c.core.ip = 0;
+  }
+
+  void load(const std::string& s) { ASSERT_TRUE(CPUTest::load(0x1000, s)); }
+};
+
+// L: INC AX; JMP L
+static const std::string forever = "40 EBFD";
+
+TEST_F(RunForTest, InstructionBudget) {
+  load(forever);
+  for (const auto mode : {execution_mode_t::interpreted, execution_mode_t::threaded}) {
+    c.execution_mode = mode;
+    const auto start = c.instructions;
+    // Odd, so the last block only partly fits.
+    budget_t budget;
+    budget.instructions = 11;
+    EXPECT_EQ(stop_reason_t::budget, c.run_for(budget));
+    EXPECT_EQ(start + 11, c.instructions);
+  }
+  EXPECT_EQ(11, regs.x.ax);
+}
+
+TEST_F(RunForTest, CycleBudget) {
+  load(forever);
+  c.execution_mode = execution_mode_t::threaded;
+  budget_t budget;
+  budget.cycles = 1000;
+  EXPECT_EQ(stop_reason_t::budget, c.run_for(budget));
+  // INC is 3 cycles and JMP 15, and we stop at the first instruction past the budget.
+  EXPECT_GE(c.cycles, 1000u);
+  EXPECT_LT(c.cycles, 1015u);
+}
+
+TEST_F(RunForTest, Deadline) {
+  load(forever);
+  budget_t budget;
+  budget.deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(10);
+  EXPECT_EQ(stop_reason_t::deadline, c.run_for(budget));
+}
+
+TEST_F(RunForTest, Cycles) {
+  // MOV AX, 0; CMP AX, 0; JE +1; NOP; INT 20
+  load("B80000 3D0000 7401 90 CD20");
+  EXPECT_EQ(stop_reason_t::halted, c.run_for({}));
+  EXPECT_EQ(4u, c.instructions);
+  EXPECT_EQ(4u + 4u + 16u + 71u, c.cycles);
+  // Not taken this time, so the NOP runs.
+  load("B80000 3D0000 7501 90 CD20");
+  c.resume();
+  c.core.ip = 0;
+  c.cycles = 0;
+  c.execution_mode = execution_mode_t::interpreted;
+  EXPECT_EQ(stop_reason_t::halted, c.run_for({}));
+  EXPECT_EQ(4u + 4u + 4u + 3u + 71u, c.cycles);
+}
+
+TEST_F(RunForTest, Breakpoint) {
+  // INC AX; INC AX; INC AX; INT 20
+  load("40 40 40 CD20");
+  c.breakpoints.insert(0x1002);
+  EXPECT_EQ(stop_reason_t::breakpoint, c.run_for({}));
+  EXPECT_EQ(2, c.core.ip);
+  EXPECT_EQ(2, regs.x.ax);
+  // Resumes from the breakpoint.
+  EXPECT_EQ(stop_reason_t::halted, c.run_for({}));
+  EXPECT_EQ(3, regs.x.ax);
+}
+
+TEST_F(RunForTest, Unimplemented) {
+  // INC AX; DAA; INC AX; INT 20
+  load("40 27 40 CD20");
+  EXPECT_EQ(stop_reason_t::unimplemented, c.run_for({}));
+  EXPECT_EQ(2, c.core.ip);
+  EXPECT_EQ(stop_reason_t::halted, c.run_for({}));
+  EXPECT_EQ(2, regs.x.ax);
+}
+
+TEST_F(RunForTest, WaitingForInput) {
+  mem[0x16 * 4] = 0x16;
+  int calls = 0;
+  c.int_handlers().try_emplace(0x16, [&calls](int, CPU& cpu) {
+    if (++calls == 1) {
+      cpu.wait_for_input();
+      return;
+    }
+    cpu.core.regs.x.ax = 0x1c0d;
+  });
+  // XOR AX, AX; INT 16; INT 20
+  load("31C0 CD16 CD20");
+  EXPECT_EQ(stop_reason_t::waiting, c.run_for({}));
+  // Back on the INT 16.
+  EXPECT_EQ(2, c.core.ip);
+  EXPECT_EQ(stop_reason_t::halted, c.run_for({}));
+  EXPECT_EQ(2, calls);
+  EXPECT_EQ(0x1c0d, regs.x.ax);
+}
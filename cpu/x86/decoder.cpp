@@ -3,6 +3,7 @@
 #include "core/log.h"
 #include "fmt/ranges.h"
 #include "fmt/format.h"
+#include <algorithm>
 #include <sstream>
 #include <string>
 #include <vector>
@@ -238,7 +239,7 @@ std::vector<op_code_data_t> create_opcode_metadata() {
       {0xCC, op_mask_none, "INT3"},
       {0xCD, op_mask_imm8, "INT", 8},
       {0xCE, op_mask_none, "INTO"},
-      {0xCF, op_mask_notimpl, "IRET"},
+      {0xCF, op_mask_none, "IRET"},
 
       {0xD0, op_mask_modrm8 | uses_reg_subcode, "0xD0/M", 8},
       {0xD1, op_mask_modrm16 | uses_reg_subcode, "0xD1/M"},
@@ -279,7 +280,7 @@ std::vector<op_code_data_t> create_opcode_metadata() {
       {0xF1, op_mask_notimpl, ""},
       {0xF2, op_mask_notimpl, ""},
       {0xF3, op_mask_notimpl, ""},
-      {0xF4, op_mask_notimpl, ""},
+      {0xF4, op_mask_none, "HLT"},
       {0xF5, op_mask_none, "CMC"},
       {0xF6, op_mask_modrm8 | uses_reg_subcode, "0xF6/M", 8},
       {0xF7, op_mask_modrm16 | uses_reg_subcode, "0xF7/M"},
@@ -344,7 +345,7 @@ inline static bool has_modrm_operand16(const reg_mod_rm& r) {
 
 inline static bool has_modrm_operand8(const reg_mod_rm& r) { return r.rm == 0x01; }
 
-bool instruction_t::has_modrm() const { return door86::cpu::x86::has_modrm(metadata.mask); }
+bool instruction_t::has_modrm() const { return door86::cpu::x86::has_modrm(metadata->mask); }
 
 static segment_t default_segment_for_index(uint8_t mod, uint8_t rm) {
   if (rm == 2 || rm == 3 || (rm == 6 && mod != 0)) {
@@ -354,90 +355,89 @@ static segment_t default_segment_for_index(uint8_t mod, uint8_t rm) {
 }
 
 segment_t instruction_t::seg_index() const {
-  return seg_override.value_or(default_segment_for_index(mdrm.mod, mdrm.rm));
+  return has_seg_override ? seg_override : default_segment_for_index(mdrm.mod, mdrm.rm);
 }
 
-instruction_t Decoder::decode(const std::vector<uint8_t> o) { return decode(o.data()); }
+instruction_t Decoder::decode(const std::vector<uint8_t>& o) { return decode(o.data()); }
+
+uint16_t dispatch_index(const instruction_t& i) {
+  if (i.metadata->mask & op_mask_notimpl) {
+    return dispatch_notimpl;
+  }
+  if ((i.rep || i.repne) && i.op >= first_rep_opcode && i.op <= last_rep_opcode) {
+    return dispatch_rep_base + (i.op - first_rep_opcode);
+  }
+  // REP and REPNE are ignored on anything other than string instructions.
+  if (const auto g = group_index(i.op); g >= 0) {
+    return dispatch_group_base + (g * 8) + i.mdrm.reg;
+  }
+  return i.op;
+}
+
+static inline void set_seg_override(instruction_t& i, segment_t seg) {
+  i.has_seg_override = true;
+  i.seg_override = seg;
+}
 
 instruction_t Decoder::decode(const uint8_t* o) {
   instruction_t i;
-  // TODO(rushfan): add in prefix bytes here.
-  i.bytes.push_back(*o);
-  const auto first_byte = *o++;
-  ++i.len;
-
-  if (first_byte == 0x2e) {
-    i.seg_override = segment_t::CS;
-    i.bytes.push_back(*o);
-    i.op = *o++;
-    ++i.len;
-  } else if (first_byte == 0x36) {
-    i.seg_override = segment_t::SS;
-    i.bytes.push_back(*o);
-    i.op = *o++;
-    ++i.len;
-  } else if (first_byte == 0x3E) {
-    i.seg_override = segment_t::DS;
-    ++i.len;
-    i.bytes.push_back(*o);
-    i.op = *o++;
-  } else if (first_byte == 0x26) {
-    i.seg_override = segment_t::ES;
-    i.bytes.push_back(*o);
-    i.op = *o++;
-    ++i.len;
-  } else if (first_byte == 0xf0) {
-    i.lock = true;
-    i.bytes.push_back(*o);
-    i.op = *o++;
-    ++i.len;
-  } else if (first_byte == 0xf2) {
-    i.repne = true;
-    i.bytes.push_back(*o);
-    i.op = *o++;
-    ++i.len;
-  } else if (first_byte == 0xf3) {
-    i.rep = true;
-    i.bytes.push_back(*o);
-    i.op = *o++;
-    ++i.len;
-  } else {
-    i.op = first_byte;
+  const auto* start = o;
+  // Prefixes are folded into the instruction (and it's dispatch index) here
+  // so the CPU never sees them as separate instructions.
+  for (int n = 0; n <= max_prefixes; n++) {
+    const auto b = *o++;
+    if (n == max_prefixes) {
+      i.op = b;
+      break;
+    }
+    if (b == 0x2e) {
+      set_seg_override(i, segment_t::CS);
+    } else if (b == 0x36) {
+      set_seg_override(i, segment_t::SS);
+    } else if (b == 0x3E) {
+      set_seg_override(i, segment_t::DS);
+    } else if (b == 0x26) {
+      set_seg_override(i, segment_t::ES);
+    } else if (b == 0xf0) {
+      i.lock = true;
+    } else if (b == 0xf2) {
+      i.repne = true;
+    } else if (b == 0xf3) {
+      i.rep = true;
+    } else {
+      i.op = b;
+      break;
+    }
   }
 
-  i.metadata = op_data_[i.op];
-  if (has_modrm(i.metadata.mask)) {
-    ++i.len;
-    i.bytes.push_back(*o);
+  i.metadata = &op_data_[i.op];
+  const auto mask = i.metadata->mask;
+  if (has_modrm(mask)) {
     i.mdrm = parse_modrm(*o++);
     if ((i.mdrm.rm == 0x06 && i.mdrm.mod == 0) || i.mdrm.mod == 0x02) {
-      i.len += 2;
       // disp16
-      i.bytes.push_back(*o);
-      auto lsb = *o++;
-      i.bytes.push_back(*o);
-      auto msb = *o++;
+      const auto lsb = *o++;
+      const auto msb = *o++;
       i.disp16 = (msb << 8) | lsb;
     } else if (i.mdrm.mod == 0x01) {
-      i.len++;
-      i.bytes.push_back(*o);
       i.disp8 = *o++;
     }
   }
   // Let the metadata immediate bytes replace any that came from
   // modrm bytes
-  if (i.metadata.mask & op_mask_imm8) {
-    i.len++;
-    i.bytes.push_back(*o);
+  if (mask & op_mask_imm8) {
     i.imm8 = *o++;
-  } else if (i.metadata.mask & op_mask_imm16) {
-    i.len += 2;
-    i.bytes.push_back(*o);
-    auto lsb = *o++;
-    i.bytes.push_back(*o);
-    auto msb = *o++;
+  } else if (mask & op_mask_imm16) {
+    const auto lsb = *o++;
+    const auto msb = *o++;
     i.imm16 = (msb << 8) | lsb;
   }
+  i.len = static_cast<uint8_t>(o - start);
+  i.dispatch = dispatch_index(i);
+  if (save_bytes_) {
+    i.num_bytes = i.len;
+    std::copy(start, o, std::begin(i.bytes));
+  }
   return i;
 }
 
@@ -529,8 +529,8 @@ std::string instruction_t::DebugString() const {
   static std::vector<char*> reg8 = {"AL", "CL", "DL", "BL", "AH", "CH", "DH", "BH"};
 
   std::ostringstream ss;
-  if (!bytes.empty()) {
-    auto bs = fmt::format("{:02X}", fmt::join(bytes, ""));
+  if (num_bytes > 0) {
+    auto bs = fmt::format("{:02X}", fmt::join(std::begin(bytes), std::begin(bytes) + num_bytes, ""));
     ss << fmt::format("{:10}", bs);
   };
   //ss << fmt::format("[len:{}] ", len);
@@ -540,41 +540,41 @@ std::string instruction_t::DebugString() const {
   } else if (repne) {
     ss << "[REPNE]";
   }
-  if (seg_override.has_value()) {
+  if (has_seg_override) {
     ss << fmt::format("[SO:{}] ", segment_names.at(static_cast<int>(seg_index())));
   }
-  ss << metadata.name << " ";
-  if (metadata.mask & uses_reg_subcode) {
+  ss << metadata->name << " ";
+  if (metadata->mask & uses_reg_subcode) {
     ss << fmt::format("/{:d} ", mdrm.reg);
   }
-  if (metadata.mask & uses_encoded_reg) {
-    if (metadata.bits == 8) {
-      ss << rmreg8_to_string(op - metadata.r_base) << " ";
+  if (metadata->mask & uses_encoded_reg) {
+    if (metadata->bits == 8) {
+      ss << rmreg8_to_string(op - metadata->r_base) << " ";
     } else {
-      ss << rmreg16_to_string(op - metadata.r_base) << " ";
+      ss << rmreg16_to_string(op - metadata->r_base) << " ";
     }
   }
   if (has_modrm()) {
-    switch (metadata.op_enc) {
+    switch (metadata->op_enc) {
     case op_enc_t::r_rm:
-      ss << r_to_string(mdrm, metadata) << ", ";
-      ss << rm_to_string(mdrm, metadata, disp8, disp16);
+      ss << r_to_string(mdrm, *metadata) << ", ";
+      ss << rm_to_string(mdrm, *metadata, disp8, disp16);
       break;
     case op_enc_t::rm_r:
-      ss << r_to_string(mdrm, metadata) << ", " << rm_to_string(mdrm, metadata, disp8, disp16);
+      ss << r_to_string(mdrm, *metadata) << ", " << rm_to_string(mdrm, *metadata, disp8, disp16);
       break;
     default: {
-      if (metadata.mask & op_mask_has_r_and_rm) {
-        ss << r_to_string(mdrm, metadata) << ", ";
+      if (metadata->mask & op_mask_has_r_and_rm) {
+        ss << r_to_string(mdrm, *metadata) << ", ";
       }
-      ss << rm_to_string(mdrm, metadata, disp8, disp16);
+      ss << rm_to_string(mdrm, *metadata, disp8, disp16);
     } break;
     };
     ss << " ";
   }
-  if (metadata.mask & op_mask_imm8) {
+  if (metadata->mask & op_mask_imm8) {
     ss << fmt::format("0x{:02X} ", imm8);
-  } else if (metadata.mask & op_mask_imm16) {
+  } else if (metadata->mask & op_mask_imm16) {
     ss << fmt::format("0x{:04X} ", imm16);
   }
   return ss.str();
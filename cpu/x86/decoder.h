@@ -2,8 +2,9 @@
 #define INCLUDED_CPU_X86_DECODER_H
 
 #include "cpu/memory.h"
-#include <optional>
+#include <array>
 #include <string>
+#include <type_traits>
 #include <vector>
 
 namespace door86::cpu::x86 {
@@ -62,6 +63,51 @@ struct op_code_data_t {
   uint8_t r_base{0};
 };
 
+// Longest instruction we decode: 2 prefixes + opcode + modrm + disp16 + imm16
+constexpr int max_instruction_len = 8;
+
+// Most prefix bytes (segment override, LOCK, REP, REPNE) we decode on one instruction.
+constexpr int max_prefixes = 2;
+
+// Opcodes where the reg field of the ModRM byte selects the operation.
+constexpr std::array<uint8_t, 14> group_opcodes = {0x80, 0x81, 0x82, 0x83, 0xC0, 0xC1, 0xD0,
+                                                   0xD1, 0xD2, 0xD3, 0xF6, 0xF7, 0xFE, 0xFF};
+
+// Returns the index of op in group_opcodes, or -1 if it isn't a group opcode.
+constexpr int group_index(uint8_t op) {
+  for (int i = 0; i < static_cast<int>(group_opcodes.size()); i++) {
+    if (group_opcodes[i] == op) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+// String instructions that have their own handler when REP or REPNE prefixed.
+constexpr uint8_t first_rep_opcode = 0xA4;
+constexpr uint8_t last_rep_opcode = 0xAF;
+
+/**
+ * Layout of the CPU's dispatch table, see instruction_t::dispatch.
+ *
+ *   0x000-0x0FF: one handler per opcode.
+ *   dispatch_group_base: 8 handlers (one per ModRM reg) for each of group_opcodes.
+ *   dispatch_rep_base: REP/REPNE handlers for first_rep_opcode to last_rep_opcode.
+ *   dispatch_notimpl: opcodes we don't implement yet.
+ */
+constexpr uint16_t dispatch_group_base = 0x100;
+constexpr uint16_t dispatch_rep_base = dispatch_group_base + group_opcodes.size() * 8;
+constexpr uint16_t dispatch_notimpl =
+    dispatch_rep_base + (last_rep_opcode - first_rep_opcode + 1);
+constexpr uint16_t dispatch_size = dispatch_notimpl + 1;
+
+/**
+ * A decoded instruction.
+ *
+ * This is a fixed size, trivially copyable record so that decoding never
+ * touches the heap. The opcode metadata is owned by the Decoder that created
+ * the instruction and must outlive it.
+ */
 class instruction_t {
 public:
   uint8_t op{0};
@@ -70,8 +116,11 @@ public:
   uint16_t disp16{0};
   uint8_t imm8{0};
   uint16_t imm16{0};
-  int len{0};
-  op_code_data_t metadata{};
+  uint8_t len{0};
+  // Index of the handler in the CPU's dispatch table, resolved by the decoder
+  // from the opcode, group sub-opcode and prefixes.
+  uint16_t dispatch{dispatch_notimpl};
+  const op_code_data_t* metadata{nullptr};
 
   // methods.
   bool has_modrm() const;
@@ -83,16 +132,24 @@ public:
   // prefix instructions
   // TODO(rushfan: merge rep and repne and set direction
 
-  std::optional<segment_t> seg_override;
+  bool has_seg_override{false};
+  segment_t seg_override{segment_t::DS};
   bool lock{false};
   bool rep{false};
   bool repne{false};
 
-  std::vector<uint8_t> bytes;
+  // Raw bytes of the instruction, only filled in when the decoder saves bytes.
+  uint8_t num_bytes{0};
+  std::array<uint8_t, max_instruction_len> bytes{};
 };
 
+static_assert(std::is_trivially_copyable_v<instruction_t>, "instruction_t must be trivially copyable");
+
 reg_mod_rm parse_modrm(uint8_t b);
 
+// Returns the dispatch table index for the decoded instruction i.
+uint16_t dispatch_index(const instruction_t& i);
+
 std::string rmreg8_to_string(uint8_t);
 std::string rmreg16_to_string(uint8_t);
 
@@ -112,7 +169,7 @@ public:
   /** Fetches the next instruction from the bytestream at o */
   instruction_t decode(const uint8_t* o);
   /** Fetches the next instruction from the bytestream at o */
-  instruction_t decode(const std::vector<uint8_t> o);
+  instruction_t decode(const std::vector<uint8_t>& o);
 
 //  std::string to_string(const instruction_t& i);
   const op_code_data_t& op_data(uint8_t opcode) const { return op_data_.at(opcode); }
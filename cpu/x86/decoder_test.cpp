@@ -34,19 +34,19 @@ TEST(DecoderTest, Smoke) {
   uint8_t* end = ip + ops.length();
   auto inst = decoder.decode(ip);
   ip += inst.len;
-  EXPECT_EQ("MOV", inst.metadata.name);
+  EXPECT_EQ("MOV", inst.metadata->name);
   inst = decoder.decode(ip);
   ip += inst.len;
-  EXPECT_EQ("MOV", inst.metadata.name);
+  EXPECT_EQ("MOV", inst.metadata->name);
   inst = decoder.decode(ip);
   ip += inst.len;
-  EXPECT_EQ("MOV", inst.metadata.name);
+  EXPECT_EQ("MOV", inst.metadata->name);
   inst = decoder.decode(ip);
   ip += inst.len;
-  EXPECT_EQ("LEA", inst.metadata.name);
+  EXPECT_EQ("LEA", inst.metadata->name);
   inst = decoder.decode(ip);
   ip += inst.len;
-  EXPECT_EQ("INT", inst.metadata.name);
+  EXPECT_EQ("INT", inst.metadata->name);
 }
 
 // 810626008000
@@ -60,4 +60,67 @@ TEST(DecoderTest, Disp16AndImm16) {
   EXPECT_EQ(0x0080, inst.imm16);
 }
 
-// 833E260000 - Disp16AndImm8
\ No newline at end of file
+// 833E260000 - Disp16AndImm8
+TEST(DecoderTest, SaveBytes) {
+  Decoder decoder(true);
+  const auto ops = parse_opcodes_from_line("2E810626008000");
+  const auto inst = decoder.decode(ops);
+
+  EXPECT_EQ(7, inst.len);
+  ASSERT_EQ(7, inst.num_bytes);
+  EXPECT_EQ(0x2E, inst.bytes[0]);
+  EXPECT_EQ(0x80, inst.bytes[5]);
+  EXPECT_TRUE(inst.has_seg_override);
+  EXPECT_EQ(door86::cpu::segment_t::CS, inst.seg_index());
+}
+
+TEST(DecoderTest, NoSaveBytes) {
+  Decoder decoder(false);
+  const auto ops = parse_opcodes_from_line("810626008000");
+  const auto inst = decoder.decode(ops);
+
+  EXPECT_EQ(6, inst.len);
+  EXPECT_EQ(0, inst.num_bytes);
+  EXPECT_FALSE(inst.has_seg_override);
+  EXPECT_EQ(&decoder.op_data(0x81), inst.metadata);
+}
+
+TEST(DecoderTest, Dispatch_Opcode) {
+  Decoder decoder;
+  const auto inst = decoder.decode(parse_opcodes_from_line("B8FECA"));
+  EXPECT_EQ(0xB8, inst.dispatch);
+}
+
+TEST(DecoderTest, Dispatch_Group) {
+  Decoder decoder;
+  // 83 /5 ib: SUB BX, 1
+  const auto inst = decoder.decode(parse_opcodes_from_line("83EB01"));
+  EXPECT_EQ(dispatch_group_base + group_index(0x83) * 8 + 5, inst.dispatch);
+}
+
+TEST(DecoderTest, Dispatch_Rep) {
+  Decoder decoder;
+  const auto inst = decoder.decode(parse_opcodes_from_line("F3A4"));
+  EXPECT_EQ(dispatch_rep_base + (0xA4 - first_rep_opcode), inst.dispatch);
+
+  // REP is ignored on non string instructions.
+  const auto ret = decoder.decode(parse_opcodes_from_line("F3C3"));
+  EXPECT_EQ(0xC3, ret.dispatch);
+}
+
+TEST(DecoderTest, Dispatch_NotImpl) {
+  Decoder decoder;
+  const auto inst = decoder.decode(parse_opcodes_from_line("9B"));
+  EXPECT_EQ(dispatch_notimpl, inst.dispatch);
+}
+
+TEST(DecoderTest, TwoPrefixes) {
+  Decoder decoder;
+  const auto inst = decoder.decode(parse_opcodes_from_line("F32EA4"));
+  EXPECT_EQ(3, inst.len);
+  EXPECT_EQ(0xA4, inst.op);
+  EXPECT_TRUE(inst.rep);
+  EXPECT_TRUE(inst.has_seg_override);
+  EXPECT_EQ(door86::cpu::segment_t::CS, inst.seg_override);
+  EXPECT_EQ(dispatch_rep_base, inst.dispatch);
+}
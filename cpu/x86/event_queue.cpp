@@ -0,0 +1,42 @@
+#include "cpu/x86/event_queue.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace door86::cpu::x86 {
+
+bool EventQueue::later(const event_t& a, const event_t& b) {
+  return a.at != b.at ? a.at > b.at : a.id > b.id;
+}
+
+EventQueue::event_id EventQueue::schedule(uint64_t at, callback_t fn) {
+  const auto id = next_id_++;
+  heap_.push_back({at, id, std::move(fn)});
+  std::push_heap(heap_.begin(), heap_.end(), later);
+  next_ = heap_.front().at;
+  return id;
+}
+
+bool EventQueue::cancel(event_id id) {
+  const auto it =
+      std::find_if(heap_.begin(), heap_.end(), [id](const event_t& e) { return e.id == id; });
+  if (it == heap_.end()) {
+    return false;
+  }
+  heap_.erase(it);
+  std::make_heap(heap_.begin(), heap_.end(), later);
+  next_ = heap_.empty() ? never : heap_.front().at;
+  return true;
+}
+
+void EventQueue::run_due(uint64_t now) {
+  while (!heap_.empty() && heap_.front().at <= now) {
+    std::pop_heap(heap_.begin(), heap_.end(), later);
+    auto e = std::move(heap_.back());
+    heap_.pop_back();
+    next_ = heap_.empty() ? never : heap_.front().at;
+    e.fn(e.at);
+  }
+}
+
+} // namespace door86::cpu::x86
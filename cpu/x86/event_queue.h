@@ -0,0 +1,65 @@
+#ifndef INCLUDED_CPU_X86_EVENT_QUEUE_H
+#define INCLUDED_CPU_X86_EVENT_QUEUE_H
+
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <vector>
+
+namespace door86::cpu::x86 {
+
+/**
+ * Device events (timer outputs changing, a UART finishing a byte) due at a
+ * point in guest time, counted in cycles (see GuestClock::elapsed_cycles).
+ *
+ * Events are kept in a heap, so the run loop only has to compare the time
+ * against next() at the start of each block, rather than every device
+ * looking at the time after every instruction. An event runs at the end of
+ * the block it fell in (or within a few blocks when guest time is the host's
+ * clock), and while a program waits it's parked or the virtual clock is moved
+ * on until the next one (see CPU::run).
+ */
+class EventQueue {
+public:
+  using event_id = uint64_t;
+  // Called with the cycle count the event was due at.
+  using callback_t = std::function<void(uint64_t at)>;
+
+  static constexpr uint64_t never = std::numeric_limits<uint64_t>::max();
+
+  EventQueue() = default;
+  ~EventQueue() = default;
+
+  /** Runs fn once the cycle count reaches at. */
+  event_id schedule(uint64_t at, callback_t fn);
+  /** Removes the event id if it hasn't run yet, returns true if it was removed */
+  bool cancel(event_id id);
+
+  /** Cycle count the first event is due at, never if there are none */
+  uint64_t next() const noexcept { return next_; }
+  /**
+   * Runs the events due at or before now, in order. Events they schedule at
+   * or before now run too.
+   */
+  void run_due(uint64_t now);
+
+  size_t size() const noexcept { return heap_.size(); }
+  bool empty() const noexcept { return heap_.empty(); }
+
+private:
+  struct event_t {
+    uint64_t at;
+    event_id id;
+    callback_t fn;
+  };
+  // Orders the heap with the earliest event first, in the order scheduled for ties.
+  static bool later(const event_t& a, const event_t& b);
+
+  std::vector<event_t> heap_;
+  event_id next_id_{1};
+  uint64_t next_{never};
+};
+
+} // namespace door86::cpu::x86
+
+#endif // INCLUDED_CPU_X86_EVENT_QUEUE_H
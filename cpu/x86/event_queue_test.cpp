@@ -0,0 +1,56 @@
+#include <gtest/gtest.h>
+
+#include "cpu/x86/event_queue.h"
+#include <vector>
+
+using namespace door86::cpu::x86;
+
+TEST(EventQueueTest, Empty) {
+  EventQueue q;
+  EXPECT_TRUE(q.empty());
+  EXPECT_EQ(EventQueue::never, q.next());
+  q.run_due(1000);
+}
+
+TEST(EventQueueTest, RunsInOrder) {
+  EventQueue q;
+  std::vector<int> ran;
+  q.schedule(300, [&ran](uint64_t) { ran.push_back(3); });
+  q.schedule(100, [&ran](uint64_t) { ran.push_back(1); });
+  q.schedule(200, [&ran](uint64_t) { ran.push_back(2); });
+  q.schedule(100, [&ran](uint64_t) { ran.push_back(11); });
+  EXPECT_EQ(100u, q.next());
+  q.run_due(99);
+  EXPECT_TRUE(ran.empty());
+  q.run_due(250);
+  EXPECT_EQ((std::vector<int>{1, 11, 2}), ran);
+  EXPECT_EQ(300u, q.next());
+  EXPECT_EQ(1u, q.size());
+}
+
+TEST(EventQueueTest, Cancel) {
+  EventQueue q;
+  int ran = 0;
+  const auto first = q.schedule(100, [&ran](uint64_t) { ran += 1; });
+  q.schedule(200, [&ran](uint64_t) { ran += 2; });
+  EXPECT_TRUE(q.cancel(first));
+  EXPECT_FALSE(q.cancel(first));
+  EXPECT_EQ(200u, q.next());
+  q.run_due(1000);
+  EXPECT_EQ(2, ran);
+  EXPECT_EQ(EventQueue::never, q.next());
+}
+
+TEST(EventQueueTest, Reschedule) {
+  EventQueue q;
+  std::vector<uint64_t> at;
+  // A periodic event, like a timer.
+  std::function<void(uint64_t)> tick = [&](uint64_t due) {
+    at.push_back(due);
+    q.schedule(due + 100, tick);
+  };
+  q.schedule(100, tick);
+  q.run_due(350);
+  EXPECT_EQ((std::vector<uint64_t>{100, 200, 300}), at);
+  EXPECT_EQ(400u, q.next());
+}
@@ -0,0 +1,81 @@
+#include "cpu/x86/guest_clock.h"
+
+#include <ctime>
+
+namespace door86::cpu::x86 {
+
+using std::chrono::duration_cast;
+using std::chrono::microseconds;
+using std::chrono::nanoseconds;
+
+// Local time as microseconds since 1970-01-01 00:00.
+static int64_t host_local_us() {
+  const auto now = std::chrono::system_clock::now();
+  const auto t = std::chrono::system_clock::to_time_t(now);
+  std::tm local{};
+  std::tm utc{};
+#ifdef _WIN32
+  localtime_s(&local, &t);
+  gmtime_s(&utc, &t);
+#else
+  localtime_r(&t, &local);
+  gmtime_r(&t, &utc);
+#endif
+  // mktime takes both as local times, so the difference is the UTC offset.
+  utc.tm_isdst = local.tm_isdst;
+  const auto offset = static_cast<int64_t>(std::difftime(std::mktime(&local), std::mktime(&utc)));
+  return duration_cast<microseconds>(now.time_since_epoch()).count() + offset * 1000000;
+}
+
+GuestClock::GuestClock(uint64_t& cycles)
+    : cycles_(cycles), start_(clock::now()), local_start_us_(host_local_us()) {}
+
+void GuestClock::set_virtual(int64_t start_us) {
+  virtual_ = true;
+  local_start_us_ = start_us;
+  start_cycles_ = cycles_;
+}
+
+GuestClock::clock::time_point GuestClock::now() const {
+  if (!virtual_) {
+    return clock::now();
+  }
+  return start_ + to_duration(cycles_ - start_cycles_);
+}
+
+int64_t GuestClock::local_us() const {
+  return local_start_us_ + duration_cast<microseconds>(now() - start_).count();
+}
+
+uint64_t GuestClock::elapsed_cycles() const {
+  if (virtual_) {
+    return cycles_;
+  }
+  const auto ns = std::chrono::duration_cast<nanoseconds>(clock::now() - start_).count();
+  // In two parts so it doesn't overflow.
+  const auto s = static_cast<uint64_t>(ns / 1000000000);
+  const auto rem = static_cast<uint64_t>(ns % 1000000000);
+  return s * cpu_hz + rem * cpu_hz / 1000000000;
+}
+
+void GuestClock::advance_to(clock::time_point tp) {
+  if (!virtual_) {
+    return;
+  }
+  const auto target = start_cycles_ + to_cycles(tp - start_);
+  if (target > cycles_) {
+    cycles_ = target;
+  }
+}
+
+uint64_t GuestClock::to_cycles(clock::duration d) {
+  const auto us = std::chrono::ceil<microseconds>(d).count();
+  return us <= 0 ? 0 : (static_cast<uint64_t>(us) * cpu_hz + 999999) / 1000000;
+}
+
+GuestClock::clock::duration GuestClock::to_duration(uint64_t cycles) {
+  // In two parts so it doesn't overflow.
+  return microseconds(cycles / cpu_hz * 1000000 + cycles % cpu_hz * 1000000 / cpu_hz);
+}
+
+} // namespace door86::cpu::x86
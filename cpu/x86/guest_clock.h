@@ -0,0 +1,72 @@
+#ifndef INCLUDED_CPU_X86_GUEST_CLOCK_H
+#define INCLUDED_CPU_X86_GUEST_CLOCK_H
+
+#include <chrono>
+#include <cstdint>
+
+namespace door86::cpu::x86 {
+
+/**
+ * Time as the program sees it, used for everything it can observe: the BIOS
+ * tick count and INT 1Ah, DOS date and time, and timers it waits for.
+ *
+ * Normally this is the host's clock. With virtual time, it only moves as
+ * instructions execute, at the 8088's 4.77 MHz (see CPU::cycles), from a fixed
+ * date and time, so a run does exactly the same thing every time. Waiting
+ * costs nothing: rather than parking a spinning program, CPU::run moves the
+ * clock ahead to the next thing it could be waiting for (see advance_to), by
+ * adding the cycles it would have spent waiting. Waiting for input that's
+ * typed live (see IdleDetector::live_input) still takes real time.
+ */
+class GuestClock {
+public:
+  using clock = std::chrono::steady_clock;
+
+  static constexpr uint64_t cpu_hz = 4772727;
+  static constexpr int64_t us_per_day = 86400LL * 1000000;
+  // 1990-01-01 00:00:00
+  static constexpr int64_t default_virtual_start = 631152000LL * 1000000;
+
+  // cycles is the count of 8088 clock cycles executed.
+  explicit GuestClock(uint64_t& cycles);
+  ~GuestClock() = default;
+
+  /**
+   * Switches to virtual time, starting at the local time start_us (in
+   * microseconds since 1970-01-01 00:00). Call this before running anything.
+   */
+  void set_virtual(int64_t start_us = default_virtual_start);
+  bool is_virtual() const noexcept { return virtual_; }
+
+  // Monotonic time, for deadlines.
+  clock::time_point now() const;
+  // Local date and time, in microseconds since 1970-01-01 00:00.
+  int64_t local_us() const;
+  /**
+   * Guest time as 8088 clock cycles, which devices keep time in (see
+   * EventQueue). With virtual time that's CPU::cycles, otherwise it's the
+   * host's clock since the CPU started, so timers run in real time however
+   * fast the program executes.
+   */
+  uint64_t elapsed_cycles() const;
+
+  // Moves virtual time ahead to tp, if it's in the future.
+  void advance_to(clock::time_point tp);
+
+  // Cycles it takes to run for d, rounded up.
+  static uint64_t to_cycles(clock::duration d);
+  static clock::duration to_duration(uint64_t cycles);
+
+private:
+  uint64_t& cycles_;
+  bool virtual_{false};
+  // now() and local_us() when the clock started.
+  clock::time_point start_;
+  int64_t local_start_us_{0};
+  // cycles when virtual time started.
+  uint64_t start_cycles_{0};
+};
+
+} // namespace door86::cpu::x86
+
+#endif // INCLUDED_CPU_X86_GUEST_CLOCK_H
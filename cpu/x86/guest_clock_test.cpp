@@ -0,0 +1,46 @@
+#include <gtest/gtest.h>
+
+#include "cpu/x86/guest_clock.h"
+#include <chrono>
+
+using namespace door86::cpu::x86;
+using namespace std::chrono_literals;
+
+TEST(GuestClockTest, HostTime) {
+  uint64_t cycles = 0;
+  GuestClock time(cycles);
+  EXPECT_FALSE(time.is_virtual());
+  const auto before = std::chrono::steady_clock::now();
+  const auto now = time.now();
+  EXPECT_GE(now, before);
+  EXPECT_LE(now, std::chrono::steady_clock::now());
+  // Doesn't move the host's clock.
+  time.advance_to(now + 1h);
+  EXPECT_LT(time.now(), now + 1h);
+}
+
+TEST(GuestClockTest, VirtualTime) {
+  uint64_t cycles = 100;
+  GuestClock time(cycles);
+  time.set_virtual();
+  const auto start = time.now();
+  EXPECT_EQ(GuestClock::default_virtual_start, time.local_us());
+  cycles += GuestClock::cpu_hz;
+  EXPECT_EQ(start + 1s, time.now());
+  EXPECT_EQ(GuestClock::default_virtual_start + 1000000, time.local_us());
+}
+
+TEST(GuestClockTest, AdvanceTo) {
+  uint64_t cycles = 0;
+  GuestClock time(cycles);
+  time.set_virtual(0);
+  const auto start = time.now();
+  time.advance_to(start + 1500ms);
+  EXPECT_EQ(start + 1500ms, time.now());
+  // Never goes back.
+  time.advance_to(start);
+  EXPECT_EQ(start + 1500ms, time.now());
+  // Then moves on as instructions run.
+  cycles += GuestClock::cpu_hz;
+  EXPECT_EQ(2500000, time.local_us());
+}
@@ -0,0 +1,129 @@
+#include "cpu/x86/idle.h"
+
+#include "core/log.h"
+#include "cpu/x86/cpu.h"
+#include <algorithm>
+#include <cstring>
+
+namespace door86::cpu::x86 {
+
+IdleDetector::IdleDetector(CPU& cpu) : cpu_(cpu) {
+  // INT 16h - keyboard status and shift flags.
+  add_poll(0x16, 0x01);
+  add_poll(0x16, 0x02);
+  add_poll(0x16, 0x11);
+  add_poll(0x16, 0x12);
+  // INT 1Ah - read the tick count.
+  add_poll(0x1A, 0x00);
+  // INT 21h - check input status, get date and time.
+  add_poll(0x21, 0x0B);
+  add_poll(0x21, 0x2A);
+  add_poll(0x21, 0x2C);
+  // INT 14h - FOSSIL/serial port status.
+  add_poll(0x14, 0x03);
+  // INT 28h - DOS idle.
+  add_poll(0x28);
+}
+
+IdleDetector::snapshot_t IdleDetector::snapshot() const {
+  const auto& c = cpu_.core;
+  return {c.regs.x, c.sregs, c.ip, c.flags.value(), cpu_.memory.writes(), cpu_.io.outputs(),
+          services_};
+}
+
+static bool same(const regs16& a, const regs16& b) { return memcmp(&a, &b, sizeof(regs16)) == 0; }
+
+static bool same(const sregs_t& a, const sregs_t& b) {
+  return a.cs == b.cs && a.ds == b.ds && a.es == b.es && a.ss == b.ss && a.fs == b.fs &&
+         a.gs == b.gs;
+}
+
+bool IdleDetector::on_block(uint32_t start) {
+  if (!enabled) {
+    return false;
+  }
+  if (yield_) {
+    yield_ = false;
+    return true;
+  }
+  if (static_cast<int64_t>(start) != head_) {
+    if (++since_head_ > max_loop_blocks) {
+      // Not a loop we know about, start watching this block instead.
+      head_ = start;
+      since_head_ = 0;
+      spins_ = 0;
+      last_ = snapshot();
+    }
+    return false;
+  }
+  since_head_ = 0;
+  const auto now = snapshot();
+  if (!same(now.x, last_.x) || !same(now.sregs, last_.sregs) || now.ip != last_.ip ||
+      now.flags != last_.flags || now.writes != last_.writes || now.outputs != last_.outputs ||
+      now.services != last_.services) {
+    // Made progress.
+    spins_ = 0;
+    last_ = now;
+    return false;
+  }
+  if (++spins_ < spin_threshold) {
+    return false;
+  }
+  spins_ = 0;
+  return true;
+}
+
+void IdleDetector::on_interrupt(int num, uint8_t ah, uint8_t al) {
+  if (num == 0x2F && ah == 0x16 && al == 0x80) {
+    // INT 2Fh AX=1680h - release current virtual machine time slice.
+    yield_ = true;
+    return;
+  }
+  if (!is_poll(num, ah)) {
+    ++services_;
+  }
+}
+
+void IdleDetector::add_poll(int num, int ah) { polls_.emplace(num, ah); }
+
+bool IdleDetector::is_poll(int num, uint8_t ah) const {
+  return polls_.count({num, ah}) || polls_.count({num, -1});
+}
+
+void IdleDetector::wake() {
+  {
+    std::lock_guard lock(mu_);
+    woken_ = true;
+  }
+  cv_.notify_all();
+}
+
+std::optional<IdleDetector::clock::time_point> IdleDetector::wait_until(clock::time_point now) {
+  ++parks_;
+  std::lock_guard lock(mu_);
+  if (std::exchange(woken_, false)) {
+    return std::nullopt;
+  }
+  const auto until = std::min(deadline_, now + max_park);
+  if (deadline_ <= until) {
+    deadline_ = clock::time_point::max();
+  }
+  return until;
+}
+
+void IdleDetector::park_for(clock::duration d) {
+  const auto end = clock::now() + d;
+  std::unique_lock lock(mu_);
+  cv_.wait_until(lock, end, [this] { return woken_; });
+  woken_ = false;
+}
+
+void IdleDetector::wake_at(clock::time_point tp) {
+  {
+    std::lock_guard lock(mu_);
+    deadline_ = std::min(deadline_, tp);
+  }
+  cv_.notify_all();
+}
+
+} // namespace door86::cpu::x86
@@ -0,0 +1,122 @@
+#ifndef INCLUDED_CPU_X86_IDLE_H
+#define INCLUDED_CPU_X86_IDLE_H
+
+#include "cpu/x86/regs.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <utility>
+
+namespace door86::cpu::x86 {
+
+class CPU;
+
+/**
+ * Notices when a program is spinning in a loop waiting for something to
+ * happen (a keystroke, the BIOS tick to change, a UART status bit) so the
+ * thread running it can be parked until something does.  CPU::run_for stops
+ * with stop_reason_t::waiting when it does.
+ *
+ * The block dispatcher calls on_block at the start of every block. A loop is
+ * considered to be spinning when execution keeps coming back to the same
+ * block with exactly the same registers and flags, and in between:
+ *  - nothing in memory changed, other than Memory counters.
+ *  - nothing was written to an IO port (reading status ports is polling).
+ *  - no host interrupt services ran, other than poll services (i.e. INT 16h
+ *    AH=01h, which only asks if a key is ready).
+ *
+ * Anything that makes the program able to continue (a key arriving, etc)
+ * must call wake(), which may be done from any thread.
+ */
+class IdleDetector {
+public:
+  using clock = std::chrono::steady_clock;
+
+  // Blocks to wait for execution to return to the loop head before picking a new one.
+  static constexpr int max_loop_blocks = 32;
+
+  explicit IdleDetector(CPU& cpu);
+  ~IdleDetector() = default;
+
+  // If false, on_block never reports spinning.
+  bool enabled{false};
+  // Unchanged trips around a loop before it counts as spinning.
+  int spin_threshold{8};
+  // Longest time to park without being woken, one BIOS tick by default.
+  std::chrono::milliseconds max_park{55};
+  // Input comes from the host as it's typed (see Keyboard::attach), rather than
+  // being replayed, so with virtual time it can't be skipped ahead to.
+  bool live_input{false};
+
+  /**
+   * Called by the dispatcher before running the block at linear address start.
+   * Returns true if the program is spinning and should be parked, after which
+   * it has to spin for another spin_threshold trips before true is returned again.
+   */
+  bool on_block(uint32_t start);
+
+  /** Called after the host interrupt service num, with the AH it was called with, ran */
+  void on_interrupt(int num, uint8_t ah, uint8_t al);
+
+  /** Marks INT num AH=ah (any AH if ah is -1) as only checking for something to do */
+  void add_poll(int num, int ah = -1);
+
+  /** Wakes a thread in park_for, or keeps the next wait from happening if none is */
+  void wake();
+
+  /** Makes the next wait_until return by tp, for timers due then */
+  void wake_at(clock::time_point tp);
+
+  /**
+   * Returns when a waiting program should run again if nothing wakes it, as
+   * of now on the guest clock: the next deadline, or max_park from now. Returns
+   * nullopt if wake() was called, so it can run again right away. Used by
+   * CPU::begin_wait, which parks the program or moves virtual time on to then.
+   */
+  std::optional<clock::time_point> wait_until(clock::time_point now);
+
+  /** Waits until wake() is called, or d passes on the host's clock */
+  void park_for(clock::duration d);
+
+  /** Number of times wait_until has been called, i.e. the program waited */
+  uint64_t parks() const noexcept { return parks_; }
+
+private:
+  struct snapshot_t {
+    regs16 x;
+    sregs_t sregs;
+    uint16_t ip;
+    uint16_t flags;
+    uint64_t writes;
+    uint64_t outputs;
+    uint64_t services;
+  };
+  snapshot_t snapshot() const;
+  bool is_poll(int num, uint8_t ah) const;
+
+  CPU& cpu_;
+  std::set<std::pair<int, int>> polls_;
+  // linear address of the block at the top of the current loop, or -1.
+  int64_t head_{-1};
+  // blocks since execution was last at head_.
+  int since_head_{0};
+  int spins_{0};
+  snapshot_t last_{};
+  // non-poll host interrupt services run.
+  uint64_t services_{0};
+  // program asked to give up its time slice.
+  bool yield_{false};
+  uint64_t parks_{0};
+
+  std::mutex mu_;
+  std::condition_variable cv_;
+  bool woken_{false};
+  clock::time_point deadline_{clock::time_point::max()};
+};
+
+} // namespace door86::cpu::x86
+
+#endif // INCLUDED_CPU_X86_IDLE_H
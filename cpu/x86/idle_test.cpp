@@ -0,0 +1,136 @@
+#include <gtest/gtest.h>
+
+#include "cpu/x86/cpu.h"
+#include "cpu/x86/cpu_fixture.h"
+#include "cpu/x86/idle.h"
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+
+using namespace door86::cpu;
+using namespace door86::cpu::x86;
+using namespace std::chrono_literals;
+
+class IdleTest : public testing::Test {
+public:
+  IdleTest() {
+    // INT 20h halts the CPU.
+    c.memory[0x20 * 4] = 0x20;
+    c.int_handlers().try_emplace(0x20, [](int, CPU& cpu) { cpu.halt(); });
+    // INT 16h AH=01h returns AL=1 once a key is ready after polls calls.
+    c.memory[0x16 * 4] = 0x16;
+    c.int_handlers().try_emplace(0x16, [this](int, CPU& cpu) {
+      cpu.core.regs.h.al = ++calls >= polls ? 1 : 0;
+    });
+    c.core.regs.x.ax = c.core.regs.x.bx = c.core.regs.x.cx = c.core.regs.x.dx = 0;
+    c.core.regs.x.si = c.core.regs.x.di = c.core.regs.x.bp = 0;
+    c.execution_mode = execution_mode_t::threaded;
+    c.idle.enabled = true;
+    c.idle.max_park = 1ms;
+  }
+
+  void run(const std::string& s) {
+    const auto ops = parse_opcodes_from_line(s);
+    ASSERT_TRUE(c.memory.load_image(0x1000, ops.size(), ops.data()));
+    ASSERT_TRUE(c.run(0x100, 0));
+  }
+
+  CPU c;
+  int calls{0};
+  int polls{100};
+};
+
+TEST_F(IdleTest, PollingParks) {
+  // L: MOV AH, 1; INT 16; CMP AL, 0; JE L; INT 20
+  run("B401 CD16 3C00 74F8 CD20");
+  EXPECT_EQ(polls, calls);
+  EXPECT_GT(c.idle.parks(), 0u);
+}
+
+TEST_F(IdleTest, WritingMemoryIsProgress) {
+  // L: INC BYTE [0200]; MOV AH, 1; INT 16; CMP AL, 0; JE L; INT 20
+  run("FE060002 B401 CD16 3C00 74F4 CD20");
+  EXPECT_EQ(polls, calls);
+  EXPECT_EQ(0u, c.idle.parks());
+}
+
+TEST_F(IdleTest, WritingCounterIsNotProgress) {
+  c.memory.add_counter(0x46C, 4);
+  // The BIOS tick keeps changing while the program waits.
+  c.int_handlers()[0x16] = [this](int, CPU& cpu) {
+    cpu.memory.set<uint16_t>(0x40, 0x6C, static_cast<uint16_t>(calls));
+    cpu.core.regs.h.al = ++calls >= polls ? 1 : 0;
+  };
+  run("B401 CD16 3C00 74F8 CD20");
+  EXPECT_EQ(polls, calls);
+  EXPECT_GT(c.idle.parks(), 0u);
+  EXPECT_EQ(polls - 1, c.memory.get<uint16_t>(0x40, 0x6C));
+}
+
+TEST_F(IdleTest, Disabled) {
+  c.idle.enabled = false;
+  run("B401 CD16 3C00 74F8 CD20");
+  EXPECT_EQ(0u, c.idle.parks());
+}
+
+TEST_F(IdleTest, Wake) {
+  const auto start = std::chrono::steady_clock::now();
+  // Woken before parking, so this doesn't wait.
+  c.idle.wake();
+  c.idle.park_for(10s);
+  // Or from another thread while it waits.
+  std::thread waker([this] {
+    std::this_thread::sleep_for(10ms);
+    c.idle.wake();
+  });
+  c.idle.park_for(10s);
+  waker.join();
+  EXPECT_LT(std::chrono::steady_clock::now() - start, 5s);
+}
+
+TEST_F(IdleTest, WaitUntil) {
+  c.idle.max_park = 10s;
+  const auto now = std::chrono::steady_clock::now();
+  EXPECT_EQ(now + 10s, c.idle.wait_until(now));
+  // Not past the next deadline.
+  c.idle.wake_at(now + 1ms);
+  EXPECT_EQ(now + 1ms, c.idle.wait_until(now));
+  // Woken, so it runs again right away.
+  c.idle.wake();
+  EXPECT_EQ(std::nullopt, c.idle.wait_until(now));
+  EXPECT_EQ(3u, c.idle.parks());
+}
+
+TEST_F(IdleTest, VirtualTimeFastForwards) {
+  c.time.set_virtual();
+  c.idle.max_park = 10s;
+  const auto start = std::chrono::steady_clock::now();
+  const auto virtual_start = c.time.now();
+  run("B401 CD16 3C00 74F8 CD20");
+  EXPECT_EQ(polls, calls);
+  EXPECT_GT(c.idle.parks(), 0u);
+  // Each park skipped max_park of virtual time instead of waiting for it.
+  EXPECT_GE(c.time.now() - virtual_start, 10s);
+  EXPECT_LT(std::chrono::steady_clock::now() - start, 5s);
+}
+
+TEST_F(IdleTest, VirtualTimeWaitsForLiveInput) {
+  c.time.set_virtual();
+  c.idle.live_input = true;
+  c.idle.max_park = 10s;
+  std::atomic<bool> typed{false};
+  c.int_handlers()[0x16] = [&typed](int, CPU& cpu) { cpu.core.regs.h.al = typed ? 1 : 0; };
+  std::thread typist([this, &typed] {
+    std::this_thread::sleep_for(50ms);
+    typed = true;
+    c.idle.wake();
+  });
+  const auto virtual_start = c.time.now();
+  run("B401 CD16 3C00 74F8 CD20");
+  typist.join();
+  // Parked until the key arrived, rather than spinning through max_park at a time.
+  EXPECT_LT(c.idle.parks(), 10u);
+  EXPECT_GE(c.time.now() - virtual_start, 40ms);
+  EXPECT_LT(c.time.now() - virtual_start, 5s);
+}
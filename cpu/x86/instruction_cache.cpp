@@ -0,0 +1,55 @@
+#include "cpu/x86/instruction_cache.h"
+
+#include "core/log.h"
+
+namespace door86::cpu::x86 {
+
+InstructionCache::InstructionCache(Decoder& decoder, Memory& memory)
+    : decoder_(decoder), memory_(memory) {}
+
+void InstructionCache::reset(page_t& page, uint32_t gen) {
+  page.gen = gen;
+  page.index.fill(-1);
+  page.insts.clear();
+}
+
+const instruction_t& InstructionCache::get(uint32_t loc) {
+  const auto page_num = loc >> Memory::page_shift;
+  const auto page_off = loc & (Memory::page_size - 1);
+  uint8_t buf[max_instruction_len];
+  if (page_off + max_instruction_len > Memory::page_size || !memory_.host_backed(loc)) {
+    // Instructions near the end of a page may span into the next one, writes
+    // there wouldn't be noticed, and what's read from a page that isn't RAM or
+    // ROM can change without a write, so don't cache these.
+    ++misses_;
+    scratch_ = decoder_.decode(memory_.fetch(loc, buf, max_instruction_len));
+    return scratch_;
+  }
+  if (page_num >= pages_.size()) {
+    pages_.resize(page_num + 1);
+  }
+  auto& page = pages_[page_num];
+  const auto gen = memory_.code_generation(loc);
+  if (!page) {
+    page = std::make_unique<page_t>();
+    reset(*page, gen);
+  } else if (page->gen != gen) {
+    VLOG(2) << "Code page written, dropping decoded instructions for page: " << page_num;
+    reset(*page, gen);
+  }
+
+  if (const auto idx = page->index[page_off]; idx >= 0) {
+    ++hits_;
+    return page->insts[idx];
+  }
+  ++misses_;
+  page->index[page_off] = static_cast<int16_t>(page->insts.size());
+  const auto& inst =
+      page->insts.emplace_back(decoder_.decode(memory_.fetch(loc, buf, max_instruction_len)));
+  memory_.mark_code(loc, inst.len);
+  return inst;
+}
+
+void InstructionCache::clear() { pages_.clear(); }
+
+} // namespace door86::cpu::x86
@@ -0,0 +1,62 @@
+#ifndef INCLUDED_CPU_X86_INSTRUCTION_CACHE_H
+#define INCLUDED_CPU_X86_INSTRUCTION_CACHE_H
+
+#include "cpu/memory.h"
+#include "cpu/x86/decoder.h"
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <vector>
+
+namespace door86::cpu::x86 {
+
+/**
+ * Cache of decoded instructions indexed by linear address.
+ *
+ * Instructions are grouped by the memory page that holds them. Each page
+ * remembers the code generation of the memory page when it was filled, and
+ * once a write changes the bytes of an instruction decoded from that page
+ * (self modifying code or code being loaded over the old image) every entry
+ * in that page is dropped and decoded again. Writes to data in the same
+ * page leave them alone (see Memory::mark_code).
+ */
+class InstructionCache {
+public:
+  InstructionCache(Decoder& decoder, Memory& memory);
+  ~InstructionCache() = default;
+
+  /** Returns the decoded instruction at linear address loc, after the A20 line (Memory::mask) */
+  const instruction_t& get(uint32_t loc);
+
+  /** Drops all cached instructions */
+  void clear();
+
+  // Statistics
+  uint64_t hits() const noexcept { return hits_; }
+  uint64_t misses() const noexcept { return misses_; }
+
+private:
+  struct page_t {
+    // memory code generation of the page when these entries were decoded.
+    uint32_t gen{0};
+    // index into insts for each offset within the page, or -1 if not decoded.
+    std::array<int16_t, Memory::page_size> index;
+    // deque so that references handed out stay valid as entries are added.
+    std::deque<instruction_t> insts;
+  };
+
+  void reset(page_t& page, uint32_t gen);
+
+  Decoder& decoder_;
+  Memory& memory_;
+  std::vector<std::unique_ptr<page_t>> pages_;
+  // Used for the rare instruction that spans two pages.
+  instruction_t scratch_;
+  uint64_t hits_{0};
+  uint64_t misses_{0};
+};
+
+} // namespace door86::cpu::x86
+
+#endif // INCLUDED_CPU_X86_INSTRUCTION_CACHE_H
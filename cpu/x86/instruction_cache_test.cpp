@@ -0,0 +1,66 @@
+#include <gtest/gtest.h>
+
+#include "cpu/memory.h"
+#include "cpu/x86/cpu_fixture.h"
+#include "cpu/x86/decoder.h"
+#include "cpu/x86/instruction_cache.h"
+#include <iostream>
+
+using namespace door86::cpu;
+using namespace door86::cpu::x86;
+
+class InstructionCacheTest : public testing::Test {
+public:
+  InstructionCacheTest() : cache(decoder, memory) {}
+
+  bool load(uint32_t loc, const std::string& s) {
+    const auto ops = parse_opcodes_from_line(s);
+    return memory.load_image(loc, ops.size(), ops.data());
+  }
+
+  Decoder decoder;
+  Memory memory{1 << 20};
+  InstructionCache cache;
+};
+
+TEST_F(InstructionCacheTest, Hit) {
+  ASSERT_TRUE(load(0x1000, "B8FECA"));
+  const auto& first = cache.get(0x1000);
+  EXPECT_EQ(0xB8, first.op);
+  EXPECT_EQ(0xCAFE, first.imm16);
+  EXPECT_EQ(1u, cache.misses());
+
+  const auto& second = cache.get(0x1000);
+  EXPECT_EQ(&first, &second);
+  EXPECT_EQ(1u, cache.hits());
+}
+
+TEST_F(InstructionCacheTest, SelfModifyingCode) {
+  ASSERT_TRUE(load(0x1000, "B8FECA"));
+  EXPECT_EQ(0xCAFE, cache.get(0x1000).imm16);
+
+  // Rewrite the immediate of the cached MOV.
+  memory.set<uint16_t>(0x100, 0x01, 0xBEEF);
+  EXPECT_EQ(0xBEEF, cache.get(0x1000).imm16);
+  EXPECT_EQ(2u, cache.misses());
+}
+
+TEST_F(InstructionCacheTest, WriteToOtherPage) {
+  ASSERT_TRUE(load(0x1000, "B8FECA"));
+  cache.get(0x1000);
+  memory.set<uint16_t>(0x200, 0x01, 0xBEEF);
+  cache.get(0x1000);
+  EXPECT_EQ(1u, cache.hits());
+  EXPECT_EQ(1u, cache.misses());
+}
+
+TEST_F(InstructionCacheTest, DataWriteToCodePage) {
+  ASSERT_TRUE(load(0x1000, "B8FECA"));
+  cache.get(0x1000);
+  // A variable next to the code.
+  memory.set<uint16_t>(0x100, 0x03, 0xBEEF);
+  memory.set<uint16_t>(0x100, 0x80, 0xBEEF);
+  EXPECT_EQ(0xCAFE, cache.get(0x1000).imm16);
+  EXPECT_EQ(1u, cache.hits());
+  EXPECT_EQ(1u, cache.misses());
+}
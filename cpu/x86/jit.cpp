@@ -0,0 +1,579 @@
+#include "cpu/x86/jit.h"
+
+#include "core/log.h"
+#include "cpu/x86/cpu.h"
+#include <cstddef>
+#include <iterator>
+#include <vector>
+
+namespace door86::cpu::x86 {
+
+#ifdef DOOR86_JIT
+
+namespace {
+
+enum host_reg_t : uint8_t {
+  RAX = 0, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+  R8, R9, R10, R11, R12, R13, R14, R15
+};
+
+// Registers used to pass the first three integer arguments.
+#ifdef _WIN32
+constexpr host_reg_t arg_regs[] = {RCX, RDX, R8};
+#else
+constexpr host_reg_t arg_regs[] = {RDI, RSI, RDX};
+#endif
+
+// Callee saved registers used by generated code, pushed by the prologue.
+constexpr host_reg_t saved_regs[] = {RBX, RBP, R12, R13, R14, R15};
+// Stack reserved below the saved registers. This is the Win64 shadow space and
+// also keeps RSP 16 byte aligned at calls.
+constexpr uint8_t frame_size = 40;
+// Holds the address of cpu_core for the whole block.
+constexpr host_reg_t core_reg = RBX;
+
+// Host register holding each guest register (in regs16 order: AX, CX, DX, BX,
+// SP, BP, SI, DI), or RSP for guest registers left in cpu_core.
+constexpr host_reg_t guest_regs[8] = {R12, R13, R14, R15, RSP, RSP, RBP, RSP};
+constexpr bool mapped(int guest) { return guest_regs[guest] != RSP; }
+
+// Generated code calls back into these for anything it doesn't translate.
+
+void jit_set_flags(flags_t* flags, uint32_t op_dst, uint32_t src_res) {
+  flags->lazy<uint16_t>(static_cast<flags_op_t>(op_dst >> 16), static_cast<uint16_t>(op_dst),
+                        static_cast<uint16_t>(src_res >> 16), static_cast<uint16_t>(src_res));
+}
+
+// Runs a single instruction with its handler, returns false if the block was
+// written to and has to stop.
+bool jit_execute(CPU* cpu, const block_entry_t* e, const block_t* block) {
+  (cpu->*e->fn)(e->inst);
+  return cpu->memory.code_generation(block->start) == block->gen;
+}
+
+// Just enough of an x86-64 assembler for the code we generate.
+class Emitter {
+public:
+  void byte(uint8_t b) { code.push_back(b); }
+  void word(uint16_t w) {
+    byte(static_cast<uint8_t>(w));
+    byte(static_cast<uint8_t>(w >> 8));
+  }
+  void dword(uint32_t d) {
+    word(static_cast<uint16_t>(d));
+    word(static_cast<uint16_t>(d >> 16));
+  }
+  void qword(uint64_t q) {
+    dword(static_cast<uint32_t>(q));
+    dword(static_cast<uint32_t>(q >> 32));
+  }
+
+  // REX prefix, only emitted when needed.
+  void rex(bool w, int reg, int rm) {
+    const uint8_t r = 0x40 | (w ? 0x08 : 0) | ((reg >> 3) << 2) | (rm >> 3);
+    if (r != 0x40) {
+      byte(r);
+    }
+  }
+  void modrm(int mod, int reg, int rm) {
+    byte(static_cast<uint8_t>((mod << 6) | ((reg & 7) << 3) | (rm & 7)));
+  }
+
+  // op16 r16, [core_reg + disp]
+  void op16_mem(uint8_t op, int r, int32_t disp) {
+    byte(0x66);
+    rex(false, r, core_reg);
+    byte(op);
+    modrm(2, r, core_reg);
+    dword(static_cast<uint32_t>(disp));
+  }
+  // mov r16, [core + disp]
+  void load16(int r, int32_t disp) { op16_mem(0x8B, r, disp); }
+  // mov [core + disp], r16
+  void store16(int32_t disp, int r) { op16_mem(0x89, r, disp); }
+  // add word [core + disp], imm16
+  void add_mem16(int32_t disp, uint16_t imm) {
+    byte(0x66);
+    byte(0x81);
+    modrm(2, 0, core_reg);
+    dword(static_cast<uint32_t>(disp));
+    word(imm);
+  }
+
+  // mov r16, imm16
+  void mov16(int r, uint16_t imm) {
+    byte(0x66);
+    rex(false, 0, r);
+    byte(0xB8 + (r & 7));
+    word(imm);
+  }
+  // mov r8, imm8 (low byte)
+  void mov8(int r, uint8_t imm) {
+    rex(false, 0, r);
+    byte(0xB0 + (r & 7));
+    byte(imm);
+  }
+  // op r/m16, r16 (ADD=01, OR=09, AND=21, SUB=29, XOR=31, CMP=39, MOV=89)
+  void alu16(uint8_t op, int dst, int src) {
+    byte(0x66);
+    rex(false, src, dst);
+    byte(op);
+    modrm(3, src, dst);
+  }
+  // op r16, imm16 (81 /ext)
+  void alu16_imm(int ext, int dst, uint16_t imm) {
+    byte(0x66);
+    rex(false, 0, dst);
+    byte(0x81);
+    modrm(3, ext, dst);
+    word(imm);
+  }
+  // inc/dec r16 (FF /0, FF /1)
+  void incdec16(bool dec, int r) {
+    byte(0x66);
+    rex(false, 0, r);
+    byte(0xFF);
+    modrm(3, dec ? 1 : 0, r);
+  }
+  // movzx r32, r16
+  void movzx(int dst, int src) {
+    rex(false, dst, src);
+    byte(0x0F);
+    byte(0xB7);
+    modrm(3, dst, src);
+  }
+  // mov r32, imm32
+  void mov32(int r, uint32_t imm) {
+    rex(false, 0, r);
+    byte(0xB8 + (r & 7));
+    dword(imm);
+  }
+  // op r/m32, r32 (OR=09, SUB=29)
+  void alu32(uint8_t op, int dst, int src) {
+    rex(false, src, dst);
+    byte(op);
+    modrm(3, src, dst);
+  }
+  // or r32, imm32
+  void or32_imm(int r, uint32_t imm) {
+    rex(false, 0, r);
+    byte(0x81);
+    modrm(3, 1, r);
+    dword(imm);
+  }
+  // shl r32, imm8
+  void shl32(int r, uint8_t n) {
+    rex(false, 0, r);
+    byte(0xC1);
+    modrm(3, 4, r);
+    byte(n);
+  }
+  // mov r64, imm64
+  void mov64(int r, uint64_t imm) {
+    rex(true, 0, r);
+    byte(0xB8 + (r & 7));
+    qword(imm);
+  }
+  void mov64(int r, const void* p) { mov64(r, reinterpret_cast<uint64_t>(p)); }
+  // mov r64, r64
+  void mov64_reg(int dst, int src) {
+    rex(true, src, dst);
+    byte(0x89);
+    modrm(3, src, dst);
+  }
+  void push(int r) {
+    rex(false, 0, r);
+    byte(0x50 + (r & 7));
+  }
+  void pop(int r) {
+    rex(false, 0, r);
+    byte(0x58 + (r & 7));
+  }
+  // call rax
+  void call_rax() {
+    byte(0xFF);
+    byte(0xD0);
+  }
+  // jmp rel32. Returns the offset of the rel32 to patch.
+  size_t jmp_rel32() {
+    byte(0xE9);
+    const auto at = code.size();
+    dword(0);
+    return at;
+  }
+  // test al, al; jz rel32. Returns the offset of the rel32 to patch.
+  size_t jz_if_al_zero() {
+    byte(0x84);
+    byte(0xC0);
+    byte(0x0F);
+    byte(0x84);
+    const auto at = code.size();
+    dword(0);
+    return at;
+  }
+  void patch_rel32(size_t at, size_t target) {
+    const auto rel = static_cast<uint32_t>(static_cast<int32_t>(target - (at + 4)));
+    for (int i = 0; i < 4; i++) {
+      code[at + i] = static_cast<uint8_t>(rel >> (i * 8));
+    }
+  }
+
+  std::vector<uint8_t> code;
+};
+
+// How an instruction is handled by generated code.
+enum class kind_t { fallback, nop, mov, alu, incdec };
+
+// A translated instruction.
+struct op_t {
+  kind_t kind{kind_t::fallback};
+  // host opcode for alu16 (MOV=89, ADD=01, ...), or 81 /ext for immediates.
+  uint8_t host_op{0};
+  flags_op_t flags{flags_op_t::none};
+  // guest registers, in regs16 order.
+  int dst{0};
+  int src{0};
+  bool has_imm{false};
+  uint16_t imm{0};
+  // MOV r8, imm8 into the low byte of dst.
+  bool byte_reg{false};
+  bool cmp{false};
+  bool dec{false};
+};
+
+// ALU operations selected by bits 3-5 of 00-3F and by the reg field of 81/83.
+struct alu_t {
+  bool ok;
+  uint8_t host_op;
+  flags_op_t flags;
+};
+constexpr alu_t alu_ops[8] = {
+    {true, 0x01, flags_op_t::add},  {true, 0x09, flags_op_t::logic},
+    {false, 0, flags_op_t::none},   {false, 0, flags_op_t::none}, // ADC, SBB
+    {true, 0x21, flags_op_t::logic}, {true, 0x29, flags_op_t::sub},
+    {true, 0x31, flags_op_t::logic}, {true, 0x39, flags_op_t::sub}};
+
+op_t alu_op(int n, int dst, int src) {
+  op_t o;
+  const auto& a = alu_ops[n];
+  if (!a.ok || !mapped(dst) || !mapped(src)) {
+    return o;
+  }
+  o.kind = kind_t::alu;
+  o.host_op = a.host_op;
+  o.flags = a.flags;
+  o.dst = dst;
+  o.src = src;
+  o.cmp = n == 7;
+  return o;
+}
+
+op_t alu_imm_op(int n, int dst, uint16_t imm) {
+  auto o = alu_op(n, dst, dst);
+  o.src = 0;
+  o.has_imm = true;
+  o.imm = imm;
+  return o;
+}
+
+// Works out how (or if) inst can be translated.
+op_t translate(const instruction_t& inst) {
+  op_t o;
+  const auto op = inst.op;
+  const auto reg3 = inst.mdrm.mod == 3;
+  if (op < 0x40 && (op & 0x07) <= 0x05) {
+    const auto n = (op >> 3) & 0x07;
+    switch (op & 0x07) {
+    // op r/m16, r16
+    case 0x1: return reg3 ? alu_op(n, inst.mdrm.rm, inst.mdrm.reg) : o;
+    // op r16, r/m16
+    case 0x3: return reg3 ? alu_op(n, inst.mdrm.reg, inst.mdrm.rm) : o;
+    // op AX, imm16
+    case 0x5: return alu_imm_op(n, 0, inst.imm16);
+    }
+    return o;
+  }
+  if (op >= 0x40 && op <= 0x4F) {
+    const auto r = op & 0x07;
+    if (mapped(r)) {
+      o.kind = kind_t::incdec;
+      o.dec = op & 0x08;
+      o.flags = o.dec ? flags_op_t::dec : flags_op_t::inc;
+      o.dst = r;
+    }
+    return o;
+  }
+  switch (op) {
+  // op r/m16, imm16 and op r/m16, imm8 (sign extended)
+  case 0x81: return reg3 ? alu_imm_op(inst.mdrm.reg, inst.mdrm.rm, inst.imm16) : o;
+  case 0x83:
+    return reg3 ? alu_imm_op(inst.mdrm.reg, inst.mdrm.rm,
+                             static_cast<uint16_t>(static_cast<int8_t>(inst.imm8)))
+                : o;
+  // MOV r/m16, r16 and MOV r16, r/m16
+  case 0x89:
+  case 0x8B: {
+    const int dst = op == 0x89 ? inst.mdrm.rm : inst.mdrm.reg;
+    const int src = op == 0x89 ? inst.mdrm.reg : inst.mdrm.rm;
+    if (reg3 && mapped(dst) && mapped(src)) {
+      o.kind = kind_t::mov;
+      o.host_op = 0x89;
+      o.dst = dst;
+      o.src = src;
+    }
+    return o;
+  }
+  case 0x90: o.kind = kind_t::nop; return o;
+  }
+  // MOV AL/CL/DL/BL, imm8
+  if (op >= 0xB0 && op <= 0xB3) {
+    o.kind = kind_t::mov;
+    o.dst = op & 0x07;
+    o.has_imm = true;
+    o.byte_reg = true;
+    o.imm = inst.imm8;
+    return o;
+  }
+  // MOV r16, imm16
+  if (op >= 0xB8 && op <= 0xBF && mapped(op & 0x07)) {
+    o.kind = kind_t::mov;
+    o.dst = op & 0x07;
+    o.has_imm = true;
+    o.imm = inst.imm16;
+    return o;
+  }
+  return o;
+}
+
+int32_t offset_of(const cpu_core& core, const void* p) {
+  return static_cast<int32_t>(reinterpret_cast<const uint8_t*>(p) -
+                              reinterpret_cast<const uint8_t*>(&core));
+}
+
+} // namespace
+
+Jit::Jit(CPU& cpu) : cpu_(cpu) {}
+
+bool Jit::compile(block_t& block) {
+  const auto n = block.entries.size();
+  std::vector<op_t> ops(n);
+  int native = 0;
+  for (size_t i = 0; i < n; i++) {
+    ops[i] = translate(block.entries[i].inst);
+    if (ops[i].kind != kind_t::fallback) {
+      ++native;
+    }
+  }
+  if (native == 0) {
+    return false;
+  }
+
+  // Work backwards to find which instructions need to compute flags: only
+  // those whose flags may be read by a later handler or after the block.
+  std::vector<bool> need_flags(n);
+  bool live = true;
+  for (auto i = n; i-- > 0;) {
+    switch (ops[i].kind) {
+    case kind_t::fallback: live = true; break;
+    case kind_t::alu:
+      need_flags[i] = live;
+      live = false;
+      break;
+    // INC and DEC pass CF through, so flags live after are still live before.
+    case kind_t::incdec: need_flags[i] = live; break;
+    default: break;
+    }
+  }
+
+  auto& core = cpu_.core;
+  int32_t reg_offset[8];
+  for (int r = 0; r < 8; r++) {
+    reg_offset[r] = offset_of(core, core.regs.x.regptr(r));
+  }
+  const auto ip_offset = offset_of(core, &core.ip);
+
+  Emitter e;
+  for (auto r : saved_regs) {
+    e.push(r);
+  }
+  e.byte(0x48); // sub rsp, frame_size
+  e.byte(0x83);
+  e.byte(0xEC);
+  e.byte(frame_size);
+  e.mov64(core_reg, &core);
+
+  const auto load_all = [&] {
+    for (int r = 0; r < 8; r++) {
+      if (mapped(r)) {
+        e.load16(guest_regs[r], reg_offset[r]);
+      }
+    }
+  };
+  // Guest registers changed since they were last written back to cpu_core.
+  uint8_t dirty = 0;
+  const auto store_dirty = [&] {
+    for (int r = 0; r < 8; r++) {
+      if (dirty & (1 << r)) {
+        e.store16(reg_offset[r], guest_regs[r]);
+      }
+    }
+    dirty = 0;
+  };
+  // Bytes of instructions executed since core.ip was last updated.
+  uint16_t ip_pending = 0;
+  const auto sync_ip = [&] {
+    if (ip_pending) {
+      e.add_mem16(ip_offset, ip_pending);
+      ip_pending = 0;
+    }
+  };
+
+  load_all();
+  // Where a block that wrote to its own code leaves early, and how many entries had run.
+  std::vector<std::pair<size_t, uint32_t>> exits;
+  for (size_t i = 0; i < n; i++) {
+    const auto& entry = block.entries[i];
+    const auto& o = ops[i];
+    ip_pending += entry.inst.len;
+    const auto dst = guest_regs[o.dst];
+    switch (o.kind) {
+    case kind_t::nop: break;
+    case kind_t::mov: {
+      if (o.byte_reg) {
+        e.mov8(dst, static_cast<uint8_t>(o.imm));
+      } else if (o.has_imm) {
+        e.mov16(dst, o.imm);
+      } else {
+        e.alu16(0x89, dst, guest_regs[o.src]);
+      }
+      dirty |= 1 << o.dst;
+    } break;
+    case kind_t::alu:
+    case kind_t::incdec: {
+      if (!need_flags[i]) {
+        if (o.kind == kind_t::incdec) {
+          e.incdec16(o.dec, dst);
+        } else if (o.cmp) {
+          // CMP without anyone looking at the flags does nothing.
+          break;
+        } else if (o.has_imm) {
+          e.alu16_imm((o.host_op >> 3) & 0x07, dst, o.imm);
+        } else {
+          e.alu16(o.host_op, dst, guest_regs[o.src]);
+        }
+        dirty |= 1 << o.dst;
+        break;
+      }
+      // r10 = dst, r11 = src before the operation, rax = result.
+      e.movzx(R10, dst);
+      if (o.kind == kind_t::incdec) {
+        e.mov32(R11, 1);
+        e.incdec16(o.dec, dst);
+        e.movzx(RAX, dst);
+      } else {
+        if (o.has_imm) {
+          e.mov32(R11, o.imm);
+        } else {
+          e.movzx(R11, guest_regs[o.src]);
+        }
+        if (o.cmp) {
+          e.mov64_reg(RAX, R10);
+          e.alu32(0x29, RAX, R11);
+          e.movzx(RAX, RAX);
+        } else {
+          if (o.has_imm) {
+            e.alu16_imm((o.host_op >> 3) & 0x07, dst, o.imm);
+          } else {
+            e.alu16(o.host_op, dst, guest_regs[o.src]);
+          }
+          e.movzx(RAX, dst);
+        }
+      }
+      if (!o.cmp) {
+        dirty |= 1 << o.dst;
+      }
+      // jit_set_flags(&core.flags, op << 16 | dst, src << 16 | res)
+      e.or32_imm(R10, static_cast<uint32_t>(o.flags) << 16);
+      e.shl32(R11, 16);
+      e.alu32(0x09, R11, RAX);
+      e.mov64_reg(arg_regs[1], R10);
+      e.mov64_reg(arg_regs[2], R11);
+      e.mov64(arg_regs[0], &core.flags);
+      e.mov64(RAX, reinterpret_cast<const void*>(&jit_set_flags));
+      e.call_rax();
+    } break;
+    case kind_t::fallback: {
+      store_dirty();
+      sync_ip();
+      e.mov64(arg_regs[0], &cpu_);
+      e.mov64(arg_regs[1], &entry);
+      e.mov64(arg_regs[2], &block);
+      e.mov64(RAX, reinterpret_cast<const void*>(&jit_execute));
+      e.call_rax();
+      if (i + 1 < n) {
+        // The handler may have changed any register.
+        load_all();
+        exits.emplace_back(e.jz_if_al_zero(), static_cast<uint32_t>(i + 1));
+      }
+    } break;
+    }
+  }
+  store_dirty();
+  sync_ip();
+  // Returns how many entries ran.
+  e.mov32(RAX, static_cast<uint32_t>(n));
+  std::vector<size_t> to_epilogue{e.jmp_rel32()};
+  for (const auto& [at, ran] : exits) {
+    e.patch_rel32(at, e.code.size());
+    e.mov32(RAX, ran);
+    to_epilogue.push_back(e.jmp_rel32());
+  }
+
+  // Epilogue, everything is back in cpu_core by the time we get here.
+  const auto epilogue = e.code.size();
+  for (auto at : to_epilogue) {
+    e.patch_rel32(at, epilogue);
+  }
+  e.byte(0x48); // add rsp, frame_size
+  e.byte(0x83);
+  e.byte(0xC4);
+  e.byte(frame_size);
+  for (auto it = std::rbegin(saved_regs); it != std::rend(saved_regs); ++it) {
+    e.pop(*it);
+  }
+  e.byte(0xC3); // ret
+
+  if (!code_) {
+    code_ = std::make_unique<CodeBuffer>(code_buffer_size);
+  }
+  const auto* p = code_->add(e.code);
+  if (!p) {
+    full_ = code_->ok();
+    return false;
+  }
+  block.native = p;
+  ++compiled_;
+  translated_ += native;
+  VLOG(2) << "JIT: compiled block at " << std::hex << block.start << "; " << std::dec << native
+          << " of " << n << " instructions native; " << e.code.size() << " bytes";
+  return true;
+}
+
+void Jit::clear() {
+  if (code_) {
+    code_->clear();
+  }
+  full_ = false;
+}
+
+#else // DOOR86_JIT
+
+Jit::Jit(CPU& cpu) : cpu_(cpu) {}
+
+bool Jit::compile(block_t&) { return false; }
+
+void Jit::clear() { full_ = false; }
+
+#endif // DOOR86_JIT
+
+} // namespace door86::cpu::x86
@@ -0,0 +1,89 @@
+#ifndef INCLUDED_CPU_X86_JIT_H
+#define INCLUDED_CPU_X86_JIT_H
+
+#include "cpu/x86/block_cache.h"
+#include "cpu/x86/code_buffer.h"
+#include <cstdint>
+#include <memory>
+
+// The JIT only knows how to generate x86-64 code.
+#if (defined(__x86_64__) || defined(_M_X64)) && !defined(DOOR86_NO_JIT)
+#define DOOR86_JIT 1
+#endif
+
+namespace door86::cpu::x86 {
+
+class CPU;
+
+// Generated code for a single block. Everything it needs is baked into the
+// code, so it takes no arguments. Returns how many of the block's entries ran,
+// fewer than all of them when one wrote to the block's code.
+using native_block_t = uint32_t (*)();
+
+/**
+ * Translates hot blocks from the BlockCache into native x86-64 code.
+ *
+ * For the duration of a block, AX, CX, DX, BX and SI live in host
+ * registers.  Simple register to register and register/immediate MOV and ALU
+ * instructions are translated directly; everything else calls back into the
+ * instruction's handler (with the guest registers written back to cpu_core
+ * first), so the native code always produces the same results as
+ * CPU::execute_block.  Flags are only computed for instructions whose flags
+ * may be read before they are overwritten.
+ *
+ * Generated code stays in the code buffer until it's full(), when every
+ * block is dropped and the buffer cleared. A block the BlockCache rebuilds
+ * (i.e. because its code was written) is compiled again into new space, and
+ * its old code is left unused until then.
+ */
+class Jit {
+public:
+  // Times a block runs before it is compiled.
+  static constexpr uint32_t hot_threshold = 16;
+  // Bytes of executable memory for generated code.
+  static constexpr size_t code_buffer_size = 4 << 20;
+
+  explicit Jit(CPU& cpu);
+  ~Jit() = default;
+
+  /** Returns true if native code can be generated on this host */
+  static constexpr bool supported() {
+#ifdef DOOR86_JIT
+    return true;
+#else
+    return false;
+#endif
+  }
+
+  /**
+   * Compiles block into native code, setting block.native. Returns false if
+   * the block isn't worth compiling (nothing in it can be translated) or if
+   * the code buffer is full().
+   */
+  bool compile(block_t& block);
+
+  /**
+   * True once the code buffer has run out of space. All blocks must be
+   * dropped from the BlockCache before calling clear().
+   */
+  bool full() const noexcept { return full_; }
+
+  /** Frees all generated code */
+  void clear();
+
+  // Statistics
+  uint64_t compiled() const noexcept { return compiled_; }
+  uint64_t translated() const noexcept { return translated_; }
+
+private:
+  CPU& cpu_;
+  // Allocated on the first compile, so CPUs that never use the JIT don't pay for it.
+  std::unique_ptr<CodeBuffer> code_;
+  bool full_{false};
+  uint64_t compiled_{0};
+  uint64_t translated_{0};
+};
+
+} // namespace door86::cpu::x86
+
+#endif // INCLUDED_CPU_X86_JIT_H
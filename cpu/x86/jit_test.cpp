@@ -0,0 +1,135 @@
+#include <gtest/gtest.h>
+
+#include "cpu/x86/cpu.h"
+#include "cpu/x86/cpu_fixture.h"
+#include "cpu/x86/jit.h"
+#include <string>
+
+using namespace door86::cpu;
+using namespace door86::cpu::x86;
+
+class JitTest : public testing::Test {
+public:
+  JitTest() {
+    if (!Jit::supported()) {
+      return;
+    }
+    for (auto* c : {&jit, &interp}) {
+      // INT 20h halts the CPU.
+      c->memory[0x20 * 4] = 0x20;
+      c->int_handlers().try_emplace(0x20, [](int, CPU& cpu) { cpu.halt(); });
+      c->core.regs.x.ax = c->core.regs.x.bx = c->core.regs.x.cx = c->core.regs.x.dx = 0;
+      c->core.regs.x.si = c->core.regs.x.di = c->core.regs.x.bp = 0;
+    }
+    jit.execution_mode = execution_mode_t::jit;
+    interp.execution_mode = execution_mode_t::interpreted;
+  }
+
+  // Loads s at 0100:0000 into both CPUs and runs it.
+  void run(const std::string& s) {
+    const auto ops = parse_opcodes_from_line(s);
+    for (auto* c : {&jit, &interp}) {
+      ASSERT_TRUE(c->memory.load_image(0x1000, ops.size(), ops.data()));
+      c->resume();
+      ASSERT_TRUE(c->run(0x100, 0));
+    }
+  }
+
+  void ExpectSameState() {
+    const auto& j = jit.core;
+    const auto& i = interp.core;
+    EXPECT_EQ(i.regs.x.ax, j.regs.x.ax);
+    EXPECT_EQ(i.regs.x.bx, j.regs.x.bx);
+    EXPECT_EQ(i.regs.x.cx, j.regs.x.cx);
+    EXPECT_EQ(i.regs.x.dx, j.regs.x.dx);
+    EXPECT_EQ(i.regs.x.si, j.regs.x.si);
+    EXPECT_EQ(i.regs.x.di, j.regs.x.di);
+    EXPECT_EQ(i.ip, j.ip);
+    EXPECT_EQ(i.flags.value(), j.flags.value());
+  }
+
+  CPU jit;
+  CPU interp;
+};
+
+// MOV CX, 1000; XOR AX, AX; L: ADD AX, CX; DEC CX; JNZ L; INT 20
+static const std::string sum_loop = "B9E803 31C0 01C8 49 75FB CD20";
+
+TEST_F(JitTest, SumLoop) {
+  if (!Jit::supported()) {
+    GTEST_SKIP() << "No JIT on this host";
+  }
+  run(sum_loop);
+  EXPECT_EQ(static_cast<uint16_t>(500500), jit.core.regs.x.ax);
+  EXPECT_EQ(1u, jit.jit.compiled());
+  ExpectSameState();
+}
+
+TEST_F(JitTest, CompareAndBranch) {
+  if (!Jit::supported()) {
+    GTEST_SKIP() << "No JIT on this host";
+  }
+  // MOV CX, 0; MOV BX, 100; L: INC CX; CMP CX, BX; JB L; INT 20
+  run("B90000 BB6400 41 39D9 72FB CD20");
+  EXPECT_EQ(100, jit.core.regs.x.cx);
+  EXPECT_GT(jit.jit.compiled(), 0u);
+  ExpectSameState();
+}
+
+TEST_F(JitTest, MixedNativeAndFallback) {
+  if (!Jit::supported()) {
+    GTEST_SKIP() << "No JIT on this host";
+  }
+  // MOV CX, 40; MOV BX, 7; MOV SI, 5
+  // L: ADD AX, BX; XOR AX, SI; SUB SI, 1; MOV DL, 3; SUB SI, DX; OR AX, SI;
+  //    AND BX, 0FFFh; MOV DI, AX; INC DI; DEC SI; ADD BX, 1234h; DEC CX; JNZ L
+  // INT 20
+  run("B92800 BB0700 BE0500 "
+      "01D8 31F0 83EE01 B203 29D6 09F0 81E3FF0F 89C7 47 4E 81C33412 49 75E4 "
+      "CD20");
+  EXPECT_EQ(0, jit.core.regs.x.cx);
+  EXPECT_GT(jit.jit.translated(), 0u);
+  ExpectSameState();
+}
+
+TEST_F(JitTest, Invalidate) {
+  if (!Jit::supported()) {
+    GTEST_SKIP() << "No JIT on this host";
+  }
+  run(sum_loop);
+  auto* b = jit.blocks.get(0x1005);
+  ASSERT_NE(nullptr, b);
+  EXPECT_NE(nullptr, b->native);
+
+  // Change ADD AX, CX to SUB AX, CX; the generated code has to go.
+  jit.memory.set<uint8_t>(0x100, 5, 0x29);
+  interp.memory.set<uint8_t>(0x100, 5, 0x29);
+  b = jit.blocks.get(0x1005);
+  ASSERT_NE(nullptr, b);
+  EXPECT_EQ(nullptr, b->native);
+
+  for (auto* c : {&jit, &interp}) {
+    c->resume();
+    ASSERT_TRUE(c->run(0x100, 0));
+  }
+  EXPECT_EQ(static_cast<uint16_t>(-500500), jit.core.regs.x.ax);
+  ExpectSameState();
+}
+
+TEST_F(JitTest, BlockRewritesItself) {
+  if (!Jit::supported()) {
+    GTEST_SKIP() << "No JIT on this host";
+  }
+  // MOV CX, 0280; XOR BX, BX; L: MOV [100B], CH; ADD BX, 2; DEC CX; JNZ L; INT 20
+  // The MOV writes CH over the ADD's immediate, which only changes it when CH
+  // does, after the loop has been compiled.
+  for (auto* c : {&jit, &interp}) {
+    c->core.sregs.ds = 0;
+  }
+  run("B98002 31DB 882E0B10 83C302 49 75F6 CD20");
+  EXPECT_GT(jit.jit.compiled(), 1u);
+  ExpectSameState();
+  // The compiled loop that left early after the MOV only counted that.
+  EXPECT_EQ(interp.instructions, jit.instructions);
+  EXPECT_EQ(interp.cycles, jit.cycles);
+}
@@ -5,6 +5,7 @@
 #include "cpu/memory.h"
 #include "cpu/x86/decoder.h"
 #include <cstdint>
+#include <type_traits>
 
 // Start with instructons needed for hello world in asm, then expand
 // to these, then on to others as needed.
@@ -191,88 +192,182 @@ constexpr uint16_t OF = 0x0800;
 #define FLAG_COND(cond, flags, flg)                                                                \
   do {                                                                                             \
     if (cond) {                                                                                    \
-      FLAG_SET((flags.value_), (flg));                                                             \
+      (flags).set(flg);                                                                            \
     } else {                                                                                       \
-      FLAG_CLEAR((flags.value_), (flg));                                                           \
+      (flags).clear(flg);                                                                          \
     }                                                                                              \
   } while (0);
 
+// The ALU operation that last set the lazily evaluated flags.
+enum class flags_op_t : uint8_t { none, add, adc, sub, sbb, inc, dec, logic, szp };
+
+/**
+ * The FLAGS register.
+ *
+ * Arithmetic and logic instructions don't compute their flags eagerly, most of
+ * them are overwritten before anything looks at them. Instead the last
+ * operation, its operands and its result are recorded, and individual flags
+ * are only computed when they are read (Jcc, PUSHF, ADC, SBB, interrupts,
+ * the debugger, ...).
+ */
 class flags_t {
 public:
-  inline bool cflag() const { return value_ & CF; }
-  inline bool pflag() const { return value_ & PF; }
-  inline bool aflag() const { return value_ & AF; }
-  inline bool zflag() const { return value_ & ZF; }
-  inline bool sflag() const { return value_ & SF; }
+  inline bool cflag() const { return (lazy_ & CF) ? lazy_cf() : (value_ & CF); }
+  inline bool pflag() const { return (lazy_ & PF) ? parity_table[res_ & 0xff] : (value_ & PF); }
+  inline bool aflag() const { return (lazy_ & AF) ? ((dst_ ^ src_ ^ res_) & 0x10) : (value_ & AF); }
+  inline bool zflag() const { return (lazy_ & ZF) ? res_ == 0 : (value_ & ZF); }
+  inline bool sflag() const { return (lazy_ & SF) ? (res_ & msb()) : (value_ & SF); }
   inline bool tflag() const { return value_ & TF; }
   inline bool iflag() const { return value_ & IF; }
   inline bool dflag() const { return value_ & DF; }
-  inline bool oflag() const { return value_ & OF; }
+  inline bool oflag() const { return (lazy_ & OF) ? lazy_of() : (value_ & OF); }
 
   // set
 
-  inline void cflag(bool b) {
-    if (b)
-      value_ |= CF;
-    else
-      value_ &= ~CF;
+  inline void cflag(bool b) { put(CF, b); }
+  inline void pflag(bool b) { put(PF, b); }
+  inline void aflag(bool b) { put(AF, b); }
+  inline void zflag(bool b) { put(ZF, b); }
+  inline void sflag(bool b) { put(SF, b); }
+  inline void tflag(bool b) { put(TF, b); }
+  inline void iflag(bool b) { put(IF, b); }
+  inline void dflag(bool b) { put(DF, b); }
+  inline void oflag(bool b) { put(OF, b); }
+
+  // bit 1 and 12-15 are always on
+  inline void reset() {
+    value_ = 0xf002;
+    lazy_ = 0;
   }
-  inline void pflag(bool b) {
-    if (b)
-      value_ |= PF;
-    else
-      value_ &= ~PF;
+  inline void set(uint16_t flg) {
+    value_ |= flg;
+    lazy_ &= ~flg;
   }
-  inline void aflag(bool b) {
-    if (b)
-      value_ |= AF;
-    else
-      value_ &= ~AF;
+  inline void clear(uint16_t flg) {
+    value_ &= ~flg;
+    lazy_ &= ~flg;
   }
-  inline void zflag(bool b) {
-    if (b)
-      value_ |= ZF;
-    else
-      value_ &= ~ZF;
+  inline bool test(uint16_t flg) const { return value() & flg; }
+
+  /** Returns the full value of the flags register, computing any lazy flags */
+  inline uint16_t value() const {
+    if (!lazy_) {
+      return value_;
+    }
+    return (value_ & ~lazy_) | compute(lazy_);
   }
-  inline void sflag(bool b) {
-    if (b)
-      value_ |= SF;
-    else
-      value_ &= ~SF;
+
+  /** Sets the full value of the flags register (POPF, IRET) */
+  inline void value(uint16_t v) {
+    value_ = v;
+    lazy_ = 0;
   }
-  inline void tflag(bool b) {
-    if (b)
-      value_ |= TF;
-    else
-      value_ &= ~TF;
+
+  /**
+   * Records the result of an ALU operation of width T. The flags affected by
+   * op are computed from dst, src and res when they are read.  carry is the
+   * carry (or borrow) in for ADC and SBB.
+   */
+  template <typename T> inline void lazy(flags_op_t op, T dst, T src, T res, bool carry = false) {
+    static_assert(std::is_same_v<T, uint8_t> || std::is_same_v<T, uint16_t>,
+                  "needs uint8_t or uint16_t");
+    const auto affected = lazy_masks[static_cast<int>(op)];
+    if (const auto keep = lazy_ & ~affected; keep) {
+      // Save any flags from the previous operation that op doesn't change.
+      value_ = (value_ & ~keep) | compute(keep);
+    }
+    if (op == flags_op_t::logic) {
+      // AND, OR, XOR and TEST always clear CF and OF.
+      value_ &= ~(CF | OF | AF);
+    }
+    lazy_ = affected;
+    op_ = op;
+    wide_ = std::is_same_v<T, uint16_t>;
+    carry_ = carry;
+    dst_ = dst;
+    src_ = src;
+    res_ = res;
   }
-  inline void iflag(bool b) {
-    if (b)
-      value_ |= IF;
-    else
-      value_ &= ~IF;
+
+private:
+  // Flags computed lazily for each flags_op_t.
+  static constexpr uint16_t lazy_masks[] = {
+      0,                             // none
+      CF | PF | AF | ZF | SF | OF,   // add
+      CF | PF | AF | ZF | SF | OF,   // adc
+      CF | PF | AF | ZF | SF | OF,   // sub
+      CF | PF | AF | ZF | SF | OF,   // sbb
+      PF | AF | ZF | SF | OF,        // inc (CF is untouched)
+      PF | AF | ZF | SF | OF,        // dec (CF is untouched)
+      PF | ZF | SF,                  // logic
+      PF | ZF | SF};                 // szp
+
+  inline void put(uint16_t flg, bool b) {
+    if (b) {
+      value_ |= flg;
+    } else {
+      value_ &= ~flg;
+    }
+    lazy_ &= ~flg;
   }
-  inline void dflag(bool b) {
-    if (b)
-      value_ |= DF;
-    else
-      value_ &= ~DF;
+
+  inline uint16_t msb() const { return wide_ ? 0x8000 : 0x80; }
+
+  inline bool lazy_cf() const {
+    switch (op_) {
+    case flags_op_t::add: return res_ < dst_;
+    case flags_op_t::adc: return res_ < dst_ || (carry_ && res_ == dst_);
+    case flags_op_t::sub: return dst_ < src_;
+    case flags_op_t::sbb: return dst_ < static_cast<uint32_t>(src_) + carry_;
+    default: return false;
+    }
   }
-  inline void oflag(bool b) {
-    if (b)
-      value_ |= OF;
-    else
-      value_ &= ~OF;
+
+  inline bool lazy_of() const {
+    switch (op_) {
+    case flags_op_t::add:
+    case flags_op_t::adc: return (dst_ ^ res_) & (src_ ^ res_) & msb();
+    case flags_op_t::sub:
+    case flags_op_t::sbb: return (dst_ ^ src_) & (dst_ ^ res_) & msb();
+    case flags_op_t::inc: return res_ == msb();
+    case flags_op_t::dec: return res_ == msb() - 1;
+    default: return false;
+    }
   }
 
-  // bit 1 and 12-15 are always on
-  inline void reset() { value_ = 0xf002; }
-  inline void set(uint16_t flg) { value_ |= flg; }
-  inline void clear(uint16_t flg) { value_ &= !flg; }
-  inline bool test(uint16_t flg) const { return value_ & flg; }
+  // Computes the lazy flags in bits.
+  inline uint16_t compute(uint16_t bits) const {
+    uint16_t f = 0;
+    if ((bits & CF) && lazy_cf()) {
+      f |= CF;
+    }
+    if ((bits & PF) && parity_table[res_ & 0xff]) {
+      f |= PF;
+    }
+    if ((bits & AF) && ((dst_ ^ src_ ^ res_) & 0x10)) {
+      f |= AF;
+    }
+    if ((bits & ZF) && res_ == 0) {
+      f |= ZF;
+    }
+    if ((bits & SF) && (res_ & msb())) {
+      f |= SF;
+    }
+    if ((bits & OF) && lazy_of()) {
+      f |= OF;
+    }
+    return f;
+  }
 
   uint16_t value_{0xf002};
+  // Bits of value_ that are stale and need to be computed from the last operation.
+  uint16_t lazy_{0};
+  flags_op_t op_{flags_op_t::none};
+  bool wide_{false};
+  bool carry_{false};
+  uint16_t dst_{0};
+  uint16_t src_{0};
+  uint16_t res_{0};
 };
 
 } // namespace door86::cpu::x86
@@ -27,14 +27,6 @@ enum class RmmType { EITHER, MEMORY, REGISTER };
 template <RmmType R, typename T> class Rmm {
 public:
 
-  // A type that is one larger than T, used to detect overflow
-  using bigT = std::conditional_t<std::is_same_v<T, uint8_t>, uint16_t,
-               std::conditional_t<std::is_same_v<T, uint16_t>, uint32_t, void>>;
-  // FIXME
-  // TODO(rushfan): Our CF and OF handling is completely broken.
-  static constexpr bigT cf_mask = std::numeric_limits<bigT>::max() - std::numeric_limits<T>::max();
-  static constexpr bigT of_mask =
-      std::numeric_limits<bigT>::max() - std::numeric_limits<std::make_signed_t<T>>::max();
   static constexpr auto digits = std::numeric_limits<T>::digits;
   static constexpr auto msb_mask = (1 << (digits - 1));
   static constexpr auto remainder_mask = ~msb_mask;
@@ -80,31 +72,14 @@ public:
     core_->flags.clear(f);
   }
 
-  inline void set_flags_psz(const T& cur) {
-    core_->flags.pflag((kern_popcount(cur) % 2) == 0);
-    core_->flags.zflag(cur == 0);
-    if constexpr (std::is_same_v<T, uint8_t>) {
-      core_->flags.sflag(cur & 0x80);
-    } else if constexpr (std::is_same_v<T, uint16_t>) {
-      core_->flags.sflag(cur & 0x8000);
-    } else {
-      static_assert(false, "needs uint8_t or uint16_t");
-    }
-  }
-
-  inline T set_flags_from_bigt(bigT& cur) {
-    core_->flags.oflag(cur & of_mask);
-    core_->flags.cflag(cur & cf_mask);
-
-    const auto adj_cur = static_cast<T>(cur);
-    set_flags_psz(adj_cur);
-    return adj_cur;
-  }
+  // PF, SF and ZF are computed from cur when read.
+  inline void set_flags_psz(const T& cur) { core_->flags.lazy<T>(flags_op_t::szp, 0, 0, cur); }
 
   inline Rmm& operator+=(const T& other) {
-    bigT cur = get();
-    cur += other;
-    set(set_flags_from_bigt(cur));
+    const T dst = get();
+    const T res = dst + other;
+    core_->flags.lazy<T>(flags_op_t::add, dst, other, res);
+    set(res);
     return *this;
   }
 
@@ -113,9 +88,10 @@ public:
   inline Rmm& operator+=(const Rmm<RmmType::EITHER, T>& other) { return operator+=(other.get()); }
 
   inline Rmm& operator-=(const T& other) {
-    bigT cur = get();
-    cur -= other;
-    set(set_flags_from_bigt(cur));
+    const T dst = get();
+    const T res = dst - other;
+    core_->flags.lazy<T>(flags_op_t::sub, dst, other, res);
+    set(res);
     return *this;
   }
 
@@ -131,22 +107,62 @@ public:
     // firstoperand and then setting the status flags in the same manner as
     // the SUB instruction.  When an immediate value is used as an operand, 
     // it is sign-extended to the length of the first operand.
-    T saved = get();
-    bigT cur = saved;
-    cur -= other;
-    set_flags_from_bigt(cur);
+    const T dst = get();
+    core_->flags.lazy<T>(flags_op_t::sub, dst, other, static_cast<T>(dst - other));
   }
 
   inline void cmp(const Rmm<RmmType::MEMORY, T>& other) { return cmp(other.get()); }
   inline void cmp(const Rmm<RmmType::REGISTER, T>& other) { return cmp(other.get()); }
   inline void cmp(const Rmm<RmmType::EITHER, T>& other) { return cmp(other.get()); }
 
+  // add with carry
+  inline Rmm& adc(const T& other) {
+    const bool carry = core_->flags.cflag();
+    const T dst = get();
+    const T res = dst + other + carry;
+    core_->flags.lazy<T>(flags_op_t::adc, dst, other, res, carry);
+    set(res);
+    return *this;
+  }
+
+  // subtract with borrow
+  inline Rmm& sbb(const T& other) {
+    const bool carry = core_->flags.cflag();
+    const T dst = get();
+    const T res = dst - other - carry;
+    core_->flags.lazy<T>(flags_op_t::sbb, dst, other, res, carry);
+    set(res);
+    return *this;
+  }
+
+  // INC and DEC leave CF alone.
+  inline Rmm& inc() {
+    const T dst = get();
+    const T res = dst + 1;
+    core_->flags.lazy<T>(flags_op_t::inc, dst, 1, res);
+    set(res);
+    return *this;
+  }
+
+  inline Rmm& dec() {
+    const T dst = get();
+    const T res = dst - 1;
+    core_->flags.lazy<T>(flags_op_t::dec, dst, 1, res);
+    set(res);
+    return *this;
+  }
+
+  // AND without storing the result.
+  inline void test(const T& other) {
+    const T dst = get();
+    core_->flags.lazy<T>(flags_op_t::logic, dst, other, static_cast<T>(dst & other));
+  }
+
 
   inline Rmm& operator|=(const T& other) {
     T cur = get();
     cur |= other;
-    clear_flags_coa();
-    set_flags_psz(cur);
+    core_->flags.lazy<T>(flags_op_t::logic, 0, 0, cur);
     set(cur);
     return *this;
   }
@@ -157,8 +173,7 @@ public:
   inline Rmm& operator^=(const T& other) {
     T cur = get();
     cur ^= other;
-    clear_flags_coa();
-    set_flags_psz(cur);
+    core_->flags.lazy<T>(flags_op_t::logic, 0, 0, cur);
     set(cur);
     return *this;
   }
@@ -171,8 +186,7 @@ public:
   inline Rmm& operator&=(const T& other) {
     T cur = get();
     cur &= other;
-    clear_flags_coa();
-    set_flags_psz(cur);
+    core_->flags.lazy<T>(flags_op_t::logic, 0, 0, cur);
     set(cur);
     return *this;
   }
@@ -180,16 +194,12 @@ public:
   inline Rmm& operator&=(const Rmm<RmmType::REGISTER, T>& other) { return operator&=(other.get()); }
   inline Rmm& operator&=(const Rmm<RmmType::EITHER, T>& other) { return operator&=(other.get()); }
 
+  // NEG sets the flags as if 0 - value.
   inline Rmm& neg() {
-    bigT cur;
-    if constexpr (std::is_same_v<T, uint8_t>) {
-      cur = 0x100 - get();
-    } else if constexpr (std::is_same_v<T, uint16_t>) {
-      cur = 0x10000 - get();
-    } else {
-      static_assert(false, "needs uint8_t or uint16_t");
-    }
-    set(set_flags_from_bigt(cur));
+    const T src = get();
+    const T res = static_cast<T>(0) - src;
+    core_->flags.lazy<T>(flags_op_t::sub, 0, src, res);
+    set(res);
     return *this;
   }
 
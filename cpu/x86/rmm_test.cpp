@@ -164,4 +164,103 @@ TEST_F(RmmTest, XCHG) {
   swap(r, rm);
   EXPECT_EQ(core.regs.h.ch, 0x22);
   EXPECT_EQ(memory.get<uint8_t>(10, 10), 0x11);
-}
\ No newline at end of file
+}
+TEST_F(RmmTest, Add_OF) {
+  core.regs.x.cx = 0x7fff;
+  auto r = cx();
+  r += 1;
+  EXPECT_EQ(0x8000, r.get());
+  EXPECT_TRUE(core.flags.oflag());
+  EXPECT_TRUE(core.flags.sflag());
+  EXPECT_FALSE(core.flags.cflag());
+}
+
+TEST_F(RmmTest, Sub_CF) {
+  core.regs.h.ch = 0x01;
+  auto r = ch();
+  r -= 2;
+  EXPECT_EQ(0xff, r.get());
+  EXPECT_TRUE(core.flags.cflag());
+  EXPECT_FALSE(core.flags.oflag());
+  EXPECT_TRUE(core.flags.sflag());
+}
+
+TEST_F(RmmTest, Adc) {
+  core.flags.cflag(true);
+  core.regs.x.cx = 0xfffe;
+  auto r = cx();
+  r.adc(1);
+  EXPECT_EQ(0x0000, r.get());
+  EXPECT_TRUE(core.flags.cflag());
+  EXPECT_TRUE(core.flags.zflag());
+}
+
+TEST_F(RmmTest, Sbb) {
+  core.flags.cflag(true);
+  core.regs.x.cx = 0x0001;
+  auto r = cx();
+  r.sbb(1);
+  EXPECT_EQ(0xffff, r.get());
+  EXPECT_TRUE(core.flags.cflag());
+}
+
+TEST_F(RmmTest, Inc_KeepsCF) {
+  core.regs.x.cx = 0xffff;
+  auto r = cx();
+  r += 1;
+  EXPECT_TRUE(core.flags.cflag());
+  r.inc();
+  EXPECT_EQ(0x0001, r.get());
+  EXPECT_TRUE(core.flags.cflag());
+  EXPECT_FALSE(core.flags.zflag());
+}
+
+TEST_F(RmmTest, Dec_OF) {
+  core.regs.h.ch = 0x80;
+  auto r = ch();
+  r.dec();
+  EXPECT_EQ(0x7f, r.get());
+  EXPECT_TRUE(core.flags.oflag());
+}
+
+TEST_F(RmmTest, Neg) {
+  core.regs.x.cx = 0x0001;
+  auto r = cx();
+  r.neg();
+  EXPECT_EQ(0xffff, r.get());
+  EXPECT_TRUE(core.flags.cflag());
+  r.set(0);
+  r.neg();
+  EXPECT_FALSE(core.flags.cflag());
+  EXPECT_TRUE(core.flags.zflag());
+}
+
+TEST_F(RmmTest, Test_KeepsValue) {
+  core.regs.h.ch = 0xf0;
+  auto r = ch();
+  r.test(0x0f);
+  EXPECT_EQ(0xf0, r.get());
+  EXPECT_TRUE(core.flags.zflag());
+  EXPECT_FALSE(core.flags.cflag());
+}
+
+TEST_F(RmmTest, PF) {
+  core.regs.h.ch = 0x00;
+  auto r = ch();
+  r |= 0x03;
+  EXPECT_TRUE(core.flags.pflag());
+  r |= 0x07;
+  EXPECT_FALSE(core.flags.pflag());
+}
+
+TEST_F(RmmTest, FlagsValue) {
+  core.flags.value(0xf002);
+  core.regs.x.cx = 0xffff;
+  auto r = cx();
+  r += 1;
+  // CF, PF, AF and ZF
+  EXPECT_EQ(0xf002 | CF | PF | AF | ZF, core.flags.value());
+  core.flags.value(0xf002);
+  EXPECT_FALSE(core.flags.cflag());
+  EXPECT_FALSE(core.flags.zflag());
+}
@@ -0,0 +1,295 @@
+#include "cpu/x86/string_ops.h"
+
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+
+namespace door86::cpu::x86 {
+
+static inline uint32_t linear(uint16_t seg, uint16_t off) { return (seg * 0x10) + off; }
+
+// Moves off forward (or backward when df is set) by n elements of width bytes.
+static inline void advance(uint16_t& off, int n, int width, bool df) {
+  off += static_cast<uint16_t>(df ? -(n * width) : n * width);
+}
+
+// Byte offset, from the lowest address of a run of n elements, of the k-th
+// element in execution order.
+static inline int element_offset(int k, int n, int width, bool df) {
+  return (df ? (n - 1 - k) : k) * width;
+}
+
+template <typename T> static inline T load(const uint8_t* p) {
+  if constexpr (std::is_same_v<T, uint8_t>) {
+    return *p;
+  } else {
+    return static_cast<uint16_t>(p[0] | (p[1] << 8));
+  }
+}
+
+template <typename T> static inline void store(uint8_t* p, T value) {
+  if constexpr (std::is_same_v<T, uint8_t>) {
+    *p = value;
+  } else {
+    p[0] = static_cast<uint8_t>(value & 0xff);
+    p[1] = static_cast<uint8_t>(value >> 8);
+  }
+}
+
+// Sets the flags as CMP left, right.
+template <typename T> static inline void cmp_flags(cpu_core& core, T left, T right) {
+  core.flags.lazy<T>(flags_op_t::sub, left, right, static_cast<T>(left - right));
+}
+
+int string_run_length(const Memory& memory, uint16_t seg, uint16_t off, int width, bool df) {
+  if (off + width > 0x10000) {
+    // A word at FFFF wraps within the element.
+    return 0;
+  }
+  const auto start = linear(seg, off);
+  // Only plain RAM can be handled in bulk, anything else goes an element at a time.
+  if (df) {
+    const auto to_wrap = static_cast<uint32_t>(off / width + 1);
+    return static_cast<int>(memory.direct_size_before(start + width, to_wrap * width) / width);
+  }
+  const auto to_wrap = static_cast<uint32_t>((0x10000 - off) / width);
+  return static_cast<int>(memory.direct_size(start, to_wrap * width) / width);
+}
+
+// Copies bytes from src to dst (both the lowest address of the run) with the
+// same result as copying one element at a time in the direction given by df.
+template <typename T>
+static void copy_elements(Memory& memory, uint32_t dst, uint32_t src, int bytes, bool df) {
+  constexpr int width = sizeof(T);
+  const int64_t dist = df ? static_cast<int64_t>(src) - dst : static_cast<int64_t>(dst) - src;
+  if (dist <= 0 || dist >= bytes) {
+    // Nothing is read after it's been written, so this is just a memmove.
+    memory.move(dst, src, bytes);
+    return;
+  }
+  // The destination is ahead of the source, so later elements read what the
+  // earlier ones wrote (this is how "REP MOVSB" with DI = SI + 1 fills memory).
+  const auto chunk = static_cast<int>(dist - (dist % width));
+  if (chunk == 0) {
+    // Words shifted by a single byte, each element depends on the last one.
+    auto* d = memory.write_ptr(dst, bytes);
+    const auto* s = memory.read_ptr(src);
+    const int n = bytes / width;
+    for (int k = 0; k < n; k++) {
+      const auto off = element_offset(k, n, width, df);
+      store<T>(d + off, load<T>(s + off));
+    }
+    return;
+  }
+  // Copy in pieces no longer than the distance, so each piece is a plain copy.
+  if (df) {
+    for (int end = bytes; end > 0;) {
+      const auto len = std::min(chunk, end);
+      end -= len;
+      memory.move(dst + end, src + end, len);
+    }
+  } else {
+    for (int off = 0; off < bytes; off += chunk) {
+      memory.move(dst + off, src + off, std::min(chunk, bytes - off));
+    }
+  }
+}
+
+template <typename T> void rep_movs(cpu_core& core, Memory& memory, uint16_t src_seg) {
+  constexpr int width = sizeof(T);
+  const auto df = core.flags.dflag();
+  const auto es = core.sregs.es;
+  auto& r = core.regs.x;
+  while (r.cx) {
+    const auto n = std::min({static_cast<int>(r.cx), string_run_length(memory, src_seg, r.si, width, df),
+                             string_run_length(memory, es, r.di, width, df)});
+    if (n == 0) {
+      // This element straddles the end of a segment.
+      memory.set<T>(es, r.di, memory.get<T>(src_seg, r.si));
+      advance(r.si, 1, width, df);
+      advance(r.di, 1, width, df);
+      --r.cx;
+      continue;
+    }
+    const auto back = df ? (n - 1) * width : 0;
+    copy_elements<T>(memory, linear(es, static_cast<uint16_t>(r.di - back)),
+                     linear(src_seg, static_cast<uint16_t>(r.si - back)), n * width, df);
+    advance(r.si, n, width, df);
+    advance(r.di, n, width, df);
+    r.cx -= static_cast<uint16_t>(n);
+  }
+}
+
+template <typename T> void rep_stos(cpu_core& core, Memory& memory) {
+  constexpr int width = sizeof(T);
+  const auto df = core.flags.dflag();
+  const auto es = core.sregs.es;
+  auto& r = core.regs.x;
+  const auto lo = core.regs.h.al;
+  const auto hi = core.regs.h.ah;
+  while (r.cx) {
+    const auto n = std::min(static_cast<int>(r.cx), string_run_length(memory, es, r.di, width, df));
+    if (n == 0) {
+      if constexpr (std::is_same_v<T, uint8_t>) {
+        memory.set<T>(es, r.di, lo);
+      } else {
+        memory.set<T>(es, r.di, r.ax);
+      }
+      advance(r.di, 1, width, df);
+      --r.cx;
+      continue;
+    }
+    const auto bytes = n * width;
+    const auto start = linear(es, static_cast<uint16_t>(r.di - (df ? bytes - width : 0)));
+    if (width == 1 || lo == hi) {
+      memory.fill(start, bytes, lo);
+    } else {
+      auto* p = memory.write_ptr(start, bytes);
+      for (int i = 0; i < bytes; i += 2) {
+        p[i] = lo;
+        p[i + 1] = hi;
+      }
+    }
+    advance(r.di, n, width, df);
+    r.cx -= static_cast<uint16_t>(n);
+  }
+}
+
+template <typename T> void rep_lods(cpu_core& core, Memory& memory, uint16_t src_seg) {
+  constexpr int width = sizeof(T);
+  auto& r = core.regs.x;
+  if (!r.cx) {
+    return;
+  }
+  // Only the last element loaded is left in the accumulator.
+  const auto df = core.flags.dflag();
+  advance(r.si, r.cx - 1, width, df);
+  if constexpr (std::is_same_v<T, uint8_t>) {
+    core.regs.h.al = memory.get<T>(src_seg, r.si);
+  } else {
+    r.ax = memory.get<T>(src_seg, r.si);
+  }
+  advance(r.si, 1, width, df);
+  r.cx = 0;
+}
+
+// Returns the index (in execution order) of the element of the n element run
+// at p that ends a REPE (repne false) or REPNE scan for value, or n if none do.
+template <typename T> static int find_scas_end(const uint8_t* p, int n, bool df, T value, bool repne) {
+  constexpr int width = sizeof(T);
+  if constexpr (std::is_same_v<T, uint8_t>) {
+    if (repne && !df) {
+      const auto* f = static_cast<const uint8_t*>(memchr(p, value, n));
+      return f ? static_cast<int>(f - p) : n;
+    }
+  }
+  for (int k = 0; k < n; k++) {
+    if ((load<T>(p + element_offset(k, n, width, df)) == value) == repne) {
+      return k;
+    }
+  }
+  return n;
+}
+
+template <typename T> void rep_scas(cpu_core& core, Memory& memory, bool repne) {
+  constexpr int width = sizeof(T);
+  const auto df = core.flags.dflag();
+  const auto es = core.sregs.es;
+  auto& r = core.regs.x;
+  T value;
+  if constexpr (std::is_same_v<T, uint8_t>) {
+    value = core.regs.h.al;
+  } else {
+    value = r.ax;
+  }
+  while (r.cx) {
+    const auto n = std::min(static_cast<int>(r.cx), string_run_length(memory, es, r.di, width, df));
+    if (n == 0) {
+      const auto e = memory.get<T>(es, r.di);
+      cmp_flags<T>(core, value, e);
+      advance(r.di, 1, width, df);
+      --r.cx;
+      if ((e == value) == repne) {
+        return;
+      }
+      continue;
+    }
+    const auto back = df ? (n - 1) * width : 0;
+    const auto* p = memory.read_ptr(linear(es, static_cast<uint16_t>(r.di - back)));
+    const auto end = find_scas_end<T>(p, n, df, value, repne);
+    const auto count = std::min(end + 1, n);
+    cmp_flags<T>(core, value, load<T>(p + element_offset(count - 1, n, width, df)));
+    advance(r.di, count, width, df);
+    r.cx -= static_cast<uint16_t>(count);
+    if (end < n) {
+      return;
+    }
+  }
+}
+
+// Returns the index (in execution order) of the element pair that ends a
+// REPE (repne false) or REPNE compare of the n element runs at s and d, or n if none do.
+template <typename T>
+static int find_cmps_end(const uint8_t* s, const uint8_t* d, int n, bool df, bool repne) {
+  constexpr int width = sizeof(T);
+  if (!repne && memcmp(s, d, n * width) == 0) {
+    return n;
+  }
+  for (int k = 0; k < n; k++) {
+    const auto off = element_offset(k, n, width, df);
+    if ((load<T>(s + off) == load<T>(d + off)) == repne) {
+      return k;
+    }
+  }
+  return n;
+}
+
+template <typename T>
+void rep_cmps(cpu_core& core, Memory& memory, uint16_t src_seg, bool repne) {
+  constexpr int width = sizeof(T);
+  const auto df = core.flags.dflag();
+  const auto es = core.sregs.es;
+  auto& r = core.regs.x;
+  while (r.cx) {
+    const auto n = std::min({static_cast<int>(r.cx), string_run_length(memory, src_seg, r.si, width, df),
+                             string_run_length(memory, es, r.di, width, df)});
+    if (n == 0) {
+      const auto left = memory.get<T>(src_seg, r.si);
+      const auto right = memory.get<T>(es, r.di);
+      cmp_flags<T>(core, left, right);
+      advance(r.si, 1, width, df);
+      advance(r.di, 1, width, df);
+      --r.cx;
+      if ((left == right) == repne) {
+        return;
+      }
+      continue;
+    }
+    const auto back = df ? (n - 1) * width : 0;
+    const auto* s = memory.read_ptr(linear(src_seg, static_cast<uint16_t>(r.si - back)));
+    const auto* d = memory.read_ptr(linear(es, static_cast<uint16_t>(r.di - back)));
+    const auto end = find_cmps_end<T>(s, d, n, df, repne);
+    const auto count = std::min(end + 1, n);
+    const auto off = element_offset(count - 1, n, width, df);
+    cmp_flags<T>(core, load<T>(s + off), load<T>(d + off));
+    advance(r.si, count, width, df);
+    advance(r.di, count, width, df);
+    r.cx -= static_cast<uint16_t>(count);
+    if (end < n) {
+      return;
+    }
+  }
+}
+
+template void rep_movs<uint8_t>(cpu_core&, Memory&, uint16_t);
+template void rep_movs<uint16_t>(cpu_core&, Memory&, uint16_t);
+template void rep_stos<uint8_t>(cpu_core&, Memory&);
+template void rep_stos<uint16_t>(cpu_core&, Memory&);
+template void rep_lods<uint8_t>(cpu_core&, Memory&, uint16_t);
+template void rep_lods<uint16_t>(cpu_core&, Memory&, uint16_t);
+template void rep_scas<uint8_t>(cpu_core&, Memory&, bool);
+template void rep_scas<uint16_t>(cpu_core&, Memory&, bool);
+template void rep_cmps<uint8_t>(cpu_core&, Memory&, uint16_t, bool);
+template void rep_cmps<uint16_t>(cpu_core&, Memory&, uint16_t, bool);
+
+} // namespace door86::cpu::x86
@@ -0,0 +1,48 @@
+#ifndef INCLUDED_CPU_X86_STRING_OPS_H
+#define INCLUDED_CPU_X86_STRING_OPS_H
+
+#include "cpu/memory.h"
+#include "cpu/x86/cpu_core.h"
+#include <cstdint>
+
+namespace door86::cpu::x86 {
+
+/**
+ * Bulk execution of REP and REPNE prefixed string instructions.
+ *
+ * Rather than executing the instruction once per element, each of these
+ * works out how many elements can be handled in one run (limited by CX, the
+ * direction flag and SI/DI wrapping around their 64K segment) and then
+ * processes the run with memmove/memset/memchr style host primitives.
+ *
+ * The results (memory, CX, SI, DI, AL/AX and flags) are the same as running
+ * the instruction one element at a time, including overlapping copies such
+ * as "REP MOVSB" with DI = SI + 1 used to fill memory.
+ *
+ * T is the element type, uint8_t or uint16_t. src_seg is the value of the
+ * (possibly overridden) segment register used with SI.
+ */
+
+// REP MOVS
+template <typename T> void rep_movs(cpu_core& core, Memory& memory, uint16_t src_seg);
+// REP STOS
+template <typename T> void rep_stos(cpu_core& core, Memory& memory);
+// REP LODS
+template <typename T> void rep_lods(cpu_core& core, Memory& memory, uint16_t src_seg);
+// REPE or REPNE SCAS
+template <typename T> void rep_scas(cpu_core& core, Memory& memory, bool repne);
+// REPE or REPNE CMPS
+template <typename T>
+void rep_cmps(cpu_core& core, Memory& memory, uint16_t src_seg, bool repne);
+
+/**
+ * Returns the number of elements of width bytes, starting at seg:off and
+ * moving down when df is set, that fit before off wraps around the segment
+ * or the end of plain RAM (see Memory::direct_size) is reached.  Returns 0 when the first element itself
+ * straddles the end of the segment.
+ */
+int string_run_length(const Memory& memory, uint16_t seg, uint16_t off, int width, bool df);
+
+} // namespace door86::cpu::x86
+
+#endif // INCLUDED_CPU_X86_STRING_OPS_H
@@ -0,0 +1,178 @@
+#include <gtest/gtest.h>
+
+#include "cpu/memory.h"
+#include "cpu/x86/cpu_core.h"
+#include "cpu/x86/string_ops.h"
+#include <string>
+
+using namespace door86::cpu;
+using namespace door86::cpu::x86;
+
+class StringOpsTest : public testing::Test {
+public:
+  StringOpsTest() {
+    for (int i = 0; i < 8; i++) {
+      core.regs.x.set(i, 0);
+    }
+    core.sregs.ds = 0x1000;
+    core.sregs.es = 0x2000;
+  }
+
+  std::string str(uint16_t seg, uint16_t off, int len) {
+    std::string s;
+    for (int i = 0; i < len; i++) {
+      s.push_back(static_cast<char>(memory.get<uint8_t>(seg, off + i)));
+    }
+    return s;
+  }
+
+  cpu_core core;
+  Memory memory{1 << 20};
+};
+
+TEST_F(StringOpsTest, Movsb) {
+  memory.load_string(0x10000, "Hello World");
+  core.regs.x.cx = 11;
+  rep_movs<uint8_t>(core, memory, core.sregs.ds);
+  EXPECT_EQ("Hello World", str(0x2000, 0, 11));
+  EXPECT_EQ(0, core.regs.x.cx);
+  EXPECT_EQ(11, core.regs.x.si);
+  EXPECT_EQ(11, core.regs.x.di);
+}
+
+TEST_F(StringOpsTest, Movsw_Backwards) {
+  memory.load_string(0x10000, "ABCDEF");
+  core.flags.dflag(true);
+  core.regs.x.cx = 3;
+  core.regs.x.si = 4;
+  core.regs.x.di = 4;
+  rep_movs<uint16_t>(core, memory, core.sregs.ds);
+  EXPECT_EQ("ABCDEF", str(0x2000, 0, 6));
+  EXPECT_EQ(0xfffe, core.regs.x.si);
+  EXPECT_EQ(0xfffe, core.regs.x.di);
+}
+
+TEST_F(StringOpsTest, Movsb_OverlapFill) {
+  // MOVSB with DI one past SI repeats the first byte.
+  core.sregs.es = core.sregs.ds;
+  memory.load_string(0x10000, "X.......");
+  core.regs.x.si = 0;
+  core.regs.x.di = 1;
+  core.regs.x.cx = 7;
+  rep_movs<uint8_t>(core, memory, core.sregs.ds);
+  EXPECT_EQ("XXXXXXXX", str(0x1000, 0, 8));
+}
+
+TEST_F(StringOpsTest, Movsw_OverlapOddDistance) {
+  core.sregs.es = core.sregs.ds;
+  memory.load_string(0x10000, "ABCDEF");
+  core.regs.x.si = 0;
+  core.regs.x.di = 1;
+  core.regs.x.cx = 2;
+  rep_movs<uint16_t>(core, memory, core.sregs.ds);
+  // [1] = AB -> "AABDEF", then [3] = BD (from offset 2) -> "AABBDF"
+  EXPECT_EQ("AABBDF", str(0x1000, 0, 6));
+}
+
+TEST_F(StringOpsTest, Movsb_SegmentWrap) {
+  memory.load_string(0x10000 + 0xfffe, "ab");
+  memory.load_string(0x10000, "cd");
+  core.regs.x.si = 0xfffe;
+  core.regs.x.cx = 4;
+  rep_movs<uint8_t>(core, memory, core.sregs.ds);
+  EXPECT_EQ("abcd", str(0x2000, 0, 4));
+  EXPECT_EQ(2, core.regs.x.si);
+}
+
+TEST_F(StringOpsTest, Stosw) {
+  core.regs.x.ax = 0x0720;
+  core.regs.x.cx = 4;
+  rep_stos<uint16_t>(core, memory);
+  for (int i = 0; i < 4; i++) {
+    EXPECT_EQ(0x0720, memory.get<uint16_t>(0x2000, i * 2));
+  }
+  EXPECT_EQ(0, memory.get<uint16_t>(0x2000, 8));
+  EXPECT_EQ(8, core.regs.x.di);
+}
+
+TEST_F(StringOpsTest, Stosb_CxZero) {
+  core.regs.h.al = 0xff;
+  core.regs.x.cx = 0;
+  rep_stos<uint8_t>(core, memory);
+  EXPECT_EQ(0, memory.get<uint8_t>(0x2000, 0));
+  EXPECT_EQ(0, core.regs.x.di);
+}
+
+TEST_F(StringOpsTest, Lodsb) {
+  memory.load_string(0x10000, "xyz");
+  core.regs.x.cx = 3;
+  rep_lods<uint8_t>(core, memory, core.sregs.ds);
+  EXPECT_EQ('z', core.regs.h.al);
+  EXPECT_EQ(3, core.regs.x.si);
+  EXPECT_EQ(0, core.regs.x.cx);
+}
+
+TEST_F(StringOpsTest, Repne_Scasb) {
+  memory.load_string(0x20000, "Hello");
+  core.regs.h.al = 'l';
+  core.regs.x.cx = 0xffff;
+  rep_scas<uint8_t>(core, memory, true);
+  EXPECT_EQ(3, core.regs.x.di);
+  EXPECT_EQ(0xffff - 3, core.regs.x.cx);
+  EXPECT_TRUE(core.flags.zflag());
+}
+
+TEST_F(StringOpsTest, Repne_Scasb_NotFound) {
+  memory.load_string(0x20000, "Hello");
+  core.regs.h.al = 'z';
+  core.regs.x.cx = 5;
+  rep_scas<uint8_t>(core, memory, true);
+  EXPECT_EQ(5, core.regs.x.di);
+  EXPECT_EQ(0, core.regs.x.cx);
+  EXPECT_FALSE(core.flags.zflag());
+}
+
+TEST_F(StringOpsTest, Repe_Scasw_Backwards) {
+  memory.set<uint16_t>(0x2000, 0, 0x1234);
+  memory.set<uint16_t>(0x2000, 2, 0x5555);
+  memory.set<uint16_t>(0x2000, 4, 0x5555);
+  core.flags.dflag(true);
+  core.regs.x.ax = 0x5555;
+  core.regs.x.di = 4;
+  core.regs.x.cx = 10;
+  rep_scas<uint16_t>(core, memory, false);
+  EXPECT_EQ(0xfffe, core.regs.x.di);
+  EXPECT_EQ(7, core.regs.x.cx);
+  EXPECT_FALSE(core.flags.zflag());
+}
+
+TEST_F(StringOpsTest, Repe_Cmpsb) {
+  memory.load_string(0x10000, "abcdef");
+  memory.load_string(0x20000, "abcxef");
+  core.regs.x.cx = 6;
+  rep_cmps<uint8_t>(core, memory, core.sregs.ds, false);
+  EXPECT_EQ(4, core.regs.x.si);
+  EXPECT_EQ(4, core.regs.x.di);
+  EXPECT_EQ(2, core.regs.x.cx);
+  EXPECT_FALSE(core.flags.zflag());
+  // 'd' < 'x'
+  EXPECT_TRUE(core.flags.cflag());
+}
+
+TEST_F(StringOpsTest, Repe_Cmpsb_Equal) {
+  memory.load_string(0x10000, "abcdef");
+  memory.load_string(0x20000, "abcdef");
+  core.regs.x.cx = 6;
+  rep_cmps<uint8_t>(core, memory, core.sregs.ds, false);
+  EXPECT_EQ(0, core.regs.x.cx);
+  EXPECT_TRUE(core.flags.zflag());
+}
+
+TEST_F(StringOpsTest, RunLength) {
+  EXPECT_EQ(0x10000, string_run_length(memory, 0x1000, 0, 1, false));
+  EXPECT_EQ(1, string_run_length(memory, 0x1000, 0, 1, true));
+  EXPECT_EQ(0, string_run_length(memory, 0x1000, 0xffff, 2, false));
+  EXPECT_EQ(0x8000, string_run_length(memory, 0x1000, 0xfffe, 2, true));
+  // Stop at the end of memory.
+  EXPECT_EQ(0x10, string_run_length(memory, 0xf000, 0xfff0, 1, false));
+}
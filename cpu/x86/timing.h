@@ -0,0 +1,200 @@
+#ifndef INCLUDED_CPU_X86_TIMING_H
+#define INCLUDED_CPU_X86_TIMING_H
+
+#include "cpu/x86/decoder.h"
+#include <array>
+#include <cstdint>
+
+// 8088 instruction timings, in clock cycles.
+//
+// These are the figures from the Intel iAPX 86/88 User's Manual, with 4
+// cycles added for each word transferred over the 8088's 8-bit bus. Things
+// the manual gives as a range (MUL, DIV, shifts by CL) use the middle of the
+// range, so the counts are close to, but not exactly, what a real 8088 does.
+
+namespace door86::cpu::x86 {
+
+struct op_timing_t {
+  // cycles with a register (or no) operand.
+  uint8_t reg{2};
+  // cycles with a memory operand, not counting the effective address.
+  uint8_t mem{2};
+  // extra cycles when a conditional branch is taken.
+  uint8_t taken{0};
+};
+
+namespace timing {
+
+constexpr op_timing_t op(uint8_t reg, uint8_t mem) { return {reg, mem, 0}; }
+constexpr op_timing_t op(uint8_t reg) { return {reg, reg, 0}; }
+constexpr op_timing_t branch(uint8_t not_taken, uint8_t taken) {
+  return {not_taken, not_taken, static_cast<uint8_t>(taken - not_taken)};
+}
+
+// clang-format off
+// Indexed by opcode. Group opcodes hold the timing of their /0 form, see group_timings.
+constexpr std::array<op_timing_t, 256> op_timings = {
+  // 00-07: ADD, PUSH ES, POP ES
+  op(3, 16), op(3, 24), op(3, 9), op(3, 13), op(4), op(4), op(14), op(12),
+  // 08-0F: OR, PUSH CS, POP CS
+  op(3, 16), op(3, 24), op(3, 9), op(3, 13), op(4), op(4), op(14), op(12),
+  // 10-17: ADC, PUSH SS, POP SS
+  op(3, 16), op(3, 24), op(3, 9), op(3, 13), op(4), op(4), op(14), op(12),
+  // 18-1F: SBB, PUSH DS, POP DS
+  op(3, 16), op(3, 24), op(3, 9), op(3, 13), op(4), op(4), op(14), op(12),
+  // 20-27: AND, ES:, DAA
+  op(3, 16), op(3, 24), op(3, 9), op(3, 13), op(4), op(4), op(2), op(4),
+  // 28-2F: SUB, CS:, DAS
+  op(3, 16), op(3, 24), op(3, 9), op(3, 13), op(4), op(4), op(2), op(4),
+  // 30-37: XOR, SS:, AAA
+  op(3, 16), op(3, 24), op(3, 9), op(3, 13), op(4), op(4), op(2), op(8),
+  // 38-3F: CMP, DS:, AAS
+  op(3, 9), op(3, 13), op(3, 9), op(3, 13), op(4), op(4), op(2), op(8),
+  // 40-4F: INC r16, DEC r16
+  op(3), op(3), op(3), op(3), op(3), op(3), op(3), op(3),
+  op(3), op(3), op(3), op(3), op(3), op(3), op(3), op(3),
+  // 50-5F: PUSH r16, POP r16
+  op(15), op(15), op(15), op(15), op(15), op(15), op(15), op(15),
+  op(12), op(12), op(12), op(12), op(12), op(12), op(12), op(12),
+  // 60-6F: aliases of 70-7F on the 8088
+  branch(4, 16), branch(4, 16), branch(4, 16), branch(4, 16),
+  branch(4, 16), branch(4, 16), branch(4, 16), branch(4, 16),
+  branch(4, 16), branch(4, 16), branch(4, 16), branch(4, 16),
+  branch(4, 16), branch(4, 16), branch(4, 16), branch(4, 16),
+  // 70-7F: Jcc rel8
+  branch(4, 16), branch(4, 16), branch(4, 16), branch(4, 16),
+  branch(4, 16), branch(4, 16), branch(4, 16), branch(4, 16),
+  branch(4, 16), branch(4, 16), branch(4, 16), branch(4, 16),
+  branch(4, 16), branch(4, 16), branch(4, 16), branch(4, 16),
+  // 80-87: ALU r/m, imm, TEST r/m, r, XCHG r/m, r
+  op(4, 17), op(4, 25), op(4, 17), op(4, 25), op(3, 9), op(3, 13), op(4, 17), op(4, 25),
+  // 88-8F: MOV, MOV r/m16, sreg, LEA, MOV sreg, r/m16, POP r/m16
+  op(2, 9), op(2, 13), op(2, 8), op(2, 12), op(2, 13), op(2, 2), op(2, 12), op(12, 25),
+  // 90-97: NOP, XCHG AX, r16
+  op(3), op(3), op(3), op(3), op(3), op(3), op(3), op(3),
+  // 98-9F: CBW, CWD, CALL far, WAIT, PUSHF, POPF, SAHF, LAHF
+  op(2), op(5), op(36), op(4), op(14), op(12), op(4), op(4),
+  // A0-A7: MOV AL/AX, moffs and back, MOVS, CMPS
+  op(10), op(14), op(10), op(14), op(18), op(26), op(22), op(30),
+  // A8-AF: TEST AL/AX, imm, STOS, LODS, SCAS
+  op(4), op(4), op(11), op(15), op(12), op(16), op(15), op(19),
+  // B0-BF: MOV r, imm
+  op(4), op(4), op(4), op(4), op(4), op(4), op(4), op(4),
+  op(4), op(4), op(4), op(4), op(4), op(4), op(4), op(4),
+  // C0-C7: shift r/m, imm, RET imm, RET, LES, LDS, MOV r/m, imm
+  op(8, 20), op(8, 28), op(24), op(20), op(24, 24), op(24, 24), op(4, 10), op(4, 14),
+  // C8-CF: ENTER, LEAVE, RETF imm, RETF, INT3, INT, INTO, IRET
+  op(15), op(8), op(33), op(34), op(72), op(71), op(4), op(44),
+  // D0-D7: shift r/m, 1, shift r/m, CL, AAM, AAD, SALC, XLAT
+  op(2, 15), op(2, 23), op(8, 20), op(8, 28), op(83), op(60), op(4), op(11),
+  // D8-DF: ESC
+  op(2, 8), op(2, 8), op(2, 8), op(2, 8), op(2, 8), op(2, 8), op(2, 8), op(2, 8),
+  // E0-E7: LOOPNE, LOOPE, LOOP, JCXZ, IN AL/AX, imm, OUT imm, AL/AX
+  branch(5, 19), branch(6, 18), branch(5, 17), branch(6, 18), op(10), op(14), op(10), op(14),
+  // E8-EF: CALL, JMP near, JMP far, JMP short, IN AL/AX, DX, OUT DX, AL/AX
+  op(23), op(15), op(15), op(15), op(8), op(12), op(8), op(12),
+  // F0-F7: LOCK, -, REPNE, REP, HLT, CMC, group 3
+  op(2), op(2), op(2), op(2), op(2), op(2), op(5, 11), op(5, 15),
+  // F8-FF: CLC, STC, CLI, STI, CLD, STD, group 4, group 5
+  op(2), op(2), op(2), op(2), op(2), op(2), op(3, 15), op(3, 23),
+};
+
+// Indexed by group_index(opcode), then the ModRM reg field.
+constexpr std::array<std::array<op_timing_t, 8>, group_opcodes.size()> group_timings = {{
+  // 80: ADD, OR, ADC, SBB, AND, SUB, XOR, CMP r/m8, imm8
+  {op(4, 17), op(4, 17), op(4, 17), op(4, 17), op(4, 17), op(4, 17), op(4, 17), op(4, 10)},
+  // 81: r/m16, imm16
+  {op(4, 25), op(4, 25), op(4, 25), op(4, 25), op(4, 25), op(4, 25), op(4, 25), op(4, 14)},
+  // 82: alias of 80
+  {op(4, 17), op(4, 17), op(4, 17), op(4, 17), op(4, 17), op(4, 17), op(4, 17), op(4, 10)},
+  // 83: r/m16, sign extended imm8
+  {op(4, 25), op(4, 25), op(4, 25), op(4, 25), op(4, 25), op(4, 25), op(4, 25), op(4, 14)},
+  // C0, C1: ROL, ROR, RCL, RCR, SHL, SHR, SAL, SAR r/m, imm8
+  {op(8, 20), op(8, 20), op(8, 20), op(8, 20), op(8, 20), op(8, 20), op(8, 20), op(8, 20)},
+  {op(8, 28), op(8, 28), op(8, 28), op(8, 28), op(8, 28), op(8, 28), op(8, 28), op(8, 28)},
+  // D0, D1: r/m, 1
+  {op(2, 15), op(2, 15), op(2, 15), op(2, 15), op(2, 15), op(2, 15), op(2, 15), op(2, 15)},
+  {op(2, 23), op(2, 23), op(2, 23), op(2, 23), op(2, 23), op(2, 23), op(2, 23), op(2, 23)},
+  // D2, D3: r/m, CL
+  {op(8, 20), op(8, 20), op(8, 20), op(8, 20), op(8, 20), op(8, 20), op(8, 20), op(8, 20)},
+  {op(8, 28), op(8, 28), op(8, 28), op(8, 28), op(8, 28), op(8, 28), op(8, 28), op(8, 28)},
+  // F6: TEST, TEST, NOT, NEG, MUL, IMUL, DIV, IDIV r/m8
+  {op(5, 11), op(5, 11), op(3, 16), op(3, 16), op(77, 83), op(98, 104), op(90, 96), op(112, 118)},
+  // F7: r/m16
+  {op(5, 15), op(5, 15), op(3, 24), op(3, 24), op(133, 143), op(154, 164), op(162, 172),
+   op(184, 194)},
+  // FE: INC, DEC r/m8
+  {op(3, 15), op(3, 15), op(3, 15), op(3, 15), op(3, 15), op(3, 15), op(3, 15), op(3, 15)},
+  // FF: INC, DEC, CALL, CALL far, JMP, JMP far, PUSH r/m16
+  {op(3, 23), op(3, 23), op(20, 29), op(53, 53), op(11, 22), op(32, 32), op(15, 24), op(15, 24)},
+}};
+
+// Cycles for each repetition of a REP prefixed string instruction, indexed by
+// opcode - first_rep_opcode, on top of 9 cycles to set up the repetitions.
+constexpr std::array<uint8_t, last_rep_opcode - first_rep_opcode + 1> rep_timings = {
+  // MOVS, CMPS, TEST, STOS, LODS, SCAS
+  17, 25, 22, 30, 0, 0, 10, 14, 13, 17, 15, 19,
+};
+// clang-format on
+
+// Timing of each entry in the CPU's dispatch table.
+constexpr std::array<op_timing_t, dispatch_size> make_dispatch_timings() {
+  std::array<op_timing_t, dispatch_size> t{};
+  for (int i = 0; i < 256; i++) {
+    t[i] = op_timings[i];
+  }
+  for (size_t g = 0; g < group_opcodes.size(); g++) {
+    for (int reg = 0; reg < 8; reg++) {
+      t[dispatch_group_base + g * 8 + reg] = group_timings[g][reg];
+    }
+  }
+  for (int i = 0; i < static_cast<int>(rep_timings.size()); i++) {
+    t[dispatch_rep_base + i] = op(9);
+  }
+  // Whatever an unimplemented opcode cost, it didn't do it.
+  t[dispatch_notimpl] = op(0);
+  return t;
+}
+
+constexpr std::array<op_timing_t, dispatch_size> dispatch_timings = make_dispatch_timings();
+
+// Cycles to compute the effective address of a memory operand.
+constexpr uint8_t ea_cycles(const reg_mod_rm& m) {
+  if (m.mod == 0) {
+    // [BX+SI], [BX+DI], [BP+SI], [BP+DI], [SI], [DI], [disp16], [BX]
+    constexpr uint8_t c[] = {7, 8, 8, 7, 5, 5, 6, 5};
+    return c[m.rm];
+  }
+  // Same with an 8 or 16-bit displacement.
+  constexpr uint8_t c[] = {11, 12, 12, 11, 9, 9, 9, 9};
+  return c[m.rm];
+}
+
+} // namespace timing
+
+/** Cycles an 8088 takes to execute inst, not counting a taken branch or REP repetitions */
+inline uint32_t instruction_cycles(const instruction_t& inst) {
+  const auto& t = timing::dispatch_timings[inst.dispatch];
+  // The segment override prefix.
+  const uint32_t prefix = inst.has_seg_override ? 2 : 0;
+  if (inst.has_modrm() && inst.mdrm.mod != 3) {
+    return prefix + t.mem + timing::ea_cycles(inst.mdrm);
+  }
+  return prefix + t.reg;
+}
+
+/** Extra cycles when inst is a conditional branch that's taken */
+constexpr uint32_t taken_cycles(const instruction_t& inst) {
+  return timing::dispatch_timings[inst.dispatch].taken;
+}
+
+/** Cycles for each repetition of the REP prefixed string instruction op */
+constexpr uint32_t rep_cycles(uint8_t op) {
+  return op >= first_rep_opcode && op <= last_rep_opcode
+             ? timing::rep_timings[op - first_rep_opcode]
+             : 0;
+}
+
+} // namespace door86::cpu::x86
+
+#endif // INCLUDED_CPU_X86_TIMING_H
@@ -0,0 +1,55 @@
+#include <gtest/gtest.h>
+
+#include "cpu/x86/cpu_fixture.h"
+#include "cpu/x86/decoder.h"
+#include "cpu/x86/timing.h"
+#include <string>
+
+using namespace door86::cpu;
+using namespace door86::cpu::x86;
+
+class TimingTest : public testing::Test {
+public:
+  uint32_t cycles(const std::string& s) {
+    return instruction_cycles(decoder.decode(parse_opcodes_from_line(s)));
+  }
+
+  Decoder decoder;
+};
+
+TEST_F(TimingTest, Register) {
+  // MOV AX, BX
+  EXPECT_EQ(2u, cycles("89D8"));
+  // ADD AX, BX
+  EXPECT_EQ(3u, cycles("01D8"));
+  // MUL BX
+  EXPECT_EQ(133u, cycles("F7E3"));
+}
+
+TEST_F(TimingTest, Memory) {
+  // ADD [BX], AX: 24 + 5 for [BX]
+  EXPECT_EQ(29u, cycles("0107"));
+  // ES: ADD [BX], AX
+  EXPECT_EQ(31u, cycles("260107"));
+  // MOV AX, [BP+2]: 12 + 9 for [BP+disp8]
+  EXPECT_EQ(21u, cycles("8B4602"));
+  // CMP BYTE [1234], 5: 10 + 6 for [disp16]
+  EXPECT_EQ(16u, cycles("803E341205"));
+}
+
+TEST_F(TimingTest, Branches) {
+  const auto jz = decoder.decode(parse_opcodes_from_line("7400"));
+  EXPECT_EQ(4u, instruction_cycles(jz));
+  EXPECT_EQ(12u, taken_cycles(jz));
+  // JMP is always taken.
+  const auto jmp = decoder.decode(parse_opcodes_from_line("EB00"));
+  EXPECT_EQ(15u, instruction_cycles(jmp));
+  EXPECT_EQ(0u, taken_cycles(jmp));
+}
+
+TEST_F(TimingTest, Rep) {
+  // REP STOSB
+  EXPECT_EQ(9u, cycles("F3AA"));
+  EXPECT_EQ(10u, rep_cycles(0xAA));
+  EXPECT_EQ(0u, rep_cycles(0x90));
+}
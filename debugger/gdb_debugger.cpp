@@ -319,7 +319,7 @@ bool GdbDebugger::handle_registers(const std::string& line) {
     regs.emplace_back(to_intel_format_hex16(r.x.si));
     regs.emplace_back(to_intel_format_hex16(r.x.di));
     regs.emplace_back(to_intel_format_seg_off(sr.cs, cpu_->core.ip));
-    regs.emplace_back(to_intel_format_hex16(cpu_->core.flags.value_));
+    regs.emplace_back(to_intel_format_hex16(cpu_->core.flags.value()));
     regs.emplace_back(to_intel_format_seg_off(sr.cs, 0));
     regs.emplace_back(to_intel_format_seg_off(sr.ss, 0));
     regs.emplace_back(to_intel_format_seg_off(sr.ds, 0));
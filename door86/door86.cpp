@@ -1,4 +1,6 @@
 #include "bios/bios.h"
+#include "bios/fossil.h"
+#include "bios/uart.h"
 #include "core/log.h"
 #include "core/command_line.h"
 #include "core/net.h"
@@ -11,15 +13,20 @@
 #include "dos/dos.h"
 #include "dos/exe.h"
 #include "fmt/format.h"
+#include "host/image_cache.h"
+#include "host/scheduler.h"
+#include "host/session.h"
 
 #include <atomic>
 #include <chrono>
 #include <cstdint>
 #include <cstdio>
+#include <fstream>
 #include <iomanip>
 #include <iostream>
 #include <optional>
 #include <sstream>
+#include <string_view>
 #include <thread>
 #include <vector>
 
@@ -43,6 +50,122 @@ static void HandleLameDebuggerConnection(door86::dbg::DebuggerBackend* di, SOCKE
 
 std::atomic<bool> need_to_exit;
 
+// Loads the AOT module for the program in filename from aot_dir, if there is one.
+static void load_aot(CPU& cpu, const door86::dos::Dos& dos, const std::string& filename,
+                     const std::string& aot_dir) {
+  if (aot_dir.empty()) {
+    return;
+  }
+  if (const auto hash = door86::cpu::x86::image_hash(filename)) {
+    const auto path = std::filesystem::path(aot_dir) / aot_module_filename(hash.value());
+    if (std::filesystem::exists(path)) {
+      cpu.aot = AotModule::load(path, hash.value(), dos.image_seg() * 0x10);
+    }
+    if (cpu.aot) {
+      LOG(INFO) << "Loaded " << cpu.aot->size() << " AOT blocks from: " << path.string();
+    } else {
+      LOG(INFO) << "No AOT module for this program, using: " << path.string();
+    }
+  }
+}
+
+// Input recorded by --record_input has a line for each read: the instruction
+// count it was typed at, and the bytes in hex.
+static bool replay_input(door86::bios::Keyboard& keyboard, const std::string& path) {
+  std::ifstream in(path);
+  if (!in) {
+    LOG(ERROR) << "Unable to open input to replay: " << path;
+    return false;
+  }
+  uint64_t at;
+  std::string hex;
+  while (in >> at >> hex) {
+    std::string bytes;
+    for (size_t i = 0; i + 1 < hex.size(); i += 2) {
+      bytes.push_back(static_cast<char>(std::stoi(hex.substr(i, 2), nullptr, 16)));
+    }
+    keyboard.type_at(at, std::move(bytes));
+  }
+  return true;
+}
+
+static void record_input(std::ofstream& out, uint64_t at, std::string_view bytes) {
+  out << at << ' ';
+  for (const auto c : bytes) {
+    out << fmt::format("{:02x}", static_cast<uint8_t>(c));
+  }
+  out << std::endl;
+}
+
+static execution_mode_t to_execution_mode(const std::string& engine) {
+  if (engine == "interpreted") {
+    return execution_mode_t::interpreted;
+  }
+  if (engine == "jit") {
+    return execution_mode_t::jit;
+  }
+  return execution_mode_t::threaded;
+}
+
+// Connects session to the console, with the same options as a single program.
+static bool attach_console(door86::host::Session& session, CommandLine& cmdline,
+                           std::ofstream& recording) {
+  if (const auto path = cmdline.sarg("record_input"); !path.empty()) {
+    recording.open(path);
+    session.bios.keyboard.on_typed = [&recording](uint64_t at, std::string_view bytes) {
+      record_input(recording, at, bytes);
+    };
+  }
+  if (const auto path = cmdline.sarg("replay_input"); !path.empty()) {
+    return replay_input(session.bios.keyboard, path) &&
+           session.attach(door86::host::connection_t::keyboard, -1, 1);
+  }
+  auto device = door86::host::connection_t::keyboard;
+  if (cmdline.barg("fossil")) {
+    device = door86::host::connection_t::fossil;
+  } else if (cmdline.barg("uart")) {
+    device = door86::host::connection_t::uart;
+  }
+  return session.attach(device, 0, 1);
+}
+
+// Runs every program in filenames as a session on a pool of workers. The
+// first session has the console, the others run without a connection.
+static int run_sessions(CommandLine& cmdline, const std::vector<std::string>& filenames) {
+  door86::host::scheduler_options_t options;
+  options.workers = cmdline.iarg("workers");
+  options.pin_workers = cmdline.barg("pin_workers");
+  door86::host::session_options_t session_options;
+  session_options.virtual_time = cmdline.barg("virtual_time");
+  // Outlives the sessions recording to it.
+  std::ofstream recording;
+  door86::host::Scheduler scheduler(options);
+  // Sessions running the same program share the pages of it they don't write to.
+  door86::host::ImageCache images;
+  int id = 0;
+  for (const auto& filename : filenames) {
+    auto image = images.get(filename);
+    auto session =
+        image ? std::make_unique<door86::host::Session>(++id, std::move(image), session_options)
+              : std::make_unique<door86::host::Session>(++id, session_options);
+    if (!session->load(filename)) {
+      return EXIT_FAILURE;
+    }
+    if (id == 1 && !attach_console(*session, cmdline, recording)) {
+      return EXIT_FAILURE;
+    }
+    load_aot(session->cpu, session->dos, filename, cmdline.sarg("aot_dir"));
+    session->cpu.execution_mode = to_execution_mode(cmdline.sarg("engine"));
+    session->cpu.idle.enabled = cmdline.barg("park_idle");
+    scheduler.add(std::move(session));
+  }
+  LOG(INFO) << "Running " << filenames.size() << " sessions on " << scheduler.workers()
+            << " workers.";
+  scheduler.start();
+  scheduler.wait();
+  return EXIT_SUCCESS;
+}
+
 static void StartDebugger(door86::dbg::DebuggerBackend* debugger) {
   auto gdb_debugger_fn = [&](accepted_socket_t r) {
     std::thread client(HandleGdbDebuggerConnection, debugger, r.client_socket);
@@ -70,6 +193,27 @@ int main(int argc, char** argv) {
       BooleanCommandLineArgument{"debugger", 'D', "Enable lame debugger.", true});
   cmdline.add_argument(BooleanCommandLineArgument{
       "wait_debugger", 'W', "Wait for a debugger to be attached before executing.", false});
+  cmdline.add_argument(
+      {"engine", 'E', "Execution engine. (threaded | interpreted | jit)", "threaded"});
+  cmdline.add_argument(
+      {"aot_dir", "Directory of modules built from aot output, loaded by content hash.", ""});
+  cmdline.add_argument(BooleanCommandLineArgument{
+      "park_idle", 'I', "Sleep while the program spins waiting for input (threaded and jit).", true});
+  cmdline.add_argument({"workers",
+                        "Run each program given as a session on this many worker threads, "
+                        "the first one on the console (0 runs a single program on this thread).",
+                        "0"});
+  cmdline.add_argument(BooleanCommandLineArgument{
+      "pin_workers", 'P', "Pin each worker thread to its own core.", false});
+  cmdline.add_argument(BooleanCommandLineArgument{
+      "fossil", 'F', "Connect the FOSSIL driver (INT 14h) to stdin and stdout.", false});
+  cmdline.add_argument(BooleanCommandLineArgument{
+      "uart", 'U', "Connect the UART on COM1 (3F8h, IRQ 4) to stdin and stdout.", false});
+  cmdline.add_argument(BooleanCommandLineArgument{
+      "virtual_time", "Time seen by the program only passes as it executes, so runs are "
+                      "reproducible and waiting is skipped.", false});
+  cmdline.add_argument({"record_input", "Write keyboard input to this file, for replay_input.", ""});
+  cmdline.add_argument({"replay_input", "Type the keyboard input recorded in this file.", ""});
   cmdline.set_no_args_allowed(true);
 
   if (!cmdline.Parse()) {
@@ -85,18 +229,54 @@ int main(int argc, char** argv) {
     std::cout << "Usage: door86 [options] <exename>\r\n" << cmdline.GetHelp() << std::endl;
     return 1;
   }
+  if (cmdline.iarg("workers") > 0 || cmdline.remaining().size() > 1) {
+    return run_sessions(cmdline, cmdline.remaining());
+  }
   const auto& filename = cmdline.remaining().front();
 
   CPU cpu;
+  // Before the BIOS reads the clock.
+  if (cmdline.barg("virtual_time")) {
+    cpu.time.set_virtual();
+  }
   door86::bios::Bios bios(&cpu);
+  door86::bios::Fossil fossil(&cpu);
+  door86::bios::Uart uart(&cpu);
   door86::dos::Dos dos(&cpu);
   door86::dbg::DebuggerBackend debugger(&cpu);
+  std::ofstream recording;
+  if (const auto path = cmdline.sarg("record_input"); !path.empty()) {
+    recording.open(path);
+    bios.keyboard.on_typed = [&recording](uint64_t at, std::string_view bytes) {
+      record_input(recording, at, bytes);
+    };
+  }
+  if (const auto path = cmdline.sarg("replay_input"); !path.empty()) {
+    if (!replay_input(bios.keyboard, path)) {
+      return EXIT_FAILURE;
+    }
+  } else if (cmdline.barg("fossil")) {
+    if (!fossil.attach(0, 1)) {
+      LOG(ERROR) << "Unable to attach the FOSSIL driver to stdin/stdout";
+      return EXIT_FAILURE;
+    }
+  } else if (cmdline.barg("uart")) {
+    if (!uart.attach(0, 1)) {
+      LOG(ERROR) << "Unable to attach the UART to stdin/stdout";
+      return EXIT_FAILURE;
+    }
+  } else if (!bios.keyboard.attach(0)) {
+    LOG(ERROR) << "Unable to attach the keyboard to stdin";
+    return EXIT_FAILURE;
+  }
 
   if (!dos.initialize_process(filename)) {
     LOG(ERROR) << "Failed to initialize DOS process";
     return EXIT_FAILURE;
   }
 
+  load_aot(cpu, dos, filename, cmdline.sarg("aot_dir"));
+
   if (cmdline.barg("debugger")) {
     [[maybe_unused]] static bool initialized = wwiv::core::InitializeSockets();
     std::thread client(StartDebugger, &debugger);
@@ -106,6 +286,8 @@ int main(int argc, char** argv) {
       cpu.wait_for_debugger = true;
     }
   }
+  cpu.execution_mode = to_execution_mode(cmdline.sarg("engine"));
+  cpu.idle.enabled = cmdline.barg("park_idle");
   cpu.core.regs.x.ax = 2; // drive C
   const auto start = std::chrono::system_clock::now();
   bool result = cpu.run();
@@ -116,6 +298,10 @@ int main(int argc, char** argv) {
   auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
   auto us = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
   fmt::print("Time elapsed: {}ms ({}us)", ms.count(), us.count());
+  for (const auto& [port, stats] : cpu.io.unclaimed()) {
+    LOG(INFO) << fmt::format("Unclaimed IO port {:04X}: {} reads, {} writes", port, stats.reads,
+                             stats.writes);
+  }
 
   return result ? EXIT_SUCCESS : EXIT_FAILURE;
 }
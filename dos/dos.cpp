@@ -1,5 +1,6 @@
 #include "dos/dos.h"
 
+#include "bios/time_of_day.h"
 #include "core/file.h"
 #include "core/log.h"
 #include "core/scope_exit.h"
@@ -7,10 +8,15 @@
 #include "dos/mcb.h"
 #include "fmt/format.h"
 #include "fmt/printf.h"
+#include <algorithm>
+#include <cstddef>
 #include <cstdio>
+#include <cstring>
 #include <filesystem>
 #include <optional>
 #include <string>
+#include <utility>
+#include <vector>
 
 // MSVC only has __PRETTY_FUNCTION__ in intellisense,
 // TODO(rushfan): Find a better home for this macro.
@@ -67,6 +73,7 @@ bool Dos::initialize_process(const std::filesystem::path& filename) {
 
     // skip PSP
     const auto seg = psp_seg + 0x10;
+    image_seg_ = static_cast<uint16_t>(seg);
     LOG(INFO) << fmt::format("PSP SEG:  0x{:04X} ", psp_seg);
     cpu_->core.sregs.cs = exe.hdr.cs + seg;
     cpu_->core.sregs.ss = exe.hdr.ss + seg;
@@ -86,6 +93,7 @@ bool Dos::initialize_process(const std::filesystem::path& filename) {
     const auto seg = oseg.value();
 
     auto image_seg = seg + 0x10;
+    image_seg_ = static_cast<uint16_t>(image_seg);
 
     if (!door86::dos::load_image(filename, image_seg, 0, cpu_->memory)) {
       return false;
@@ -103,6 +111,10 @@ bool Dos::initialize_process(const std::filesystem::path& filename) {
   psp_ = std::make_unique<PSP>(m);
   psp_->initialize();
   psp_->psp->environ_seg = eseg.value();
+  psp_->psp->jft_pointer = {static_cast<uint16_t>(offsetof(psp_t, job_file_table)),
+                            cpu_->core.sregs.ds};
+  // Programs start with interrupts enabled, as COMMAND.COM runs them.
+  cpu_->core.flags.iflag(true);
 
   return true;
 }
@@ -188,20 +200,27 @@ void DosMemoryManager::write_mcb(const memory_block& b) {
   strncpy(mcb->program_name, b.prog_name.c_str(), std::min<int>(b.prog_name.size(), 8));
 }
 
-Dos::Dos(door86::cpu::x86::CPU* cpu) : cpu_(cpu), mem_mgr(&cpu->memory) {
+Dos::Dos(door86::cpu::x86::CPU* cpu)
+    : cpu_(cpu), mem_mgr(&cpu->memory), files(std::filesystem::current_path()) {
   cpu_->int_handlers().try_emplace(
       0x20, std::bind(&Dos::int20, this, std::placeholders::_1, std::placeholders::_2));
   cpu_->int_handlers().try_emplace(
       0x21, std::bind(&Dos::int21, this, std::placeholders::_1, std::placeholders::_2));
 
-  // Setup vector pointing to our bogus locations.
+  // Setup vector pointing to our bogus locations, other than the BIOS's ROM ones.
   for (auto i = 0; i < 0xff; i++) {
+    if (cpu_->rom_vector(i)) {
+      continue;
+    }
     // offset i, segment 0;
     cpu_->memory[i * 4] = i;
   }
 }
 
-void Dos::int20(int, door86::cpu::x86::CPU& cpu) { cpu_->halt(); }
+void Dos::int20(int, door86::cpu::x86::CPU& cpu) {
+  close_handles();
+  cpu_->halt();
+}
 
 void Dos::int21(int, door86::cpu::x86::CPU& cpu) {
   VLOG(3) << fmt::format("[{:04x}:{:04x}] DOS Interrupt: 0x{:04x}; {:02X}", cpu_->core.sregs.cs,
@@ -209,30 +228,53 @@ void Dos::int21(int, door86::cpu::x86::CPU& cpu) {
                            static_cast<int>(cpu_->core.regs.h.ah));
   switch (cpu_->core.regs.h.ah) {
   // terminate app
-  case 0x00: cpu_->halt(); break;
+  case 0x00:
+    close_handles();
+    cpu_->halt();
+    break;
   // read char
   case 0x01: get_char(); break;
   // display char
   case 0x02: display_char(); break;
+  // direct console I/O
+  case 0x06: direct_console_io(); break;
+  // read char without echo
+  case 0x07:
+  case 0x08: get_char_no_echo(); break;
   // display string
   case 0x9: display_string(); break;
+  // check standard input status
+  case 0x0B: input_status(); break;
   // INT 21 - AH = 25h DOS - SET INTERRUPT VECTOR
   case 0x25: set_interrupt_vector(); break;
   // INT 21 - DOS 2+ - GET DOS VERSION
   case 0x30: getversion(); break;
+  // Get system date
+  case 0x2A: get_date(); break;
+  // Get system time
+  case 0x2C: get_time(); break;
   // Get Interrupt Vector
   case 0x35: get_interrupt_vector(); break;
+  case 0x3C: create_file(); break;
+  case 0x3D: open_file(); break;
+  case 0x3E: close_file(); break;
+  case 0x3F: read_file(); break;
   case 0x40: dos_write(); break;
+  case 0x42: seek_file(); break;
+  case 0x45: dup_handle(); break;
+  case 0x46: force_dup_handle(); break;
   case 0x48: allocate(); break;
   case 0x49: free(); break;
   case 0x4a: realloc(); break;
   // terminate app.
   case 0x4c:
     VLOG(2) << "Terminate App";
+    close_handles();
     cpu_->halt();
     break;
   case 0x58: memory_strategy(); break;
   case 0x67: set_handle_count(); break;
+  case 0x68: commit_file(); break;
   default: {
     // unhandled
     LOG(WARNING) << "Unhandled DOS Interrupt "
@@ -248,6 +290,47 @@ void Dos::getversion() {
   cpu_->core.regs.x.cx = 0x0000;
 }
 
+void Dos::get_date() {
+  auto& r = cpu_->core.regs;
+  const auto days = cpu_->time.local_us() / door86::cpu::x86::GuestClock::us_per_day;
+  // 1970-01-01 was a Thursday.
+  r.h.al = static_cast<uint8_t>((days + 4) % 7);
+  // Days since 1970 to a civil date, from Howard Hinnant's date algorithms.
+  const auto z = days + 719468;
+  const auto era = z / 146097;
+  const auto doe = z - era * 146097;
+  const auto yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+  const auto doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+  const auto mp = (5 * doy + 2) / 153;
+  const auto day = doy - (153 * mp + 2) / 5 + 1;
+  const auto month = mp < 10 ? mp + 3 : mp - 9;
+  const auto year = yoe + era * 400 + (month <= 2 ? 1 : 0);
+  r.x.cx = static_cast<uint16_t>(year);
+  r.h.dh = static_cast<uint8_t>(month);
+  r.h.dl = static_cast<uint8_t>(day);
+}
+
+void Dos::get_time() {
+  auto& r = cpu_->core.regs;
+  auto& handlers = cpu_->int_handlers();
+  const auto it = handlers.find(0x1A);
+  if (it == std::end(handlers)) {
+    LOG(WARNING) << "No BIOS clock for get system time";
+    r.x.cx = r.x.dx = 0;
+    return;
+  }
+  // Like the CLOCK$ device, the time comes from the BIOS tick count.
+  const auto ax = r.x.ax;
+  r.h.ah = 0x00;
+  it->second(0x1A, *cpu_);
+  r.x.ax = ax;
+  const auto t = door86::bios::time_of_day((static_cast<uint32_t>(r.x.cx) << 16) | r.x.dx);
+  r.h.ch = t.hour;
+  r.h.cl = t.minute;
+  r.h.dh = t.second;
+  r.h.dl = t.hundredths;
+}
+
 void Dos::get_interrupt_vector() {
   const uint8_t v = cpu_->core.regs.h.al;
   uint16_t off = cpu_->memory.get<uint16_t>(0, v * 4);
@@ -267,20 +350,118 @@ void Dos::set_interrupt_vector() {
   VLOG(2) << fmt::format("Set Interrupt Vector for: {:02X} -> {:04X}{:04X}", v, seg, off);
 }
 
-void Dos::display_char() { fputc(cpu_->core.regs.h.dl, stdout); }
+void Dos::display_char() { cpu_->output.write(static_cast<char>(cpu_->core.regs.h.dl)); }
 
 void Dos::display_string() {
-  for (auto offset = cpu_->core.regs.x.dx;; ++offset) {
-    const auto m = cpu_->memory.get<uint8_t>(cpu_->core.sregs.ds, offset);
-    if (m == '$' || m == '\0') {
-      // TODO(rushfan): We shouldn't stop at \0, but we will for now.
-      break;
+  auto& mem = cpu_->memory;
+  const auto seg = cpu_->core.sregs.ds;
+  auto offset = cpu_->core.regs.x.dx;
+  // No further than the end of the segment.
+  for (uint32_t left = 0x10000 - offset; left > 0;) {
+    const auto start = (seg * 0x10) + offset;
+    const auto n = mem.direct_size(start, left);
+    if (n == 0) {
+      // Not plain RAM, a byte at a time.
+      const auto m = mem.get<uint8_t>(seg, offset);
+      if (m == '$' || m == '\0') {
+        return;
+      }
+      cpu_->output.write(static_cast<char>(m));
+      ++offset;
+      --left;
+      continue;
+    }
+    const auto* p = reinterpret_cast<const char*>(mem.read_ptr(start));
+    // TODO(rushfan): We shouldn't stop at \0, but we will for now.
+    const auto len = strnlen(p, n);
+    const auto* end = static_cast<const char*>(memchr(p, '$', len));
+    const auto count = end ? static_cast<size_t>(end - p) : len;
+    cpu_->output.write(p, count);
+    if (count < n) {
+      return;
+    }
+    offset = static_cast<uint16_t>(offset + n);
+    left -= n;
+  }
+}
+
+std::optional<uint8_t> Dos::read_key(bool wait) {
+  if (pending_scan_) {
+    return std::exchange(pending_scan_, std::nullopt);
+  }
+  auto& handlers = cpu_->int_handlers();
+  const auto it = handlers.find(0x16);
+  if (it == std::end(handlers)) {
+    // No BIOS.
+    if (!wait) {
+      return std::nullopt;
     }
-    fputc(m, stdout);
+    return static_cast<uint8_t>(fgetc(stdin));
+  }
+  auto& r = cpu_->core.regs;
+  const auto ax = r.x.ax;
+  if (!wait) {
+    r.h.ah = 0x01;
+    it->second(0x16, *cpu_);
+    const auto ready = !cpu_->core.flags.zflag();
+    r.x.ax = ax;
+    if (!ready) {
+      return std::nullopt;
+    }
+  }
+  r.h.ah = 0x00;
+  it->second(0x16, *cpu_);
+  const auto key = r.x.ax;
+  r.x.ax = ax;
+  if (cpu_->waiting_for_input()) {
+    return std::nullopt;
+  }
+  if ((key & 0xff) == 0) {
+    pending_scan_ = static_cast<uint8_t>(key >> 8);
+  }
+  return static_cast<uint8_t>(key & 0xff);
+}
+
+void Dos::get_char() {
+  // Show everything before waiting for the key.
+  cpu_->output.flush();
+  if (const auto ch = read_key(true)) {
+    cpu_->core.regs.h.al = *ch;
+    cpu_->output.write(static_cast<char>(*ch));
+  }
+}
+
+void Dos::get_char_no_echo() {
+  cpu_->output.flush();
+  if (const auto ch = read_key(true)) {
+    cpu_->core.regs.h.al = *ch;
   }
 }
 
-void Dos::get_char() { cpu_->core.regs.h.al = static_cast<uint8_t>(fgetc(stdin)); }
+void Dos::direct_console_io() {
+  auto& r = cpu_->core.regs;
+  if (r.h.dl != 0xff) {
+    cpu_->output.write(static_cast<char>(r.h.dl));
+    return;
+  }
+  const auto ch = read_key(false);
+  r.h.al = ch.value_or(0);
+  cpu_->core.flags.zflag(!ch);
+}
+
+void Dos::input_status() {
+  auto& r = cpu_->core.regs;
+  auto& handlers = cpu_->int_handlers();
+  bool ready = pending_scan_.has_value();
+  if (const auto it = handlers.find(0x16); !ready && it != std::end(handlers)) {
+    const auto ax = r.x.ax;
+    r.h.ah = 0x01;
+    it->second(0x16, *cpu_);
+    ready = !cpu_->core.flags.zflag();
+    r.x.ax = ax;
+  }
+  r.h.al = ready ? 0xff : 0x00;
+}
 
 /*
   AH = 40h
@@ -297,14 +478,325 @@ void Dos::get_char() { cpu_->core.regs.h.al = static_cast<uint8_t>(fgetc(stdin))
  */
 void Dos::dos_write() {
   VLOG(1) << "dos_write: ";
+  auto* f = file(cpu_->core.regs.x.bx);
+  if (!f) {
+    fail(dos_error_t::invalid_handle);
+    return;
+  }
+  if (!f->can_write()) {
+    fail(dos_error_t::access_denied);
+    return;
+  }
+  auto& mem = cpu_->memory;
+  const auto seg = cpu_->core.sregs.ds;
+  const auto offset = cpu_->core.regs.x.dx;
+  const auto size = std::min<uint32_t>(cpu_->core.regs.x.cx, 0x10000 - offset);
+  const auto start = (seg * 0x10) + offset;
+  if (f->device != DosFile::device_t::none) {
+    // These all go to the console.
+    if (mem.direct_size(start, size) == size) {
+      cpu_->output.write(reinterpret_cast<const char*>(mem.read_ptr(start)), size);
+    } else {
+      for (uint32_t i = 0; i < size; i++) {
+        cpu_->output.write(
+            static_cast<char>(mem.get<uint8_t>(seg, static_cast<uint16_t>(offset + i))));
+      }
+    }
+    cpu_->core.regs.x.ax = static_cast<uint16_t>(size);
+    cpu_->core.flags.cflag(false);
+    return;
+  }
+  if (f->pos + size > DosFile::max_file_size) {
+    // i.e. after seeking before the start.
+    fail(dos_error_t::access_denied);
+    return;
+  }
+  if (size == 0) {
+    if (!f->truncate()) {
+      fail(dos_error_t::access_denied);
+      return;
+    }
+    cpu_->core.regs.x.ax = 0;
+    cpu_->core.flags.cflag(false);
+    return;
+  }
+  int64_t written;
+  if (mem.direct_size(start, size) == size) {
+    // Straight from guest memory.
+    written = f->write(mem.read_ptr(start), size);
+  } else {
+    std::vector<uint8_t> buf(size);
+    for (uint32_t i = 0; i < size; i++) {
+      buf[i] = mem.get<uint8_t>(seg, static_cast<uint16_t>(offset + i));
+    }
+    written = f->write(buf.data(), size);
+  }
+  if (written < 0) {
+    fail(dos_error_t::access_denied);
+    return;
+  }
+  cpu_->core.regs.x.ax = static_cast<uint16_t>(written);
+  cpu_->core.flags.cflag(false);
+}
+
+uint8_t* Dos::jft() { return psp_ ? psp_->psp->job_file_table : default_jft_.data(); }
+
+DosFile* Dos::file(uint16_t handle) {
+  if (handle >= PSP::jft_entries) {
+    return nullptr;
+  }
+  const auto index = jft()[handle];
+  return index == PSP::unused_handle ? nullptr : files.get(index);
+}
+
+void Dos::fail(dos_error_t error) {
+  cpu_->core.regs.x.ax = static_cast<uint16_t>(error);
+  cpu_->core.flags.cflag(true);
+}
+
+void Dos::new_handle(uint8_t index) {
+  auto* t = jft();
+  for (uint16_t h = 0; h < PSP::jft_entries; h++) {
+    if (t[h] == PSP::unused_handle) {
+      t[h] = index;
+      cpu_->core.regs.x.ax = h;
+      cpu_->core.flags.cflag(false);
+      return;
+    }
+  }
+  files.release(index);
+  fail(dos_error_t::too_many_open_files);
+}
+
+void Dos::close_handles() {
+  auto* t = jft();
+  for (size_t h = 0; h < PSP::jft_entries; h++) {
+    if (t[h] != PSP::unused_handle) {
+      files.release(t[h]);
+      t[h] = PSP::unused_handle;
+    }
+  }
+}
+
+std::string Dos::get_asciz(uint16_t seg, uint16_t off) const {
+  std::string s;
+  // The longest DOS path.
+  for (int i = 0; i < 128; i++) {
+    const auto ch = cpu_->memory.get<uint8_t>(seg, static_cast<uint16_t>(off + i));
+    if (ch == 0) {
+      break;
+    }
+    s.push_back(static_cast<char>(ch));
+  }
+  return s;
+}
+
+// AH=3Ch, CX = attributes, DS:DX = ASCIZ filename.
+void Dos::create_file() {
+  const auto name = get_asciz(cpu_->core.sregs.ds, cpu_->core.regs.x.dx);
+  uint8_t index = 0;
+  const auto error = files.create(name, index);
+  VLOG(2) << fmt::format("Create file: '{}' error: {}", name, static_cast<int>(error));
+  if (error != dos_error_t::none) {
+    fail(error);
+    return;
+  }
+  new_handle(index);
+}
+
+// AH=3Dh, AL = access and sharing modes, DS:DX = ASCIZ filename.
+void Dos::open_file() {
+  const auto name = get_asciz(cpu_->core.sregs.ds, cpu_->core.regs.x.dx);
+  // Sharing modes don't matter, nothing else has the file open.
+  const auto mode = static_cast<uint8_t>(cpu_->core.regs.h.al & 0x07);
+  uint8_t index = 0;
+  const auto error = files.open(name, mode, index);
+  VLOG(2) << fmt::format("Open file: '{}' mode: {} error: {}", name, mode, static_cast<int>(error));
+  if (error != dos_error_t::none) {
+    fail(error);
+    return;
+  }
+  new_handle(index);
+}
+
+// AH=3Eh, BX = file handle.
+void Dos::close_file() {
+  const auto h = cpu_->core.regs.x.bx;
+  if (!file(h)) {
+    fail(dos_error_t::invalid_handle);
+    return;
+  }
+  files.release(jft()[h]);
+  jft()[h] = PSP::unused_handle;
+  cpu_->core.flags.cflag(false);
+}
+
+// AH=3Fh, BX = file handle, CX = number of bytes to read, DS:DX = buffer.
+void Dos::read_file() {
+  auto* f = file(cpu_->core.regs.x.bx);
+  if (!f) {
+    fail(dos_error_t::invalid_handle);
+    return;
+  }
+  if (!f->can_read()) {
+    fail(dos_error_t::access_denied);
+    return;
+  }
+  if (f->device == DosFile::device_t::con) {
+    read_console();
+    return;
+  }
+  if (f->device != DosFile::device_t::none) {
+    // AUX and PRN never have anything.
+    cpu_->core.regs.x.ax = 0;
+    cpu_->core.flags.cflag(false);
+    return;
+  }
+  auto& mem = cpu_->memory;
+  const auto seg = cpu_->core.sregs.ds;
+  const auto offset = cpu_->core.regs.x.dx;
+  const auto size = std::min<uint32_t>(cpu_->core.regs.x.cx, 0x10000 - offset);
+  const auto start = (seg * 0x10) + offset;
+  int64_t got;
+  if (mem.direct_size(start, size) == size) {
+    // Straight into guest memory.
+    got = f->read(mem.write_ptr(start, size), size);
+  } else {
+    std::vector<uint8_t> buf(size);
+    got = f->read(buf.data(), size);
+    for (int64_t i = 0; i < got; i++) {
+      mem.set<uint8_t>(seg, static_cast<uint16_t>(offset + i), buf[i]);
+    }
+  }
+  if (got < 0) {
+    fail(dos_error_t::access_denied);
+    return;
+  }
+  cpu_->core.regs.x.ax = static_cast<uint16_t>(got);
+  cpu_->core.flags.cflag(false);
+}
+
+void Dos::read_console() {
+  // Like DOS's buffered input, with room for the CR LF.
+  static constexpr size_t max_line = 126;
+  auto& r = cpu_->core.regs;
+  if (r.x.cx == 0) {
+    r.x.ax = 0;
+    cpu_->core.flags.cflag(false);
+    return;
+  }
+  cpu_->output.flush();
+  while (con_ready_.empty()) {
+    const auto ch = read_key(true);
+    if (!ch) {
+      // Runs again when there's a key, carrying on with the line so far.
+      return;
+    }
+    switch (*ch) {
+    case 0:
+      // Extended keys don't edit the line.
+      read_key(true);
+      break;
+    case '\r':
+      cpu_->output.write("\r\n", 2);
+      con_ready_ = std::exchange(con_line_, {}) + "\r\n";
+      break;
+    case '\b':
+    case 0x7f:
+      if (!con_line_.empty()) {
+        con_line_.pop_back();
+        cpu_->output.write("\b \b", 3);
+      }
+      break;
+    default:
+      if (con_line_.size() < max_line) {
+        con_line_.push_back(static_cast<char>(*ch));
+        cpu_->output.write(static_cast<char>(*ch));
+      }
+      break;
+    }
+  }
+  // A short read leaves the rest of the line for the next.
+  const auto n = std::min<size_t>(r.x.cx, con_ready_.size());
+  for (size_t i = 0; i < n; i++) {
+    cpu_->memory.set<uint8_t>(cpu_->core.sregs.ds, static_cast<uint16_t>(r.x.dx + i),
+                              static_cast<uint8_t>(con_ready_[i]));
+  }
+  con_ready_.erase(0, n);
+  r.x.ax = static_cast<uint16_t>(n);
+  cpu_->core.flags.cflag(false);
+}
+
+// AH=42h, AL = origin, BX = file handle, CX:DX = offset. Returns the new
+// position in DX:AX.
+void Dos::seek_file() {
+  auto& r = cpu_->core.regs;
+  auto* f = file(r.x.bx);
+  if (!f) {
+    fail(dos_error_t::invalid_handle);
+    return;
+  }
+  // Unsigned from the start, signed from anywhere else. Like DOS, the
+  // position is 32 bits and wraps, so seeking before the start works and
+  // it's the next read or write that fails.
+  const auto offset = (static_cast<uint32_t>(r.x.cx) << 16) | r.x.dx;
+  uint32_t pos = 0;
+  switch (r.h.al) {
+  case 0: pos = offset; break;
+  case 1: pos = static_cast<uint32_t>(f->pos + static_cast<int32_t>(offset)); break;
+  case 2: pos = static_cast<uint32_t>(f->size() + static_cast<int32_t>(offset)); break;
+  default: fail(dos_error_t::invalid_function); return;
+  }
+  f->pos = pos;
+  r.x.dx = static_cast<uint16_t>(pos >> 16);
+  r.x.ax = static_cast<uint16_t>(pos & 0xffff);
+  cpu_->core.flags.cflag(false);
+}
+
+// AH=45h, BX = file handle. Returns the new handle in AX.
+void Dos::dup_handle() {
   const auto h = cpu_->core.regs.x.bx;
-  if (h >= 5) {
-    LOG(WARNING) << "Writing to files not yet supported";
+  if (!file(h)) {
+    fail(dos_error_t::invalid_handle);
+    return;
+  }
+  const auto index = jft()[h];
+  files.add_ref(index);
+  new_handle(index);
+}
+
+// AH=46h, BX = file handle, CX = handle to make refer to the same file,
+// closing it first if it's open.
+void Dos::force_dup_handle() {
+  const auto h = cpu_->core.regs.x.bx;
+  const auto to = cpu_->core.regs.x.cx;
+  if (!file(h) || to >= PSP::jft_entries) {
+    fail(dos_error_t::invalid_handle);
+    return;
+  }
+  if (h != to) {
+    const auto index = jft()[h];
+    if (file(to)) {
+      files.release(jft()[to]);
+    }
+    files.add_ref(index);
+    jft()[to] = index;
+  }
+  cpu_->core.flags.cflag(false);
+}
+
+// AH=68h, BX = file handle.
+void Dos::commit_file() {
+  auto* f = file(cpu_->core.regs.x.bx);
+  if (!f) {
+    fail(dos_error_t::invalid_handle);
+    return;
+  }
+  if (f->device == DosFile::device_t::none && !f->flush()) {
+    fail(dos_error_t::access_denied);
     return;
   }
-  FILE* f = (h == 2) ? stderr : stdout;
-  auto* b = &cpu_->memory[(cpu_->core.sregs.ds * 0x10) + cpu_->core.regs.x.dx];
-  fwrite(b, 1, cpu_->core.regs.x.cx, f);
+  cpu_->core.flags.cflag(false);
 }
 
 void Dos::realloc() {
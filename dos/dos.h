@@ -3,8 +3,10 @@
 
 #include "cpu/memory.h"
 #include "cpu/x86/cpu.h"
+#include "dos/file_table.h"
 #include "dos/psp.h"
 
+#include <array>
 #include <cstdint>
 #include <filesystem>
 #include <memory>
@@ -85,12 +87,29 @@ public:
   void int20(int, door86::cpu::x86::CPU&);
   void int21(int, door86::cpu::x86::CPU&);
 
+  // Segment the program image was loaded at (just past the PSP).
+  uint16_t image_seg() const { return image_seg_; }
+
   std::unique_ptr<PSP> psp_;
   door86::cpu::x86::CPU* cpu_;
   DosMemoryManager mem_mgr;
+  // Open files, with DOS paths relative to the current directory.
+  FileTable files;
 
 private:
+  uint16_t image_seg_{0};
+  // Handles used before a process is initialized.
+  std::array<uint8_t, PSP::jft_entries> default_jft_{PSP::standard_jft()};
+  // Scan code of an extended key, returned by the next read after its 0.
+  std::optional<uint8_t> pending_scan_;
+  // CON line input: the line being typed, and what's left of the last one
+  // entered for the next reads.
+  std::string con_line_;
+  std::string con_ready_;
+
   void getversion();
+  void get_date();
+  void get_time();
   void get_interrupt_vector();
   void set_interrupt_vector();
 
@@ -99,7 +118,40 @@ private:
   void display_char();
   void display_string();
   void get_char();
+  void direct_console_io();
+  void get_char_no_echo();
+  void input_status();
   void dos_write();
+
+  // Files
+
+  // The process's job file table.
+  uint8_t* jft();
+  // The open file for a handle, or null if it isn't one.
+  DosFile* file(uint16_t handle);
+  // Sets CF and the error code in AX.
+  void fail(dos_error_t error);
+  // Gives the process a handle for the system file table entry index, in AX.
+  void new_handle(uint8_t index);
+  // Closes every handle the process has open, when it exits.
+  void close_handles();
+  // The ASCIZ string at seg:off.
+  std::string get_asciz(uint16_t seg, uint16_t off) const;
+  void create_file();
+  void open_file();
+  void close_file();
+  void read_file();
+  // Reads from CON a line at a time, like DOS: typed characters are echoed,
+  // backspace rubs out the last one, and Enter ends the line with CR LF.
+  void read_console();
+  void seek_file();
+  void dup_handle();
+  void force_dup_handle();
+  void commit_file();
+  // Reads a character with the BIOS keyboard service (INT 16h), like the CON
+  // device. Returns nothing if there isn't one, and if wait is true the
+  // program is waiting for one (see CPU::wait_for_input).
+  std::optional<uint8_t> read_key(bool wait);
   void set_handle_count();
 
   // Memory
@@ -0,0 +1,35 @@
+#include "dos/dos_fixture.h"
+
+#include "fmt/format.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <string>
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace door86::dos {
+
+static int process_id() {
+#ifdef _WIN32
+  return _getpid();
+#else
+  return getpid();
+#endif
+}
+
+std::filesystem::path create_test_directory() {
+  const auto* info = ::testing::UnitTest::GetInstance()->current_test_info();
+  auto name = fmt::format("door86_{}_{}_{}", info->test_suite_name(), info->name(), process_id());
+  // Parameterized tests have a / in their names.
+  std::replace(name.begin(), name.end(), '/', '_');
+  const auto dir = std::filesystem::temp_directory_path() / name;
+  std::filesystem::remove_all(dir);
+  std::filesystem::create_directories(dir);
+  return dir;
+}
+
+} // namespace door86::dos
@@ -0,0 +1,14 @@
+#ifndef INCLUDED_DOS_DOS_FIXTURE_H
+#define INCLUDED_DOS_DOS_FIXTURE_H
+
+#include <filesystem>
+
+namespace door86::dos {
+
+// Creates an empty temporary directory named after the running test and this
+// process, so test binaries run in parallel (ctest -j) never share one.
+std::filesystem::path create_test_directory();
+
+} // namespace door86::dos
+
+#endif // INCLUDED_DOS_DOS_FIXTURE_H
@@ -1,11 +1,332 @@
 #include <gtest/gtest.h>
 
+#include "cpu/x86/cpu.h"
+#include "dos/dos.h"
+#include "dos/dos_fixture.h"
 #include "dos/psp.h"
 
 #include <cstdlib>
 #include <cstdint>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
 
 using namespace door86::dos;
 
 TEST(DosTest, Smoke) { EXPECT_TRUE(true); }
+
+class DosOutputTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    cpu.output.set_sink([this](const char* data, size_t size) {
+      sent.append(data, size);
+      return size;
+    });
+    cpu.core.sregs.ds = 0x200;
+  }
+  void int21(uint16_t ax) {
+    cpu.core.regs.x.ax = ax;
+    dos.int21(0x21, cpu);
+  }
+
+  door86::cpu::x86::CPU cpu;
+  Dos dos{&cpu};
+  std::string sent;
+};
+
+TEST_F(DosOutputTest, DisplayString) {
+  cpu.memory.load_string(0x2000, "Hello, World$ignored");
+  cpu.core.regs.x.dx = 0;
+  int21(0x0900);
+  // Held until flushed.
+  EXPECT_EQ("", sent);
+  cpu.output.flush();
+  EXPECT_EQ("Hello, World", sent);
+}
+
+TEST_F(DosOutputTest, DisplayStringIntoRom) {
+  // Continues into ROM, which isn't plain RAM.
+  cpu.memory.map_rom(0x3000, 0x1000);
+  cpu.memory.load_string(0x2ffe, "xyz$");
+  cpu.core.regs.x.dx = 0xffe;
+  int21(0x0900);
+  cpu.output.flush();
+  EXPECT_EQ("xyz", sent);
+}
+
+TEST_F(DosOutputTest, DisplayChar) {
+  cpu.core.regs.x.dx = 'A';
+  int21(0x0200);
+  cpu.output.flush();
+  EXPECT_EQ("A", sent);
+}
+
+TEST_F(DosOutputTest, WriteHandle) {
+  cpu.memory.load_string(0x2010, "line\r\n");
+  cpu.core.regs.x.bx = 1;
+  cpu.core.regs.x.cx = 6;
+  cpu.core.regs.x.dx = 0x10;
+  int21(0x4000);
+  cpu.output.flush();
+  EXPECT_EQ("line\r\n", sent);
+  EXPECT_EQ(6, cpu.core.regs.x.ax);
+  EXPECT_FALSE(cpu.core.flags.cflag());
+}
+
+// Keys come from the BIOS keyboard service, which is faked here.
+class DosInputTest : public DosOutputTest {
+protected:
+  void SetUp() override {
+    DosOutputTest::SetUp();
+    cpu.int_handlers().try_emplace(0x16, [this](int, door86::cpu::x86::CPU& c) {
+      auto& r = c.core.regs;
+      if (r.h.ah == 0x01) {
+        c.core.flags.zflag(keys.empty());
+        if (!keys.empty()) {
+          r.x.ax = keys.front();
+        }
+      } else if (r.h.ah == 0x00) {
+        if (keys.empty()) {
+          c.wait_for_input();
+          return;
+        }
+        r.x.ax = keys.front();
+        keys.erase(keys.begin());
+      }
+    });
+  }
+
+  std::vector<uint16_t> keys;
+};
+
+TEST_F(DosInputTest, ReadCharEchoes) {
+  keys = {0x1E61};
+  int21(0x0100);
+  EXPECT_EQ('a', cpu.core.regs.h.al);
+  EXPECT_EQ(0x01, cpu.core.regs.h.ah);
+  cpu.output.flush();
+  EXPECT_EQ("a", sent);
+}
+
+TEST_F(DosInputTest, ReadCharWaits) {
+  int21(0x0800);
+  EXPECT_TRUE(cpu.waiting_for_input());
+  // Runs again as the same service.
+  EXPECT_EQ(0x08, cpu.core.regs.h.ah);
+}
+
+TEST_F(DosInputTest, ExtendedKey) {
+  keys = {0x4800};
+  int21(0x0700);
+  EXPECT_EQ(0, cpu.core.regs.h.al);
+  int21(0x0700);
+  EXPECT_EQ(0x48, cpu.core.regs.h.al);
+  cpu.output.flush();
+  EXPECT_EQ("", sent);
+}
+
+TEST_F(DosInputTest, DirectConsoleInput) {
+  cpu.core.regs.x.dx = 0xff;
+  int21(0x0600);
+  EXPECT_TRUE(cpu.core.flags.zflag());
+  EXPECT_FALSE(cpu.waiting_for_input());
+  keys = {0x3062};
+  int21(0x0B00);
+  EXPECT_EQ(0xff, cpu.core.regs.h.al);
+  int21(0x0600);
+  EXPECT_FALSE(cpu.core.flags.zflag());
+  EXPECT_EQ('b', cpu.core.regs.h.al);
+  int21(0x0B00);
+  EXPECT_EQ(0x00, cpu.core.regs.h.al);
+}
+
+// Reads cx bytes from handle 0 (CON) into DS:0300.
+TEST_F(DosInputTest, ReadConsoleLine) {
+  keys = {0x2368, 0x2D78, 0x0E08, 0x1769, 0x1C0D};
+  cpu.core.regs.x.bx = 0;
+  cpu.core.regs.x.cx = 2;
+  cpu.core.regs.x.dx = 0x300;
+  int21(0x3F00);
+  EXPECT_FALSE(cpu.core.flags.cflag());
+  EXPECT_EQ(2, cpu.core.regs.x.ax);
+  EXPECT_EQ('h', cpu.memory.abs8(0x2300));
+  EXPECT_EQ('i', cpu.memory.abs8(0x2301));
+  // The rest of the line.
+  cpu.core.regs.x.cx = 10;
+  int21(0x3F00);
+  EXPECT_EQ(2, cpu.core.regs.x.ax);
+  EXPECT_EQ('\r', cpu.memory.abs8(0x2300));
+  EXPECT_EQ('\n', cpu.memory.abs8(0x2301));
+  cpu.output.flush();
+  EXPECT_EQ("hx\b \bi\r\n", sent);
+}
+
+TEST_F(DosInputTest, ReadConsoleWaits) {
+  keys = {0x1E61};
+  cpu.core.regs.x.bx = 0;
+  cpu.core.regs.x.cx = 10;
+  cpu.core.regs.x.dx = 0x300;
+  int21(0x3F00);
+  // Not end of file, the rest of the line hasn't been typed yet.
+  EXPECT_TRUE(cpu.waiting_for_input());
+  EXPECT_EQ(0x3F, cpu.core.regs.h.ah);
+  keys = {0x3062, 0x1C0D};
+  // Resumed, which runs the INT again.
+  cpu.run_for({0});
+  int21(0x3F00);
+  EXPECT_EQ(4, cpu.core.regs.x.ax);
+  EXPECT_EQ('a', cpu.memory.abs8(0x2300));
+  EXPECT_EQ('b', cpu.memory.abs8(0x2301));
+}
+
+TEST_F(DosOutputTest, GetTime) {
+  // INT 1Ah AH=00h, half way through the day.
+  cpu.int_handlers().try_emplace(0x1A, [](int, door86::cpu::x86::CPU& c) {
+    c.core.regs.x.cx = 0x000C;
+    c.core.regs.x.dx = 0x0058;
+  });
+  int21(0x2C00);
+  EXPECT_EQ(12, cpu.core.regs.h.ch);
+  EXPECT_EQ(0, cpu.core.regs.h.cl);
+  EXPECT_EQ(0x2C, cpu.core.regs.h.ah);
+}
+
+TEST_F(DosOutputTest, GetDate) {
+  cpu.time.set_virtual();
+  int21(0x2A00);
+  EXPECT_EQ(1990, cpu.core.regs.x.cx);
+  EXPECT_EQ(1, cpu.core.regs.h.dh);
+  EXPECT_EQ(1, cpu.core.regs.h.dl);
+  // Monday
+  EXPECT_EQ(1, cpu.core.regs.h.al);
+}
+
+class DosFileTest : public DosOutputTest {
+protected:
+  void SetUp() override {
+    DosOutputTest::SetUp();
+    dir_ = create_test_directory();
+    dos.files.set_root(dir_);
+  }
+  void TearDown() override { std::filesystem::remove_all(dir_); }
+
+  // Calls AH with the file name at DS:0000, returns the handle in AX.
+  uint16_t open(uint16_t ax, const std::string& name) {
+    cpu.memory.load_string(0x2000, name + '\0');
+    cpu.core.regs.x.dx = 0;
+    cpu.core.regs.x.cx = 0;
+    int21(ax);
+    return cpu.core.regs.x.ax;
+  }
+  // Reads or writes cx bytes at DS:DX.
+  void transfer(uint16_t ax, uint16_t handle, uint16_t cx, uint16_t dx) {
+    cpu.core.regs.x.bx = handle;
+    cpu.core.regs.x.cx = cx;
+    cpu.core.regs.x.dx = dx;
+    int21(ax);
+  }
+
+  std::filesystem::path dir_;
+};
+
+TEST_F(DosFileTest, CreateWriteReadBack) {
+  const auto h = open(0x3C00, "C:\\SCORES.DAT");
+  ASSERT_FALSE(cpu.core.flags.cflag());
+  // After the standard handles.
+  EXPECT_EQ(5, h);
+  cpu.memory.load_string(0x2100, "Hello, World");
+  transfer(0x4000, h, 12, 0x100);
+  EXPECT_FALSE(cpu.core.flags.cflag());
+  EXPECT_EQ(12, cpu.core.regs.x.ax);
+  // Back to 7 bytes from the start.
+  cpu.core.regs.x.bx = h;
+  cpu.core.regs.x.cx = 0;
+  cpu.core.regs.x.dx = 7;
+  int21(0x4200);
+  EXPECT_EQ(7, cpu.core.regs.x.ax);
+  EXPECT_EQ(0, cpu.core.regs.x.dx);
+  transfer(0x3F00, h, 100, 0x200);
+  EXPECT_EQ(5, cpu.core.regs.x.ax);
+  EXPECT_EQ('W', cpu.memory.abs8(0x2200));
+  EXPECT_EQ('d', cpu.memory.abs8(0x2204));
+  // Size from the end.
+  cpu.core.regs.x.dx = 0;
+  int21(0x4202);
+  EXPECT_EQ(12, cpu.core.regs.x.ax);
+  cpu.core.regs.x.bx = h;
+  int21(0x3E00);
+  EXPECT_FALSE(cpu.core.flags.cflag());
+  std::ifstream f(dir_ / "SCORES.DAT", std::ios::binary);
+  EXPECT_EQ("Hello, World",
+            std::string(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>()));
+  // Closed already.
+  int21(0x3E00);
+  EXPECT_TRUE(cpu.core.flags.cflag());
+  EXPECT_EQ(6, cpu.core.regs.x.ax);
+}
+
+TEST_F(DosFileTest, OpenMissing) {
+  open(0x3D00, "NOTHERE.DAT");
+  EXPECT_TRUE(cpu.core.flags.cflag());
+  EXPECT_EQ(2, cpu.core.regs.x.ax);
+}
+
+TEST_F(DosFileTest, ReadOnly) {
+  std::ofstream(dir_ / "users.dat") << "abc";
+  const auto h = open(0x3D00, "USERS.DAT");
+  ASSERT_FALSE(cpu.core.flags.cflag());
+  transfer(0x4000, h, 1, 0x100);
+  EXPECT_TRUE(cpu.core.flags.cflag());
+  EXPECT_EQ(5, cpu.core.regs.x.ax);
+}
+
+TEST_F(DosFileTest, DupAndTruncate) {
+  const auto h = open(0x3C00, "LOG.TXT");
+  cpu.memory.load_string(0x2100, "0123456789");
+  transfer(0x4000, h, 10, 0x100);
+  cpu.core.regs.x.bx = h;
+  int21(0x4500);
+  ASSERT_FALSE(cpu.core.flags.cflag());
+  const auto dup = cpu.core.regs.x.ax;
+  EXPECT_NE(h, dup);
+  cpu.core.regs.x.bx = h;
+  int21(0x3E00);
+  // The duplicate shares the position, and writing nothing truncates there.
+  cpu.core.regs.x.bx = dup;
+  cpu.core.regs.x.cx = 0xFFFF;
+  cpu.core.regs.x.dx = 0xFFFC;
+  int21(0x4201);
+  EXPECT_EQ(6, cpu.core.regs.x.ax);
+  transfer(0x4000, dup, 0, 0x100);
+  EXPECT_FALSE(cpu.core.flags.cflag());
+  cpu.core.regs.x.bx = dup;
+  int21(0x3E00);
+  EXPECT_EQ(6u, std::filesystem::file_size(dir_ / "LOG.TXT"));
+}
+
+TEST_F(DosFileTest, SeekIs32Bits) {
+  const auto h = open(0x3C00, "BIG.DAT");
+  // Past 2 GiB from the start is unsigned.
+  cpu.core.regs.x.bx = h;
+  cpu.core.regs.x.cx = 0x8000;
+  cpu.core.regs.x.dx = 0x0010;
+  int21(0x4200);
+  EXPECT_FALSE(cpu.core.flags.cflag());
+  EXPECT_EQ(0x8000, cpu.core.regs.x.dx);
+  EXPECT_EQ(0x0010, cpu.core.regs.x.ax);
+  // Before the start wraps around, and it's the write that fails.
+  cpu.core.regs.x.bx = h;
+  cpu.core.regs.x.cx = 0xFFFF;
+  cpu.core.regs.x.dx = 0xFFFF;
+  int21(0x4202);
+  EXPECT_FALSE(cpu.core.flags.cflag());
+  EXPECT_EQ(0xFFFF, cpu.core.regs.x.dx);
+  EXPECT_EQ(0xFFFF, cpu.core.regs.x.ax);
+  cpu.memory.load_string(0x2100, "x");
+  transfer(0x4000, h, 1, 0x100);
+  EXPECT_TRUE(cpu.core.flags.cflag());
+  EXPECT_EQ(0u, std::filesystem::file_size(dir_ / "BIG.DAT"));
+}
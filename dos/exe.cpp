@@ -5,8 +5,10 @@
 #include "core/scope_exit.h"
 #include "fmt/format.h"
 #include <cstdio>
+#include <cstdint>
 #include <string>
 #include <optional>
+#include <vector>
 
 // MSVC only has __PRETTY_FUNCTION__ in intellisense, 
 // TODO(rushfan): Find a better home for this macro.
@@ -132,10 +134,13 @@ bool load_image(const std::filesystem::path& filepath, uint16_t base_segment, ui
     // skip header
     f.Seek(offset, File::Whence::begin);
   }
-  if (f.Read(&mem[base_segment * 0x10], filesize) != filesize) {
+  // Read it separately so that memory only changes where the image differs from what's
+  // already there, which keeps pages shared with a MemoryImage.
+  std::vector<uint8_t> image(filesize);
+  if (f.Read(image.data(), filesize) != filesize) {
     VLOG(1) << "Failed to read binary into memory";
   }
-  return true;
+  return mem.load_image(base_segment * 0x10, image.size(), image.data());
 }
 
 }
@@ -0,0 +1,492 @@
+#include "dos/file_table.h"
+
+#include "core/log.h"
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace door86::dos {
+
+namespace fs = std::filesystem;
+
+#ifdef _WIN32
+
+static int host_open(const fs::path& path, int flags) {
+  return _wopen(path.c_str(), flags | _O_BINARY, _S_IREAD | _S_IWRITE);
+}
+static int64_t host_pread(int fd, void* p, size_t n, int64_t pos) {
+  if (_lseeki64(fd, pos, SEEK_SET) < 0) {
+    return -1;
+  }
+  return _read(fd, p, static_cast<unsigned>(n));
+}
+static int64_t host_pwrite(int fd, const void* p, size_t n, int64_t pos) {
+  if (_lseeki64(fd, pos, SEEK_SET) < 0) {
+    return -1;
+  }
+  return _write(fd, p, static_cast<unsigned>(n));
+}
+static bool host_truncate(int fd, int64_t size) { return _chsize_s(fd, size) == 0; }
+static int64_t host_size(int fd) {
+  struct _stat64 st;
+  return _fstat64(fd, &st) == 0 ? st.st_size : -1;
+}
+static void host_close(int fd) { _close(fd); }
+
+#else
+
+static int host_open(const fs::path& path, int flags) { return open(path.c_str(), flags, 0666); }
+static int64_t host_pread(int fd, void* p, size_t n, int64_t pos) { return pread(fd, p, n, pos); }
+static int64_t host_pwrite(int fd, const void* p, size_t n, int64_t pos) {
+  return pwrite(fd, p, n, pos);
+}
+static bool host_truncate(int fd, int64_t size) { return ftruncate(fd, size) == 0; }
+static int64_t host_size(int fd) {
+  struct stat st;
+  return fstat(fd, &st) == 0 ? st.st_size : -1;
+}
+static void host_close(int fd) { close(fd); }
+
+#endif
+
+/**
+ * A host file open in any session, shared by every DosFile for it, with the
+ * buffer they read and write through.
+ *
+ * The file is opened for reading and writing if the host allows it, whatever
+ * the first entry for it wanted, so later ones can share it. It's closed when
+ * the last entry is. Sessions run on their own threads, so everything is
+ * done under a lock.
+ */
+class HostFile {
+public:
+  // The HostFile for path, opening it if nothing has it open yet. create
+  // truncates it, and needs it writable. Returns null if it couldn't be opened.
+  static std::shared_ptr<HostFile> acquire(const fs::path& path, bool create);
+  // An entry for file was closed, the file is closed with the last one.
+  static void release(const std::shared_ptr<HostFile>& file);
+
+  HostFile(std::string key, int fd, bool writable, int64_t size)
+      : key_(std::move(key)), fd_(fd), writable_(writable), size_(size), buf_(DosFile::buffer_size) {}
+  HostFile(const HostFile&) = delete;
+  HostFile& operator=(const HostFile&) = delete;
+
+  bool writable() const noexcept { return writable_; }
+  int64_t size();
+  int64_t read(int64_t pos, uint8_t* dest, size_t n);
+  int64_t write(int64_t pos, const uint8_t* src, size_t n);
+  bool truncate(int64_t size);
+  bool flush();
+
+  uint64_t host_reads() const noexcept { return host_reads_; }
+  uint64_t host_writes() const noexcept { return host_writes_; }
+
+private:
+  // Open files by canonical path.
+  static std::mutex& files_mutex();
+  static std::map<std::string, std::pair<std::shared_ptr<HostFile>, int>>& files();
+
+  int64_t buf_end() const noexcept { return buf_start_ + static_cast<int64_t>(buf_len_); }
+  // Picks up anything added to the file outside of DOS since size_ was last
+  // looked at, so the cached size isn't taken for the end of the file.
+  void update_size();
+  bool flush_locked();
+  // Moves the buffer to start at pos, reading what's there.
+  bool fill(int64_t pos);
+  void close();
+
+  const std::string key_;
+  std::mutex mutex_;
+  int fd_;
+  const bool writable_;
+  int64_t size_;
+  std::vector<uint8_t> buf_;
+  // The part of the file in buf_.
+  int64_t buf_start_{0};
+  size_t buf_len_{0};
+  // Written bytes in buf_ not yet written to the host file, as file positions.
+  int64_t dirty_start_{0};
+  int64_t dirty_end_{0};
+  uint64_t host_reads_{0};
+  uint64_t host_writes_{0};
+};
+
+std::mutex& HostFile::files_mutex() {
+  static std::mutex mutex;
+  return mutex;
+}
+
+std::map<std::string, std::pair<std::shared_ptr<HostFile>, int>>& HostFile::files() {
+  static std::map<std::string, std::pair<std::shared_ptr<HostFile>, int>> files;
+  return files;
+}
+
+std::shared_ptr<HostFile> HostFile::acquire(const fs::path& path, bool create) {
+  std::error_code ec;
+  auto canonical = fs::weakly_canonical(path, ec);
+  const auto key = (ec ? path : canonical).string();
+
+  std::lock_guard lock(files_mutex());
+  auto& open = files();
+  if (auto it = open.find(key); it != open.end()) {
+    auto& [file, refs] = it->second;
+    if (create && (!file->writable() || !file->truncate(0))) {
+      return nullptr;
+    }
+    ++refs;
+    return file;
+  }
+  int fd = host_open(path, create ? O_RDWR | O_CREAT | O_TRUNC : O_RDWR);
+  bool writable = fd >= 0;
+  if (fd < 0 && !create && (errno == EACCES || errno == EPERM || errno == EROFS)) {
+    fd = host_open(path, O_RDONLY);
+  }
+  if (fd < 0) {
+    VLOG(1) << "Unable to open " << path.string() << ": " << strerror(errno);
+    return nullptr;
+  }
+  auto file = std::make_shared<HostFile>(key, fd, writable, std::max<int64_t>(host_size(fd), 0));
+  open.emplace(key, std::make_pair(file, 1));
+  return file;
+}
+
+void HostFile::release(const std::shared_ptr<HostFile>& file) {
+  std::lock_guard lock(files_mutex());
+  auto& open = files();
+  auto it = open.find(file->key_);
+  if (it == open.end() || --it->second.second > 0) {
+    return;
+  }
+  // Still under the lock, so nothing opens the file again until it's written out.
+  file->close();
+  open.erase(it);
+}
+
+void HostFile::close() {
+  std::lock_guard lock(mutex_);
+  if (fd_ >= 0) {
+    flush_locked();
+    host_close(fd_);
+    fd_ = -1;
+  }
+}
+
+void HostFile::update_size() {
+  const auto size = host_size(fd_);
+  size_ = std::max(size_, size);
+}
+
+int64_t HostFile::size() {
+  std::lock_guard lock(mutex_);
+  update_size();
+  return size_;
+}
+
+bool HostFile::flush() {
+  std::lock_guard lock(mutex_);
+  return flush_locked();
+}
+
+bool HostFile::flush_locked() {
+  while (dirty_end_ > dirty_start_) {
+    ++host_writes_;
+    const auto n = host_pwrite(fd_, buf_.data() + (dirty_start_ - buf_start_),
+                               static_cast<size_t>(dirty_end_ - dirty_start_), dirty_start_);
+    if (n <= 0) {
+      LOG(WARNING) << "Failed to write buffered DOS file data: " << strerror(errno);
+      return false;
+    }
+    dirty_start_ += n;
+  }
+  dirty_start_ = dirty_end_ = 0;
+  return true;
+}
+
+bool HostFile::fill(int64_t pos) {
+  if (!flush_locked()) {
+    return false;
+  }
+  buf_start_ = pos;
+  buf_len_ = 0;
+  ++host_reads_;
+  const auto n = host_pread(fd_, buf_.data(), buf_.size(), pos);
+  if (n < 0) {
+    return false;
+  }
+  buf_len_ = static_cast<size_t>(n);
+  return true;
+}
+
+int64_t HostFile::read(int64_t pos, uint8_t* dest, size_t n) {
+  std::lock_guard lock(mutex_);
+  if (pos + static_cast<int64_t>(n) > size_) {
+    update_size();
+  }
+  if (pos >= size_) {
+    return 0;
+  }
+  n = static_cast<size_t>(std::min<int64_t>(n, size_ - pos));
+  if (n >= DosFile::buffer_size) {
+    // Straight into the caller's memory, after anything waiting to be written
+    // that it might include.
+    if (!flush_locked()) {
+      return -1;
+    }
+    size_t done = 0;
+    while (done < n) {
+      ++host_reads_;
+      const auto got = host_pread(fd_, dest + done, n - done, pos + done);
+      if (got < 0) {
+        return -1;
+      }
+      if (got == 0) {
+        break;
+      }
+      done += static_cast<size_t>(got);
+    }
+    return static_cast<int64_t>(done);
+  }
+  if (pos < buf_start_ || pos + static_cast<int64_t>(n) > buf_end()) {
+    if (!fill(pos)) {
+      return -1;
+    }
+  }
+  const auto len = std::min<size_t>(n, static_cast<size_t>(std::max<int64_t>(buf_end() - pos, 0)));
+  memcpy(dest, buf_.data() + (pos - buf_start_), len);
+  return static_cast<int64_t>(len);
+}
+
+int64_t HostFile::write(int64_t pos, const uint8_t* src, size_t n) {
+  std::lock_guard lock(mutex_);
+  if (n >= DosFile::buffer_size) {
+    if (!flush_locked()) {
+      return -1;
+    }
+    size_t done = 0;
+    while (done < n) {
+      ++host_writes_;
+      const auto put = host_pwrite(fd_, src + done, n - done, pos + done);
+      if (put <= 0) {
+        return done ? static_cast<int64_t>(done) : -1;
+      }
+      done += static_cast<size_t>(put);
+    }
+    // What's in the buffer for that part of the file is stale now.
+    if (pos < buf_end() && pos + static_cast<int64_t>(done) > buf_start_) {
+      buf_len_ = 0;
+    }
+    size_ = std::max<int64_t>(size_, pos + done);
+    return static_cast<int64_t>(done);
+  }
+  // Carries on from the buffer's window if it can, otherwise starts a new one here.
+  if (pos < buf_start_ || pos > buf_end() ||
+      pos + static_cast<int64_t>(n) > buf_start_ + static_cast<int64_t>(buf_.size())) {
+    if (!flush_locked()) {
+      return -1;
+    }
+    buf_start_ = pos;
+    buf_len_ = 0;
+  }
+  memcpy(buf_.data() + (pos - buf_start_), src, n);
+  buf_len_ = std::max<size_t>(buf_len_, static_cast<size_t>(pos + n - buf_start_));
+  if (dirty_end_ > dirty_start_) {
+    dirty_start_ = std::min(dirty_start_, pos);
+    dirty_end_ = std::max<int64_t>(dirty_end_, pos + n);
+  } else {
+    dirty_start_ = pos;
+    dirty_end_ = pos + n;
+  }
+  size_ = std::max<int64_t>(size_, pos + n);
+  return static_cast<int64_t>(n);
+}
+
+bool HostFile::truncate(int64_t size) {
+  std::lock_guard lock(mutex_);
+  if (!flush_locked() || !host_truncate(fd_, size)) {
+    return false;
+  }
+  size_ = size;
+  if (buf_end() > size) {
+    buf_len_ = size > buf_start_ ? static_cast<size_t>(size - buf_start_) : 0;
+  }
+  return true;
+}
+
+DosFile::DosFile(std::shared_ptr<HostFile> host, uint8_t mode)
+    : device(device_t::none), mode(mode), host_(std::move(host)) {}
+
+DosFile::~DosFile() {
+  if (host_) {
+    HostFile::release(host_);
+  }
+}
+
+int64_t DosFile::size() const { return host_ ? host_->size() : 0; }
+
+int64_t DosFile::read(uint8_t* dest, size_t n) {
+  const auto got = host_->read(pos, dest, n);
+  if (got > 0) {
+    pos += got;
+  }
+  return got;
+}
+
+int64_t DosFile::write(const uint8_t* src, size_t n) {
+  const auto put = host_->write(pos, src, n);
+  if (put > 0) {
+    pos += put;
+  }
+  return put;
+}
+
+bool DosFile::truncate() { return host_->truncate(pos); }
+
+bool DosFile::flush() { return host_ ? host_->flush() : true; }
+
+uint64_t DosFile::host_reads() const { return host_ ? host_->host_reads() : 0; }
+
+uint64_t DosFile::host_writes() const { return host_ ? host_->host_writes() : 0; }
+
+static bool iequals(const std::string& a, const std::string& b) {
+  return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [](char x, char y) {
+           return std::toupper(static_cast<unsigned char>(x)) ==
+                  std::toupper(static_cast<unsigned char>(y));
+         });
+}
+
+// dir / name, or whatever's in dir with the same name ignoring case.
+static fs::path match(const fs::path& dir, const std::string& name) {
+  auto path = dir / name;
+  std::error_code ec;
+  if (fs::exists(path, ec)) {
+    return path;
+  }
+  for (const auto& e : fs::directory_iterator(dir, ec)) {
+    if (iequals(e.path().filename().string(), name)) {
+      return e.path();
+    }
+  }
+  return path;
+}
+
+FileTable::FileTable(fs::path root) : root_(std::move(root)) {
+  files_.emplace_back(std::make_unique<DosFile>(DosFile::device_t::con));
+  files_.emplace_back(std::make_unique<DosFile>(DosFile::device_t::aux));
+  files_.emplace_back(std::make_unique<DosFile>(DosFile::device_t::prn));
+}
+
+fs::path FileTable::host_path(std::string_view name) const {
+  // Every drive is root_.
+  if (name.size() >= 2 && name[1] == ':') {
+    name.remove_prefix(2);
+  }
+  auto path = root_;
+  for (size_t start = 0; start <= name.size();) {
+    auto end = name.find_first_of("\\/", start);
+    if (end == std::string_view::npos) {
+      end = name.size();
+    }
+    const std::string part(name.substr(start, end - start));
+    start = end + 1;
+    if (part.empty() || part == ".") {
+      continue;
+    }
+    if (part == "..") {
+      if (path != root_) {
+        path = path.parent_path();
+      }
+      continue;
+    }
+    path = match(path, part);
+  }
+  return path;
+}
+
+dos_error_t FileTable::add(std::unique_ptr<DosFile> file, uint8_t& index) {
+  for (size_t i = 0; i < files_.size(); i++) {
+    if (!files_[i]) {
+      files_[i] = std::move(file);
+      index = static_cast<uint8_t>(i);
+      return dos_error_t::none;
+    }
+  }
+  if (files_.size() >= max_files) {
+    return dos_error_t::too_many_open_files;
+  }
+  files_.emplace_back(std::move(file));
+  index = static_cast<uint8_t>(files_.size() - 1);
+  return dos_error_t::none;
+}
+
+dos_error_t FileTable::open(std::string_view name, uint8_t mode, uint8_t& index) {
+  if (mode > 2) {
+    return dos_error_t::invalid_access;
+  }
+  const auto path = host_path(name);
+  std::error_code ec;
+  if (!fs::exists(path, ec)) {
+    return fs::is_directory(path.parent_path(), ec) ? dos_error_t::file_not_found
+                                                    : dos_error_t::path_not_found;
+  }
+  if (fs::is_directory(path, ec)) {
+    return dos_error_t::access_denied;
+  }
+  auto host = HostFile::acquire(path, false);
+  if (!host) {
+    return dos_error_t::access_denied;
+  }
+  if (mode != 0 && !host->writable()) {
+    HostFile::release(host);
+    return dos_error_t::access_denied;
+  }
+  return add(std::make_unique<DosFile>(std::move(host), mode), index);
+}
+
+dos_error_t FileTable::create(std::string_view name, uint8_t& index) {
+  const auto path = host_path(name);
+  std::error_code ec;
+  if (!fs::is_directory(path.parent_path(), ec)) {
+    return dos_error_t::path_not_found;
+  }
+  if (fs::is_directory(path, ec)) {
+    return dos_error_t::access_denied;
+  }
+  auto host = HostFile::acquire(path, true);
+  if (!host) {
+    return dos_error_t::access_denied;
+  }
+  return add(std::make_unique<DosFile>(std::move(host), 2), index);
+}
+
+DosFile* FileTable::get(uint8_t index) const {
+  return index < files_.size() ? files_[index].get() : nullptr;
+}
+
+void FileTable::add_ref(uint8_t index) {
+  if (auto* f = get(index)) {
+    ++f->refs;
+  }
+}
+
+void FileTable::release(uint8_t index) {
+  auto* f = get(index);
+  // The devices stay open.
+  if (f && --f->refs <= 0 && f->device == DosFile::device_t::none) {
+    files_[index].reset();
+  }
+}
+
+} // namespace door86::dos
@@ -0,0 +1,131 @@
+#ifndef INCLUDED_DOS_FILE_TABLE_H
+#define INCLUDED_DOS_FILE_TABLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+namespace door86::dos {
+
+// DOS error codes, returned in AX with CF set.
+enum class dos_error_t : uint16_t {
+  none = 0,
+  invalid_function = 0x01,
+  file_not_found = 0x02,
+  path_not_found = 0x03,
+  too_many_open_files = 0x04,
+  access_denied = 0x05,
+  invalid_handle = 0x06,
+  invalid_access = 0x0C,
+};
+
+class HostFile;
+
+/**
+ * An entry in the system file table: a file (or device) as it was opened,
+ * with its own position and access mode, shared by every handle duplicated
+ * from the one it was opened as.
+ *
+ * Every entry for the same host file, in this session or any other, shares
+ * one HostFile: the host's descriptor and a buffer holding a window of the
+ * file, so each sees what the others wrote straight away. Reads and writes of
+ * less than buffer_size bytes go through the buffer, so a program reading or
+ * writing a small record at a time (i.e. 128 byte user records) makes one
+ * host call every buffer_size bytes instead of one a record. Writes stay in
+ * the buffer until something else needs it, the file is flushed, or the last
+ * entry for it is closed. Anything bigger goes straight between the caller's
+ * memory and the host file.
+ */
+class DosFile {
+public:
+  enum class device_t { none, con, aux, prn };
+  static constexpr size_t buffer_size = 0x1000;
+  // Sizes and positions are 32 bits.
+  static constexpr int64_t max_file_size = 0xFFFFFFFF;
+
+  explicit DosFile(device_t device) : device(device), mode(2) {}
+  // Opened with the DOS access mode (0-2).
+  DosFile(std::shared_ptr<HostFile> host, uint8_t mode);
+  ~DosFile();
+  DosFile(const DosFile&) = delete;
+  DosFile& operator=(const DosFile&) = delete;
+
+  bool can_read() const noexcept { return mode != 1; }
+  bool can_write() const noexcept { return mode != 0; }
+  // Including anything written that's still in the buffer, and anything
+  // added to the file outside of DOS.
+  int64_t size() const;
+
+  // Read or write up to n bytes at pos, and move pos past them. Return how
+  // many were, or -1 if the host failed.
+  int64_t read(uint8_t* dest, size_t n);
+  int64_t write(const uint8_t* src, size_t n);
+  // Truncates or extends the file to pos.
+  bool truncate();
+  // Writes out anything waiting in the buffer.
+  bool flush();
+
+  // Calls made to the host to read or write the file, by any entry for it.
+  uint64_t host_reads() const;
+  uint64_t host_writes() const;
+
+  const device_t device;
+  const uint8_t mode;
+  int64_t pos{0};
+  // Handles (in any process) referring to this entry.
+  int refs{1};
+
+private:
+  std::shared_ptr<HostFile> host_;
+};
+
+/**
+ * The DOS system file table: every open file, indexed by the entries of
+ * each process's job file table (the handle table in its PSP).
+ *
+ * The first three entries are the CON, AUX and PRN devices, which is where
+ * the standard handles 0-4 of a new process point. DOS paths name files
+ * under root, which is the root directory of every drive. The host file
+ * system may be case sensitive, so names are matched to what's there without
+ * regard to case.
+ */
+class FileTable {
+public:
+  static constexpr uint8_t con = 0;
+  static constexpr uint8_t aux = 1;
+  static constexpr uint8_t prn = 2;
+  // FILES=
+  static constexpr size_t max_files = 40;
+
+  explicit FileTable(std::filesystem::path root);
+  ~FileTable() = default;
+
+  void set_root(std::filesystem::path root) { root_ = std::move(root); }
+  // Host path for the DOS path name.
+  std::filesystem::path host_path(std::string_view name) const;
+
+  // Open an existing file (with DOS access mode 0-2) or create one, truncating
+  // any that's there. Return the index of the new entry in index.
+  dos_error_t open(std::string_view name, uint8_t mode, uint8_t& index);
+  dos_error_t create(std::string_view name, uint8_t& index);
+
+  // The entry at index, or null.
+  DosFile* get(uint8_t index) const;
+  // Another handle refers to index.
+  void add_ref(uint8_t index);
+  // A handle referring to index was closed, the file is closed with the last one.
+  void release(uint8_t index);
+
+private:
+  dos_error_t add(std::unique_ptr<DosFile> file, uint8_t& index);
+
+  std::filesystem::path root_;
+  std::vector<std::unique_ptr<DosFile>> files_;
+};
+
+} // namespace door86::dos
+
+#endif // INCLUDED_DOS_FILE_TABLE_H
@@ -0,0 +1,195 @@
+#include <gtest/gtest.h>
+
+#include "dos/dos_fixture.h"
+#include "dos/file_table.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+using namespace door86::dos;
+
+class FileTableTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    dir_ = create_test_directory();
+    files.set_root(dir_);
+  }
+  void TearDown() override { std::filesystem::remove_all(dir_); }
+
+  std::string contents(const std::string& name) {
+    std::ifstream f(dir_ / name, std::ios::binary);
+    return {std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>()};
+  }
+
+  uint8_t create(const std::string& name) {
+    uint8_t index = 0;
+    EXPECT_EQ(dos_error_t::none, files.create(name, index));
+    return index;
+  }
+
+  std::filesystem::path dir_;
+  FileTable files{std::filesystem::current_path()};
+};
+
+// 128 byte records, each filled with its number.
+static std::vector<uint8_t> records(int count) {
+  std::vector<uint8_t> data;
+  for (int i = 0; i < count; i++) {
+    data.insert(data.end(), 128, static_cast<uint8_t>(i));
+  }
+  return data;
+}
+
+TEST_F(FileTableTest, Devices) {
+  ASSERT_NE(nullptr, files.get(FileTable::con));
+  EXPECT_EQ(DosFile::device_t::con, files.get(FileTable::con)->device);
+  EXPECT_EQ(DosFile::device_t::prn, files.get(FileTable::prn)->device);
+  EXPECT_EQ(nullptr, files.get(3));
+}
+
+TEST_F(FileTableTest, SmallReadsAreBuffered) {
+  const auto data = records(64);
+  std::ofstream(dir_ / "USERS.DAT", std::ios::binary)
+      .write(reinterpret_cast<const char*>(data.data()), data.size());
+  uint8_t index = 0;
+  ASSERT_EQ(dos_error_t::none, files.open("USERS.DAT", 0, index));
+  auto* f = files.get(index);
+  ASSERT_NE(nullptr, f);
+  EXPECT_EQ(8192, f->size());
+  uint8_t rec[128];
+  for (int i = 0; i < 64; i++) {
+    ASSERT_EQ(128, f->read(rec, sizeof(rec)));
+    ASSERT_EQ(i, rec[0]);
+    ASSERT_EQ(i, rec[127]);
+  }
+  EXPECT_EQ(0, f->read(rec, sizeof(rec)));
+  // A host read for every buffer full.
+  EXPECT_EQ(2u, f->host_reads());
+  EXPECT_FALSE(f->can_write());
+}
+
+TEST_F(FileTableTest, WritesAreBuffered) {
+  auto* f = files.get(create("SCORES.DAT"));
+  ASSERT_NE(nullptr, f);
+  const auto data = records(64);
+  for (int i = 0; i < 64; i++) {
+    ASSERT_EQ(128, f->write(data.data() + i * 128, 128));
+  }
+  EXPECT_EQ(8192, f->size());
+  EXPECT_EQ(1u, f->host_writes());
+  // Reads see what's still in the buffer.
+  f->pos = 8064;
+  uint8_t rec[128];
+  ASSERT_EQ(128, f->read(rec, sizeof(rec)));
+  EXPECT_EQ(63, rec[0]);
+  EXPECT_TRUE(f->flush());
+  EXPECT_EQ(std::string(data.begin(), data.end()), contents("SCORES.DAT"));
+}
+
+TEST_F(FileTableTest, RewriteRecord) {
+  const auto index = create("SCORES.DAT");
+  auto* f = files.get(index);
+  const auto data = records(4);
+  ASSERT_EQ(512, f->write(data.data(), data.size()));
+  f->pos = 128;
+  const std::vector<uint8_t> rec(128, 0xAA);
+  ASSERT_EQ(128, f->write(rec.data(), rec.size()));
+  files.release(index);
+  EXPECT_EQ(nullptr, files.get(index));
+  auto expected = data;
+  std::fill(expected.begin() + 128, expected.begin() + 256, 0xAA);
+  // Written out when closed.
+  EXPECT_EQ(std::string(expected.begin(), expected.end()), contents("SCORES.DAT"));
+}
+
+TEST_F(FileTableTest, LargeTransfersAreDirect) {
+  auto* f = files.get(create("BIG.DAT"));
+  const auto data = records(64);
+  ASSERT_EQ(8192, f->write(data.data(), data.size()));
+  EXPECT_EQ(1u, f->host_writes());
+  f->pos = 0;
+  std::vector<uint8_t> got(8192);
+  ASSERT_EQ(8192, f->read(got.data(), got.size()));
+  EXPECT_EQ(1u, f->host_reads());
+  EXPECT_EQ(data, got);
+}
+
+TEST_F(FileTableTest, Truncate) {
+  auto* f = files.get(create("LOG.TXT"));
+  const std::string s = "Hello, World";
+  ASSERT_EQ(12, f->write(reinterpret_cast<const uint8_t*>(s.data()), s.size()));
+  f->pos = 5;
+  ASSERT_TRUE(f->truncate());
+  EXPECT_EQ(5, f->size());
+  EXPECT_EQ("Hello", contents("LOG.TXT"));
+}
+
+TEST_F(FileTableTest, HostPathIgnoresCase) {
+  std::filesystem::create_directories(dir_ / "Data");
+  std::ofstream(dir_ / "Data" / "Users.dat") << "x";
+  EXPECT_EQ(dir_ / "Data" / "Users.dat", files.host_path("C:\\DATA\\USERS.DAT"));
+  EXPECT_EQ(dir_ / "Data" / "NEW.DAT", files.host_path("\\data\\..\\DATA\\NEW.DAT"));
+  uint8_t index = 0;
+  EXPECT_EQ(dos_error_t::file_not_found, files.open("MISSING.DAT", 0, index));
+  EXPECT_EQ(dos_error_t::path_not_found, files.open("NODIR\\MISSING.DAT", 0, index));
+  EXPECT_EQ(dos_error_t::invalid_access, files.open("DATA\\USERS.DAT", 3, index));
+}
+
+TEST_F(FileTableTest, HandlesShareTheFile) {
+  const auto data = records(4);
+  std::ofstream(dir_ / "MSGS.DAT", std::ios::binary)
+      .write(reinterpret_cast<const char*>(data.data()), data.size());
+  uint8_t writer = 0;
+  uint8_t reader = 0;
+  ASSERT_EQ(dos_error_t::none, files.open("MSGS.DAT", 2, writer));
+  // Another session opening it, each with its own position.
+  FileTable other{dir_};
+  ASSERT_EQ(dos_error_t::none, other.open("msgs.dat", 0, reader));
+  auto* w = files.get(writer);
+  auto* r = other.get(reader);
+  uint8_t rec[128];
+  r->pos = 384;
+  ASSERT_EQ(128, r->read(rec, sizeof(rec)));
+  EXPECT_EQ(0, r->read(rec, sizeof(rec)));
+
+  // An appended record, and a rewritten one, are there for the reader even
+  // before they're flushed.
+  const std::vector<uint8_t> appended(128, 0xAA);
+  w->pos = 512;
+  ASSERT_EQ(128, w->write(appended.data(), appended.size()));
+  ASSERT_EQ(128, r->read(rec, sizeof(rec)));
+  EXPECT_EQ(0xAA, rec[0]);
+  const std::vector<uint8_t> rewritten(128, 0xBB);
+  w->pos = 0;
+  ASSERT_EQ(128, w->write(rewritten.data(), rewritten.size()));
+  r->pos = 0;
+  ASSERT_EQ(128, r->read(rec, sizeof(rec)));
+  EXPECT_EQ(0xBB, rec[0]);
+
+  // Written out when the last one's closed.
+  files.release(writer);
+  EXPECT_EQ(0, contents("MSGS.DAT")[0]);
+  other.release(reader);
+  const auto written = contents("MSGS.DAT");
+  EXPECT_EQ(640u, written.size());
+  EXPECT_EQ(0xBB, static_cast<uint8_t>(written[0]));
+}
+
+TEST_F(FileTableTest, ReadsPastCachedSize) {
+  std::ofstream(dir_ / "CHAT.LOG") << "Hello";
+  uint8_t index = 0;
+  ASSERT_EQ(dos_error_t::none, files.open("CHAT.LOG", 0, index));
+  auto* f = files.get(index);
+  char buf[16];
+  ASSERT_EQ(5, f->read(reinterpret_cast<uint8_t*>(buf), sizeof(buf)));
+  EXPECT_EQ(0, f->read(reinterpret_cast<uint8_t*>(buf), sizeof(buf)));
+  // Added outside of DOS.
+  std::ofstream(dir_ / "CHAT.LOG", std::ios::app) << ", World";
+  ASSERT_EQ(7, f->read(reinterpret_cast<uint8_t*>(buf), sizeof(buf)));
+  EXPECT_EQ(", World", std::string(buf, 7));
+  EXPECT_EQ(12, f->size());
+}
@@ -1,5 +1,8 @@
 #include "dos/psp.h"
 
+#include <algorithm>
+#include <cstring>
+
 namespace door86::dos {
 
 bool PSP::initialize() {
@@ -12,9 +15,21 @@ bool PSP::initialize() {
   psp->dos_version_to_return = 0x05;
   // todo: add int21_retf_instructions and cmdline
   psp->parent_psp_segment = 0xFFFE;
+  const auto jft = standard_jft();
+  std::copy(jft.begin(), jft.end(), psp->job_file_table);
+  psp->jft_size = jft_entries;
   return true;
 };
 
+std::array<uint8_t, PSP::jft_entries> PSP::standard_jft() {
+  std::array<uint8_t, jft_entries> jft;
+  jft.fill(unused_handle);
+  jft[0] = jft[1] = jft[2] = 0;
+  jft[3] = 1;
+  jft[4] = 2;
+  return jft;
+}
+
 void PSP::set_commandline(std::string args) {
   if (args.empty() || args.back() != 0x0d) {
     args.push_back(0x0d);
@@ -2,6 +2,7 @@
 #define INCLUDED_DOS_PSP_H
 
 #include "cpu/memory_bits.h"
+#include <array>
 #include <cstdint>
 #include <string>
 
@@ -40,6 +41,15 @@ struct psp_t {
 
 class PSP final {
 public:
+  static constexpr uint8_t unused_handle = 0xFF;
+  static constexpr size_t jft_entries = sizeof(psp_t::job_file_table);
+
+  /**
+   * Job file table of a new process: handles 0-2 are CON, 3 is AUX and 4 is
+   * PRN (the first three entries of the system file table).
+   */
+  static std::array<uint8_t, jft_entries> standard_jft();
+
   PSP(void* memory) { psp = reinterpret_cast<psp_t*>(memory); }
   ~PSP() = default;
 
@@ -0,0 +1,32 @@
+#include "host/image_cache.h"
+
+#include "core/log.h"
+#include "host/session.h"
+
+namespace door86::host {
+
+std::shared_ptr<const door86::cpu::MemoryImage>
+ImageCache::get(const std::filesystem::path& filename) {
+  std::lock_guard lock(mu_);
+  if (auto it = images_.find(filename); it != std::end(images_)) {
+    return it->second;
+  }
+  // Load it once into a session that never runs, and keep what memory ended up as.
+  Session s(0);
+  if (!s.load(filename)) {
+    return nullptr;
+  }
+  auto image = door86::cpu::MemoryImage::create(s.cpu.memory);
+  if (image) {
+    VLOG(1) << "Created memory image for: " << filename.string();
+    images_.emplace(filename, image);
+  }
+  return image;
+}
+
+size_t ImageCache::size() const {
+  std::lock_guard lock(mu_);
+  return images_.size();
+}
+
+} // namespace door86::host
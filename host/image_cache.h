@@ -0,0 +1,40 @@
+#ifndef INCLUDED_HOST_IMAGE_CACHE_H
+#define INCLUDED_HOST_IMAGE_CACHE_H
+
+#include "cpu/memory_image.h"
+
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+
+namespace door86::host {
+
+/**
+ * Memory images of programs loaded by DOS, shared by every session running
+ * the same program.
+ *
+ * A session created over the image for its program and then loaded as usual
+ * (see Session::load) only gets private copies of the pages that loading
+ * writes differently (the PSP and environment of that session), the program
+ * itself stays shared until the session writes to it.
+ */
+class ImageCache {
+public:
+  ImageCache() = default;
+  ~ImageCache() = default;
+
+  /** Returns the image for filename, loading it the first time. Returns nullptr on failure. */
+  std::shared_ptr<const door86::cpu::MemoryImage> get(const std::filesystem::path& filename);
+
+  /** Number of images loaded */
+  size_t size() const;
+
+private:
+  mutable std::mutex mu_;
+  std::map<std::filesystem::path, std::shared_ptr<const door86::cpu::MemoryImage>> images_;
+};
+
+} // namespace door86::host
+
+#endif // INCLUDED_HOST_IMAGE_CACHE_H
@@ -0,0 +1,63 @@
+#include <gtest/gtest.h>
+
+#include "cpu/x86/cpu_fixture.h"
+#include "dos/dos_fixture.h"
+#include "host/image_cache.h"
+#include "host/session.h"
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+using namespace door86::cpu::x86;
+using namespace door86::host;
+
+class ImageCacheTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    dir_ = door86::dos::create_test_directory();
+    // MOV CX, 1000; XOR AX, AX; L: ADD AX, CX; DEC CX; JNZ L; INT 20
+    const auto ops = parse_opcodes_from_line("B9E803 31C0 01C8 49 75FB CD20");
+    path_ = dir_ / "SUM.COM";
+    std::ofstream f(path_, std::ios::binary);
+    f.write(reinterpret_cast<const char*>(ops.data()), ops.size());
+  }
+
+  void TearDown() override { std::filesystem::remove_all(dir_); }
+
+  std::filesystem::path dir_;
+  std::filesystem::path path_;
+};
+
+TEST_F(ImageCacheTest, LoadsOnce) {
+  ImageCache cache;
+  auto a = cache.get(path_);
+  ASSERT_NE(nullptr, a);
+  EXPECT_EQ(a, cache.get(path_));
+  EXPECT_EQ(1u, cache.size());
+}
+
+TEST_F(ImageCacheTest, Missing) {
+  ImageCache cache;
+  EXPECT_EQ(nullptr, cache.get(dir_ / "MISSING.COM"));
+  EXPECT_EQ(0u, cache.size());
+}
+
+TEST_F(ImageCacheTest, SessionsOverImage) {
+  ImageCache cache;
+  auto image = cache.get(path_);
+  ASSERT_NE(nullptr, image);
+
+  Session first(1, image);
+  Session second(2, image);
+  ASSERT_TRUE(first.load(path_));
+  ASSERT_TRUE(second.load(path_));
+  // The program was already there, so loading it didn't write much.
+  EXPECT_LT(first.cpu.memory.writes(), 0x1000u);
+
+  first.cpu.run();
+  EXPECT_EQ(static_cast<uint16_t>(500500), first.cpu.core.regs.x.ax);
+  // Running one doesn't change the other.
+  EXPECT_EQ(2, second.cpu.core.regs.x.ax);
+  second.cpu.run();
+  EXPECT_EQ(static_cast<uint16_t>(500500), second.cpu.core.regs.x.ax);
+}
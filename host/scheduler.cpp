@@ -0,0 +1,235 @@
+#include "host/scheduler.h"
+
+#include "core/log.h"
+#include <algorithm>
+#include <optional>
+#include <utility>
+
+#ifdef _WIN32
+#include <Windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace door86::host {
+
+using namespace door86::cpu::x86;
+using clock = std::chrono::steady_clock;
+
+static void pin_to_core(std::thread& t, int core) {
+#ifdef _WIN32
+  SetThreadAffinityMask(t.native_handle(), DWORD_PTR{1} << core);
+#elif defined(__linux__)
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(core, &set);
+  if (pthread_setaffinity_np(t.native_handle(), sizeof(set), &set) != 0) {
+    LOG(WARNING) << "Unable to pin worker to core " << core;
+  }
+#else
+  LOG(WARNING) << "Pinning workers to cores isn't supported on this platform.";
+#endif
+}
+
+Scheduler::Scheduler(const scheduler_options_t& options) : options_(options) {
+  auto n = options_.workers;
+  if (n <= 0) {
+    n = std::max<int>(1, std::thread::hardware_concurrency());
+  }
+  for (int i = 0; i < n; i++) {
+    workers_.emplace_back(std::make_unique<worker_t>());
+  }
+}
+
+Scheduler::~Scheduler() { stop(); }
+
+Session& Scheduler::add(std::unique_ptr<Session> session) {
+  std::lock_guard lock(mu_);
+  auto& s = *session;
+  s.scheduler_ = this;
+  s.home_ = next_home_++ % workers();
+  sessions_.emplace_back(std::move(session));
+  ++live_;
+  enqueue(s);
+  return s;
+}
+
+void Scheduler::start() {
+  const auto cores = std::max<int>(1, std::thread::hardware_concurrency());
+  for (int i = 0; i < workers(); i++) {
+    auto& w = *workers_[i];
+    w.thread = std::thread(&Scheduler::run_worker, this, i);
+    if (options_.pin_workers) {
+      pin_to_core(w.thread, i % cores);
+    }
+  }
+}
+
+void Scheduler::stop() {
+  {
+    std::lock_guard lock(mu_);
+    stopping_ = true;
+  }
+  cv_.notify_all();
+  for (auto& w : workers_) {
+    if (w->thread.joinable()) {
+      w->thread.join();
+    }
+  }
+}
+
+void Scheduler::wait() {
+  std::unique_lock lock(mu_);
+  done_cv_.wait(lock, [this] { return live_ == 0; });
+}
+
+void Scheduler::wake(Session& s) {
+  std::lock_guard lock(mu_);
+  switch (s.state_) {
+  case session_state_t::parked:
+    parked_.erase(std::remove(parked_.begin(), parked_.end(), &s), parked_.end());
+    enqueue(s);
+    break;
+  case session_state_t::running:
+    // Don't park when this slice ends.
+    s.wake_pending_ = true;
+    break;
+  default: break;
+  }
+}
+
+void Scheduler::enqueue(Session& s) {
+  s.state_ = session_state_t::runnable;
+  auto& w = *workers_[s.home_];
+  {
+    std::lock_guard lock(w.mu);
+    w.queue.push_back(&s);
+  }
+  ++runnable_;
+  cv_.notify_one();
+}
+
+Session* Scheduler::pop(int n) {
+  auto& w = *workers_[n];
+  std::lock_guard lock(w.mu);
+  if (w.queue.empty()) {
+    return nullptr;
+  }
+  auto* s = w.queue.front();
+  w.queue.pop_front();
+  --runnable_;
+  return s;
+}
+
+Session* Scheduler::steal(int n) {
+  for (int i = 1; i < workers(); i++) {
+    auto& w = *workers_[(n + i) % workers()];
+    std::lock_guard lock(w.mu);
+    if (w.queue.empty()) {
+      continue;
+    }
+    // Take the one that's waited longest, it's the least likely to still be cache hot.
+    auto* s = w.queue.front();
+    w.queue.pop_front();
+    --runnable_;
+    ++steals_;
+    return s;
+  }
+  return nullptr;
+}
+
+void Scheduler::wake_due() {
+  std::lock_guard lock(mu_);
+  if (parked_.empty()) {
+    return;
+  }
+  const auto now = clock::now();
+  for (auto it = parked_.begin(); it != parked_.end();) {
+    if ((*it)->park_until_ <= now) {
+      enqueue(**it);
+      it = parked_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+void Scheduler::run_worker(int n) {
+  for (;;) {
+    auto* s = pop(n);
+    if (!s) {
+      s = steal(n);
+    }
+    if (s) {
+      run_slice(n, *s);
+      wake_due();
+      continue;
+    }
+    std::unique_lock lock(mu_);
+    if (stopping_) {
+      return;
+    }
+    // Sleep until there's something to run, or the next parked session is due.
+    // With nothing parked there's no deadline to wait for: a
+    // time_point::max() one overflows converting to the clock the wait uses.
+    const auto ready = [this] { return runnable_ > 0 || stopping_; };
+    if (parked_.empty()) {
+      cv_.wait(lock, [&] { return ready() || !parked_.empty(); });
+    } else {
+      auto due = parked_.front()->park_until_;
+      for (const auto* p : parked_) {
+        due = std::min(due, p->park_until_);
+      }
+      cv_.wait_until(lock, due, ready);
+    }
+    lock.unlock();
+    wake_due();
+  }
+}
+
+void Scheduler::run_slice(int n, Session& s) {
+  s.state_ = session_state_t::running;
+  budget_t budget;
+  budget.deadline = clock::now() + options_.slice;
+  if (options_.slice_cycles) {
+    budget.cycles = options_.slice_cycles;
+  }
+  s.cpu.end_wait();
+  const auto reason = s.cpu.run_for(budget);
+  s.cpu.end_slice(reason);
+  const auto until = reason == stop_reason_t::waiting ? s.cpu.begin_wait() : std::nullopt;
+  ++slices_;
+  ++s.slices_;
+  s.last_stop_ = reason;
+
+  std::lock_guard lock(mu_);
+  // It's cache hot here now.
+  s.home_ = n;
+  switch (reason) {
+  case stop_reason_t::halted:
+    s.state_ = session_state_t::finished;
+    if (--live_ == 0) {
+      done_cv_.notify_all();
+    }
+    break;
+  case stop_reason_t::waiting:
+    if (std::exchange(s.wake_pending_, false) || !until) {
+      enqueue(s);
+      break;
+    }
+    s.state_ = session_state_t::parked;
+    s.park_until_ = *until;
+    parked_.push_back(&s);
+    ++parks_;
+    // Let an idle worker know about the new deadline.
+    cv_.notify_one();
+    break;
+  default:
+    s.wake_pending_ = false;
+    enqueue(s);
+    break;
+  }
+}
+
+} // namespace door86::host
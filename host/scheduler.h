@@ -0,0 +1,112 @@
+#ifndef INCLUDED_HOST_SCHEDULER_H
+#define INCLUDED_HOST_SCHEDULER_H
+
+#include "host/session.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace door86::host {
+
+struct scheduler_options_t {
+  // Worker threads, 0 means one per hardware thread.
+  int workers{0};
+  // Longest a session runs before giving another one a turn.
+  std::chrono::microseconds slice{2000};
+  // 8088 cycles a session may run per slice, 0 for no limit.
+  uint64_t slice_cycles{0};
+  // Pins worker N to core N, so sessions that stay on their worker stay cache hot.
+  bool pin_workers{false};
+};
+
+/**
+ * Runs many sessions on a fixed pool of worker threads (M sessions on N
+ * threads).
+ *
+ * Each worker has its own run queue, and sessions go back to the queue of
+ * the worker that last ran them. Workers with nothing to do steal the longest
+ * waiting session from the other queues. Sessions run for one slice at a time (see
+ * CPU::run_for), and sessions waiting for input are parked until woken by
+ * Session::wake, or until their next device event or idle timeout
+ * (CPU::idle.max_park), see CPU::begin_wait.
+ */
+class Scheduler {
+public:
+  explicit Scheduler(const scheduler_options_t& options);
+  /** Stops the workers, sessions still running are abandoned */
+  ~Scheduler();
+  Scheduler(const Scheduler&) = delete;
+  Scheduler& operator=(const Scheduler&) = delete;
+
+  /** Adds session, which is runnable right away, returns it */
+  Session& add(std::unique_ptr<Session> session);
+
+  /** Starts the workers */
+  void start();
+
+  /** Stops the workers once they finish their current slices */
+  void stop();
+
+  /** Waits until every session added has finished */
+  void wait();
+
+  /** Makes session runnable if it's parked, see Session::wake */
+  void wake(Session& session);
+
+  int workers() const noexcept { return static_cast<int>(workers_.size()); }
+
+  // Statistics
+  uint64_t slices() const noexcept { return slices_; }
+  uint64_t steals() const noexcept { return steals_; }
+  uint64_t parks() const noexcept { return parks_; }
+
+private:
+  struct worker_t {
+    std::mutex mu;
+    std::deque<Session*> queue;
+    std::thread thread;
+  };
+
+  void run_worker(int n);
+  Session* pop(int n);
+  Session* steal(int n);
+  void run_slice(int n, Session& s);
+  // Puts s on its home worker's run queue. mu_ must be held.
+  void enqueue(Session& s);
+  // Makes parked sessions whose time is up runnable again.
+  void wake_due();
+
+  const scheduler_options_t options_;
+  std::vector<std::unique_ptr<worker_t>> workers_;
+
+  // Guards session state changes and the following.
+  std::mutex mu_;
+  // Idle workers wait on this for runnable sessions.
+  std::condition_variable cv_;
+  // wait() waits on this for sessions to finish.
+  std::condition_variable done_cv_;
+  std::vector<std::unique_ptr<Session>> sessions_;
+  std::vector<Session*> parked_;
+  // sessions not yet finished.
+  int live_{0};
+  // sessions in run queues, only incremented while holding mu_.
+  std::atomic<int> runnable_{0};
+  bool stopping_{false};
+  // worker to give the next new session to.
+  int next_home_{0};
+
+  std::atomic<uint64_t> slices_{0};
+  std::atomic<uint64_t> steals_{0};
+  std::atomic<uint64_t> parks_{0};
+};
+
+} // namespace door86::host
+
+#endif // INCLUDED_HOST_SCHEDULER_H
@@ -0,0 +1,189 @@
+#include <gtest/gtest.h>
+
+#include "cpu/x86/cpu_fixture.h"
+#include "host/scheduler.h"
+#include "host/session.h"
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+using namespace door86::cpu::x86;
+using namespace door86::host;
+using namespace std::chrono_literals;
+
+// MOV CX, 1000; XOR AX, AX; L: ADD AX, CX; DEC CX; JNZ L; INT 20
+static const std::string sum_loop = "B9E803 31C0 01C8 49 75FB CD20";
+static constexpr uint16_t sum_result = static_cast<uint16_t>(500500);
+
+// MOV DX, 10; L1: MOV CX, FFFF; L2: DEC CX; JNZ L2; DEC DX; JNZ L1; INT 20
+static const std::string long_loop = "BA0A00 B9FFFF 49 75FD 4A 75F7 CD20";
+
+static std::unique_ptr<Session> make_session(int id, const std::string& code) {
+  auto s = std::make_unique<Session>(id);
+  auto& c = s->cpu;
+  c.core.regs.x.ax = c.core.regs.x.bx = c.core.regs.x.cx = c.core.regs.x.dx = 0;
+  c.core.regs.x.si = c.core.regs.x.di = c.core.regs.x.bp = c.core.regs.x.sp = 0;
+  const auto ops = parse_opcodes_from_line(code);
+  c.memory.load_image(0x1000, ops.size(), ops.data());
+  c.core.sregs.cs = 0x100;
+  c.core.ip = 0;
+  return s;
+}
+
+TEST(SchedulerTest, RunsSessionsToCompletion) {
+  scheduler_options_t options;
+  options.workers = 2;
+  Scheduler sched(options);
+  std::vector<Session*> sessions;
+  for (int i = 0; i < 8; i++) {
+    sessions.push_back(&sched.add(make_session(i, sum_loop)));
+  }
+  sched.start();
+  sched.wait();
+  for (const auto* s : sessions) {
+    EXPECT_EQ(session_state_t::finished, s->state());
+    EXPECT_EQ(stop_reason_t::halted, s->last_stop());
+    EXPECT_EQ(sum_result, s->cpu.core.regs.x.ax);
+  }
+}
+
+TEST(SchedulerTest, TimeSlices) {
+  scheduler_options_t options;
+  options.workers = 1;
+  options.slice_cycles = 10000;
+  Scheduler sched(options);
+  auto& slow = sched.add(make_session(1, long_loop));
+  auto& fast = sched.add(make_session(2, sum_loop));
+  sched.start();
+  sched.wait();
+  EXPECT_EQ(sum_result, fast.cpu.core.regs.x.ax);
+  EXPECT_EQ(0, slow.cpu.core.regs.x.dx);
+  // The fast one finished while the slow one was still going.
+  EXPECT_GT(slow.slices(), fast.slices());
+  EXPECT_EQ(slow.slices() + fast.slices(), sched.slices());
+}
+
+TEST(SchedulerTest, ParkAndWake) {
+  scheduler_options_t options;
+  options.workers = 1;
+  Scheduler sched(options);
+  auto session = make_session(1, "31C0 CD16 CD20");
+  std::atomic<bool> key{false};
+  // INT 16h waits for a key, in place of the BIOS keyboard.
+  session->cpu.int_handlers().insert_or_assign(0x16, [&key](int, CPU& cpu) {
+    if (!key) {
+      cpu.wait_for_input();
+      return;
+    }
+    cpu.core.regs.x.ax = 0x1c0d;
+  });
+  session->cpu.idle.max_park = 10s;
+  // Stops the system timer, so only the key ends the park.
+  session->cpu.io.outb(0x43, 0x30);
+  auto& s = sched.add(std::move(session));
+  sched.start();
+
+  const auto start = std::chrono::steady_clock::now();
+  while (s.state() != session_state_t::parked && std::chrono::steady_clock::now() - start < 5s) {
+    std::this_thread::sleep_for(1ms);
+  }
+  ASSERT_EQ(session_state_t::parked, s.state());
+  key = true;
+  s.wake();
+  sched.wait();
+  EXPECT_EQ(0x1c0d, s.cpu.core.regs.x.ax);
+  EXPECT_EQ(1u, sched.parks());
+  // Woken long before max_park.
+  EXPECT_LT(std::chrono::steady_clock::now() - start, 5s);
+}
+
+#ifndef _WIN32
+
+TEST(SchedulerTest, AttachedSession) {
+  int fds[2];
+  ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+  scheduler_options_t options;
+  options.workers = 1;
+  Scheduler sched(options);
+  // MOV AH, 0; INT 16; MOV DL, AL; MOV AH, 2; INT 21; INT 20
+  auto& s = sched.add(make_session(1, "B400 CD16 88C2 B402 CD21 CD20"));
+  ASSERT_TRUE(s.attach(connection_t::keyboard, fds[0], fds[0]));
+  s.cpu.idle.max_park = 10s;
+  sched.start();
+
+  const auto start = std::chrono::steady_clock::now();
+  while (s.state() != session_state_t::parked && std::chrono::steady_clock::now() - start < 5s) {
+    std::this_thread::sleep_for(1ms);
+  }
+  ASSERT_EQ(session_state_t::parked, s.state());
+  // The keyboard's IO thread wakes the session.
+  ASSERT_EQ(1, write(fds[1], "x", 1));
+  sched.wait();
+  EXPECT_LT(std::chrono::steady_clock::now() - start, 5s);
+  s.detach();
+  // Console output went to the session's connection.
+  char out = 0;
+  EXPECT_EQ(1, read(fds[1], &out, 1));
+  EXPECT_EQ('x', out);
+  close(fds[0]);
+  close(fds[1]);
+}
+
+TEST(SchedulerTest, AttachedUart) {
+  int fds[2];
+  ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+  scheduler_options_t options;
+  options.workers = 1;
+  Scheduler sched(options);
+  // MOV DX, 3F8; MOV AL, 'y'; OUT DX, AL; INT 20
+  auto& s = sched.add(make_session(1, "BAF803 B079 EE CD20"));
+  ASSERT_TRUE(s.attach(connection_t::uart, fds[0], fds[0]));
+  sched.start();
+  sched.wait();
+  char out = 0;
+  EXPECT_EQ(1, read(fds[1], &out, 1));
+  EXPECT_EQ('y', out);
+  s.detach();
+  close(fds[0]);
+  close(fds[1]);
+}
+
+#endif
+
+TEST(SchedulerTest, HltWaitsForTimer) {
+  scheduler_options_t options;
+  options.workers = 1;
+  Scheduler sched(options);
+  // STI; HLT; INT 20
+  auto& s = sched.add(make_session(1, "FB F4 CD20"));
+  sched.start();
+  const auto start = std::chrono::steady_clock::now();
+  while (s.state() != session_state_t::finished && std::chrono::steady_clock::now() - start < 2s) {
+    std::this_thread::sleep_for(1ms);
+  }
+  // Parked until IRQ 0 was due, and woken by it.
+  EXPECT_EQ(session_state_t::finished, s.state());
+  EXPECT_GT(sched.parks(), 0u);
+  EXPECT_GE(s.cpu.cycles, 0x10000 * 4 / 2);
+}
+
+TEST(SchedulerTest, Steals) {
+  scheduler_options_t options;
+  options.workers = 2;
+  options.slice_cycles = 10000;
+  Scheduler sched(options);
+  // Two for the first worker, one for the second.
+  for (int i = 0; i < 3; i++) {
+    sched.add(make_session(i, long_loop));
+  }
+  sched.start();
+  sched.wait();
+  EXPECT_GT(sched.steals(), 0u);
+}
@@ -0,0 +1,96 @@
+#include "host/session.h"
+
+#include "core/log.h"
+#include "host/scheduler.h"
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace door86::host {
+
+using door86::cpu::x86::CPU;
+
+// Sets up the clock before the BIOS reads it.
+static CPU* with_clock(CPU& cpu, const session_options_t& options) {
+  if (options.virtual_time) {
+    cpu.time.set_virtual();
+  }
+  return &cpu;
+}
+
+// Console output of a session with no connection.
+static size_t discard(const char*, size_t size) { return size; }
+
+Session::Session(int id, const session_options_t& options)
+    : bios(with_clock(cpu, options)), fossil(&cpu), uart(&cpu), dos(&cpu), id_(id) {
+  bios.keyboard.on_input = [this] { wake(); };
+  fossil.on_input = [this] { wake(); };
+  uart.on_input = [this] { wake(); };
+  cpu.output.set_sink(discard);
+}
+
+Session::Session(int id, std::shared_ptr<const door86::cpu::MemoryImage> base,
+                 const session_options_t& options)
+    : cpu(std::move(base)), bios(with_clock(cpu, options)), fossil(&cpu), uart(&cpu), dos(&cpu),
+      id_(id) {
+  bios.keyboard.on_input = [this] { wake(); };
+  fossil.on_input = [this] { wake(); };
+  uart.on_input = [this] { wake(); };
+  cpu.output.set_sink(discard);
+}
+
+Session::~Session() { detach(); }
+
+bool Session::load(const std::filesystem::path& filename) {
+  if (!dos.initialize_process(filename)) {
+    LOG(ERROR) << "Session " << id_ << ": Failed to initialize DOS process: " << filename.string();
+    return false;
+  }
+  cpu.core.regs.x.ax = 2; // drive C
+  return true;
+}
+
+bool Session::attach(connection_t device, int in_fd, int out_fd) {
+  detach();
+  if (in_fd >= 0) {
+    bool attached = false;
+    switch (device) {
+    case connection_t::keyboard: attached = bios.keyboard.attach(in_fd); break;
+    case connection_t::fossil: attached = fossil.attach(in_fd, out_fd); break;
+    case connection_t::uart: attached = uart.attach(in_fd, out_fd); break;
+    }
+    if (!attached) {
+      LOG(ERROR) << "Session " << id_ << ": Unable to attach to fd " << in_fd;
+      return false;
+    }
+  }
+  cpu.output.set_sink([out_fd](const char* data, size_t size) -> size_t {
+#ifdef _WIN32
+    const auto n = _write(out_fd, data, static_cast<unsigned>(size));
+#else
+    const auto n = ::write(out_fd, data, size);
+#endif
+    return n > 0 ? static_cast<size_t>(n) : 0;
+  });
+  return true;
+}
+
+void Session::detach() {
+  bios.keyboard.detach();
+  fossil.detach();
+  uart.detach();
+  cpu.output.flush();
+  cpu.output.set_sink(discard);
+}
+
+void Session::wake() {
+  cpu.idle.wake();
+  if (scheduler_) {
+    scheduler_->wake(*this);
+  }
+}
+
+} // namespace door86::host
@@ -0,0 +1,109 @@
+#ifndef INCLUDED_HOST_SESSION_H
+#define INCLUDED_HOST_SESSION_H
+
+#include "bios/bios.h"
+#include "bios/fossil.h"
+#include "bios/uart.h"
+#include "cpu/x86/cpu.h"
+#include "dos/dos.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+
+namespace door86::host {
+
+class Scheduler;
+
+enum class session_state_t {
+  // waiting in a run queue for a worker.
+  runnable,
+  // on a worker.
+  running,
+  // waiting for input or a timer, see Scheduler::wake.
+  parked,
+  // the program exited.
+  finished
+};
+
+// What reads the caller's input, see Session::attach.
+enum class connection_t { keyboard, fossil, uart };
+
+struct session_options_t {
+  // See GuestClock::set_virtual.
+  bool virtual_time{false};
+};
+
+/**
+ * One running door program: the CPU with the BIOS, DOS and serial services it
+ * uses, and its connection to the caller.
+ *
+ * Sessions are run by a Scheduler a time slice at a time. The devices hold
+ * onto the CPU, so sessions can't be copied or moved.
+ */
+class Session {
+public:
+  explicit Session(int id, const session_options_t& options = {});
+  // A session whose memory starts out as a copy-on-write mapping of base, see ImageCache.
+  Session(int id, std::shared_ptr<const door86::cpu::MemoryImage> base,
+          const session_options_t& options = {});
+  ~Session();
+  Session(const Session&) = delete;
+  Session& operator=(const Session&) = delete;
+
+  /** Loads the program in filename, ready to run */
+  bool load(const std::filesystem::path& filename);
+
+  /**
+   * Connects the session to the caller: device reads input from in_fd, and
+   * console output (and what device transmits) goes to out_fd, which may be
+   * the same descriptor (i.e. a socket). in_fd may be -1 to only send output
+   * (i.e. when the input is replayed). Until then console output is thrown
+   * away. Call this while the session isn't running. Returns false if device's
+   * IO thread couldn't be started.
+   */
+  bool attach(connection_t device, int in_fd, int out_fd);
+  /** Stops the IO threads, and throws console output away again. */
+  void detach();
+
+  /**
+   * Lets the program continue if it's waiting for input. Call this whenever
+   * input arrives for the session, from any thread.
+   */
+  void wake();
+
+  int id() const noexcept { return id_; }
+  session_state_t state() const noexcept { return state_; }
+  // Why the last time slice ended.
+  door86::cpu::x86::stop_reason_t last_stop() const noexcept { return last_stop_; }
+  // Time slices run so far.
+  uint64_t slices() const noexcept { return slices_; }
+
+  door86::cpu::x86::CPU cpu;
+  door86::bios::Bios bios;
+  door86::bios::Fossil fossil;
+  door86::bios::Uart uart;
+  door86::dos::Dos dos;
+
+private:
+  friend class Scheduler;
+
+  const int id_;
+  // The following are owned by the scheduler.
+  Scheduler* scheduler_{nullptr};
+  std::atomic<session_state_t> state_{session_state_t::runnable};
+  // worker whose queue the session goes back to.
+  int home_{0};
+  // wake() was called while running, so don't park.
+  bool wake_pending_{false};
+  // when to run again if nothing wakes us first.
+  std::chrono::steady_clock::time_point park_until_{};
+  door86::cpu::x86::stop_reason_t last_stop_{door86::cpu::x86::stop_reason_t::budget};
+  uint64_t slices_{0};
+};
+
+} // namespace door86::host
+
+#endif // INCLUDED_HOST_SESSION_H